@@ -1,5 +1,7 @@
--- not efficient, in fact painfully inefficient,
--- but seems to work with quad faces in 3d; not as sure about 4 yet...
+-- module.refine uses dimensional.catmullClarkSubdivision; module.refineLua is the original
+-- version, kept for comparison. It's not efficient, in fact painfully inefficient, but seems to
+-- work with quad faces in 3d; in 4d it divides by the number of faces around a point where it
+-- should divide by the number of lines, which shrinks the shape (see src/catmullClark.h).
 
 local module = {}
 
@@ -109,7 +111,7 @@ local mapLinesToFaces = function(faces, lines)
 end
 module.mapLinesToFaces = mapLinesToFaces
 
-module.refine = function(lines, points)
+module.refineLua = function(lines, points)
     local newPoints, newLines = {}, {}
 
     local faces = facesFromLines(lines)
@@ -214,4 +216,10 @@ module.refine = function(lines, points)
     }
 end
 
+-- levels defaults to 1; the result also includes the faces, so it can be passed straight back in
+-- as dimensional.catmullClarkSubdivision(result.points, result.lines, result.faces)
+module.refine = function(lines, points, levels)
+    return dimensional.catmullClarkSubdivision(points, lines, levels)
+end
+
 return module
@@ -38,75 +38,36 @@ wEyeD  = 2
 scale  = 1
 offset = 1
 
-projectXYZ = function(x,y,z,w)
-    return scale * wEyeD * x / (wEyeD + scale * w + offset),
-           scale * wEyeD * y / (wEyeD + scale * w + offset),
-           scale * wEyeD * z / (wEyeD + scale * w + offset)
-end
+-- dimensional.projectCoordinatesDown does this for every point at once:
+--     x, y, z = scale * wEyeD * { x, y, z } / (wEyeD + scale * w + offset)
 
 module.lines = fourLines
 module.default4Points = default4Points
 
--- cache sin and cos
-local oldSin = {}
-local oldCos = {}
-
-module.cachedSin = oldSin
-module.cachedCos = oldCos
+-- packed once, so each frame only has to project them
+module.pointBuffer = dimensional.pointBuffer(default4Points)
+module.lineBuffer  = dimensional.indexBuffer(fourLines)
 
-local sin = function(d)
-    if not oldSin[d] then oldSin[d] = math.sin(math.rad(d)) end
-    return oldSin[d]
-end
-
-local cos = function(d)
-    if not oldCos[d] then oldCos[d] = math.cos(math.rad(d)) end
-    return oldCos[d]
-end
-
--- pre-build
-for d = 1, 360, 1 do
-    cos(d)
-    sin(d)
-end
+module.identity = dimensional.transform(4)
+module.rotation = dimensional.transform(4)
 
 -- https://math.stackexchange.com/a/3311905
 -- https://en.wikipedia.org/wiki/Rotations_in_4-dimensional_Euclidean_space
-local commonRotater = function(coords, increment, count, delay)
+local commonRotater = function(axes, increment, count, delay)
     increment = increment or 5
     count     = count or 1
     delay     = delay or .02
 
-    local mat = uitk.util.matrix4.identity()
     local fn
     fn = coroutine.wrap(function()
         local c = 0
-        local c11 = coords[1][1]
-        local c12 = coords[1][2]
-        local c21 = coords[2][1]
-        local c22 = coords[2][2]
-        local c31 = coords[3][1]
-        local c32 = coords[3][2]
-        local c41 = coords[4][1]
-        local c42 = coords[4][2]
-
         while c < count do
             c = c + 1
             local d = 0
             while d < 360 do
                 d = d + increment
-                local cosOfD = cos(d)
-                local sinOfD = sin(d)
-                mat[c11][c12] =  cosOfD
-                mat[c21][c22] = -sinOfD
-                mat[c31][c32] =  sinOfD
-                mat[c41][c42] =  cosOfD
-
-                -- fyi moving matrix multiplication into obj-c doesn't help -- transfer in and out of
-                -- larger points table takes more time than actually just doing it in lua
-                local n4p = {}
-                for i = 1, #module.default4Points, 1 do n4p[i] = mat * module.default4Points[i] end
-                module.genPoints(n4p)
+                -- the rotation and the projection happen in one pass over the points
+                module.genPoints(module.rotation:reset():rotate(axes[1], axes[2], math.rad(d)))
 
                 repeat
                     coroutine.applicationYield(delay)
@@ -122,7 +83,7 @@ local commonRotater = function(coords, increment, count, delay)
             end
         end
         fn = nil
-        module.genPoints(module.default4Points)
+        module.genPoints()
     end)
     fn()
 end
@@ -146,13 +107,11 @@ module.lineGeometry:firstMaterial():diffuse():contents({green = 1})
 module.lineGeometry:firstMaterial():specular():contents({white = 1})
 module.lineGeometry:firstMaterial():shininess(0.15)
 
--- update point positions to reflect their projection into 3space
-module.genPoints = function(fp)
-    module.points = {}
-    for i, v in ipairs(fp) do
-        local x, y, z = projectXYZ(v[1], v[2], v[3], v[4])
-        table.insert(module.points, { x, y, z })
-    end
+-- update point positions to reflect their projection into 3space, after the transform if given
+module.genPoints = function(transform)
+    transform = transform or module.identity
+    -- reuses the buffer from the last frame
+    module.points = transform:project(module.pointBuffer, wEyeD, scale, offset, 3, module.points)
 
     -- in case it's changed
     module.pointGeometry:radius(module.pointRadius)
@@ -164,7 +123,7 @@ module.genPoints = function(fp)
 -- external obj-c the rest of this function and invoke like:
    dimensional.generate3dObject(
       module.points,
-      module.lines,
+      module.lineBuffer,
       points,
       lines,
       module.pointNode,
@@ -225,36 +184,30 @@ module.w = uitk.window{x = 100, y = 100, h = 500, w = 500 }:content(module.scene
 module.scene:rootNode():addChildNode(module.objectNode)
 
 module.rotateZWfixed = function(...)
-    local coords = { { 1, 1 }, { 1, 2 }, { 2, 1 }, { 2, 2 } }
-    commonRotater(coords, ...)
+    commonRotater({ 1, 2 }, ...)
 end
 
 module.rotateYWfixed = function(...)
-    local coords = { { 1, 1 }, { 1, 3 }, { 3, 1 }, { 3, 3 } }
-    commonRotater(coords, ...)
+    commonRotater({ 1, 3 }, ...)
 end
 
 module.rotateYZfixed = function(...)
-    local coords = { { 1, 1 }, { 1, 4 }, { 4, 1 }, { 4, 4 } }
-    commonRotater(coords, ...)
+    commonRotater({ 1, 4 }, ...)
 end
 
 module.rotateXWfixed = function(...)
-    local coords = { { 2, 2 }, { 2, 3 }, { 3, 2 }, { 3, 3 } }
-    commonRotater(coords, ...)
+    commonRotater({ 2, 3 }, ...)
 end
 
 module.rotateXZfixed = function(...)
-    local coords = { { 2, 2 }, { 2, 4 }, { 4, 2 }, { 4, 4 } }
-    commonRotater(coords, ...)
+    commonRotater({ 2, 4 }, ...)
 end
 
 module.rotateXYfixed = function(...)
-    local coords = { { 3, 3 }, { 3, 4 }, { 4, 3 }, { 4, 4 } }
-    commonRotater(coords, ...)
+    commonRotater({ 3, 4 }, ...)
 end
 
-module.genPoints(module.default4Points)
+module.genPoints()
 
 return module
 
@@ -0,0 +1,296 @@
+// Benchmark for finding faces with ../src/meshFaces.h
+//
+// Builds a few kinds of mesh over a range of sizes -- hypercubes (the tesseract is the 32 line one),
+// cubes with each side divided into a grid as subdivision leaves them, and flat grids split into
+// triangles -- and times how long finding their faces takes. For the smaller meshes, and for
+// random tangles of lines with shared endpoints, loops and duplicate lines thrown in, the result is
+// also checked against a straight C copy of the original search from libdimensional.m (timed in the
+// "original ms" column; it is still far quicker than the Objective-C version was, since it doesn't
+// box every number it looks at), with the lines shuffled so the order they're given in is tested too.
+//
+//     make
+//     ./facesBenchmark [maxLines]
+//
+// maxLines (default 100000) limits how large the largest meshes get.
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <time.h>
+
+#include "meshFaces.h"
+
+#pragma mark - Meshes
+
+typedef struct {
+    char    name[32] ;
+    int64_t *endpoints ;
+    size_t  count ;
+    size_t  capacity ;
+    bool    triangles ;  // whether faces should be searched for with triangles included
+} mesh ;
+
+static void mesh_addLine(mesh *m, int64_t from, int64_t to) {
+    if (m->count == m->capacity) {
+        m->capacity  = (m->capacity > 0) ? m->capacity * 2 : 64 ;
+        m->endpoints = realloc(m->endpoints, m->capacity * 2 * sizeof(int64_t)) ;
+        if (!m->endpoints) {
+            fprintf(stderr, "out of memory\n") ;
+            exit(1) ;
+        }
+    }
+    m->endpoints[m->count * 2]     = from ;
+    m->endpoints[m->count * 2 + 1] = to ;
+    m->count++ ;
+}
+
+// points are numbered from 1, as they are in Lua
+static void mesh_hypercube(mesh *m, int dimensions) {
+    snprintf(m->name, sizeof(m->name), "%d-cube", dimensions) ;
+    for (int64_t point = 0 ; point < ((int64_t)1 << dimensions) ; point++) {
+        for (int axis = 0 ; axis < dimensions ; axis++) {
+            if (!(point & ((int64_t)1 << axis))) mesh_addLine(m, point + 1, (point | ((int64_t)1 << axis)) + 1) ;
+        }
+    }
+}
+
+// the surface of a cube with each side divided into divisions x divisions squares
+static void mesh_subdividedCube(mesh *m, int divisions) {
+    snprintf(m->name, sizeof(m->name), "cube %dx%d", divisions, divisions) ;
+    int64_t side = divisions + 1 ;
+    for (int64_t x = 0 ; x < side ; x++) {
+        for (int64_t y = 0 ; y < side ; y++) {
+            for (int64_t z = 0 ; z < side ; z++) {
+                int64_t p[3] = { x, y, z } ;
+                for (int axis = 0 ; axis < 3 ; axis++) {
+                    if (p[axis] == divisions) continue ;
+                    // the line lies on the surface if one of the other coordinates is on a side
+                    bool onSurface = false ;
+                    for (int other = 0 ; other < 3 ; other++) {
+                        if (other != axis && (p[other] == 0 || p[other] == divisions)) onSurface = true ;
+                    }
+                    if (!onSurface) continue ;
+                    int64_t q[3] = { x, y, z } ;
+                    q[axis]++ ;
+                    mesh_addLine(m, 1 + p[0] + p[1] * side + p[2] * side * side,
+                                    1 + q[0] + q[1] * side + q[2] * side * side) ;
+                }
+            }
+        }
+    }
+}
+
+// a flat grid with every square cut across one diagonal
+static void mesh_triangleGrid(mesh *m, int divisions) {
+    snprintf(m->name, sizeof(m->name), "triangles %dx%d", divisions, divisions) ;
+    m->triangles = true ;
+    int64_t side = divisions + 1 ;
+    for (int64_t y = 0 ; y < side ; y++) {
+        for (int64_t x = 0 ; x < side ; x++) {
+            int64_t point = 1 + x + y * side ;
+            if (x < divisions) mesh_addLine(m, point, point + 1) ;
+            if (y < divisions) mesh_addLine(m, point, point + side) ;
+            if (x < divisions && y < divisions) mesh_addLine(m, point, point + side + 1) ;
+        }
+    }
+}
+
+static uint64_t randomState = 0x9e3779b97f4a7c15ULL ;
+
+static uint64_t nextRandom(void) {
+    randomState ^= randomState << 13 ;
+    randomState ^= randomState >> 7 ;
+    randomState ^= randomState << 17 ;
+    return randomState ;
+}
+
+static void mesh_tangle(mesh *m, int lines, int points) {
+    snprintf(m->name, sizeof(m->name), "tangle %d/%d", lines, points) ;
+    m->triangles = (lines % 2) == 1 ;
+    for (int i = 0 ; i < lines ; i++) {
+        mesh_addLine(m, (int64_t)(nextRandom() % (uint64_t)points) + 1, (int64_t)(nextRandom() % (uint64_t)points) + 1) ;
+    }
+}
+
+// reorders the lines and which way round they go; the faces are found in terms of line numbers,
+// so the searches should still agree
+static void mesh_shuffle(mesh *m) {
+    for (size_t i = m->count ; i > 1 ; i--) {
+        size_t  j = (size_t)(nextRandom() % i) ;
+        int64_t from = m->endpoints[(i - 1) * 2], to = m->endpoints[(i - 1) * 2 + 1] ;
+        m->endpoints[(i - 1) * 2]     = m->endpoints[j * 2] ;
+        m->endpoints[(i - 1) * 2 + 1] = m->endpoints[j * 2 + 1] ;
+        m->endpoints[j * 2]           = (nextRandom() & 1) ? from : to ;
+        m->endpoints[j * 2 + 1]       = (m->endpoints[j * 2] == from) ? to : from ;
+    }
+}
+
+#pragma mark - Original search
+
+// the search facesFromLines used to do: every ordered choice of 4 different lines, each touching
+// the next, which between them use 4 points exactly twice each, kept unless the same 4 lines were
+// already found; triangles are tried the same way when asked for
+static void originalSearch(const mesh *m, meshFaceList *found) {
+    const int64_t *e = m->endpoints ;
+    size_t        n  = m->count ;
+    found->count = 0 ;
+
+#define touches(i, j) (e[(i) * 2] == e[(j) * 2] || e[(i) * 2] == e[(j) * 2 + 1] || \
+                       e[(i) * 2 + 1] == e[(j) * 2] || e[(i) * 2 + 1] == e[(j) * 2 + 1])
+
+    for (size_t a = 0 ; a < n ; a++) {
+        for (size_t b = 0 ; b < n ; b++) {
+            if (a == b) continue ;
+            for (size_t c = 0 ; c < n ; c++) {
+                if (a == c || b == c) continue ;
+                for (size_t d = (m->triangles ? 0 : 1) ; d <= n ; d++) {
+                    // d == 0 stands for no fourth line
+                    size_t lines[4] = { a, b, c, d - 1 } ;
+                    size_t sides    = (d == 0) ? 3 : 4 ;
+                    if (sides == 4 && (a == d - 1 || b == d - 1 || c == d - 1)) continue ;
+
+                    bool closed = true ;
+                    for (size_t i = 0 ; i < sides ; i++) closed = closed && touches(lines[i], lines[(i + 1) % sides]) ;
+                    if (!closed) continue ;
+
+                    int64_t points[8] ;
+                    int     counts[8] ;
+                    size_t  distinct = 0 ;
+                    for (size_t i = 0 ; i < sides * 2 ; i++) {
+                        int64_t point = e[lines[i / 2] * 2 + (i % 2)] ;
+                        size_t  j     = 0 ;
+                        while (j < distinct && points[j] != point) j++ ;
+                        if (j == distinct) {
+                            points[distinct]   = point ;
+                            counts[distinct++] = 0 ;
+                        }
+                        counts[j]++ ;
+                    }
+                    bool isBad = false ;
+                    for (size_t i = 0 ; i < distinct ; i++) isBad = isBad || (counts[i] != 2) ;
+                    if (isBad) continue ;
+
+                    bool alreadySeen = false ;
+                    for (size_t f = 0 ; f < found->count && !alreadySeen ; f++) {
+                        const meshFace *face = &found->faces[f] ;
+                        if (meshFaces_sides(face) != sides) continue ;
+                        alreadySeen = true ;
+                        for (size_t i = 0 ; i < sides ; i++) {
+                            bool contains = false ;
+                            for (size_t j = 0 ; j < sides ; j++) contains = contains || (face->lines[j] == lines[i] + 1) ;
+                            alreadySeen = alreadySeen && contains ;
+                        }
+                    }
+                    if (!alreadySeen) meshFaces_add(found, (uint32_t)a, (uint32_t)b, (uint32_t)c, (sides == 3) ? UINT32_MAX : (uint32_t)(d - 1)) ;
+                }
+            }
+        }
+    }
+#undef touches
+
+    // with triangles in, the loops above find a line's quads before its triangles
+    qsort(found->faces, found->count, sizeof(meshFace), meshFaces_compareFaces) ;
+}
+
+#pragma mark - Running
+
+static double now(void) {
+    struct timespec ts ;
+    clock_gettime(CLOCK_MONOTONIC, &ts) ;
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9 ;
+}
+
+static size_t originalLimit = 200 ;
+
+static bool run(mesh *m, meshFaceList *list, meshFaceList *reference) {
+    if (m->count <= originalLimit) mesh_shuffle(m) ;
+
+    // repeated until at least a tenth of a second has gone by, so small meshes get a steady time
+    size_t repeats = 0 ;
+    double start   = now(), elapsed = 0.0 ;
+    do {
+        if (!meshFaces_find(list, m->endpoints, m->count, m->triangles)) {
+            fprintf(stderr, "out of memory\n") ;
+            exit(1) ;
+        }
+        repeats++ ;
+        elapsed = now() - start ;
+    } while (elapsed < 0.1) ;
+
+    size_t triangles = 0 ;
+    for (size_t i = 0 ; i < list->count ; i++) triangles += (meshFaces_sides(&list->faces[i]) == 3) ;
+
+    char   original[32] = "-", matches[8] = "-" ;
+    bool   same         = true ;
+    if (m->count <= originalLimit) {
+        start = now() ;
+        originalSearch(m, reference) ;
+        snprintf(original, sizeof(original), "%.3f", (now() - start) * 1000.0) ;
+        same = (reference->count == list->count) &&
+               (list->count == 0 || memcmp(reference->faces, list->faces, list->count * sizeof(meshFace)) == 0) ;
+        snprintf(matches, sizeof(matches), "%s", same ? "yes" : "NO") ;
+    }
+
+    printf("%-16s %10zu %10zu %10zu %12.3f %12s %8s\n", m->name, m->count, list->count - triangles, triangles,
+           elapsed * 1000.0 / (double)repeats, original, matches) ;
+
+    free(m->endpoints) ;
+    return same ;
+}
+
+int main(int argc, char **argv) {
+    size_t maxLines = (argc > 1) ? (size_t)strtoull(argv[1], NULL, 10) : 100000 ;
+
+    meshFaceList list, reference ;
+    meshFaces_init(&list) ;
+    meshFaces_init(&reference) ;
+    bool allSame = true ;
+
+    printf("%-16s %10s %10s %10s %12s %12s %8s\n", "mesh", "lines", "quads", "triangles", "ms", "original ms", "matches") ;
+
+    for (int dimensions = 4 ; dimensions <= 16 ; dimensions++) {
+        mesh m = { 0 } ;
+        mesh_hypercube(&m, dimensions) ;
+        if (m.count > maxLines) {
+            free(m.endpoints) ;
+            break ;
+        }
+        allSame = run(&m, &list, &reference) && allSame ;
+    }
+
+    int divisions[] = { 1, 2, 3, 10, 30, 60, 90 } ;
+    for (size_t i = 0 ; i < sizeof(divisions) / sizeof(int) ; i++) {
+        mesh m = { 0 } ;
+        mesh_subdividedCube(&m, divisions[i]) ;
+        if (m.count > maxLines) {
+            free(m.endpoints) ;
+            break ;
+        }
+        allSame = run(&m, &list, &reference) && allSame ;
+    }
+
+    for (size_t i = 0 ; i < sizeof(divisions) / sizeof(int) ; i++) {
+        mesh m = { 0 } ;
+        mesh_triangleGrid(&m, divisions[i] * 2) ;
+        if (m.count > maxLines) {
+            free(m.endpoints) ;
+            break ;
+        }
+        allSame = run(&m, &list, &reference) && allSame ;
+    }
+
+    for (int i = 0 ; i < 20 ; i++) {
+        mesh m = { 0 } ;
+        mesh_tangle(&m, 20 + i * 7, 6 + i) ;
+        allSame = run(&m, &list, &reference) && allSame ;
+    }
+
+    meshFaces_free(&list) ;
+    meshFaces_free(&reference) ;
+
+    if (!allSame) {
+        fprintf(stderr, "faces found don't match the original search\n") ;
+        return 1 ;
+    }
+    return 0 ;
+}
@@ -0,0 +1,282 @@
+// Check and benchmark for the frame to frame change tracking in ../src/geometryDiff.h
+//
+// Animates grids of points, joined by lines to their neighbours, through a run of frames: each
+// frame moves some of the points (a few by less than epsilon), and now and then the mesh grows,
+// shrinks or has lines joined to different points. A copy of the nodes generate3dObject would keep
+// is updated with only what geometryDiff says changed, the way the module does, and after every
+// frame it's checked that
+//
+//   * a point was marked changed exactly when it moved more than epsilon from where it was drawn
+//     or is new, and a line exactly when it's new, joins different points or either end changed
+//   * every point node is within epsilon of its point (or, like it, NaN)
+//   * every line node joins the right points and is drawn between where those point nodes are
+//
+// and the time taken per frame is reported along with how many nodes it touched. A point which
+// becomes NaN, stays NaN and then recovers is checked to be redrawn, with its lines, each time.
+//
+//     make
+//     ./geometryDiffBenchmark
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "geometryDiff.h"
+
+static double now(void) {
+    struct timespec ts ;
+    clock_gettime(CLOCK_MONOTONIC, &ts) ;
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9 ;
+}
+
+static uint64_t randomState = 0x9e3779b97f4a7c15ULL ;
+
+static uint64_t nextRandom(void) {
+    randomState ^= randomState << 13 ;
+    randomState ^= randomState >> 7 ;
+    randomState ^= randomState << 17 ;
+    return randomState ;
+}
+
+static double nextUnit(void) {
+    return (double)(nextRandom() >> 11) / (double)(1ULL << 53) ;
+}
+
+static void *allocate(size_t size) {
+    void *memory = malloc(size > 0 ? size : 1) ;
+    if (!memory) {
+        fprintf(stderr, "out of memory\n") ;
+        exit(1) ;
+    }
+    return memory ;
+}
+
+#define STRIDE 4  // points carry a 4th component, as they do before being projected down
+
+static const double epsilon = 1e-4 ;
+
+typedef struct {
+    double  *points ;      // count * STRIDE
+    int32_t *lines ;       // lineCount * 2, 1 based
+    size_t  count ;
+    size_t  lineCount ;
+    double  *pointNodes ;  // where each point node is, 3 per node
+    double  *lineNodes ;   // where each line node's ends are, 6 per node
+    int32_t *lineJoins ;   // which points each line node was drawn for
+    size_t  pointNodeCount ;
+    size_t  lineNodeCount ;
+} scene ;
+
+// a side x side grid with each point joined to the next in its row and column
+static void scene_build(scene *s, size_t side) {
+    s->count     = side * side ;
+    s->lineCount = 0 ;
+    s->points    = allocate(s->count * STRIDE * sizeof(double)) ;
+    s->lines     = allocate(s->count * 2 * 2 * sizeof(int32_t)) ;
+    for (size_t i = 0 ; i < s->count ; i++) {
+        s->points[i * STRIDE]     = (double)(i % side) ;
+        s->points[i * STRIDE + 1] = (double)(i / side) ;
+        s->points[i * STRIDE + 2] = 0.0 ;
+        s->points[i * STRIDE + 3] = 1.0 ;
+        if (i % side + 1 < side) {
+            s->lines[s->lineCount * 2]     = (int32_t)i + 1 ;
+            s->lines[s->lineCount * 2 + 1] = (int32_t)i + 2 ;
+            s->lineCount++ ;
+        }
+        if (i + side < s->count) {
+            s->lines[s->lineCount * 2]     = (int32_t)i + 1 ;
+            s->lines[s->lineCount * 2 + 1] = (int32_t)(i + side) + 1 ;
+            s->lineCount++ ;
+        }
+    }
+    s->pointNodes     = allocate(s->count * 3 * sizeof(double)) ;
+    s->lineNodes      = allocate(s->lineCount * 6 * sizeof(double)) ;
+    s->lineJoins      = allocate(s->lineCount * 2 * sizeof(int32_t)) ;
+    s->pointNodeCount = 0 ;
+    s->lineNodeCount  = 0 ;
+}
+
+static void scene_free(scene *s) {
+    free(s->points) ;
+    free(s->lines) ;
+    free(s->pointNodes) ;
+    free(s->lineNodes) ;
+    free(s->lineJoins) ;
+}
+
+// moves about `fraction` of the points; a quarter of those by less than epsilon
+static void scene_move(scene *s, double fraction) {
+    for (size_t i = 0 ; i < s->count ; i++) {
+        if (nextUnit() >= fraction) continue ;
+        double step = (nextUnit() < 0.25) ? epsilon * 0.5 : 0.01 ;
+        for (size_t c = 0 ; c < STRIDE ; c++) s->points[i * STRIDE + c] += step * (nextUnit() * 2.0 - 1.0) ;
+    }
+}
+
+// drops or restores up to a tenth of the points and the lines that use them, keeping lines in range
+static void scene_resize(scene *s, size_t fullCount, size_t fullLineCount) {
+    size_t count = fullCount - (size_t)(nextRandom() % (fullCount / 10 + 1)) ;
+    size_t lines = 0 ;
+    while (lines < fullLineCount && s->lines[lines * 2] <= (int32_t)count && s->lines[lines * 2 + 1] <= (int32_t)count) lines++ ;
+    s->count     = count ;
+    s->lineCount = lines ;
+}
+
+// joins a few lines to different points
+static void scene_rewire(scene *s) {
+    for (size_t n = 0 ; n < 3 && s->lineCount > 0 ; n++) {
+        size_t line = (size_t)(nextRandom() % s->lineCount) ;
+        s->lines[line * 2 + 1] = (int32_t)(nextRandom() % s->count) + 1 ;
+    }
+}
+
+// what geometryDiff_update should decide, worked out from the nodes rather than the diff
+static bool scene_checkFlags(const scene *s, const geometryDiff *diff) {
+    for (size_t i = 0 ; i < s->count ; i++) {
+        bool expected = (i >= s->pointNodeCount) ;
+        for (size_t c = 0 ; c < 3 && !expected ; c++) {
+            expected = !(fabs(s->points[i * STRIDE + c] - s->pointNodes[i * 3 + c]) <= epsilon) ;
+        }
+        if ((bool)diff->pointChanged[i] != expected) return false ;
+    }
+    for (size_t i = 0 ; i < s->lineCount ; i++) {
+        int32_t from     = s->lines[i * 2], to = s->lines[i * 2 + 1] ;
+        bool    expected = (i >= s->lineNodeCount) ||
+                           s->lineJoins[i * 2] != from || s->lineJoins[i * 2 + 1] != to ||
+                           diff->pointChanged[from - 1] || diff->pointChanged[to - 1] ;
+        if ((bool)diff->lineChanged[i] != expected) return false ;
+    }
+    return true ;
+}
+
+// updates the nodes the way generate3dObject does: only the changed ones, growing or shrinking at
+// the end; line nodes are drawn between where their point nodes are
+static void scene_draw(scene *s, const geometryDiff *diff) {
+    for (size_t i = 0 ; i < s->count ; i++) {
+        if (!diff->pointChanged[i]) continue ;
+        memcpy(&s->pointNodes[i * 3], &s->points[i * STRIDE], 3 * sizeof(double)) ;
+    }
+    s->pointNodeCount = s->count ;
+    for (size_t i = 0 ; i < s->lineCount ; i++) {
+        if (!diff->lineChanged[i]) continue ;
+        int32_t from = s->lines[i * 2], to = s->lines[i * 2 + 1] ;
+        memcpy(&s->lineNodes[i * 6],     &diff->positions[(size_t)(from - 1) * 3], 3 * sizeof(double)) ;
+        memcpy(&s->lineNodes[i * 6 + 3], &diff->positions[(size_t)(to - 1) * 3],   3 * sizeof(double)) ;
+        s->lineJoins[i * 2]     = from ;
+        s->lineJoins[i * 2 + 1] = to ;
+    }
+    s->lineNodeCount = s->lineCount ;
+}
+
+static bool scene_checkNodes(const scene *s) {
+    for (size_t i = 0 ; i < s->count ; i++) {
+        for (size_t c = 0 ; c < 3 ; c++) {
+            double point = s->points[i * STRIDE + c], node = s->pointNodes[i * 3 + c] ;
+            if (!(fabs(point - node) <= epsilon) && !(isnan(point) && isnan(node))) return false ;
+        }
+    }
+    for (size_t i = 0 ; i < s->lineCount ; i++) {
+        int32_t from = s->lines[i * 2], to = s->lines[i * 2 + 1] ;
+        if (s->lineJoins[i * 2] != from || s->lineJoins[i * 2 + 1] != to) return false ;
+        if (memcmp(&s->lineNodes[i * 6],     &s->pointNodes[(size_t)(from - 1) * 3], 3 * sizeof(double)) != 0) return false ;
+        if (memcmp(&s->lineNodes[i * 6 + 3], &s->pointNodes[(size_t)(to - 1) * 3],   3 * sizeof(double)) != 0) return false ;
+    }
+    return true ;
+}
+
+// a point in the middle of a small grid becomes NaN for two frames and then recovers; it and the
+// lines joined to it have to be redrawn on each of those frames
+static bool checkNaN(void) {
+    scene s ;
+    scene_build(&s, 4) ;
+    geometryDiff diff ;
+    geometryDiff_init(&diff) ;
+
+    size_t nanPoint = 5 ;
+    double original = s.points[nanPoint * STRIDE] ;
+    bool   correct  = true ;
+    for (size_t frame = 0 ; frame < 4 && correct ; frame++) {
+        s.points[nanPoint * STRIDE] = (frame == 1 || frame == 2) ? NAN : original ;
+        if (!geometryDiff_update(&diff, s.points, s.count, STRIDE, s.lines, s.lineCount, epsilon)) {
+            fprintf(stderr, "out of memory\n") ;
+            exit(1) ;
+        }
+        correct = scene_checkFlags(&s, &diff) && diff.pointChanged[nanPoint] ;
+        for (size_t i = 0 ; i < s.lineCount ; i++) {
+            bool joined = (size_t)s.lines[i * 2] == nanPoint + 1 || (size_t)s.lines[i * 2 + 1] == nanPoint + 1 ;
+            if (joined) correct = correct && diff.lineChanged[i] ;
+        }
+        scene_draw(&s, &diff) ;
+        correct = correct && scene_checkNodes(&s) ;
+    }
+
+    geometryDiff_free(&diff) ;
+    scene_free(&s) ;
+    return correct ;
+}
+
+int main(void) {
+    size_t sides[]     = { 4, 32, 316, 1000 } ;
+    double fractions[] = { 0.0, 0.01, 0.1, 1.0 } ;
+    size_t frames      = 20 ;
+    bool   allCorrect  = true ;
+
+    printf("%10s %10s %8s %12s %12s %12s %12s %8s\n", "points", "lines", "moving", "points drawn", "lines drawn", "ms / frame", "frames / s", "correct") ;
+
+    for (size_t n = 0 ; n < sizeof(sides) / sizeof(size_t) ; n++) {
+        for (size_t f = 0 ; f < sizeof(fractions) / sizeof(double) ; f++) {
+            scene s ;
+            scene_build(&s, sides[n]) ;
+            size_t fullCount = s.count, fullLineCount = s.lineCount ;
+
+            geometryDiff diff ;
+            geometryDiff_init(&diff) ;
+            bool   correct      = true ;
+            double elapsed      = 0.0 ;
+            size_t pointsDrawn  = 0, linesDrawn = 0 ;
+
+            for (size_t frame = 0 ; frame <= frames ; frame++) {
+                if (frame > 0) scene_move(&s, fractions[f]) ;
+                if (frame % 7 == 6) scene_resize(&s, fullCount, fullLineCount) ;
+                if (frame % 5 == 4) scene_rewire(&s) ;
+
+                double start = now() ;
+                if (!geometryDiff_update(&diff, s.points, s.count, STRIDE, s.lines, s.lineCount, epsilon)) {
+                    fprintf(stderr, "out of memory\n") ;
+                    return 1 ;
+                }
+                if (frame > 0) elapsed += now() - start ;
+
+                correct = correct && scene_checkFlags(&s, &diff) ;
+                scene_draw(&s, &diff) ;
+                correct = correct && scene_checkNodes(&s) ;
+                if (frame > 0) {
+                    pointsDrawn += diff.changedPoints ;
+                    linesDrawn  += diff.changedLines ;
+                }
+            }
+            allCorrect = allCorrect && correct ;
+
+            char moving[16] ;
+            snprintf(moving, sizeof(moving), "%g%%", fractions[f] * 100.0) ;
+            printf("%10zu %10zu %8s %12zu %12zu %12.4f %12.0f %8s\n", fullCount, fullLineCount, moving,
+                   pointsDrawn / frames, linesDrawn / frames, elapsed * 1000.0 / (double)frames,
+                   (double)frames / elapsed, correct ? "yes" : "NO") ;
+
+            geometryDiff_free(&diff) ;
+            scene_free(&s) ;
+        }
+    }
+
+    bool nanCorrect = checkNaN() ;
+    printf("\npoint becoming NaN and recovering: %s\n", nanCorrect ? "correct" : "NOT CORRECT") ;
+    allCorrect = allCorrect && nanCorrect ;
+
+    if (!allCorrect) {
+        fprintf(stderr, "nodes drawn from geometryDiff don't match the mesh\n") ;
+        return 1 ;
+    }
+    return 0 ;
+}
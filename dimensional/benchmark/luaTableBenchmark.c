@@ -0,0 +1,298 @@
+// Check and benchmark for copying Lua tables into buffers with ../src/luaTable.h
+//
+// Builds Lua tables of 4-D grids of points and the lines joining them, from the 16 points and 32
+// lines of a tesseract up to 331,776 points and 1.3 million lines, and copies them into buffers
+// three ways:
+//
+//   unchecked   lua_rawgeti and lua_tonumber / lua_tointeger straight into the buffer, trusting
+//               the table, as the module did while validate_luaTable was stubbed out
+//   two pass    the checks validate_luaTable had commented out, done with lua_geti as it did them,
+//               followed by the unchecked copy
+//   single      luaTable_copyToBuffer, checking each value as it's copied, with lines checked
+//               against the number of points
+//
+// and reports items per second for each, and the overhead of the single pass over the unchecked
+// copy. The copies are compared with each other, and then a run of bad tables is checked to be
+// refused with the right message, and a few good but unusual ones accepted.
+//
+// This needs Lua 5.4's headers and library, which Hammerspoon has built in but this doesn't use;
+// LUA_CFLAGS and LUA_LIBS default to what pkg-config says for lua5.4:
+//
+//     make luaTableBenchmark
+//     ./luaTableBenchmark
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <time.h>
+
+#include <lauxlib.h>
+#include <lualib.h>
+
+#include "luaTable.h"
+
+static double now(void) {
+    struct timespec ts ;
+    clock_gettime(CLOCK_MONOTONIC, &ts) ;
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9 ;
+}
+
+#pragma mark - The three ways
+
+static bool copyUnchecked(lua_State *L, int idx, packedBuffer *buffer) {
+    size_t count = lua_rawlen(L, idx) ;
+    if (!packedBuffer_resize(buffer, count)) return false ;
+    for (size_t i = 0 ; i < count ; i++) {
+        lua_rawgeti(L, idx, (lua_Integer)(i + 1)) ;
+        for (size_t c = 0 ; c < buffer->components ; c++) {
+            lua_rawgeti(L, -1, (lua_Integer)(c + 1)) ;
+            if (buffer->type == packedBuffer_points) {
+                buffer->data.points[i * buffer->components + c] = lua_tonumber(L, -1) ;
+            } else {
+                buffer->data.indicies[i * buffer->components + c] = (int32_t)lua_tointeger(L, -1) ;
+            }
+            lua_pop(L, 1) ;
+        }
+        lua_pop(L, 1) ;
+    }
+    return true ;
+}
+
+// what validate_luaTable's commented out body did, less building its messages
+static bool validateTwoPass(lua_State *L, int idx, size_t components, bool isInteger, lua_Integer maxInt) {
+    lua_Integer count = luaL_len(L, idx) ;
+    for (lua_Integer i = 1 ; i <= count ; i++) {
+        if (lua_geti(L, idx, i) != LUA_TTABLE || luaL_len(L, -1) != (lua_Integer)components) {
+            lua_pop(L, 1) ;
+            return false ;
+        }
+        for (lua_Integer j = 1 ; j <= (lua_Integer)components ; j++) {
+            bool valid = (lua_geti(L, -1, j) == LUA_TNUMBER) ;
+            if (valid && isInteger) {
+                lua_Integer value = lua_tointeger(L, -1) ;
+                valid = lua_isinteger(L, -1) && value >= 1 && value <= maxInt ;
+            }
+            lua_pop(L, 1) ;
+            if (!valid) {
+                lua_pop(L, 1) ;
+                return false ;
+            }
+        }
+        lua_pop(L, 1) ;
+    }
+    return true ;
+}
+
+#pragma mark - Tables
+
+// a grid of side^4 4-D points with a line from each to its next neighbour along each axis
+static void pushGrid(lua_State *L, size_t side, size_t *pointCount, size_t *lineCount) {
+    size_t count = side * side * side * side, lines = 0 ;
+    lua_createtable(L, (int)count, 0) ;
+    for (size_t i = 0 ; i < count ; i++) {
+        lua_createtable(L, 4, 0) ;
+        for (size_t c = 0, rest = i ; c < 4 ; c++, rest /= side) {
+            lua_pushnumber(L, (double)(rest % side) - (double)(side - 1) / 2.0) ;
+            lua_rawseti(L, -2, (lua_Integer)(c + 1)) ;
+        }
+        lua_rawseti(L, -2, (lua_Integer)(i + 1)) ;
+    }
+    lua_createtable(L, (int)(count * 4), 0) ;
+    for (size_t i = 0 ; i < count ; i++) {
+        for (size_t c = 0, step = 1 ; c < 4 ; c++, step *= side) {
+            if ((i / step) % side + 1 == side) continue ;
+            lua_createtable(L, 2, 0) ;
+            lua_pushinteger(L, (lua_Integer)(i + 1)) ;
+            lua_rawseti(L, -2, 1) ;
+            lua_pushinteger(L, (lua_Integer)(i + step + 1)) ;
+            lua_rawseti(L, -2, 2) ;
+            lua_rawseti(L, -2, (lua_Integer)(++lines)) ;
+        }
+    }
+    *pointCount = count ;
+    *lineCount  = lines ;
+}
+
+typedef struct {
+    lua_State    *L ;
+    size_t       pointCount ;
+    packedBuffer *points ;
+    packedBuffer *lines ;
+    bool         correct ;
+} copyRun ;
+
+static void runUnchecked(copyRun *run) {
+    copyUnchecked(run->L, 1, run->points) ;
+    copyUnchecked(run->L, 2, run->lines) ;
+}
+
+static void runTwoPass(copyRun *run) {
+    if (validateTwoPass(run->L, 1, 4, false, 0) && validateTwoPass(run->L, 2, 2, true, (lua_Integer)run->pointCount)) {
+        copyUnchecked(run->L, 1, run->points) ;
+        copyUnchecked(run->L, 2, run->lines) ;
+    } else {
+        run->correct = false ;
+    }
+}
+
+static void runSingle(copyRun *run) {
+    run->points->count = 0 ;
+    run->lines->count  = 0 ;
+    run->correct = run->correct && !luaTable_copyToBuffer(run->L, 1, run->points, 0, LUATABLE_NO_RANGE, false) ;
+    run->correct = run->correct && !luaTable_copyToBuffer(run->L, 2, run->lines, 2, (int64_t)run->pointCount, false) ;
+    run->correct = run->correct && lua_gettop(run->L) == 2 ;
+}
+
+// runs copy until a tenth of a second has passed, and returns items per second
+static double timeRuns(void (*copy)(copyRun *), copyRun *run, size_t items) {
+    size_t repeats = 0 ;
+    double start   = now(), elapsed = 0.0 ;
+    do {
+        copy(run) ;
+        repeats++ ;
+        elapsed = now() - start ;
+    } while (elapsed < 0.1) ;
+    return (double)(items * repeats) / elapsed ;
+}
+
+#pragma mark - Bad tables
+
+typedef struct {
+    const char *points ;    // Lua source for the table
+    const char *lines ;
+    const char *expected ;  // the message for the first table that's refused, or NULL if they're fine
+} badCase ;
+
+static const badCase badCases[] = {
+    { "{ {1,2,3}, {4,5,6} }",         "{ {1,2} }",             NULL },
+    { "{ {1,2,3}, {4,5} }",           "{ {1,2} }",             "expected table at index 2 to contain 3 components" },
+    { "{ {1,2,3}, 7 }",               "{ {1,2} }",             "expected table at index 2 to contain 3 components" },
+    { "{ {1,2,3}, {4,'5',6} }",       "{ {1,2} }",             "expected number for component 2 of index 2" },
+    { "{ {1,2,3}, {4,5,6} }",         "{ {1,2}, {2,3} }",      "expected integer between 1 and 2 inclusive for component 2 of index 2" },
+    { "{ {1,2,3}, {4,5,6} }",         "{ {1,2}, {0,1} }",      "expected integer between 1 and 2 inclusive for component 1 of index 2" },
+    { "{ {1,2,3}, {4,5,6} }",         "{ {1,2.5} }",           "expected integer for component 2 of index 1" },
+    { "{ {1,2,3}, {4,5,6} }",         "{ {1,2.0} }",           NULL },
+    { "{ {1,2,3}, {4,5,6} }",         "{ {1,2,3} }",           "expected table at index 1 to contain 2 components" },
+    { "{ {1,2,3}, {4,5,6} }",         "{ {1, 1 << 40} }",      "expected 32 bit integer for component 2 of index 1" },
+    { "{ x = {1,2,3} }",              "{ }",                   "expected array type table or buffer" },
+    { "{ }",                          "{ }",                   NULL },
+    { "{ {} }",                       "{ }",                   "expected table at index 1 to contain at least 1 component" },
+    { "setmetatable({}, { __index = function() return {1,2,3} end, __len = function() return 5 end })",
+                                      "{ }",                   NULL },
+} ;
+
+// copies points and lines as the module does for a mesh: lines are checked against the points
+static const char *copyMesh(lua_State *L, int points, int lines) {
+    packedBuffer pointBuffer, lineBuffer ;
+    packedBuffer_init(&pointBuffer, packedBuffer_points, 0) ;
+    packedBuffer_init(&lineBuffer, packedBuffer_indicies, 2) ;
+    const char *message = luaTable_copyToBuffer(L, points, &pointBuffer, 0, LUATABLE_NO_RANGE, false) ;
+    if (!message) message = luaTable_copyToBuffer(L, lines, &lineBuffer, 2, (int64_t)pointBuffer.count, false) ;
+    packedBuffer_free(&pointBuffer) ;
+    packedBuffer_free(&lineBuffer) ;
+    return message ;
+}
+
+// faces as catmullClarkSubdivision takes them: 3 or 4 lines, with 0 allowed for the missing 4th
+static bool checkFaces(lua_State *L) {
+    static const struct {
+        const char *faces ;
+        bool       accepted ;
+    } faceCases[] = {
+        { "{ {1,2,3,4}, {1,2,3} }", true },
+        { "{ {1,2,3,0} }",          true },
+        { "{ {1,2,0,4} }",          false },
+        { "{ {1,2} }",              false },
+        { "{ {1,2,3,5} }",          false },
+    } ;
+    bool correct = true ;
+    for (size_t i = 0 ; i < sizeof(faceCases) / sizeof(faceCases[0]) ; i++) {
+        char source[128] ;
+        snprintf(source, sizeof(source), "return %s", faceCases[i].faces) ;
+        if (luaL_dostring(L, source) != LUA_OK) return false ;
+        packedBuffer faces ;
+        packedBuffer_init(&faces, packedBuffer_indicies, 4) ;
+        const char *message = luaTable_copyToBuffer(L, -1, &faces, 3, 4, true) ;
+        bool       accepted = (message == NULL) ;
+        if (accepted) correct = correct && packedBuffer_findOutOfRange(&faces, 4, true) == SIZE_MAX ;
+        correct = correct && accepted == faceCases[i].accepted ;
+        packedBuffer_free(&faces) ;
+        lua_settop(L, 0) ;
+    }
+    return correct ;
+}
+
+static bool checkBadTables(lua_State *L) {
+    bool correct = true ;
+    for (size_t i = 0 ; i < sizeof(badCases) / sizeof(badCase) ; i++) {
+        char source[256] ;
+        snprintf(source, sizeof(source), "return %s, %s", badCases[i].points, badCases[i].lines) ;
+        if (luaL_dostring(L, source) != LUA_OK) {
+            fprintf(stderr, "%s\n", lua_tostring(L, -1)) ;
+            return false ;
+        }
+        int         top     = lua_gettop(L) ;
+        const char *message = copyMesh(L, 1, 2) ;
+        bool        right   = badCases[i].expected ? (message && strcmp(message, badCases[i].expected) == 0) : !message ;
+        // nothing left behind but the message
+        right = right && lua_gettop(L) == top + (message ? 1 : 0) ;
+        if (!right) fprintf(stderr, "case %zu: got \"%s\"\n", i + 1, message ? message : "(accepted)") ;
+        correct = correct && right ;
+        lua_settop(L, 0) ;
+    }
+    return correct && checkFaces(L) ;
+}
+
+int main(void) {
+    lua_State *L = luaL_newstate() ;
+    luaL_openlibs(L) ;
+
+    size_t sides[]    = { 2, 6, 18, 24 } ;
+    bool   allCorrect = true ;
+
+    printf("%10s %10s %16s %16s %16s %10s\n", "points", "lines", "unchecked it/s", "two pass it/s", "single it/s", "overhead") ;
+
+    for (size_t n = 0 ; n < sizeof(sides) / sizeof(size_t) ; n++) {
+        size_t pointCount, lineCount ;
+        pushGrid(L, sides[n], &pointCount, &lineCount) ;
+        size_t items = pointCount + lineCount ;
+
+        packedBuffer points[2], lines[2] ;
+        for (size_t k = 0 ; k < 2 ; k++) {
+            packedBuffer_init(&points[k], packedBuffer_points, 4) ;
+            packedBuffer_init(&lines[k], packedBuffer_indicies, 2) ;
+        }
+
+        copyRun unchecked = { L, pointCount, &points[0], &lines[0], true } ;
+        copyRun single    = { L, pointCount, &points[1], &lines[1], true } ;
+        double  uncheckedRate = timeRuns(runUnchecked, &unchecked, items) ;
+        double  twoPassRate   = timeRuns(runTwoPass, &unchecked, items) ;
+        double  singleRate    = timeRuns(runSingle, &single, items) ;
+
+        bool correct = unchecked.correct && single.correct ;
+        correct = correct && points[1].count == pointCount && lines[1].count == lineCount &&
+                  memcmp(points[0].data.points, points[1].data.points, pointCount * 4 * sizeof(double)) == 0 &&
+                  memcmp(lines[0].data.indicies, lines[1].data.indicies, lineCount * 2 * sizeof(int32_t)) == 0 ;
+        allCorrect = allCorrect && correct ;
+
+        printf("%10zu %10zu %16.0f %16.0f %16.0f %9.1f%%%s\n", pointCount, lineCount, uncheckedRate, twoPassRate, singleRate,
+               (uncheckedRate / singleRate - 1.0) * 100.0, correct ? "" : "  WRONG") ;
+
+        for (size_t k = 0 ; k < 2 ; k++) {
+            packedBuffer_free(&points[k]) ;
+            packedBuffer_free(&lines[k]) ;
+        }
+        lua_settop(L, 0) ;
+    }
+
+    bool refused = checkBadTables(L) ;
+    printf("bad tables refused: %s\n", refused ? "yes" : "NO") ;
+    allCorrect = allCorrect && refused ;
+    lua_close(L) ;
+
+    if (!allCorrect) {
+        fprintf(stderr, "tables weren't copied or checked correctly\n") ;
+        return 1 ;
+    }
+    return 0 ;
+}
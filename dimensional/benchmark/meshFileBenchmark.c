@@ -0,0 +1,293 @@
+// Check and benchmark for writing and reading meshes with ../src/meshFile.h
+//
+// Builds cubes and tesseracts, subdivided with ../src/catmullClark.h up to a few million lines,
+// and writes each as OBJ, binary PLY and the native format, reporting the size and write speed of
+// each. The native file is then mapped back in with meshFile_map and compared with the mesh it was
+// written from, and the OBJ and PLY files are checked for the right number of records and the
+// right size. Finally a few things that should fail are checked too: a 5-D mesh as OBJ, a face
+// whose lines don't meet, and native files that are cut short, from the other byte order or not
+// mesh files at all.
+//
+// Files are written to a temporary directory, removed afterwards.
+//
+//     make
+//     ./meshFileBenchmark
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "catmullClark.h"
+#include "meshFile.h"
+
+static double now(void) {
+    struct timespec ts ;
+    clock_gettime(CLOCK_MONOTONIC, &ts) ;
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9 ;
+}
+
+static volatile double sink ;
+
+static void *allocate(size_t size) {
+    void *memory = malloc(size > 0 ? size : 1) ;
+    if (!memory) {
+        fprintf(stderr, "out of memory\n") ;
+        exit(1) ;
+    }
+    return memory ;
+}
+
+// the corners and edges of a cube of the given dimensions, with its square faces, subdivided
+static void buildCube(catmullClarkMesh *mesh, size_t dimensions, size_t levels) {
+    size_t pointCount = (size_t)1 << dimensions, lineCount = 0 ;
+    catmullClark_init(mesh, dimensions) ;
+    if (!catmullClark_resize(mesh, pointCount, pointCount * dimensions / 2, 0)) {
+        fprintf(stderr, "out of memory\n") ;
+        exit(1) ;
+    }
+    for (size_t i = 0 ; i < pointCount ; i++) {
+        for (size_t c = 0 ; c < dimensions ; c++) mesh->points[i * dimensions + c] = ((i >> c) & 1) ? 1.0 : -1.0 ;
+        for (size_t c = 0 ; c < dimensions ; c++) {
+            size_t j = i | ((size_t)1 << c) ;
+            if (j == i) continue ;
+            mesh->lines[lineCount * 2]     = (uint32_t)i ;
+            mesh->lines[lineCount * 2 + 1] = (uint32_t)j ;
+            lineCount++ ;
+        }
+    }
+    char error[128] ;
+    if (!catmullClark_findFaces(mesh) || !catmullClark_subdivide(mesh, levels, error, sizeof(error))) {
+        fprintf(stderr, "unable to build the mesh\n") ;
+        exit(1) ;
+    }
+}
+
+// the mesh as meshFile takes it: 1 based lines, faces as 4 line numbers
+static void toData(const catmullClarkMesh *mesh, meshFileData *data, int32_t **lines, int32_t **faces) {
+    *lines = allocate(mesh->lineCount * 2 * sizeof(int32_t)) ;
+    *faces = allocate(mesh->faceCount * 4 * sizeof(int32_t)) ;
+    for (size_t i = 0 ; i < mesh->lineCount * 2 ; i++) (*lines)[i] = (int32_t)mesh->lines[i] + 1 ;
+    for (size_t i = 0 ; i < mesh->faceCount ; i++) {
+        for (size_t j = 0 ; j < 4 ; j++) (*faces)[i * 4 + j] = (int32_t)mesh->faces[i].lines[j] ;
+    }
+    data->points         = mesh->points ;
+    data->lines          = *lines ;
+    data->faces          = *faces ;
+    data->dimensions     = mesh->dimensions ;
+    data->pointCount     = mesh->pointCount ;
+    data->lineCount      = mesh->lineCount ;
+    data->faceCount      = mesh->faceCount ;
+    data->faceComponents = 4 ;
+}
+
+static size_t fileSize(const char *path) {
+    struct stat info ;
+    return (stat(path, &info) == 0) ? (size_t)info.st_size : 0 ;
+}
+
+// counts the v, l and f records of an OBJ file
+static bool checkOBJ(const char *path, const meshFileData *data) {
+    FILE *file = fopen(path, "r") ;
+    if (!file) return false ;
+    size_t counts[3] = { 0, 0, 0 } ;
+    char   line[256] ;
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == 'v') counts[0]++ ;
+        if (line[0] == 'l') counts[1]++ ;
+        if (line[0] == 'f') counts[2]++ ;
+    }
+    fclose(file) ;
+    return counts[0] == data->pointCount && counts[1] == data->lineCount && counts[2] == data->faceCount ;
+}
+
+// checks the PLY header's element counts and that the body is exactly the size they call for
+static bool checkPLY(const char *path, const meshFileData *data) {
+    FILE *file = fopen(path, "rb") ;
+    if (!file) return false ;
+    size_t vertices = 0, edges = 0, faces = 0, header = 0 ;
+    char   line[256] ;
+    while (fgets(line, sizeof(line), file)) {
+        sscanf(line, "element vertex %zu", &vertices) ;
+        sscanf(line, "element edge %zu", &edges) ;
+        sscanf(line, "element face %zu", &faces) ;
+        if (strcmp(line, "end_header\n") == 0) {
+            header = (size_t)ftell(file) ;
+            break ;
+        }
+    }
+    fclose(file) ;
+    size_t body = vertices * data->dimensions * sizeof(double) + edges * 2 * sizeof(int32_t) + faces * (1 + 4 * sizeof(int32_t)) ;
+    return header > 0 && vertices == data->pointCount && edges == data->lineCount && faces == data->faceCount &&
+           fileSize(path) == header + body ;
+}
+
+static bool sameData(const meshFileData *a, const meshFileData *b) {
+    return a->dimensions == b->dimensions && a->pointCount == b->pointCount &&
+           a->lineCount == b->lineCount && a->faceCount == b->faceCount && a->faceComponents == b->faceComponents &&
+           memcmp(a->points, b->points, a->pointCount * a->dimensions * sizeof(double)) == 0 &&
+           memcmp(a->lines, b->lines, a->lineCount * 2 * sizeof(int32_t)) == 0 &&
+           memcmp(a->faces, b->faces, a->faceCount * a->faceComponents * sizeof(int32_t)) == 0 ;
+}
+
+// writes size bytes of contents to path
+static void writeBytes(const char *path, const void *contents, size_t size) {
+    FILE *file = fopen(path, "wb") ;
+    if (file) {
+        fwrite(contents, 1, size, file) ;
+        fclose(file) ;
+    }
+}
+
+// the ways a write or map should fail
+static bool checkFailures(const char *directory, const meshFileData *data) {
+    char       path[512], error[256] ;
+    bool       correct = true ;
+    meshFileMap map ;
+
+    // 5-D points don't fit in OBJ, and faces have to be loops
+    catmullClarkMesh fiveCube ;
+    buildCube(&fiveCube, 5, 0) ;
+    meshFileData fiveData ;
+    int32_t      *lines, *faces ;
+    toData(&fiveCube, &fiveData, &lines, &faces) ;
+    snprintf(path, sizeof(path), "%s/five.obj", directory) ;
+    correct = correct && !meshFile_write(path, meshFile_obj, &fiveData, error, sizeof(error)) && fileSize(path) == 0 ;
+    faces[1] = faces[3] ;
+    faces[3] = (int32_t)fiveData.lineCount ;
+    snprintf(path, sizeof(path), "%s/five.ply", directory) ;
+    correct = correct && !meshFile_write(path, meshFile_ply, &fiveData, error, sizeof(error)) && fileSize(path) == 0 ;
+    free(lines) ;
+    free(faces) ;
+    catmullClark_free(&fiveCube) ;
+
+    // native files that are cut short, have extra on the end, come from the other byte order, or aren't mesh files
+    snprintf(path, sizeof(path), "%s/whole.mesh", directory) ;
+    if (!meshFile_write(path, meshFile_native, data, error, sizeof(error))) return false ;
+    size_t size     = fileSize(path) ;
+    char   *content = allocate(size + 8) ;
+    FILE   *file    = fopen(path, "rb") ;
+    if (!file || fread(content, 1, size, file) != size) return false ;
+    fclose(file) ;
+    memset(content + size, 0, 8) ;
+
+    snprintf(path, sizeof(path), "%s/damaged.mesh", directory) ;
+    size_t sizes[] = { size - 4, size + 8, sizeof(meshFileHeader) - 1, 0 } ;
+    for (size_t i = 0 ; i < sizeof(sizes) / sizeof(size_t) ; i++) {
+        writeBytes(path, content, sizes[i]) ;
+        correct = correct && !meshFile_map(path, &map, error, sizeof(error)) && map.mapping == NULL ;
+    }
+    uint32_t swapped = 0x04030201u ;
+    memcpy(content + offsetof(meshFileHeader, byteOrder), &swapped, sizeof(uint32_t)) ;
+    writeBytes(path, content, size) ;
+    correct = correct && !meshFile_map(path, &map, error, sizeof(error)) ;
+    writeBytes(path, "# not a mesh file, but long enough to have a header's worth of text\n", 68) ;
+    correct = correct && !meshFile_map(path, &map, error, sizeof(error)) ;
+    snprintf(path, sizeof(path), "%s/missing.mesh", directory) ;
+    correct = correct && !meshFile_map(path, &map, error, sizeof(error)) ;
+
+    free(content) ;
+    return correct ;
+}
+
+int main(void) {
+    typedef struct {
+        size_t dimensions, levels ;
+    } meshSize ;
+    meshSize sizes[] = { { 3, 0 }, { 4, 0 }, { 3, 6 }, { 4, 5 }, { 4, 7 }, { 3, 9 } } ;
+
+    static const char * const formatNames[] = { "obj", "ply", "mesh" } ;
+    char directory[] = "/tmp/meshFileBenchmarkXXXXXX" ;
+    if (!mkdtemp(directory)) {
+        fprintf(stderr, "unable to create a temporary directory\n") ;
+        return 1 ;
+    }
+    bool allCorrect = true ;
+
+    printf("%-10s %10s %10s %10s %-6s %12s %12s %12s %8s\n", "mesh", "points", "lines", "faces", "format", "MB", "write MB/s", "map ms", "correct") ;
+
+    meshFileData last ;
+    int32_t      *lastLines = NULL, *lastFaces = NULL ;
+    catmullClarkMesh lastMesh ;
+
+    for (size_t n = 0 ; n < sizeof(sizes) / sizeof(meshSize) ; n++) {
+        catmullClarkMesh mesh ;
+        buildCube(&mesh, sizes[n].dimensions, sizes[n].levels) ;
+        meshFileData data ;
+        int32_t      *lines, *faces ;
+        toData(&mesh, &data, &lines, &faces) ;
+
+        char label[16] ;
+        snprintf(label, sizeof(label), "%zu-cube/%zu", sizes[n].dimensions, sizes[n].levels) ;
+
+        for (meshFileFormat format = meshFile_obj ; format <= meshFile_native ; format++) {
+            char path[512], error[256] ;
+            snprintf(path, sizeof(path), "%s/mesh.%s", directory, formatNames[format]) ;
+
+            double start   = now() ;
+            bool   correct = meshFile_write(path, format, &data, error, sizeof(error)) ;
+            double written = now() - start ;
+            if (!correct) fprintf(stderr, "%s\n", error) ;
+            double megabytes = (double)fileSize(path) / 1e6, mapped = 0.0 ;
+
+            if (correct && format == meshFile_obj) correct = checkOBJ(path, &data) ;
+            if (correct && format == meshFile_ply) correct = checkPLY(path, &data) ;
+            if (correct && format == meshFile_native) {
+                meshFileMap map ;
+                start   = now() ;
+                correct = meshFile_map(path, &map, error, sizeof(error)) ;
+                // touch every page, as copying it out would
+                double sum = 0.0 ;
+                for (size_t i = 0 ; correct && i < map.data.pointCount * map.data.dimensions ; i += 512) sum += map.data.points[i] ;
+                sink    = sum ;
+                mapped  = (now() - start) * 1000.0 ;
+                correct = correct && sameData(&data, &map.data) ;
+                meshFile_unmap(&map) ;
+            }
+            allCorrect = allCorrect && correct ;
+            remove(path) ;
+
+            printf("%-10s %10zu %10zu %10zu %-6s %12.2f %12.1f ", label, data.pointCount, data.lineCount, data.faceCount,
+                   formatNames[format], megabytes, megabytes / written) ;
+            if (format == meshFile_native) {
+                printf("%12.3f", mapped) ;
+            } else {
+                printf("%12s", "") ;
+            }
+            printf(" %8s\n", correct ? "yes" : "NO") ;
+        }
+
+        if (n == 1) {
+            last      = data ;
+            lastLines = lines ;
+            lastFaces = faces ;
+            lastMesh  = mesh ;
+        } else {
+            free(lines) ;
+            free(faces) ;
+            catmullClark_free(&mesh) ;
+        }
+    }
+
+    bool failures = checkFailures(directory, &last) ;
+    printf("failures refused: %s\n", failures ? "yes" : "NO") ;
+    allCorrect = allCorrect && failures ;
+    free(lastLines) ;
+    free(lastFaces) ;
+    catmullClark_free(&lastMesh) ;
+
+    char path[512] ;
+    const char * const leftovers[] = { "five.obj", "five.ply", "whole.mesh", "damaged.mesh" } ;
+    for (size_t i = 0 ; i < sizeof(leftovers) / sizeof(char *) ; i++) {
+        snprintf(path, sizeof(path), "%s/%s", directory, leftovers[i]) ;
+        remove(path) ;
+    }
+    rmdir(directory) ;
+
+    if (!allCorrect) {
+        fprintf(stderr, "mesh files didn't write or read back correctly\n") ;
+        return 1 ;
+    }
+    return 0 ;
+}
@@ -0,0 +1,527 @@
+// Regression suite for the geometry core of hs._asm.dimensional
+//
+// Runs each of the operations behind the module's heavy functions over procedurally generated
+// meshes of growing size, headless, and reports how it scales:
+//
+//   faces      meshFaces_find from scratch, as facesFromLines does on each call
+//   halfEdge   building a half-edge mesh a point and a line at a time, then mesh:findFaces
+//   subdivide  one level of catmullClark_refine, the native version of Examples/catmullClark.lua
+//   diff       geometryDiff_update with every point moved, the worst case frame of generate3dObject
+//   project    a rotation and a projection down to 3-D with transform_project
+//
+// over hypercubes of 3 to 10 dimensions, flat square grids, and a cube and a tesseract subdivided
+// a level at a time. generate3dObject and the Lua example need SceneKit and Hammerspoon, so it's
+// the C each of them spends its time in that's measured here.
+//
+// For each operation and mesh it reports operations a second, nanoseconds per item (line, or
+// point for project) -- flat as the meshes grow for anything linear, so something going quadratic
+// or worse stands out -- the allocations made and the most heap in use during an operation, and
+// the process's peak resident size so far. Allocations are counted by routing the headers' malloc,
+// calloc, realloc and free through counting versions below. The faces, lines and subdivided faces
+// found are checked against the counts each mesh should have.
+//
+// With --json each result is printed as one JSON object per line instead of the table; save that
+// and pass it back with --baseline to have any operation that's become slower by more than the
+// tolerance (25% unless given with --tolerance), or that allocates more than it did, reported and
+// the exit status set. --quick keeps to the smaller meshes, --time sets how long each is timed
+// for, and any other arguments pick out the operations and meshes named with each of them.
+//
+//     make
+//     ./regressionBenchmark --json > baseline.json
+//     ./regressionBenchmark --baseline baseline.json
+//     ./regressionBenchmark --quick faces hypercube
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#pragma mark - Allocation counting
+
+// each block is prefixed with its size, so free and realloc know how much is being given back
+typedef union {
+    size_t      size ;
+    long double alignment ;
+    char        padding[16] ;
+} allocationHeader ;
+
+static size_t allocationCount = 0 ;
+static size_t heapInUse       = 0 ;
+static size_t heapPeak        = 0 ;
+
+static void *countedRealloc(void *memory, size_t size) {
+    allocationHeader *header = memory ? (allocationHeader *)memory - 1 : NULL ;
+    size_t           old     = header ? header->size : 0 ;
+    if (size > SIZE_MAX - sizeof(allocationHeader)) return NULL ;
+    allocationHeader *grown  = realloc(header, sizeof(allocationHeader) + size) ;
+    if (!grown) return NULL ;
+
+    grown->size = size ;
+    heapInUse   = heapInUse - old + size ;
+    if (heapInUse > heapPeak) heapPeak = heapInUse ;
+    allocationCount++ ;
+    return grown + 1 ;
+}
+
+static void *countedMalloc(size_t size) {
+    return countedRealloc(NULL, size) ;
+}
+
+static void *countedCalloc(size_t count, size_t size) {
+    if (size > 0 && count > SIZE_MAX / size) return NULL ;
+    void *memory = countedRealloc(NULL, count * size) ;
+    if (memory) memset(memory, 0, count * size) ;
+    return memory ;
+}
+
+static void countedFree(void *memory) {
+    if (!memory) return ;
+    allocationHeader *header = (allocationHeader *)memory - 1 ;
+    heapInUse -= header->size ;
+    free(header) ;
+}
+
+#define malloc(size)        countedMalloc(size)
+#define calloc(count, size) countedCalloc(count, size)
+#define realloc(ptr, size)  countedRealloc(ptr, size)
+#define free(ptr)           countedFree(ptr)
+
+#include "halfEdgeMesh.h"
+#include "geometryDiff.h"
+#include "transform.h"
+
+#pragma mark - Support
+
+static double now(void) {
+    struct timespec ts ;
+    clock_gettime(CLOCK_MONOTONIC, &ts) ;
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9 ;
+}
+
+static void *allocate(size_t size) {
+    void *memory = malloc(size > 0 ? size : 1) ;
+    if (!memory) {
+        fprintf(stderr, "out of memory\n") ;
+        exit(1) ;
+    }
+    return memory ;
+}
+
+// the most the process has had resident, in KiB
+static long peakResidentKiB(void) {
+    struct rusage usage ;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0 ;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024 ;
+#else
+    return usage.ru_maxrss ;
+#endif
+}
+
+#pragma mark - Meshes
+
+typedef struct {
+    const char *family ;
+    int        size ;     // dimensions of a hypercube, or points along each side of a grid
+    int        levels ;   // of subdivision
+    bool       quick ;    // included with --quick
+} meshSpec ;
+
+static const meshSpec meshSpecs[] = {
+    { "hypercube", 3, 0, true },  { "hypercube", 4, 0, true },  { "hypercube", 5, 0, true },
+    { "hypercube", 6, 0, true },  { "hypercube", 7, 0, false }, { "hypercube", 8, 0, false },
+    { "hypercube", 9, 0, false }, { "hypercube", 10, 0, false },
+    { "grid", 8, 0, true },       { "grid", 32, 0, true },      { "grid", 128, 0, true },
+    { "grid", 512, 0, false },
+    { "cube", 3, 1, true },       { "cube", 3, 2, true },       { "cube", 3, 3, true },
+    { "cube", 3, 4, false },      { "cube", 3, 5, false },      { "cube", 3, 6, false },
+    { "tesseract", 4, 1, true },  { "tesseract", 4, 2, true },  { "tesseract", 4, 3, false },
+    { "tesseract", 4, 4, false },
+} ;
+
+static void addLine(catmullClarkMesh *mesh, size_t *line, uint32_t a, uint32_t b) {
+    mesh->lines[*line * 2]     = a ;
+    mesh->lines[*line * 2 + 1] = b ;
+    (*line)++ ;
+}
+
+// the corners of a unit hypercube, joined along each axis
+static void buildHypercube(catmullClarkMesh *mesh, size_t dimensions) {
+    size_t pointCount = (size_t)1 << dimensions ;
+    catmullClark_init(mesh, dimensions) ;
+    if (!catmullClark_resize(mesh, pointCount, dimensions * pointCount / 2, 0)) {
+        fprintf(stderr, "out of memory\n") ;
+        exit(1) ;
+    }
+    size_t line = 0 ;
+    for (size_t i = 0 ; i < pointCount ; i++) {
+        for (size_t d = 0 ; d < dimensions ; d++) {
+            mesh->points[i * dimensions + d] = (i & ((size_t)1 << d)) ? 0.5 : -0.5 ;
+            if (!(i & ((size_t)1 << d))) addLine(mesh, &line, (uint32_t)i, (uint32_t)(i | ((size_t)1 << d))) ;
+        }
+    }
+}
+
+// side by side points in the z = 0 plane, joined to their neighbours across and down
+static void buildGrid(catmullClarkMesh *mesh, size_t side) {
+    catmullClark_init(mesh, 3) ;
+    if (!catmullClark_resize(mesh, side * side, side * (side - 1) * 2, 0)) {
+        fprintf(stderr, "out of memory\n") ;
+        exit(1) ;
+    }
+    size_t line = 0 ;
+    for (size_t y = 0 ; y < side ; y++) {
+        for (size_t x = 0 ; x < side ; x++) {
+            uint32_t point = (uint32_t)(y * side + x) ;
+            mesh->points[point * 3]     = (double)x / (double)(side - 1) - 0.5 ;
+            mesh->points[point * 3 + 1] = (double)y / (double)(side - 1) - 0.5 ;
+            mesh->points[point * 3 + 2] = 0.0 ;
+            if (x + 1 < side) addLine(mesh, &line, point, point + 1) ;
+            if (y + 1 < side) addLine(mesh, &line, point, point + (uint32_t)side) ;
+        }
+    }
+}
+
+// builds the mesh with its faces; returns how many faces it should have
+static size_t buildMesh(const meshSpec *spec, catmullClarkMesh *mesh) {
+    size_t size = (size_t)spec->size, expected = 0 ;
+    if (strcmp(spec->family, "grid") == 0) {
+        buildGrid(mesh, size) ;
+        expected = (size - 1) * (size - 1) ;
+    } else {
+        buildHypercube(mesh, size) ;
+        // each of the size * (size - 1) / 2 planes has a square for each corner of the other axes
+        expected = size * (size - 1) / 2 * ((size_t)1 << (size - 2)) ;
+    }
+
+    char error[128] ;
+    if (!catmullClark_findFaces(mesh) || !catmullClark_subdivide(mesh, (size_t)spec->levels, error, sizeof(error))) {
+        fprintf(stderr, "unable to build %s %d: %s\n", spec->family, spec->size, spec->levels > 0 ? error : "out of memory") ;
+        exit(1) ;
+    }
+    return expected << (2 * spec->levels) ;
+}
+
+#pragma mark - Operations
+
+typedef struct {
+    const catmullClarkMesh *mesh ;
+    size_t                 expectedFaces ;
+    int64_t                *endpoints ;   // the lines as meshFaces_find takes them
+    int32_t                *lines ;       // the lines 1 based, as generate3dObject takes them
+    double                 *frames[2] ;   // where the points are in alternate frames
+    double                 *projected ;
+    geometryDiff           diff ;
+    transformMatrix        transform ;
+    size_t                 frame ;
+} operationState ;
+
+typedef struct {
+    const char *name ;
+    bool       (*run)(operationState *state) ;  // false if the result is wrong
+    bool       perPoint ;                       // items are points rather than lines
+} operation ;
+
+static bool runFaces(operationState *state) {
+    meshFaceList list ;
+    meshFaces_init(&list) ;
+    bool ok = meshFaces_find(&list, state->endpoints, state->mesh->lineCount, false) && list.count == state->expectedFaces ;
+    meshFaces_free(&list) ;
+    return ok ;
+}
+
+static bool runHalfEdge(operationState *state) {
+    const catmullClarkMesh *in = state->mesh ;
+    halfEdgeMesh           mesh ;
+    char                   error[128] ;
+    halfEdge_init(&mesh, in->dimensions) ;
+
+    bool ok = true ;
+    for (size_t i = 0 ; ok && i < in->pointCount ; i++) ok = halfEdge_addPoint(&mesh, &in->points[i * in->dimensions]) != HALFEDGE_NONE ;
+    for (size_t i = 0 ; ok && i < in->lineCount ; i++) {
+        ok = halfEdge_addLine(&mesh, in->lines[i * 2], in->lines[i * 2 + 1], error, sizeof(error)) != HALFEDGE_NONE ;
+    }
+    ok = ok && halfEdge_findFaces(&mesh, false) == (long)state->expectedFaces ;
+    halfEdge_free(&mesh) ;
+    return ok ;
+}
+
+static bool runSubdivide(operationState *state) {
+    const catmullClarkMesh *in = state->mesh ;
+    catmullClarkMesh       mesh ;
+    char                   error[128] ;
+    catmullClark_init(&mesh, in->dimensions) ;
+
+    bool ok = catmullClark_resize(&mesh, in->pointCount, in->lineCount, in->faceCount) ;
+    if (ok) {
+        memcpy(mesh.points, in->points, in->pointCount * in->dimensions * sizeof(double)) ;
+        memcpy(mesh.lines, in->lines, in->lineCount * 2 * sizeof(uint32_t)) ;
+        memcpy(mesh.faces, in->faces, in->faceCount * sizeof(meshFace)) ;
+        ok = catmullClark_refine(&mesh, error, sizeof(error)) && mesh.faceCount == state->expectedFaces * 4 ;
+    }
+    catmullClark_free(&mesh) ;
+    return ok ;
+}
+
+static bool runDiff(operationState *state) {
+    const catmullClarkMesh *in = state->mesh ;
+    bool ok = geometryDiff_update(&state->diff, state->frames[state->frame % 2], in->pointCount, in->dimensions,
+                                  state->lines, in->lineCount, 1e-4) ;
+    state->frame++ ;
+    return ok && state->diff.changedPoints == in->pointCount && state->diff.changedLines == in->lineCount ;
+}
+
+static bool runProject(operationState *state) {
+    const catmullClarkMesh *in = state->mesh ;
+    transform_project(&state->transform, in->points, in->pointCount, 3, 2.0, 1.0, 1.0, state->projected) ;
+    return true ;
+}
+
+static const operation operations[] = {
+    { "faces",     runFaces,     false },
+    { "halfEdge",  runHalfEdge,  false },
+    { "subdivide", runSubdivide, false },
+    { "diff",      runDiff,      false },
+    { "project",   runProject,   true },
+} ;
+
+static void prepare(operationState *state, const catmullClarkMesh *mesh, size_t expectedFaces) {
+    size_t values = mesh->pointCount * mesh->dimensions ;
+    state->mesh          = mesh ;
+    state->expectedFaces = expectedFaces ;
+    state->endpoints     = allocate(mesh->lineCount * 2 * sizeof(int64_t)) ;
+    state->lines         = allocate(mesh->lineCount * 2 * sizeof(int32_t)) ;
+    state->frames[0]     = allocate(values * sizeof(double)) ;
+    state->frames[1]     = allocate(values * sizeof(double)) ;
+    state->projected     = allocate(mesh->pointCount * 3 * sizeof(double)) ;
+    state->frame         = 0 ;
+    for (size_t i = 0 ; i < mesh->lineCount * 2 ; i++) {
+        state->endpoints[i] = mesh->lines[i] ;
+        state->lines[i]     = (int32_t)mesh->lines[i] + 1 ;
+    }
+    for (size_t i = 0 ; i < values ; i++) {
+        state->frames[0][i] = mesh->points[i] ;
+        state->frames[1][i] = mesh->points[i] + 0.01 ;
+    }
+    geometryDiff_init(&state->diff) ;
+    if (!transform_init(&state->transform, mesh->dimensions)) {
+        fprintf(stderr, "out of memory\n") ;
+        exit(1) ;
+    }
+    for (size_t d = 1 ; d < mesh->dimensions ; d++) transform_rotate(&state->transform, d - 1, d, 0.3 * (double)d) ;
+}
+
+static void release(operationState *state) {
+    free(state->endpoints) ;
+    free(state->lines) ;
+    free(state->frames[0]) ;
+    free(state->frames[1]) ;
+    free(state->projected) ;
+    geometryDiff_free(&state->diff) ;
+    transform_free(&state->transform) ;
+}
+
+#pragma mark - Results
+
+typedef struct {
+    char   operation[16] ;
+    char   mesh[32] ;
+    double opsPerSecond ;
+    double allocationsPerOp ;
+} baselineResult ;
+
+static baselineResult *baseline      = NULL ;
+static size_t         baselineCount  = 0 ;
+
+// reads the results of an earlier --json run; returns false if the file can't be read
+static bool readBaseline(const char *path) {
+    FILE *file = fopen(path, "r") ;
+    if (!file) return false ;
+
+    size_t capacity = 0 ;
+    char   line[512] ;
+    while (fgets(line, sizeof(line), file)) {
+        baselineResult result ;
+        const char     *opField = strstr(line, "\"operation\":\"") ;
+        const char     *meshField = strstr(line, "\"mesh\":\"") ;
+        const char     *opsField  = strstr(line, "\"opsPerSecond\":") ;
+        const char     *allocField = strstr(line, "\"allocationsPerOp\":") ;
+        if (!(opField && meshField && opsField && allocField)) continue ;
+        if (sscanf(opField, "\"operation\":\"%15[^\"]\"", result.operation) != 1) continue ;
+        if (sscanf(meshField, "\"mesh\":\"%31[^\"]\"", result.mesh) != 1) continue ;
+        result.opsPerSecond     = strtod(opsField + strlen("\"opsPerSecond\":"), NULL) ;
+        result.allocationsPerOp = strtod(allocField + strlen("\"allocationsPerOp\":"), NULL) ;
+
+        if (baselineCount == capacity) {
+            capacity = capacity ? capacity * 2 : 64 ;
+            baselineResult *grown = realloc(baseline, capacity * sizeof(baselineResult)) ;
+            if (!grown) {
+                fclose(file) ;
+                return false ;
+            }
+            baseline = grown ;
+        }
+        baseline[baselineCount++] = result ;
+    }
+    fclose(file) ;
+    return true ;
+}
+
+static const baselineResult *findBaseline(const char *operationName, const char *mesh) {
+    for (size_t i = 0 ; i < baselineCount ; i++) {
+        if (strcmp(baseline[i].operation, operationName) == 0 && strcmp(baseline[i].mesh, mesh) == 0) return &baseline[i] ;
+    }
+    return NULL ;
+}
+
+// whether the operation and mesh names contain every filter given
+static bool selected(const char *operationName, const char *mesh, char **filters, size_t filterCount) {
+    for (size_t i = 0 ; i < filterCount ; i++) {
+        if (!strstr(operationName, filters[i]) && !strstr(mesh, filters[i])) return false ;
+    }
+    return true ;
+}
+
+#pragma mark - Main
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [--json] [--quick] [--time seconds] [--baseline file] [--tolerance fraction] [filter ...]\n", name) ;
+}
+
+int main(int argc, char **argv) {
+    bool       json         = false, quick = false ;
+    double     minimumTime  = 0.2, tolerance = 0.25 ;
+    const char *baselinePath = NULL ;
+    char       **filters    = allocate((size_t)argc * sizeof(char *)) ;
+    size_t     filterCount  = 0 ;
+
+    for (int i = 1 ; i < argc ; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true ;
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            quick = true ;
+        } else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+            minimumTime = strtod(argv[++i], NULL) ;
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baselinePath = argv[++i] ;
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = strtod(argv[++i], NULL) ;
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            usage(argv[0]) ;
+            return 2 ;
+        } else {
+            filters[filterCount++] = argv[i] ;
+        }
+    }
+    if (baselinePath && !readBaseline(baselinePath)) {
+        fprintf(stderr, "unable to read baseline %s\n", baselinePath) ;
+        return 2 ;
+    }
+
+    // the table goes to stdout unless that's for the JSON, when progress and regressions go to stderr
+    FILE   *report   = json ? stderr : stdout ;
+    size_t failures = 0, regressions = 0 ;
+    if (!json) {
+        printf("%-10s %-14s %9s %9s %14s %12s %11s %14s %11s %s\n", "operation", "mesh", "points", "lines",
+               "ops/s", "ns/item", "allocs/op", "peak heap", "peak RSS", baseline ? "vs baseline" : "") ;
+    }
+
+    for (size_t m = 0 ; m < sizeof(meshSpecs) / sizeof(meshSpec) ; m++) {
+        const meshSpec *spec = &meshSpecs[m] ;
+        if (quick && !spec->quick) continue ;
+
+        char meshName[32] ;
+        if (spec->levels > 0) {
+            snprintf(meshName, sizeof(meshName), "%s/%d", spec->family, spec->levels) ;
+        } else {
+            snprintf(meshName, sizeof(meshName), "%s/%d", spec->family, spec->size) ;
+        }
+
+        bool wanted = false ;
+        for (size_t o = 0 ; o < sizeof(operations) / sizeof(operation) ; o++) {
+            wanted = wanted || selected(operations[o].name, meshName, filters, filterCount) ;
+        }
+        if (!wanted) continue ;
+
+        catmullClarkMesh mesh ;
+        size_t           expectedFaces = buildMesh(spec, &mesh) ;
+        operationState   state ;
+        prepare(&state, &mesh, expectedFaces) ;
+        if (mesh.faceCount != expectedFaces) {
+            fprintf(stderr, "%s: found %zu faces building it, expected %zu\n", meshName, mesh.faceCount, expectedFaces) ;
+            failures++ ;
+        }
+
+        for (size_t o = 0 ; o < sizeof(operations) / sizeof(operation) ; o++) {
+            const operation *op = &operations[o] ;
+            if (!selected(op->name, meshName, filters, filterCount)) continue ;
+
+            // once untimed, so what's timed is the steady state: warm caches, and for diff, a
+            // previous frame to compare against
+            bool ok = op->run(&state) ;
+
+            allocationCount   = 0 ;
+            heapPeak          = heapInUse ;
+            size_t heapBefore = heapInUse ;
+            size_t repeats    = 0 ;
+            double start      = now(), elapsed = 0.0 ;
+            do {
+                ok = op->run(&state) && ok ;
+                repeats++ ;
+                elapsed = now() - start ;
+            } while (elapsed < minimumTime) ;
+
+            size_t items            = op->perPoint ? mesh.pointCount : mesh.lineCount ;
+            double opsPerSecond     = (double)repeats / elapsed ;
+            double nsPerItem        = elapsed * 1e9 / (double)repeats / (double)(items > 0 ? items : 1) ;
+            double allocationsPerOp = (double)allocationCount / (double)repeats ;
+            size_t peakHeap         = heapPeak - heapBefore ;
+            long   peakRSS          = peakResidentKiB() ;
+
+            if (!ok) {
+                fprintf(stderr, "%s %s: wrong result\n", op->name, meshName) ;
+                failures++ ;
+            }
+
+            char                 comparison[64] = "" ;
+            const baselineResult *before        = findBaseline(op->name, meshName) ;
+            if (before && before->opsPerSecond > 0.0) {
+                double ratio  = opsPerSecond / before->opsPerSecond ;
+                bool   slower = ratio < 1.0 - tolerance ;
+                bool   more   = allocationsPerOp > before->allocationsPerOp + 0.5 ;
+                snprintf(comparison, sizeof(comparison), "%.2fx%s%s", ratio, slower ? " slower" : "", more ? " more allocs" : "") ;
+                if (slower || more) {
+                    regressions++ ;
+                    if (json) fprintf(stderr, "%s %s: %s\n", op->name, meshName, comparison) ;
+                }
+            }
+
+            if (json) {
+                printf("{\"operation\":\"%s\",\"mesh\":\"%s\",\"dimensions\":%zu,\"points\":%zu,\"lines\":%zu,\"faces\":%zu,"
+                       "\"repeats\":%zu,\"seconds\":%.6f,\"opsPerSecond\":%.3f,\"nsPerItem\":%.3f,\"allocationsPerOp\":%.3f,"
+                       "\"peakHeapBytes\":%zu,\"peakRSSKiB\":%ld,\"ok\":%s}\n",
+                       op->name, meshName, mesh.dimensions, mesh.pointCount, mesh.lineCount, mesh.faceCount,
+                       repeats, elapsed, opsPerSecond, nsPerItem, allocationsPerOp, peakHeap, peakRSS, ok ? "true" : "false") ;
+                fflush(stdout) ;
+            } else {
+                printf("%-10s %-14s %9zu %9zu %14.1f %12.2f %11.1f %14zu %8ld KiB %s\n", op->name, meshName,
+                       mesh.pointCount, mesh.lineCount, opsPerSecond, nsPerItem, allocationsPerOp, peakHeap, peakRSS, comparison) ;
+            }
+        }
+
+        release(&state) ;
+        catmullClark_free(&mesh) ;
+    }
+    free(filters) ;
+    free(baseline) ;
+
+    if (failures > 0) fprintf(report, "%zu results were wrong\n", failures) ;
+    if (regressions > 0) fprintf(report, "%zu results regressed against the baseline\n", regressions) ;
+    return (failures > 0 || regressions > 0) ? 1 : 0 ;
+}
@@ -0,0 +1,163 @@
+// Benchmark for transforming and projecting points with ../src/transform.h
+//
+// Rotates random 4-D and 5-D points through a chain of 1 or 3 plane rotations, with a scale and a
+// translation, and projects them down to 3-D -- one frame of Examples/tesseract.lua's animation --
+// from the 16 points of a tesseract up to a million. The "step by step" column does what the
+// example did: each rotation multiplied into every point in turn as a separate pass, then the
+// projection as another; the "composed" column builds one transform and does it all in one pass
+// with transform_project. The results are checked against each other, and transform_apply, which
+// works in place, against transform_project with nothing to project.
+//
+//     make
+//     ./transformBenchmark
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "transform.h"
+
+static double now(void) {
+    struct timespec ts ;
+    clock_gettime(CLOCK_MONOTONIC, &ts) ;
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9 ;
+}
+
+static uint64_t randomState = 0x9e3779b97f4a7c15ULL ;
+
+static double nextRandom(void) {
+    randomState ^= randomState << 13 ;
+    randomState ^= randomState >> 7 ;
+    randomState ^= randomState << 17 ;
+    return (double)(randomState >> 11) / (double)(1ULL << 53) * 2.0 - 1.0 ;
+}
+
+static const double eyeDistance = 2.0, scale = 1.0, offset = 1.0 ;
+
+typedef struct {
+    size_t a, b ;
+    double angle ;
+} rotation ;
+
+static const rotation rotations[] = { { 0, 3, 0.3 }, { 1, 2, 1.1 }, { 2, 3, -0.7 } } ;
+
+static void *allocate(size_t size) {
+    void *memory = malloc(size > 0 ? size : 1) ;
+    if (!memory) {
+        fprintf(stderr, "out of memory\n") ;
+        exit(1) ;
+    }
+    return memory ;
+}
+
+// one pass per step, each into a new copy of the points, as a Lua loop of matrix * point would
+static void stepByStep(const double *points, size_t count, size_t dimensions, size_t chain,
+                       const double *factors, const double *offsets, double *work, double *next, double *out) {
+    memcpy(work, points, count * dimensions * sizeof(double)) ;
+    for (size_t r = 0 ; r < chain ; r++) {
+        size_t a = rotations[r].a, b = rotations[r].b ;
+        double c = cos(rotations[r].angle), s = sin(rotations[r].angle) ;
+        for (size_t i = 0 ; i < count ; i++) {
+            const double *p = &work[i * dimensions] ;
+            double       *q = &next[i * dimensions] ;
+            memcpy(q, p, dimensions * sizeof(double)) ;
+            q[a] = c * p[a] - s * p[b] ;
+            q[b] = s * p[a] + c * p[b] ;
+        }
+        memcpy(work, next, count * dimensions * sizeof(double)) ;
+    }
+    for (size_t i = 0 ; i < count * dimensions ; i++) work[i] = work[i] * factors[i % dimensions] + offsets[i % dimensions] ;
+    projection_project(work, count, dimensions, 3, eyeDistance, scale, offset, out) ;
+}
+
+static void composed(transformMatrix *transform, const double *points, size_t count, size_t chain,
+                     const double *factors, const double *offsets, double *out) {
+    transform_reset(transform) ;
+    for (size_t r = 0 ; r < chain ; r++) transform_rotate(transform, rotations[r].a, rotations[r].b, rotations[r].angle) ;
+    transform_scale(transform, factors) ;
+    transform_translate(transform, offsets) ;
+    transform_project(transform, points, count, 3, eyeDistance, scale, offset, out) ;
+}
+
+int main(void) {
+    size_t counts[]     = { 16, 1000, 100000, 1000000 } ;
+    size_t dimensions[] = { 4, 5 } ;
+    size_t chains[]     = { 1, 3 } ;
+    double factors[]    = { 1.0, 0.9, 1.1, 1.0, 0.8 } ;
+    double offsets[]    = { 0.1, 0.0, -0.2, 0.05, 0.0 } ;
+    bool   allClose     = true ;
+
+    printf("%-11s %9s %10s %18s %16s %10s %12s\n", "dimensions", "rotations", "points", "step by step pt/s", "composed pt/s", "speedup", "max error") ;
+
+    for (size_t d = 0 ; d < sizeof(dimensions) / sizeof(size_t) ; d++) {
+        transformMatrix transform ;
+        if (!transform_init(&transform, dimensions[d])) {
+            fprintf(stderr, "out of memory\n") ;
+            return 1 ;
+        }
+        for (size_t r = 0 ; r < sizeof(chains) / sizeof(size_t) ; r++) {
+            for (size_t n = 0 ; n < sizeof(counts) / sizeof(size_t) ; n++) {
+                size_t count     = counts[n] ;
+                size_t values    = count * dimensions[d] ;
+                double *points   = allocate(values * sizeof(double)) ;
+                double *work     = allocate(values * sizeof(double)) ;
+                double *next     = allocate(values * sizeof(double)) ;
+                double *expected = allocate(count * 3 * sizeof(double)) ;
+                double *out      = allocate(count * 3 * sizeof(double)) ;
+                for (size_t i = 0 ; i < values ; i++) points[i] = nextRandom() ;
+
+                size_t repeats = 0 ;
+                double start   = now(), elapsed = 0.0 ;
+                do {
+                    stepByStep(points, count, dimensions[d], chains[r], factors, offsets, work, next, expected) ;
+                    repeats++ ;
+                    elapsed = now() - start ;
+                } while (elapsed < 0.1) ;
+                double steps = (double)(count * repeats) / elapsed ;
+
+                repeats = 0 ;
+                start   = now() ;
+                do {
+                    composed(&transform, points, count, chains[r], factors, offsets, out) ;
+                    repeats++ ;
+                    elapsed = now() - start ;
+                } while (elapsed < 0.1) ;
+                double single = (double)(count * repeats) / elapsed ;
+
+                double maxError = 0.0 ;
+                for (size_t i = 0 ; i < count * 3 ; i++) {
+                    double error = fabs(out[i] - expected[i]) / fmax(1.0, fabs(expected[i])) ;
+                    if (error > maxError) maxError = error ;
+                }
+                allClose = allClose && (maxError < 1e-12) ;
+
+                if (n == 0) {
+                    double *direct = allocate(values * sizeof(double)) ;
+                    transform_project(&transform, points, count, dimensions[d], eyeDistance, scale, offset, direct) ;
+                    transform_apply(&transform, points, count, points) ;
+                    allClose = allClose && memcmp(direct, points, values * sizeof(double)) == 0 ;
+                    free(direct) ;
+                }
+
+                char label[16] ;
+                snprintf(label, sizeof(label), "%zu -> 3", dimensions[d]) ;
+                printf("%-11s %9zu %10zu %18.0f %16.0f %9.2fx %12.2e\n", label, chains[r], count, steps, single, single / steps, maxError) ;
+
+                free(points) ;
+                free(work) ;
+                free(next) ;
+                free(expected) ;
+                free(out) ;
+            }
+        }
+        transform_free(&transform) ;
+    }
+
+    if (!allClose) {
+        fprintf(stderr, "composed transforms don't match the step by step results\n") ;
+        return 1 ;
+    }
+    return 0 ;
+}
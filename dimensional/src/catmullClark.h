@@ -0,0 +1,376 @@
+// Catmull-Clark subdivision for hs._asm.dimensional
+//
+// Plain C, like meshFaces.h, working on flat arrays: points are runs of `dimensions` doubles (so
+// points with a w component, or more, subdivide just like 3-D ones), lines are pairs of point
+// numbers, and faces are loops of 3 or 4 lines as meshFaces_find reports them. Each level is done
+// in a fixed number of passes over the points, lines and faces, with everything the formulas need
+// -- the faces each line borders, the lines meeting at each point -- gathered up front into index
+// lists rather than searched for.
+//
+// Each level replaces the mesh with:
+//
+//   points: the original points moved to (F + 2R + (n - 3)P) / n, where F is the average of the
+//           face points of the faces around it, R the average of the midpoints of its n lines and
+//           P where it was; then a point at the middle of each face; then a point for each line,
+//           the average of its ends and the face points either side of it
+//   lines:  from each line's point to the face point of each face it borders, in line order, then
+//           from each original point to the points of the lines meeting there, in point order
+//   faces:  a quad at each corner of each face, reported in the same order and form as
+//           meshFaces_find would report them for the new lines
+//
+// This matches the Lua version in Examples/catmullClark.lua for closed 3-D meshes, where n is
+// the number of faces around each point as well as the number of lines. Where the two differ, as
+// at the corners of a tesseract (4 lines, 6 faces), this version weights by the number of lines,
+// which keeps the points from being pulled in towards the origin.
+
+#pragma once
+
+#include <stdio.h>
+
+#include "meshFaces.h"
+
+typedef struct {
+    size_t   dimensions ;  // components per point
+    double   *points ;     // pointCount * dimensions
+    uint32_t *lines ;      // pairs of 0 based point numbers
+    meshFace *faces ;      // 1 based line numbers, as meshFaces_find gives them
+    size_t   pointCount ;
+    size_t   lineCount ;
+    size_t   faceCount ;
+} catmullClarkMesh ;
+
+#pragma mark - Lifecycle
+
+static inline void catmullClark_init(catmullClarkMesh *mesh, size_t dimensions) {
+    memset(mesh, 0, sizeof(catmullClarkMesh)) ;
+    mesh->dimensions = dimensions ;
+}
+
+static inline void catmullClark_free(catmullClarkMesh *mesh) {
+    free(mesh->points) ;
+    free(mesh->lines) ;
+    free(mesh->faces) ;
+    catmullClark_init(mesh, mesh->dimensions) ;
+}
+
+// makes room for the given number of points, lines and faces and sets the counts; the contents
+// are left for the caller to fill in
+static bool catmullClark_resize(catmullClarkMesh *mesh, size_t pointCount, size_t lineCount, size_t faceCount) {
+    double   *points = realloc(mesh->points, (pointCount > 0 ? pointCount : 1) * mesh->dimensions * sizeof(double)) ;
+    if (points) mesh->points = points ;
+    uint32_t *lines  = realloc(mesh->lines,  (lineCount > 0 ? lineCount : 1) * 2 * sizeof(uint32_t)) ;
+    if (lines) mesh->lines = lines ;
+    meshFace *faces  = realloc(mesh->faces,  (faceCount > 0 ? faceCount : 1) * sizeof(meshFace)) ;
+    if (faces) mesh->faces = faces ;
+    if (!(points && lines && faces)) return false ;
+
+    mesh->pointCount = pointCount ;
+    mesh->lineCount  = lineCount ;
+    mesh->faceCount  = faceCount ;
+    return true ;
+}
+
+// fills in the faces from the lines with meshFaces_find (4 sided faces only, as facesFromLines
+// does by default)
+static bool catmullClark_findFaces(catmullClarkMesh *mesh) {
+    int64_t *endpoints = malloc((mesh->lineCount > 0 ? mesh->lineCount : 1) * 2 * sizeof(int64_t)) ;
+    if (!endpoints) return false ;
+    for (size_t i = 0 ; i < mesh->lineCount * 2 ; i++) endpoints[i] = mesh->lines[i] ;
+
+    meshFaceList list ;
+    meshFaces_init(&list) ;
+    bool found = meshFaces_find(&list, endpoints, mesh->lineCount, false) ;
+    free(endpoints) ;
+
+    if (found) {
+        meshFace *faces = realloc(mesh->faces, (list.count > 0 ? list.count : 1) * sizeof(meshFace)) ;
+        if (faces) {
+            if (list.count > 0) memcpy(faces, list.faces, list.count * sizeof(meshFace)) ;
+            mesh->faces     = faces ;
+            mesh->faceCount = list.count ;
+        }
+        found = (faces != NULL) ;
+    }
+    meshFaces_free(&list) ;
+    return found ;
+}
+
+#pragma mark - Support
+
+// the corners of a face, where each of its lines meets the next; fails if the lines don't go round
+// in a loop through different points
+static bool catmullClark_corners(const catmullClarkMesh *mesh, const meshFace *face, uint32_t corners[4]) {
+    size_t sides = meshFaces_sides(face) ;
+    for (size_t i = 0 ; i < sides ; i++) {
+        if (face->lines[i] == 0 || face->lines[i] > mesh->lineCount) return false ;
+    }
+
+    for (size_t i = 0 ; i < sides ; i++) {
+        const uint32_t *line = &mesh->lines[(face->lines[i] - 1) * 2] ;
+        const uint32_t *next = &mesh->lines[(face->lines[(i + 1) % sides] - 1) * 2] ;
+        if (line[0] == next[0] || line[0] == next[1]) {
+            corners[i] = line[0] ;
+        } else if (line[1] == next[0] || line[1] == next[1]) {
+            corners[i] = line[1] ;
+        } else {
+            return false ;
+        }
+    }
+
+    for (size_t i = 0 ; i < sides ; i++) {
+        const uint32_t *line    = &mesh->lines[(face->lines[i] - 1) * 2] ;
+        uint32_t       previous = corners[(i + sides - 1) % sides] ;
+        if (!((line[0] == previous && line[1] == corners[i]) || (line[1] == previous && line[0] == corners[i]))) return false ;
+        for (size_t j = 0 ; j < i ; j++) {
+            if (corners[j] == corners[i]) return false ;
+        }
+    }
+    return true ;
+}
+
+// the face with the given lines, in order round it, in the form meshFaces_find uses: starting from
+// the lowest numbered line and heading towards the lower numbered of its neighbors
+static meshFace catmullClark_canonicalFace(const uint32_t lines[4]) {
+    size_t lowest = 0 ;
+    for (size_t i = 1 ; i < 4 ; i++) {
+        if (lines[i] < lines[lowest]) lowest = i ;
+    }
+    size_t   step = (lines[(lowest + 1) % 4] < lines[(lowest + 3) % 4]) ? 1 : 3 ;
+    meshFace face ;
+    for (size_t i = 0 ; i < 4 ; i++) face.lines[i] = lines[(lowest + i * step) % 4] + 1 ;
+    return face ;
+}
+
+#pragma mark - Subdivision
+
+// replaces the mesh with the next level of subdivision; on failure the mesh is unchanged and error
+// describes the problem
+static bool catmullClark_refine(catmullClarkMesh *mesh, char *error, size_t errorSize) {
+    size_t dimensions = mesh->dimensions ;
+    size_t P = mesh->pointCount, L = mesh->lineCount, F = mesh->faceCount ;
+
+    for (size_t i = 0 ; i < L * 2 ; i++) {
+        if (mesh->lines[i] >= P) {
+            snprintf(error, errorSize, "line %zu refers to point %u, but there are only %zu points", i / 2 + 1, mesh->lines[i] + 1, P) ;
+            return false ;
+        }
+    }
+
+    // the new lines run from line points to face points (one for each side of each face), then
+    // from the original points to line points (one for each end of each line, but once for a line
+    // which starts and ends at the same point); there's a new face for each side of each face
+    size_t sideCount = 0, loopCount = 0 ;
+    for (size_t f = 0 ; f < F ; f++) sideCount += meshFaces_sides(&mesh->faces[f]) ;
+    for (size_t l = 0 ; l < L ; l++) loopCount += (mesh->lines[l * 2] == mesh->lines[l * 2 + 1]) ;
+
+    size_t newPointCount = P + F + L ;
+    size_t newLineCount  = sideCount + L * 2 - loopCount ;
+    if (newPointCount >= UINT32_MAX || newLineCount >= UINT32_MAX / 2) {
+        snprintf(error, errorSize, "subdivision would produce more than %u lines", UINT32_MAX / 2) ;
+        return false ;
+    }
+
+    uint32_t *corners       = malloc((F > 0 ? F : 1) * 4 * sizeof(uint32_t)) ;
+    uint32_t *sideLines     = malloc((F > 0 ? F : 1) * 4 * sizeof(uint32_t)) ;  // new line for each side of each face, see below
+    uint32_t *edgeOffsets   = calloc(L + 1, sizeof(uint32_t)) ;                  // faces bordering line l are edgeFaces[edgeOffsets[l]...]
+    uint32_t *edgeFaces     = malloc((sideCount > 0 ? sideCount : 1) * sizeof(uint32_t)) ;
+    uint32_t *vertexOffsets = calloc(P + 1, sizeof(uint32_t)) ;                  // lines meeting at point p are vertexLines[vertexOffsets[p]...]
+    uint32_t *vertexLines   = malloc((L > 0 ? L : 1) * 2 * sizeof(uint32_t)) ;
+    uint32_t *endLines      = malloc((L > 0 ? L : 1) * 2 * sizeof(uint32_t)) ;   // new line for each end of each line, see below
+    uint32_t *faceCounts    = calloc(P > 0 ? P : 1, sizeof(uint32_t)) ;
+    double   *faceSums      = calloc((P > 0 ? P : 1) * dimensions, sizeof(double)) ;
+    double   *midpointSums  = calloc((P > 0 ? P : 1) * dimensions, sizeof(double)) ;
+
+    double   *points        = malloc(newPointCount * dimensions * sizeof(double)) ;
+    uint32_t *lines         = malloc((newLineCount > 0 ? newLineCount : 1) * 2 * sizeof(uint32_t)) ;
+    meshFace *faces         = malloc((sideCount > 0 ? sideCount : 1) * sizeof(meshFace)) ;
+
+    bool ok = corners && sideLines && edgeOffsets && edgeFaces && vertexOffsets && vertexLines &&
+              endLines && faceCounts && faceSums && midpointSums && points && lines && faces ;
+    if (!ok) snprintf(error, errorSize, "unable to allocate memory for subdivision") ;
+
+    for (size_t f = 0 ; ok && f < F ; f++) {
+        if (!catmullClark_corners(mesh, &mesh->faces[f], &corners[f * 4])) {
+            snprintf(error, errorSize, "face %zu is not a closed loop of 3 or 4 lines", f + 1) ;
+            ok = false ;
+        }
+    }
+
+    if (ok) {
+        // faces bordering each line, in face order; a line's position in edgeFaces is also the
+        // number of the new line from its line point to that face's point, and its position in
+        // vertexLines, plus sideCount, the number of the new line from that point to its line point
+        for (size_t f = 0 ; f < F ; f++) {
+            for (size_t i = 0 ; i < meshFaces_sides(&mesh->faces[f]) ; i++) edgeOffsets[mesh->faces[f].lines[i]]++ ;
+        }
+        for (size_t l = 0 ; l < L ; l++) edgeOffsets[l + 1] += edgeOffsets[l] ;
+        for (size_t f = 0 ; f < F ; f++) {
+            for (size_t i = 0 ; i < meshFaces_sides(&mesh->faces[f]) ; i++) {
+                uint32_t l = mesh->faces[f].lines[i] - 1 ;
+                sideLines[f * 4 + i]        = edgeOffsets[l] ;
+                edgeFaces[edgeOffsets[l]++] = (uint32_t)f ;
+            }
+        }
+        // edgeOffsets[l] was used as the fill position, so shifting back down restores the starts
+        for (size_t l = L ; l > 0 ; l--) edgeOffsets[l] = edgeOffsets[l - 1] ;
+        edgeOffsets[0] = 0 ;
+
+        // lines meeting at each point, in line order; a line with both ends at the same point is
+        // only listed once
+        for (size_t l = 0 ; l < L ; l++) {
+            vertexOffsets[mesh->lines[l * 2] + 1]++ ;
+            if (mesh->lines[l * 2 + 1] != mesh->lines[l * 2]) vertexOffsets[mesh->lines[l * 2 + 1] + 1]++ ;
+        }
+        for (size_t p = 0 ; p < P ; p++) vertexOffsets[p + 1] += vertexOffsets[p] ;
+        for (size_t l = 0 ; l < L ; l++) {
+            uint32_t from = mesh->lines[l * 2], to = mesh->lines[l * 2 + 1] ;
+            endLines[l * 2]                    = (uint32_t)sideCount + vertexOffsets[from] ;
+            vertexLines[vertexOffsets[from]++] = (uint32_t)l ;
+            if (to == from) {
+                endLines[l * 2 + 1] = endLines[l * 2] ;
+            } else {
+                endLines[l * 2 + 1]              = (uint32_t)sideCount + vertexOffsets[to] ;
+                vertexLines[vertexOffsets[to]++] = (uint32_t)l ;
+            }
+        }
+        for (size_t p = P ; p > 0 ; p--) vertexOffsets[p] = vertexOffsets[p - 1] ;
+        vertexOffsets[0] = 0 ;
+
+        // face points: the average of the face's corners, added up in the order the face's lines
+        // name them
+        for (size_t f = 0 ; f < F ; f++) {
+            const meshFace *face  = &mesh->faces[f] ;
+            double         *point = &points[(P + f) * dimensions] ;
+            uint32_t       seen[8] ;
+            size_t         count = 0 ;
+            memset(point, 0, dimensions * sizeof(double)) ;
+            for (size_t i = 0 ; i < meshFaces_sides(face) ; i++) {
+                for (size_t end = 0 ; end < 2 ; end++) {
+                    uint32_t p = mesh->lines[(face->lines[i] - 1) * 2 + end] ;
+                    bool     already = false ;
+                    for (size_t j = 0 ; j < count ; j++) already = already || (seen[j] == p) ;
+                    if (already) continue ;
+                    seen[count++] = p ;
+                    for (size_t c = 0 ; c < dimensions ; c++) point[c] += mesh->points[p * dimensions + c] ;
+                }
+            }
+            for (size_t c = 0 ; c < dimensions ; c++) point[c] /= (double)count ;
+
+            for (size_t i = 0 ; i < meshFaces_sides(face) ; i++) {
+                uint32_t p = corners[f * 4 + i] ;
+                faceCounts[p]++ ;
+                for (size_t c = 0 ; c < dimensions ; c++) faceSums[p * dimensions + c] += point[c] ;
+            }
+        }
+
+        // line points: the average of the line's ends and the face points either side of it
+        for (size_t l = 0 ; l < L ; l++) {
+            const double *from  = &mesh->points[mesh->lines[l * 2] * dimensions] ;
+            const double *to    = &mesh->points[mesh->lines[l * 2 + 1] * dimensions] ;
+            double       *point = &points[(P + F + l) * dimensions] ;
+            for (size_t c = 0 ; c < dimensions ; c++) point[c] = from[c] + to[c] ;
+            for (uint32_t k = edgeOffsets[l] ; k < edgeOffsets[l + 1] ; k++) {
+                const double *facePoint = &points[(P + edgeFaces[k]) * dimensions] ;
+                for (size_t c = 0 ; c < dimensions ; c++) point[c] += facePoint[c] ;
+            }
+            double count = (double)(2 + edgeOffsets[l + 1] - edgeOffsets[l]) ;
+            for (size_t c = 0 ; c < dimensions ; c++) point[c] /= count ;
+
+            for (size_t c = 0 ; c < dimensions ; c++) {
+                double midpoint = (from[c] + to[c]) / 2 ;
+                midpointSums[mesh->lines[l * 2] * dimensions + c] += midpoint ;
+                if (mesh->lines[l * 2 + 1] != mesh->lines[l * 2]) midpointSums[mesh->lines[l * 2 + 1] * dimensions + c] += midpoint ;
+            }
+        }
+
+        // the original points move; points which aren't the corner of any face stay where they are
+        for (size_t p = 0 ; p < P ; p++) {
+            const double *original = &mesh->points[p * dimensions] ;
+            double       *point    = &points[p * dimensions] ;
+            double       n         = (double)(vertexOffsets[p + 1] - vertexOffsets[p]) ;
+            if (faceCounts[p] == 0 || n == 0) {
+                memcpy(point, original, dimensions * sizeof(double)) ;
+                continue ;
+            }
+            for (size_t c = 0 ; c < dimensions ; c++) {
+                double facePoints = faceSums[p * dimensions + c] / (double)faceCounts[p] ;
+                double midpoints  = midpointSums[p * dimensions + c] / n ;
+                point[c] = (facePoints + 2 * midpoints + (n - 3) * original[c]) / n ;
+            }
+        }
+
+        // lines from line points to face points, then from the original points to line points
+        size_t line = 0 ;
+        for (size_t l = 0 ; l < L ; l++) {
+            for (uint32_t k = edgeOffsets[l] ; k < edgeOffsets[l + 1] ; k++) {
+                lines[line * 2]     = (uint32_t)(P + F + l) ;
+                lines[line * 2 + 1] = (uint32_t)(P + edgeFaces[k]) ;
+                line++ ;
+            }
+        }
+        for (size_t p = 0 ; p < P ; p++) {
+            for (uint32_t k = vertexOffsets[p] ; k < vertexOffsets[p + 1] ; k++) {
+                lines[line * 2]     = (uint32_t)p ;
+                lines[line * 2 + 1] = (uint32_t)(P + F + vertexLines[k]) ;
+                line++ ;
+            }
+        }
+
+        // a quad at each corner: corner, the point of the next line, the face point, the point of
+        // the line before
+        size_t face = 0 ;
+        for (size_t f = 0 ; f < F ; f++) {
+            size_t sides = meshFaces_sides(&mesh->faces[f]) ;
+            for (size_t i = 0 ; i < sides ; i++) {
+                size_t   n      = (i + 1) % sides ;
+                uint32_t corner = corners[f * 4 + i] ;
+                uint32_t before = mesh->faces[f].lines[i] - 1, after = mesh->faces[f].lines[n] - 1 ;
+                uint32_t quad[4] = {
+                    endLines[after * 2 + (mesh->lines[after * 2] == corner ? 0 : 1)],
+                    sideLines[f * 4 + n],
+                    sideLines[f * 4 + i],
+                    endLines[before * 2 + (mesh->lines[before * 2] == corner ? 0 : 1)],
+                } ;
+                faces[face++] = catmullClark_canonicalFace(quad) ;
+            }
+        }
+        qsort(faces, sideCount, sizeof(meshFace), meshFaces_compareFaces) ;
+    }
+
+    free(corners) ;
+    free(sideLines) ;
+    free(edgeOffsets) ;
+    free(edgeFaces) ;
+    free(vertexOffsets) ;
+    free(vertexLines) ;
+    free(endLines) ;
+    free(faceCounts) ;
+    free(faceSums) ;
+    free(midpointSums) ;
+
+    if (!ok) {
+        free(points) ;
+        free(lines) ;
+        free(faces) ;
+        return false ;
+    }
+
+    free(mesh->points) ;
+    free(mesh->lines) ;
+    free(mesh->faces) ;
+    mesh->points     = points ;
+    mesh->lines      = lines ;
+    mesh->faces      = faces ;
+    mesh->pointCount = newPointCount ;
+    mesh->lineCount  = newLineCount ;
+    mesh->faceCount  = sideCount ;
+    return true ;
+}
+
+// applies levels of subdivision in turn; on failure the mesh is left at the last level completed
+static bool catmullClark_subdivide(catmullClarkMesh *mesh, size_t levels, char *error, size_t errorSize) {
+    for (size_t level = 0 ; level < levels ; level++) {
+        if (!catmullClark_refine(mesh, error, errorSize)) return false ;
+    }
+    return true ;
+}
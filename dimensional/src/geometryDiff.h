@@ -0,0 +1,142 @@
+// Change tracking between frames for hs._asm.dimensional's SceneKit nodes
+//
+// generate3dObject draws a point node at the x, y and z of each point and a line node between the
+// points at each end of each line. geometryDiff remembers where each one was last drawn, so the
+// next frame only has to touch the nodes whose positions actually changed: a point changed if any
+// of its coordinates moved by more than epsilon, and a line changed if either end did or it now
+// joins different points. Items past the end of the last frame are always changed.
+//
+// Only the positions that were redrawn are remembered, so a point creeping along by less than
+// epsilon a frame is still redrawn once it's drifted epsilon from where it was drawn.
+//
+// Plain C, so the comparison can be checked and timed without SceneKit; see
+// ../benchmark/geometryDiffBenchmark.c.
+
+#pragma once
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef struct {
+    double  *positions ;     // x, y and z of each point, as last drawn
+    int32_t *lines ;         // the 1 based points at each end of each line, as last drawn
+    uint8_t *pointChanged ;  // for each point of the latest update, whether to redraw it
+    uint8_t *lineChanged ;   // for each line of the latest update, whether to redraw it
+    size_t  pointCount ;
+    size_t  lineCount ;
+    size_t  pointCapacity ;
+    size_t  lineCapacity ;
+    size_t  changedPoints ;  // how many points and lines the latest update changed
+    size_t  changedLines ;
+} geometryDiff ;
+
+#pragma mark - Lifecycle
+
+static inline void geometryDiff_init(geometryDiff *diff) {
+    diff->positions     = NULL ;
+    diff->lines         = NULL ;
+    diff->pointChanged  = NULL ;
+    diff->lineChanged   = NULL ;
+    diff->pointCount    = 0 ;
+    diff->lineCount     = 0 ;
+    diff->pointCapacity = 0 ;
+    diff->lineCapacity  = 0 ;
+    diff->changedPoints = 0 ;
+    diff->changedLines  = 0 ;
+}
+
+static inline void geometryDiff_free(geometryDiff *diff) {
+    free(diff->positions) ;
+    free(diff->lines) ;
+    free(diff->pointChanged) ;
+    free(diff->lineChanged) ;
+    geometryDiff_init(diff) ;
+}
+
+// forgets what was drawn, so the next update changes everything; for when the nodes have been
+// changed by something else
+static inline void geometryDiff_reset(geometryDiff *diff) {
+    diff->pointCount = 0 ;
+    diff->lineCount  = 0 ;
+}
+
+#pragma mark - Updating
+
+static inline bool geometryDiff_reserve(geometryDiff *diff, size_t pointCount, size_t lineCount) {
+    if (pointCount > diff->pointCapacity) {
+        size_t capacity = (diff->pointCapacity > 0) ? diff->pointCapacity : 64 ;
+        while (capacity < pointCount) capacity *= 2 ;
+        double  *positions = realloc(diff->positions, capacity * 3 * sizeof(double)) ;
+        if (positions) diff->positions = positions ;
+        uint8_t *changed   = realloc(diff->pointChanged, capacity) ;
+        if (changed) diff->pointChanged = changed ;
+        if (!positions || !changed) return false ;
+        diff->pointCapacity = capacity ;
+    }
+    if (lineCount > diff->lineCapacity) {
+        size_t capacity = (diff->lineCapacity > 0) ? diff->lineCapacity : 64 ;
+        while (capacity < lineCount) capacity *= 2 ;
+        int32_t *lines   = realloc(diff->lines, capacity * 2 * sizeof(int32_t)) ;
+        if (lines) diff->lines = lines ;
+        uint8_t *changed = realloc(diff->lineChanged, capacity) ;
+        if (changed) diff->lineChanged = changed ;
+        if (!lines || !changed) return false ;
+        diff->lineCapacity = capacity ;
+    }
+    return true ;
+}
+
+// compares the new frame with the last one drawn and fills in pointChanged and lineChanged; the
+// changed items are then remembered as drawn. points are pointCount runs of stride doubles, of
+// which the first 3 are used, and lines are pairs of 1 based point numbers, already checked to be
+// in range. Returns false, leaving the last frame as it was, if there isn't memory for the new one.
+static bool geometryDiff_update(geometryDiff  *diff,
+                                const double  *points,
+                                size_t        pointCount,
+                                size_t        stride,
+                                const int32_t *lines,
+                                size_t        lineCount,
+                                double        epsilon) {
+    if (!geometryDiff_reserve(diff, pointCount, lineCount)) return false ;
+
+    size_t changedPoints = 0 ;
+    for (size_t i = 0 ; i < pointCount ; i++) {
+        const double *point   = &points[i * stride] ;
+        double       *drawn   = &diff->positions[i * 3] ;
+        // written so that a point becoming NaN (or recovering from it) counts as a change
+        bool         changed  = (i >= diff->pointCount) ||
+                                !(fabs(point[0] - drawn[0]) <= epsilon) ||
+                                !(fabs(point[1] - drawn[1]) <= epsilon) ||
+                                !(fabs(point[2] - drawn[2]) <= epsilon) ;
+        diff->pointChanged[i] = changed ;
+        if (changed) {
+            drawn[0] = point[0] ;
+            drawn[1] = point[1] ;
+            drawn[2] = point[2] ;
+            changedPoints++ ;
+        }
+    }
+
+    size_t changedLines = 0 ;
+    for (size_t i = 0 ; i < lineCount ; i++) {
+        int32_t from    = lines[i * 2] ;
+        int32_t to      = lines[i * 2 + 1] ;
+        bool    changed = (i >= diff->lineCount) ||
+                          diff->lines[i * 2] != from || diff->lines[i * 2 + 1] != to ||
+                          diff->pointChanged[from - 1] || diff->pointChanged[to - 1] ;
+        diff->lineChanged[i] = changed ;
+        if (changed) {
+            diff->lines[i * 2]     = from ;
+            diff->lines[i * 2 + 1] = to ;
+            changedLines++ ;
+        }
+    }
+
+    diff->pointCount    = pointCount ;
+    diff->lineCount     = lineCount ;
+    diff->changedPoints = changedPoints ;
+    diff->changedLines  = changedLines ;
+    return true ;
+}
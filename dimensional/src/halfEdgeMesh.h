@@ -0,0 +1,367 @@
+// Half-edge mesh for hs._asm.dimensional
+//
+// A mesh that's built up a piece at a time and keeps its connectivity as it goes, so nothing has to
+// rescan the whole mesh to find what's next to what. Each point keeps a list of the lines meeting
+// at it, threaded through the lines themselves; each side of a face is a half edge, linked to the
+// next side round its face and to the other half edges along the same line. Adding a point, a line
+// or a face only links it in at the front of these lists, and walking the lines at a point or the
+// faces along a line takes time in proportion to how many there are.
+//
+// The usual half-edge structure pairs each half edge with the one twin on the other side of its
+// line, which only works where every line borders at most two faces. The module's meshes are often
+// higher dimensional -- every line of a tesseract borders three squares -- so here a line keeps a
+// list of all its half edges instead of a twin.
+//
+// Everything is numbered from 0 here; the Lua side adds 1. Lines and faces are validated as they're
+// added: a line must join two different points and not repeat one already there (it's looked for
+// among the lines of whichever end has fewer), and a face must be 3 or 4 different lines going
+// round a loop, and not repeat a face already there.
+//
+// catmullClark.h and projection.h work on flat arrays, which halfEdge_toCatmullClark and
+// halfEdge_fromCatmullClark convert to and from; the points are always kept packed, so they can be
+// projected where they are.
+
+#pragma once
+
+#include <stdio.h>
+
+#include "catmullClark.h"
+
+#define HALFEDGE_NONE UINT32_MAX
+
+typedef struct {
+    uint32_t firstLine ;  // the most recently added line meeting here, or HALFEDGE_NONE
+    uint32_t degree ;     // how many lines meet here
+} halfEdgeVertex ;
+
+typedef struct {
+    uint32_t ends[2] ;
+    uint32_t nextAt[2] ;  // the next line meeting at ends[0] and at ends[1]
+    uint32_t firstHalf ;  // the most recently added half edge along this line, or HALFEDGE_NONE
+} halfEdgeLine ;
+
+typedef struct {
+    uint32_t line ;
+    uint32_t from ;        // the end of the line this side starts at, going round the face
+    uint32_t face ;
+    uint32_t next ;        // the next side round the face
+    uint32_t nextOnLine ;  // the next half edge along the same line, belonging to another face
+} halfEdge ;
+
+typedef struct {
+    uint32_t firstHalf ;
+    uint32_t sides ;
+} halfEdgeFace ;
+
+typedef struct {
+    size_t         dimensions ;
+    double         *points ;    // pointCount * dimensions
+    halfEdgeVertex *vertices ;  // one for each point
+    halfEdgeLine   *lines ;
+    halfEdge       *halves ;
+    halfEdgeFace   *faces ;
+    size_t         pointCount ;
+    size_t         lineCount ;
+    size_t         halfCount ;
+    size_t         faceCount ;
+    size_t         pointCapacity ;
+    size_t         lineCapacity ;
+    size_t         halfCapacity ;
+    size_t         faceCapacity ;
+} halfEdgeMesh ;
+
+#pragma mark - Lifecycle
+
+static inline void halfEdge_init(halfEdgeMesh *mesh, size_t dimensions) {
+    memset(mesh, 0, sizeof(halfEdgeMesh)) ;
+    mesh->dimensions = dimensions ;
+}
+
+static inline void halfEdge_free(halfEdgeMesh *mesh) {
+    free(mesh->points) ;
+    free(mesh->vertices) ;
+    free(mesh->lines) ;
+    free(mesh->halves) ;
+    free(mesh->faces) ;
+    halfEdge_init(mesh, mesh->dimensions) ;
+}
+
+// an array grown to hold at least count items of itemSize, doubling as it goes, or NULL with the
+// array left as it was if there isn't memory for it
+static inline void *halfEdge_grow(void *array, size_t *capacity, size_t count, size_t itemSize) {
+    if (count <= *capacity) return array ;
+    if (count >= HALFEDGE_NONE || itemSize == 0) return NULL ;
+    size_t newCapacity = (*capacity > 0) ? *capacity : 16 ;
+    while (newCapacity < count) newCapacity *= 2 ;
+    void *grown = realloc(array, newCapacity * itemSize) ;
+    if (grown) *capacity = newCapacity ;
+    return grown ;
+}
+
+// makes room for count points, and the vertices that go with them
+static bool halfEdge_reservePoints(halfEdgeMesh *mesh, size_t count) {
+    if (count <= mesh->pointCapacity) return true ;
+    size_t         capacity = mesh->pointCapacity ;
+    halfEdgeVertex *vertices = halfEdge_grow(mesh->vertices, &capacity, count, sizeof(halfEdgeVertex)) ;
+    if (!vertices) return false ;
+    mesh->vertices = vertices ;
+    capacity = mesh->pointCapacity ;
+    double *points = halfEdge_grow(mesh->points, &capacity, count, mesh->dimensions * sizeof(double)) ;
+    if (!points) return false ;
+    mesh->points        = points ;
+    mesh->pointCapacity = capacity ;
+    return true ;
+}
+
+#pragma mark - Walking
+
+// the next line meeting at point after line, which must have point as one of its ends
+static inline uint32_t halfEdge_nextLineAt(const halfEdgeMesh *mesh, uint32_t line, uint32_t point) {
+    const halfEdgeLine *l = &mesh->lines[line] ;
+    return (l->ends[0] == point) ? l->nextAt[0] : l->nextAt[1] ;
+}
+
+static inline uint32_t halfEdge_otherEnd(const halfEdgeMesh *mesh, uint32_t line, uint32_t point) {
+    const halfEdgeLine *l = &mesh->lines[line] ;
+    return (l->ends[0] == point) ? l->ends[1] : l->ends[0] ;
+}
+
+// the line joining a and b, or HALFEDGE_NONE; looks through the lines at whichever has fewer
+static uint32_t halfEdge_findLine(const halfEdgeMesh *mesh, uint32_t a, uint32_t b) {
+    if (mesh->vertices[b].degree < mesh->vertices[a].degree) {
+        uint32_t swap = a ;
+        a = b ;
+        b = swap ;
+    }
+    for (uint32_t line = mesh->vertices[a].firstLine ; line != HALFEDGE_NONE ; line = halfEdge_nextLineAt(mesh, line, a)) {
+        if (halfEdge_otherEnd(mesh, line, a) == b) return line ;
+    }
+    return HALFEDGE_NONE ;
+}
+
+// the lines of a face in order round it; returns how many there are
+static size_t halfEdge_faceLines(const halfEdgeMesh *mesh, uint32_t face, uint32_t lines[4]) {
+    const halfEdgeFace *f    = &mesh->faces[face] ;
+    uint32_t           half  = f->firstHalf ;
+    for (size_t i = 0 ; i < f->sides ; i++) {
+        lines[i] = mesh->halves[half].line ;
+        half     = mesh->halves[half].next ;
+    }
+    return f->sides ;
+}
+
+#pragma mark - Building
+
+// adds a point with the mesh's number of components; returns its number, or HALFEDGE_NONE if
+// there isn't memory for it
+static uint32_t halfEdge_addPoint(halfEdgeMesh *mesh, const double *components) {
+    size_t count = mesh->pointCount + 1 ;
+    if (!halfEdge_reservePoints(mesh, count)) return HALFEDGE_NONE ;
+
+    uint32_t point = (uint32_t)mesh->pointCount ;
+    memcpy(&mesh->points[point * mesh->dimensions], components, mesh->dimensions * sizeof(double)) ;
+    mesh->vertices[point].firstLine = HALFEDGE_NONE ;
+    mesh->vertices[point].degree    = 0 ;
+    mesh->pointCount = count ;
+    return point ;
+}
+
+// adds a line from a to b; returns its number, or HALFEDGE_NONE with error describing why not
+static uint32_t halfEdge_addLine(halfEdgeMesh *mesh, uint32_t a, uint32_t b, char *error, size_t errorSize) {
+    if (a >= mesh->pointCount || b >= mesh->pointCount) {
+        snprintf(error, errorSize, "line ends must be points of the mesh") ;
+        return HALFEDGE_NONE ;
+    }
+    if (a == b) {
+        snprintf(error, errorSize, "line must join two different points") ;
+        return HALFEDGE_NONE ;
+    }
+    if (halfEdge_findLine(mesh, a, b) != HALFEDGE_NONE) {
+        snprintf(error, errorSize, "points %u and %u are already joined by a line", a + 1, b + 1) ;
+        return HALFEDGE_NONE ;
+    }
+    halfEdgeLine *grown = halfEdge_grow(mesh->lines, &mesh->lineCapacity, mesh->lineCount + 1, sizeof(halfEdgeLine)) ;
+    if (!grown) {
+        snprintf(error, errorSize, "unable to allocate memory for line") ;
+        return HALFEDGE_NONE ;
+    }
+    mesh->lines = grown ;
+
+    uint32_t     line = (uint32_t)mesh->lineCount ;
+    halfEdgeLine *l   = &mesh->lines[line] ;
+    l->ends[0]   = a ;
+    l->ends[1]   = b ;
+    l->nextAt[0] = mesh->vertices[a].firstLine ;
+    l->nextAt[1] = mesh->vertices[b].firstLine ;
+    l->firstHalf = HALFEDGE_NONE ;
+    mesh->vertices[a].firstLine = line ;
+    mesh->vertices[b].firstLine = line ;
+    mesh->vertices[a].degree++ ;
+    mesh->vertices[b].degree++ ;
+    mesh->lineCount++ ;
+    return line ;
+}
+
+// whether the lines (which needn't be in the same order or start at the same place) are a face already
+static bool halfEdge_hasFace(const halfEdgeMesh *mesh, const uint32_t *lines, size_t sides) {
+    for (uint32_t half = mesh->lines[lines[0]].firstHalf ; half != HALFEDGE_NONE ; half = mesh->halves[half].nextOnLine) {
+        uint32_t existing[4] ;
+        if (halfEdge_faceLines(mesh, mesh->halves[half].face, existing) != sides) continue ;
+        size_t matched = 0 ;
+        for (size_t i = 0 ; i < sides ; i++) {
+            for (size_t j = 0 ; j < sides ; j++) {
+                if (existing[j] == lines[i]) {
+                    matched++ ;
+                    break ;
+                }
+            }
+        }
+        if (matched == sides) return true ;
+    }
+    return false ;
+}
+
+// adds a face of 3 or 4 lines, given in order round it; returns its number, or HALFEDGE_NONE with
+// error describing why not
+static uint32_t halfEdge_addFace(halfEdgeMesh *mesh, const uint32_t *lines, size_t sides, char *error, size_t errorSize) {
+    if (sides < 3 || sides > 4) {
+        snprintf(error, errorSize, "face must have 3 or 4 lines") ;
+        return HALFEDGE_NONE ;
+    }
+    for (size_t i = 0 ; i < sides ; i++) {
+        if (lines[i] >= mesh->lineCount) {
+            snprintf(error, errorSize, "face lines must be lines of the mesh") ;
+            return HALFEDGE_NONE ;
+        }
+    }
+
+    // each side starts where the one before it ended, and the last ends where the first started
+    uint32_t        corners[4] ;
+    const uint32_t *first = mesh->lines[lines[0]].ends, *second = mesh->lines[lines[1]].ends ;
+    corners[0] = (first[1] == second[0] || first[1] == second[1]) ? first[0] : first[1] ;
+    for (size_t i = 0 ; i < sides ; i++) {
+        const uint32_t *ends = mesh->lines[lines[i]].ends ;
+        if (ends[0] != corners[i] && ends[1] != corners[i]) {
+            snprintf(error, errorSize, "face lines must go round a loop in order") ;
+            return HALFEDGE_NONE ;
+        }
+        uint32_t to = (ends[0] == corners[i]) ? ends[1] : ends[0] ;
+        if (i + 1 < sides) {
+            for (size_t j = 0 ; j <= i ; j++) {
+                if (corners[j] == to) {
+                    snprintf(error, errorSize, "face lines must go round a loop through different points") ;
+                    return HALFEDGE_NONE ;
+                }
+            }
+            corners[i + 1] = to ;
+        } else if (to != corners[0]) {
+            snprintf(error, errorSize, "face lines must go round a loop in order") ;
+            return HALFEDGE_NONE ;
+        }
+    }
+    if (halfEdge_hasFace(mesh, lines, sides)) {
+        snprintf(error, errorSize, "face is already part of the mesh") ;
+        return HALFEDGE_NONE ;
+    }
+
+    halfEdgeFace *faces  = halfEdge_grow(mesh->faces, &mesh->faceCapacity, mesh->faceCount + 1, sizeof(halfEdgeFace)) ;
+    if (faces) mesh->faces = faces ;
+    halfEdge     *halves = faces ? halfEdge_grow(mesh->halves, &mesh->halfCapacity, mesh->halfCount + sides, sizeof(halfEdge)) : NULL ;
+    if (!halves) {
+        snprintf(error, errorSize, "unable to allocate memory for face") ;
+        return HALFEDGE_NONE ;
+    }
+    mesh->halves = halves ;
+
+    uint32_t face = (uint32_t)mesh->faceCount ;
+    uint32_t base = (uint32_t)mesh->halfCount ;
+    for (uint32_t i = 0 ; i < sides ; i++) {
+        halfEdge     *half = &mesh->halves[base + i] ;
+        halfEdgeLine *line = &mesh->lines[lines[i]] ;
+        half->line       = lines[i] ;
+        half->from       = corners[i] ;
+        half->face       = face ;
+        half->next       = base + (i + 1) % (uint32_t)sides ;
+        half->nextOnLine = line->firstHalf ;
+        line->firstHalf  = base + i ;
+    }
+    mesh->faces[face].firstHalf = base ;
+    mesh->faces[face].sides     = (uint32_t)sides ;
+    mesh->halfCount += sides ;
+    mesh->faceCount++ ;
+    return face ;
+}
+
+// adds the faces meshFaces_find finds among the lines that aren't part of the mesh already;
+// returns how many were added, or -1 if there wasn't memory
+static long halfEdge_findFaces(halfEdgeMesh *mesh, bool triangles) {
+    int64_t *endpoints = malloc((mesh->lineCount > 0 ? mesh->lineCount : 1) * 2 * sizeof(int64_t)) ;
+    if (!endpoints) return -1 ;
+    for (size_t i = 0 ; i < mesh->lineCount ; i++) {
+        endpoints[i * 2]     = mesh->lines[i].ends[0] ;
+        endpoints[i * 2 + 1] = mesh->lines[i].ends[1] ;
+    }
+
+    meshFaceList list ;
+    meshFaces_init(&list) ;
+    bool found = meshFaces_find(&list, endpoints, mesh->lineCount, triangles) ;
+    free(endpoints) ;
+
+    long added = 0 ;
+    for (size_t i = 0 ; found && i < list.count ; i++) {
+        uint32_t lines[4] ;
+        size_t   sides = meshFaces_sides(&list.faces[i]) ;
+        for (size_t j = 0 ; j < sides ; j++) lines[j] = list.faces[i].lines[j] - 1 ;
+        if (halfEdge_hasFace(mesh, lines, sides)) continue ;
+
+        char error[64] ;
+        if (halfEdge_addFace(mesh, lines, sides, error, sizeof(error)) == HALFEDGE_NONE) {
+            found = false ;
+        } else {
+            added++ ;
+        }
+    }
+    meshFaces_free(&list) ;
+    return found ? added : -1 ;
+}
+
+#pragma mark - Conversion
+
+// copies the mesh into flat arrays for catmullClark_subdivide; out should be initialized and empty
+static inline bool halfEdge_toCatmullClark(const halfEdgeMesh *mesh, catmullClarkMesh *out) {
+    out->dimensions = mesh->dimensions ;
+    if (!catmullClark_resize(out, mesh->pointCount, mesh->lineCount, mesh->faceCount)) return false ;
+    if (mesh->pointCount > 0) memcpy(out->points, mesh->points, mesh->pointCount * mesh->dimensions * sizeof(double)) ;
+    for (size_t i = 0 ; i < mesh->lineCount ; i++) {
+        out->lines[i * 2]     = mesh->lines[i].ends[0] ;
+        out->lines[i * 2 + 1] = mesh->lines[i].ends[1] ;
+    }
+    for (size_t i = 0 ; i < mesh->faceCount ; i++) {
+        uint32_t lines[4] = { 0, 0, 0, 0 } ;
+        size_t   sides    = halfEdge_faceLines(mesh, (uint32_t)i, lines) ;
+        for (size_t j = 0 ; j < 4 ; j++) out->faces[i].lines[j] = (j < sides) ? lines[j] + 1 : 0 ;
+    }
+    return true ;
+}
+
+// builds mesh, which should be initialized and empty, from flat arrays like catmullClark_subdivide
+// leaves; on failure error describes the problem
+static inline bool halfEdge_fromCatmullClark(halfEdgeMesh *mesh, const catmullClarkMesh *in, char *error, size_t errorSize) {
+    mesh->dimensions = in->dimensions ;
+    if (!halfEdge_reservePoints(mesh, in->pointCount)) {
+        snprintf(error, errorSize, "unable to allocate memory for %zu points", in->pointCount) ;
+        return false ;
+    }
+
+    for (size_t i = 0 ; i < in->pointCount ; i++) halfEdge_addPoint(mesh, &in->points[i * in->dimensions]) ;
+    for (size_t i = 0 ; i < in->lineCount ; i++) {
+        if (halfEdge_addLine(mesh, in->lines[i * 2], in->lines[i * 2 + 1], error, errorSize) == HALFEDGE_NONE) return false ;
+    }
+    for (size_t i = 0 ; i < in->faceCount ; i++) {
+        uint32_t lines[4] ;
+        size_t   sides = meshFaces_sides(&in->faces[i]) ;
+        for (size_t j = 0 ; j < sides ; j++) lines[j] = in->faces[i].lines[j] - 1 ;
+        if (halfEdge_addFace(mesh, lines, sides, error, errorSize) == HALFEDGE_NONE) return false ;
+    }
+    return true ;
+}
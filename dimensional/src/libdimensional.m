@@ -1,20 +1,57 @@
 @import Cocoa ;
 @import LuaSkin ;
 @import SceneKit ;
+@import ObjectiveC ;
 
-// TODO:    move to object model
-//              lines and points validated as added
-//              faces/edges created as they are built?
-//              see libpmp?
+#import "meshFaces.h"
+#import "catmullClark.h"
+#import "projection.h"
+#import "packedBuffer.h"
+#import "geometryDiff.h"
+#import "halfEdgeMesh.h"
+#import "transform.h"
+#import "meshFile.h"
+#import "luaTable.h"
 
-static const char * const USERDATA_TAG = "hs._asm.dimensional" ;
-static LSRefTable         refTable     = LUA_NOREF ;
+static const char * const USERDATA_TAG  = "hs._asm.dimensional" ;
+static const char * const BUFFER_TAG    = "hs._asm.dimensional.buffer" ;
+static const char * const MESH_TAG      = "hs._asm.dimensional.mesh" ;
+static const char * const TRANSFORM_TAG = "hs._asm.dimensional.transform" ;
+static LSRefTable         refTable      = LUA_NOREF ;
+
+// kept between calls to projectCoordinatesDown so animating a mesh doesn't allocate every frame
+static projectionBuffer projectionInput ;
+static projectionBuffer projectionOutput ;
 
 // #define get_objectFromUserdata(objType, L, idx, tag) (objType*)*((void**)luaL_checkudata(L, idx, tag))
 // #define get_anyObjectFromUserdata(objType, L, idx) (objType*)*((void**)lua_touserdata(L, idx))
 
 #pragma mark - Support Functions and Classes -
 
+// what generate3dObject last drew under a points node, kept on the node itself so it goes away with it
+@interface ASMDimensionalDrawnState : NSObject {
+  @public
+    geometryDiff _diff ;
+}
+@property (weak) SCNNode *linesNode ;
+@end
+
+@implementation ASMDimensionalDrawnState
+
+- (instancetype)init {
+    self = [super init] ;
+    if (self) geometryDiff_init(&_diff) ;
+    return self ;
+}
+
+- (void)dealloc {
+    geometryDiff_free(&_diff) ;
+}
+
+@end
+
+static char drawnStateKey ;
+
 static CGFloat vector4magnitude(SCNVector4 vector) {
     return sqrt(pow(vector.x, 2) + pow(vector.y, 2) + pow(vector.z, 2) + pow(vector.w, 2)) ;
 }
@@ -45,172 +82,207 @@ static SCNVector3 vector3normalized(SCNVector3 vector) {
 //     return vec1.x * vec2.x + vec1.y * vec2.y + vec1.z * vec2.z ;
 // }
 
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wunused-parameter"
-static BOOL validate_luaTable(lua_State   *L,
-                              int         idx,
-                              NSUInteger  itemCount,
-                              NSUInteger  componentsPerItem,
-                              BOOL        isInteger,
-                              lua_Integer maxInt) {
-
-// // aiming for fastest here and right now I'm pretty well sanitizing input - may need to add
-// // separate validation function if end up going more generic/public with this, as it does have
-// // some impact at higher line/point counts.,,
-//
-//     lua_Integer numItems = luaL_len(L, idx) ;
-//     if (itemCount == 0) itemCount = (NSUInteger)numItems ;
-//
-//     if (numItems == (lua_Integer)itemCount) {
-//         for (NSUInteger i = 0 ; i < itemCount ; i++) {
-//             if (lua_geti(L, idx, (lua_Integer)(i + 1)) == LUA_TTABLE) {
-//                 lua_Integer numComponents = luaL_len(L, -1) ;
-//                 if (componentsPerItem == 0) componentsPerItem = (NSUInteger)numComponents ;
-//
-//                 if (numComponents == (lua_Integer)componentsPerItem) {
-//                     for (NSUInteger j = 0 ; j < componentsPerItem ; j++) {
-//                         if (lua_geti(L, -1, (lua_Integer)(j + 1)) == LUA_TNUMBER) {
-//                             if (isInteger) {
-//                                 if (lua_isinteger(L, -1)) {
-//                                     lua_Integer t = lua_tointeger(L, -1) ;
-//                                     if (t < 1 || t > (maxInt == 0 ? NSMaxInteger : maxInt)) {
-//                                         lua_pop(L, 2) ;
-//                                         if (maxInt == 0) {
-//                                             lua_pushfstring(L, "expected integer greater than 0") ;
-//                                         } else {
-//                                             lua_pushfstring(L, "expected integer between 1 and %d inclusive for component %d of index %d", maxInt, j + 1, i + 1) ;
-//                                         }
-//                                         break ;
-//                                     }
-//                                 } else {
-//                                     lua_pop(L, 2) ;
-//                                     lua_pushfstring(L, "expected integer for component %d of index %d", j + 1, i + 1) ;
-//                                     break ;
-//                                 }
-//                             }
-//                             lua_pop(L, 1) ;
-//                         } else {
-//                             lua_pop(L, 2) ;
-//                             lua_pushfstring(L, "expected %s for component %d of index %d", (isInteger ? "integer" : "number"), j + 1, i + 1) ;
-//                             break ;
-//                         }
-//                     }
-//                     if (lua_type(L, -1) == LUA_TSTRING) {
-//                         break ;
-//                     }
-//                 } else {
-//                     lua_pop(L, 1) ;
-//                     lua_pushfstring(L, "expected table at index %d to contain %d components", i + 1, componentsPerItem) ;
-//                     break ;
-//                 }
-//                 lua_pop(L, 1) ;
-//             } else {
-//                 lua_pop(L, 1) ;
-//                 lua_pushfstring(L, "expected table at index %d", i + 1) ;
-//                 break ;
-//             }
-//         }
-//         if (lua_type(L, -1) != LUA_TSTRING) lua_pushboolean(L, YES) ;
-//     } else {
-//         lua_pushfstring(L, "expected table of %d items", itemCount) ;
-//     }
-//
-//     return (lua_type(L, -1) != LUA_TSTRING) ;
-    return YES ;
+// pushes a new, empty buffer onto the stack and returns it
+static packedBuffer *pushBuffer(lua_State *L, packedBufferType type, size_t components) {
+    packedBuffer *buffer = lua_newuserdata(L, sizeof(packedBuffer)) ;
+    packedBuffer_init(buffer, type, components) ;
+    luaL_getmetatable(L, BUFFER_TAG) ;
+    lua_setmetatable(L, -2) ;
+    return buffer ;
+}
+
+// pushes item idx (0 based) of the buffer as a table; trailing 0s of index items, like the missing
+// 4th line of a triangle, are left off
+static void pushBufferItem(lua_State *L, const packedBuffer *buffer, size_t idx) {
+    size_t components = buffer->components ;
+    if (buffer->type == packedBuffer_points) {
+        const double *item = &buffer->data.points[idx * components] ;
+        lua_createtable(L, (int)components, 0) ;
+        for (size_t c = 0 ; c < components ; c++) {
+            lua_pushnumber(L, item[c]) ;
+            lua_rawseti(L, -2, (lua_Integer)(c + 1)) ;
+        }
+    } else {
+        const int32_t *item = &buffer->data.indicies[idx * components] ;
+        while (components > 0 && item[components - 1] == 0) components-- ;
+        lua_createtable(L, (int)components, 0) ;
+        for (size_t c = 0 ; c < components ; c++) {
+            lua_pushinteger(L, item[c]) ;
+            lua_rawseti(L, -2, (lua_Integer)(c + 1)) ;
+        }
+    }
+}
+
+// pushes the buffer as a table of tables, the form the module's functions take without buffers
+static void pushBufferAsTable(lua_State *L, const packedBuffer *buffer) {
+    lua_createtable(L, (int)buffer->count, 0) ;
+    for (size_t i = 0 ; i < buffer->count ; i++) {
+        pushBufferItem(L, buffer, i) ;
+        lua_rawseti(L, -2, (lua_Integer)(i + 1)) ;
+    }
+}
+
+// reads entry i of the table at idx into value position of the buffer; returns NO if it isn't a
+// number, or for indicies, an integer that fits in 32 bits
+static BOOL readBufferValue(lua_State *L, int idx, lua_Integer i, packedBuffer *buffer, size_t position) {
+    int isNumber = 0 ;
+    if (lua_rawgeti(L, idx, i) != LUA_TNUMBER) {
+        lua_pop(L, 1) ;
+        return NO ;
+    }
+    if (buffer->type == packedBuffer_points) {
+        buffer->data.points[position] = lua_tonumberx(L, -1, &isNumber) ;
+    } else {
+        lua_Integer value = lua_tointegerx(L, -1, &isNumber) ;
+        if (isNumber && (value < INT32_MIN || value > INT32_MAX)) isNumber = 0 ;
+        if (isNumber) buffer->data.indicies[position] = (int32_t)value ;
+    }
+    lua_pop(L, 1) ;
+    return (BOOL)isNumber ;
+}
+
+// the points or indicies given as argument idx: a buffer of the right type is used as it is, while
+// a table is copied into a new buffer left on the stack. components and minComponents are as for
+// luaTable_copyToBuffer, with 0 accepting any number, and a table's indicies are checked against
+// maximum while they're copied. Raises an argument error if neither works.
+static packedBuffer *tableOrBufferArgument(lua_State *L, int idx, packedBufferType type, size_t minComponents, size_t components, int64_t maximum, bool allowZero) {
+    packedBuffer *buffer = luaL_testudata(L, idx, BUFFER_TAG) ;
+    if (buffer) {
+        if (buffer->type != type) {
+            luaL_argerror(L, idx, (type == packedBuffer_points) ? "expected point buffer" : "expected index buffer") ;
+            return NULL ;
+        }
+        if (components > 0 && (buffer->components < minComponents || buffer->components > components)) {
+            luaL_argerror(L, idx, (minComponents == components) ?
+                lua_pushfstring(L, "expected buffer with %d components", (int)components) :
+                lua_pushfstring(L, "expected buffer with %d to %d components", (int)minComponents, (int)components)) ;
+            return NULL ;
+        }
+        return buffer ;
+    }
+
+    if (lua_type(L, idx) != LUA_TTABLE) {
+        luaL_argerror(L, idx, "expected array type table or buffer") ;
+        return NULL ;
+    }
+    buffer = pushBuffer(L, type, components) ;
+    const char *errMsg = luaTable_copyToBuffer(L, idx, buffer, minComponents, maximum, allowZero) ;
+    if (errMsg) {
+        luaL_argerror(L, idx, errMsg) ;
+        return NULL ;
+    }
+    return buffer ;
+}
+
+// as tableOrBufferArgument, for points or indicies that aren't checked against a maximum
+static packedBuffer *bufferArgument(lua_State *L, int idx, packedBufferType type, size_t minComponents, size_t components) {
+    return tableOrBufferArgument(L, idx, type, minComponents, components, LUATABLE_NO_RANGE, false) ;
+}
+
+// raises an argument error unless every index in the buffer is between 1 and maximum, or is a 0
+// allowed by allowZero (see packedBuffer_findOutOfRange)
+static void checkIndexRange(lua_State *L, int idx, const packedBuffer *buffer, size_t maximum, bool allowZero) {
+    size_t position = packedBuffer_findOutOfRange(buffer, (int64_t)maximum, allowZero) ;
+    if (position != SIZE_MAX) {
+        luaL_argerror(L, idx, lua_pushfstring(L, "expected integer between 1 and %d inclusive for component %d of index %d",
+                                                 (int)maximum,
+                                                 (int)(position % buffer->components + 1),
+                                                 (int)(position / buffer->components + 1))) ;
+    }
+}
+
+// indicies given as argument idx, as for bufferArgument, all between 1 and maximum (or 0 where
+// allowZero allows it); a table is checked as it's copied, a buffer afterwards
+static packedBuffer *indexArgument(lua_State *L, int idx, size_t minComponents, size_t components, size_t maximum, bool allowZero) {
+    BOOL         isTable = (lua_type(L, idx) == LUA_TTABLE) ;
+    packedBuffer *buffer = tableOrBufferArgument(L, idx, packedBuffer_indicies, minComponents, components, (int64_t)maximum, allowZero) ;
+    if (!isTable) checkIndexRange(L, idx, buffer, maximum, allowZero) ;
+    return buffer ;
 }
-#pragma clang diagnostic pop
 
 #pragma mark - Module Functions -
 
+// points and lines may be tables or buffers; the first 3 components of each point are used. Only
+// the nodes whose points moved more than epsilon (default 0) since they were last drawn are
+// updated, and nodes are added or removed at the end when the number of points or lines changes.
 static int dimensional_generateSceneKitObject(lua_State *L) {
     LuaSkin *skin = [LuaSkin sharedWithState:L] ;
-    [skin checkArgs:LS_TTABLE,
-                    LS_TTABLE,
+    [skin checkArgs:LS_TTABLE | LS_TUSERDATA, BUFFER_TAG,
+                    LS_TTABLE | LS_TUSERDATA, BUFFER_TAG,
                     LS_TUSERDATA, "hs._asm.uitk.element.sceneKit.node",
                     LS_TUSERDATA, "hs._asm.uitk.element.sceneKit.node",
                     LS_TUSERDATA, "hs._asm.uitk.element.sceneKit.node",
                     LS_TUSERDATA, "hs._asm.uitk.element.sceneKit.node",
+                    LS_TNUMBER | LS_TOPTIONAL,
                     LS_TBREAK] ;
-    NSArray *pointsArray   = [skin toNSObjectAtIndex:1] ;
-    NSArray *linesArray    = [skin toNSObjectAtIndex:2] ;
     SCNNode *pointsNode    = [skin toNSObjectAtIndex:3] ;
     SCNNode *linesNode     = [skin toNSObjectAtIndex:4] ;
     SCNNode *pointTemplate = [skin toNSObjectAtIndex:5] ;
     SCNNode *lineTemplate  = [skin toNSObjectAtIndex:6] ;
+    double  epsilon        = (lua_type(L, 7) == LUA_TNUMBER) ? lua_tonumber(L, 7) : 0.0 ;
+    if (epsilon < 0.0) return luaL_argerror(L, 7, "expected number greater than or equal to 0") ;
 
-    NSString *errMsg = nil ;
-    if ([pointsArray isKindOfClass:[NSArray class]]) {
-        if (!validate_luaTable(L, 1, 0, 0, NO, 0)) {
-            errMsg = [NSString stringWithUTF8String:lua_tostring(L, -1)] ;
-        }
-        lua_pop(L, 1) ;
-    } else {
-        errMsg = @"expected array type table" ;
+    packedBuffer *points = bufferArgument(L, 1, packedBuffer_points, 0, 0) ;
+    if (points->count > 0 && points->components < 3) {
+        return luaL_argerror(L, 1, "expected points with at least 3 components") ;
     }
-    if (errMsg) return luaL_argerror(L, 1, errMsg.UTF8String) ;
+    packedBuffer *lines = indexArgument(L, 2, 2, 2, points->count, false) ;
 
-    if ([linesArray isKindOfClass:[NSArray class]]) {
-        if (!validate_luaTable(L, 2, 0, 2, YES, (lua_Integer)pointsArray.count)) {
-            errMsg = [NSString stringWithUTF8String:lua_tostring(L, -1)] ;
-        }
-        lua_pop(L, 1) ;
-    } else {
-        errMsg = @"expected array type table" ;
-    }
-    if (errMsg) return luaL_argerror(L, 2, errMsg.UTF8String) ;
+    NSArray *pointNodes = pointsNode.childNodes ;
+    NSArray *lineNodes  = linesNode.childNodes ;
 
-    BOOL createNewPoints = (pointsNode.childNodes.count != pointsArray.count) ;
-    BOOL createNewLines  = (linesNode.childNodes.count  != linesArray.count) ;
+    // start over if these nodes weren't the last ones drawn, or something else has added or removed some
+    ASMDimensionalDrawnState *state = objc_getAssociatedObject(pointsNode, &drawnStateKey) ;
+    if (!state) {
+        state = [[ASMDimensionalDrawnState alloc] init] ;
+        objc_setAssociatedObject(pointsNode, &drawnStateKey, state, OBJC_ASSOCIATION_RETAIN_NONATOMIC) ;
+    }
+    geometryDiff *diff = &state->_diff ;
+    if (state.linesNode != linesNode || diff->pointCount != pointNodes.count || diff->lineCount != lineNodes.count) {
+        geometryDiff_reset(diff) ;
+        state.linesNode = linesNode ;
+    }
+    if (!geometryDiff_update(diff, points->data.points, points->count, points->components, lines->data.indicies, lines->count, epsilon)) {
+        return luaL_error(L, "unable to allocate memory for %d points and %d lines", (int)points->count, (int)lines->count) ;
+    }
 
-    if (createNewPoints) {
-        while (pointsNode.childNodes.count > 0) {
-            [(SCNNode *)pointsNode.childNodes.lastObject removeFromParentNode] ;
-        }
+    for (NSUInteger idx = pointNodes.count ; idx > points->count ; idx--) {
+        [(SCNNode *)pointNodes[idx - 1] removeFromParentNode] ;
     }
-    if (createNewLines) {
-        while (linesNode.childNodes.count > 0) {
-            [(SCNNode *)linesNode.childNodes.lastObject removeFromParentNode] ;
-        }
+    for (NSUInteger idx = lineNodes.count ; idx > lines->count ; idx--) {
+        [(SCNNode *)lineNodes[idx - 1] removeFromParentNode] ;
     }
 
-    NSUInteger idx = 0 ;
-    for (NSArray *point in pointsArray) {
-        NSNumber *x = point.firstObject ;
-        NSNumber *y = [point objectAtIndex:1] ;
-        NSNumber *z = point.lastObject ;
+    // positions are taken from the diff, which has them as drawn, so lines meet their points exactly
+    const double *drawn = diff->positions ;
+
+    for (NSUInteger idx = 0 ; idx < points->count ; idx++) {
+        if (!diff->pointChanged[idx]) continue ;
+        const double *point = &drawn[idx * 3] ;
 
-        SCNNode *thePoint = createNewPoints ? [pointTemplate clone] : pointsNode.childNodes[idx] ;
-        thePoint.worldPosition = SCNVector3Make(x.doubleValue, y.doubleValue, z.doubleValue) ;
-        if (createNewPoints) {
+        BOOL    isNew     = (idx >= pointNodes.count) ;
+        SCNNode *thePoint = isNew ? [pointTemplate clone] : pointNodes[idx] ;
+        thePoint.worldPosition = SCNVector3Make(point[0], point[1], point[2]) ;
+        if (isNew) {
             thePoint.name = [NSString stringWithFormat:@"point%lu", idx] ;
             [pointsNode addChildNode:thePoint] ;
         }
-
-        idx++ ;
     }
 
-    idx = 0 ;
-    for (NSArray *line in linesArray) {
-        NSNumber *from = line.firstObject ;
-        NSNumber *to   = line.lastObject ;
-        NSArray  *p1   = pointsArray[from.unsignedIntegerValue - 1] ;
-        NSArray  *p2   = pointsArray[to.unsignedIntegerValue - 1] ;
+    for (NSUInteger idx = 0 ; idx < lines->count ; idx++) {
+        if (!diff->lineChanged[idx]) continue ;
+        const double *p1 = &drawn[(size_t)(lines->data.indicies[idx * 2] - 1) * 3] ;
+        const double *p2 = &drawn[(size_t)(lines->data.indicies[idx * 2 + 1] - 1) * 3] ;
 
-        NSNumber *p1x  = p1[0] ;
-        NSNumber *p1y  = p1[1] ;
-        NSNumber *p1z  = p1[2] ;
-        NSNumber *p2x  = p2[0] ;
-        NSNumber *p2y  = p2[1] ;
-        NSNumber *p2z  = p2[2] ;
-
-        SCNVector3 v1 = SCNVector3Make(p1x.doubleValue, p1y.doubleValue, p1z.doubleValue) ;
-        SCNVector3 v2 = SCNVector3Make(p2x.doubleValue, p2y.doubleValue, p2z.doubleValue) ;
+        SCNVector3 v1 = SCNVector3Make(p1[0], p1[1], p1[2]) ;
+        SCNVector3 v2 = SCNVector3Make(p2[0], p2[1], p2[2]) ;
 
         CGFloat height = vector3magnitude(SCNVector3Make(v2.x - v1.x, v2.y - v1.y, v2.z - v1.z)) ;
 
-        SCNNode     *theLine      = createNewLines ? [lineTemplate clone] : linesNode.childNodes[idx] ;
-        SCNCylinder *lineGeometry = (SCNCylinder *)(createNewLines ? theLine.geometry.copy : theLine.geometry) ;
-        if (createNewLines) {
+        BOOL        isNew         = (idx >= lineNodes.count) ;
+        SCNNode     *theLine      = isNew ? [lineTemplate clone] : lineNodes[idx] ;
+        SCNCylinder *lineGeometry = (SCNCylinder *)(isNew ? theLine.geometry.copy : theLine.geometry) ;
+        if (isNew) {
             theLine.name = [NSString stringWithFormat:@"line%lu", idx] ;
             theLine.geometry = lineGeometry ;
             [linesNode addChildNode:theLine] ;
@@ -243,7 +315,6 @@ static int dimensional_generateSceneKitObject(lua_State *L) {
 //                 vector3magnitude(dir) * vector3magnitude(unitY) + vector3dotProduct(unitY, dir)
                 vector3magnitude(dir) + dir.y
             ) ;
-            idx++ ;
         }
 
         theLine.orientation = vector4normalized(q) ;
@@ -251,96 +322,114 @@ static int dimensional_generateSceneKitObject(lua_State *L) {
     return 0 ;
 }
 
-// should check for 3 and 4 line faces
+// faces are closed loops of 4 lines (or 3 if the optional second argument is true) with no other
+// lines between their corners; see meshFaces.h for how they're found. Given a buffer of lines, the
+// faces are returned as a buffer of 4 line numbers each, with 0 as the 4th for a triangle.
 static int dimensional_facesFromLines(lua_State *L) {
     LuaSkin *skin = [LuaSkin sharedWithState:L] ;
-    [skin checkArgs:LS_TTABLE,  // lines
+    [skin checkArgs:LS_TTABLE | LS_TUSERDATA, BUFFER_TAG, // lines
+                    LS_TBOOLEAN | LS_TOPTIONAL,           // include triangles (default false)
                     LS_TBREAK] ;
 
-    NSArray *linesArray    = [skin toNSObjectAtIndex:1] ;
+    BOOL withTriangles = (lua_gettop(L) > 1) ? (BOOL)lua_toboolean(L, 2) : NO ;
+    BOOL asBuffer      = (lua_type(L, 1) == LUA_TUSERDATA) ;
 
-    NSString *errMsg = nil ;
-    if ([linesArray isKindOfClass:[NSArray class]]) {
-        if (!validate_luaTable(L, 1, 0, 2, YES, 0)) {
-            errMsg = [NSString stringWithUTF8String:lua_tostring(L, -1)] ;
-        }
-        lua_pop(L, 1) ;
-    } else {
-        errMsg = @"expected array type table" ;
-    }
-    if (errMsg) return luaL_argerror(L, 1, errMsg.UTF8String) ;
-
-    NSUInteger     lineCount = linesArray.count ;
-    NSMutableArray *faces    = [NSMutableArray array] ;
-
-// NSUInteger totalCount = 0 ;
-// double     timeAvg    = 0.0 ;
-
-    for (NSUInteger a = 0; a < lineCount ; a++) {
-        for (NSUInteger b = 0; b < lineCount ; b++) {
-            if (a == b) continue ;
-            for (NSUInteger c = 0; c < lineCount ; c++) {
-                if ((a == c) || (b == c)) continue ;
-// TODO: check for three point sides?
-                for (NSUInteger d = 0; d < lineCount ; d++) {
-                    if ((a == d) || (b == d) || (c == d)) continue ;
-// NSDate *start = [NSDate now] ;
-// [LuaSkin logInfo:@"%lu %lu %lu %lu", a, b, c, d] ;
-                    lua_Integer a1 = ((NSNumber *)((NSArray *)linesArray[a])[0]).integerValue ;
-                    lua_Integer a2 = ((NSNumber *)((NSArray *)linesArray[a])[1]).integerValue ;
-                    lua_Integer b1 = ((NSNumber *)((NSArray *)linesArray[b])[0]).integerValue ;
-                    lua_Integer b2 = ((NSNumber *)((NSArray *)linesArray[b])[1]).integerValue ;
-                    lua_Integer c1 = ((NSNumber *)((NSArray *)linesArray[c])[0]).integerValue ;
-                    lua_Integer c2 = ((NSNumber *)((NSArray *)linesArray[c])[1]).integerValue ;
-                    lua_Integer d1 = ((NSNumber *)((NSArray *)linesArray[d])[0]).integerValue ;
-                    lua_Integer d2 = ((NSNumber *)((NSArray *)linesArray[d])[1]).integerValue ;
-// [LuaSkin logInfo:@"%ld %ld %ld %ld %ld %ld %ld %ld", a1, a2, b1, b2, c1, c2, d1, d2] ;
-                    if ((d1 == a1 || d1 == a2 || d2 == a1 || d2 == a2) &&
-                        (a1 == b1 || a1 == b2 || a2 == b1 || a2 == b2) &&
-                        (b1 == c1 || b1 == c2 || b2 == c1 || b2 == c2) &&
-                        (c1 == d1 || c1 == d2 || c2 == d1 || c2 == d2))
-                    {
-                        // is it actually a closed path?
-                        NSMutableDictionary *pointCounts = [NSMutableDictionary dictionary] ;
-                        pointCounts[@(a1)] = @((pointCounts[@(a1)] ? ((NSNumber *)pointCounts[@(a1)]).integerValue : 0) + 1) ;
-                        pointCounts[@(a2)] = @((pointCounts[@(a2)] ? ((NSNumber *)pointCounts[@(a2)]).integerValue : 0) + 1) ;
-                        pointCounts[@(b1)] = @((pointCounts[@(b1)] ? ((NSNumber *)pointCounts[@(b1)]).integerValue : 0) + 1) ;
-                        pointCounts[@(b2)] = @((pointCounts[@(b2)] ? ((NSNumber *)pointCounts[@(b2)]).integerValue : 0) + 1) ;
-                        pointCounts[@(c1)] = @((pointCounts[@(c1)] ? ((NSNumber *)pointCounts[@(c1)]).integerValue : 0) + 1) ;
-                        pointCounts[@(c2)] = @((pointCounts[@(c2)] ? ((NSNumber *)pointCounts[@(c2)]).integerValue : 0) + 1) ;
-                        pointCounts[@(d1)] = @((pointCounts[@(d1)] ? ((NSNumber *)pointCounts[@(d1)]).integerValue : 0) + 1) ;
-                        pointCounts[@(d2)] = @((pointCounts[@(d2)] ? ((NSNumber *)pointCounts[@(d2)]).integerValue : 0) + 1) ;
-// [LuaSkin logInfo:@"%@", pointCounts];
-                        __block BOOL isBad = NO ;
-                        [pointCounts enumerateKeysAndObjectsUsingBlock:^(__unused NSNumber *key, NSNumber *val, BOOL *stop) {
-                            isBad = (val.integerValue != 2) ;
-                            *stop = isBad ;
-                        }] ;
-
-                        // if not isBad, then check if it's one we've already captured
-                        if (!isBad) {
-                            __block BOOL alreadySeen = NO ;
-                            [faces enumerateObjectsUsingBlock:^(NSArray *val, __unused NSUInteger idx, BOOL *stop) {
-                                alreadySeen = [val containsObject:@(a + 1)] &&
-                                              [val containsObject:@(b + 1)] &&
-                                              [val containsObject:@(c + 1)] &&
-                                              [val containsObject:@(d + 1)] ;
-                                *stop = alreadySeen ;
-                            }] ;
-
-                            if (!alreadySeen) [faces addObject:@[ @(a + 1), @(b + 1), @(c + 1), @(d + 1) ]] ;
-                        }
-                    }
-// timeAvg = timeAvg + start.timeIntervalSinceNow ;
-// totalCount++ ;
-                }
-            }
+    packedBuffer *lines     = bufferArgument(L, 1, packedBuffer_indicies, 2, 2) ;
+    size_t       lineCount  = lines->count ;
+    int64_t      *endpoints = malloc((lineCount > 0 ? lineCount : 1) * 2 * sizeof(int64_t)) ;
+    if (!endpoints) return luaL_error(L, "unable to allocate memory for %d lines", (int)lineCount) ;
+
+    for (size_t i = 0 ; i < lineCount * 2 ; i++) endpoints[i] = lines->data.indicies[i] ;
+
+    meshFaceList list ;
+    meshFaces_init(&list) ;
+    BOOL found = meshFaces_find(&list, endpoints, lineCount, withTriangles) ;
+    free(endpoints) ;
+
+    packedBuffer *faces = pushBuffer(L, packedBuffer_indicies, 4) ;
+    if (!found || !packedBuffer_resize(faces, list.count)) {
+        meshFaces_free(&list) ;
+        return luaL_error(L, "unable to allocate memory for faces of %d lines", (int)lineCount) ;
+    }
+    for (size_t i = 0 ; i < list.count * 4 ; i++) faces->data.indicies[i] = (int32_t)list.faces[i / 4].lines[i % 4] ;
+    meshFaces_free(&list) ;
+
+    if (!asBuffer) pushBufferAsTable(L, faces) ;
+    return 1 ;
+}
+
+// points, lines and faces as facesFromLines returns them (found from the lines if not given), and
+// the number of levels to subdivide (default 1); returns a table with the subdivided points, lines
+// and faces, as buffers if the points were given as one. See catmullClark.h for how they're laid out.
+static int dimensional_catmullClarkSubdivision(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TTABLE | LS_TUSERDATA, BUFFER_TAG,                                                  // points
+                    LS_TTABLE | LS_TUSERDATA, BUFFER_TAG,                                                  // lines
+                    LS_TTABLE | LS_TUSERDATA | LS_TNIL | LS_TNUMBER | LS_TINTEGER | LS_TOPTIONAL, BUFFER_TAG, // faces (or will call facesFromLines), or levels
+                    LS_TNUMBER | LS_TINTEGER | LS_TOPTIONAL,                                               // levels (default 1)
+                    LS_TBREAK] ;
+
+    BOOL        hasFaces  = (lua_type(L, 3) == LUA_TTABLE || lua_type(L, 3) == LUA_TUSERDATA) ;
+    BOOL        asBuffers = (lua_type(L, 1) == LUA_TUSERDATA) ;
+    int         levelsIdx = (lua_type(L, 3) == LUA_TNUMBER) ? 3 : 4 ;
+    lua_Integer levels    = (lua_type(L, levelsIdx) == LUA_TNUMBER) ? lua_tointeger(L, levelsIdx) : 1 ;
+    if (levels < 0) return luaL_argerror(L, levelsIdx, "expected integer greater than or equal to 0") ;
+
+    packedBuffer *points = bufferArgument(L, 1, packedBuffer_points, 0, 0) ;
+    if (points->count == 0) return luaL_argerror(L, 1, "expected at least 1 point") ;
+    packedBuffer *lines = indexArgument(L, 2, 2, 2, points->count, false) ;
+    // faces keep their 1 based line numbers; a missing 4th line is 0 to mark a triangle
+    packedBuffer *faces = hasFaces ? indexArgument(L, 3, 3, 4, lines->count, true) : NULL ;
+
+    catmullClarkMesh mesh ;
+    catmullClark_init(&mesh, points->components) ;
+    if (!catmullClark_resize(&mesh, points->count, lines->count, faces ? faces->count : 0)) {
+        catmullClark_free(&mesh) ;
+        return luaL_error(L, "unable to allocate memory for subdivision") ;
+    }
+    memcpy(mesh.points, points->data.points, points->count * points->components * sizeof(double)) ;
+    for (size_t i = 0 ; i < lines->count * 2 ; i++) mesh.lines[i] = (uint32_t)(lines->data.indicies[i] - 1) ;
+    for (size_t i = 0 ; faces && i < faces->count ; i++) {
+        for (size_t j = 0 ; j < 4 ; j++) {
+            mesh.faces[i].lines[j] = (j < faces->components) ? (uint32_t)faces->data.indicies[i * faces->components + j] : 0 ;
         }
     }
 
-// [LuaSkin logInfo:@"%f %ld (∂t = %f)", timeAvg, totalCount, (timeAvg / (double)totalCount)] ;
+    if (!faces && !catmullClark_findFaces(&mesh)) {
+        catmullClark_free(&mesh) ;
+        return luaL_error(L, "unable to allocate memory for faces of %d lines", (int)lines->count) ;
+    }
+
+    char error[128] ;
+    if (!catmullClark_subdivide(&mesh, (size_t)levels, error, sizeof(error))) {
+        catmullClark_free(&mesh) ;
+        return luaL_error(L, "%s", error) ;
+    }
+
+    packedBuffer *newPoints = pushBuffer(L, packedBuffer_points, mesh.dimensions) ;
+    packedBuffer *newLines  = pushBuffer(L, packedBuffer_indicies, 2) ;
+    packedBuffer *newFaces  = pushBuffer(L, packedBuffer_indicies, 4) ;
+    if (!packedBuffer_resize(newPoints, mesh.pointCount) ||
+        !packedBuffer_resize(newLines, mesh.lineCount) ||
+        !packedBuffer_resize(newFaces, mesh.faceCount)) {
+        catmullClark_free(&mesh) ;
+        return luaL_error(L, "unable to allocate memory for subdivision") ;
+    }
+    memcpy(newPoints->data.points, mesh.points, mesh.pointCount * mesh.dimensions * sizeof(double)) ;
+    for (size_t i = 0 ; i < mesh.lineCount * 2 ; i++) newLines->data.indicies[i] = (int32_t)mesh.lines[i] + 1 ;
+    for (size_t i = 0 ; i < mesh.faceCount * 4 ; i++) newFaces->data.indicies[i] = (int32_t)mesh.faces[i / 4].lines[i % 4] ;
+    catmullClark_free(&mesh) ;
 
-    [skin pushNSObject:faces] ;
+    const char *keys[] = { "points", "lines", "faces" } ;
+    lua_createtable(L, 0, 3) ;
+    for (int i = 0 ; i < 3 ; i++) {
+        if (asBuffers) {
+            lua_pushvalue(L, i - 4) ;
+        } else {
+            pushBufferAsTable(L, lua_touserdata(L, i - 4)) ;
+        }
+        lua_setfield(L, -2, keys[i]) ;
+    }
     return 1 ;
 }
 
@@ -352,69 +441,1173 @@ static int dimensional_facesFromLines(lua_State *L) {
 //
 //     return 1 ;
 // }
-//
-// static int dimensional_catmullClarkSubdivision(lua_State *L) {
-//     LuaSkin *skin = [LuaSkin sharedWithState:L] ;
-//     [skin checkArgs:LS_TTABLE,                // points
-//                     LS_TTABLE,                // lines
-//                     LS_TTABLE | LS_TOPTIONAL, // faces (or will call dimensional_facesFromLines)
-//                     LS_TBREAK] ;
-//
-//     return 1 ;
-// }
-//
-// static int dimensional_projectCoordinatesDown(lua_State *L) {
-//     LuaSkin *skin = [LuaSkin sharedWithState:L] ;
-//     [skin checkArgs:LS_TTABLE,                  // points table
-//                     LS_TNUMBER,                 // eyeDistance
-//                     LS_TNUMBER | LS_TOPTIONAL,  // scale (default 1)
-//                     LS_TNUMBER | LS_TOPTIONAL,  // offset (default 0)
-//                     LS_TBREAK] ;
-//
-//     return 1 ;
-// }
+
+// points with at least 3 (or dimensions) components, and the eye distance, scale (default 1) and
+// offset (default 0) of the projection; see projection.h. If results is given, it's filled in and
+// returned instead of a new table, reusing the tables already in it, so an animation can project
+// every frame without creating new tables. Points in a buffer are projected where they are, and
+// the results go into a buffer if results is one or if the points were and results isn't a table.
+static int dimensional_projectCoordinatesDown(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TTABLE | LS_TUSERDATA, BUFFER_TAG,                        // points
+                    LS_TNUMBER,                                                  // eyeDistance
+                    LS_TNUMBER | LS_TNIL | LS_TOPTIONAL,                         // scale (default 1)
+                    LS_TNUMBER | LS_TNIL | LS_TOPTIONAL,                         // offset (default 0)
+                    LS_TNUMBER | LS_TINTEGER | LS_TNIL | LS_TOPTIONAL,           // dimensions (default 3)
+                    LS_TTABLE | LS_TUSERDATA | LS_TNIL | LS_TOPTIONAL, BUFFER_TAG, // results table or buffer to reuse
+                    LS_TBREAK] ;
+
+    double      eyeDistance = lua_tonumber(L, 2) ;
+    double      scale       = (lua_type(L, 3) == LUA_TNUMBER) ? lua_tonumber(L, 3) : 1.0 ;
+    double      offset      = (lua_type(L, 4) == LUA_TNUMBER) ? lua_tonumber(L, 4) : 0.0 ;
+    lua_Integer target      = (lua_type(L, 5) == LUA_TNUMBER) ? lua_tointeger(L, 5) : 3 ;
+    if (target < 1) return luaL_argerror(L, 5, "expected integer greater than 0") ;
+
+    packedBuffer *source     = NULL ;
+    const double *values     = NULL ;
+    size_t       count       = 0 ;
+    size_t       dimensions  = 0 ;
+    if (lua_type(L, 1) == LUA_TUSERDATA) {
+        source     = bufferArgument(L, 1, packedBuffer_points, 0, 0) ;
+        values     = source->data.points ;
+        count      = source->count ;
+        dimensions = source->components ;
+        if (count > 0 && dimensions < (size_t)target) {
+            return luaL_argerror(L, 1, lua_pushfstring(L, "expected points with at least %d components", (int)target)) ;
+        }
+    } else {
+        count = lua_rawlen(L, 1) ;
+        if (count > 0) {
+            if (lua_rawgeti(L, 1, 1) != LUA_TTABLE) return luaL_argerror(L, 1, "expected table at index 1") ;
+            dimensions = lua_rawlen(L, -1) ;
+            lua_pop(L, 1) ;
+            if (dimensions < (size_t)target) {
+                return luaL_argerror(L, 1, lua_pushfstring(L, "expected points with at least %d components", (int)target)) ;
+            }
+        }
+
+        if (!projection_reserve(&projectionInput, count * dimensions)) {
+            return luaL_error(L, "unable to allocate memory for %d points", (int)count) ;
+        }
+
+        double *input = projectionInput.values ;
+        for (size_t i = 0 ; i < count ; i++) {
+            if (lua_rawgeti(L, 1, (lua_Integer)(i + 1)) != LUA_TTABLE || lua_rawlen(L, -1) != dimensions) {
+                return luaL_argerror(L, 1, lua_pushfstring(L, "expected table at index %d to contain %d components", (int)(i + 1), (int)dimensions)) ;
+            }
+            for (size_t c = 0 ; c < dimensions ; c++) {
+                int isNumber = 0 ;
+                if (lua_rawgeti(L, -1, (lua_Integer)(c + 1)) == LUA_TNUMBER) input[i * dimensions + c] = lua_tonumberx(L, -1, &isNumber) ;
+                lua_pop(L, 1) ;
+                if (!isNumber) {
+                    return luaL_argerror(L, 1, lua_pushfstring(L, "expected number for component %d of index %d", (int)(c + 1), (int)(i + 1))) ;
+                }
+            }
+            lua_pop(L, 1) ;
+        }
+        values = input ;
+    }
+
+    packedBuffer *resultBuffer = NULL ;
+    if (lua_type(L, 6) == LUA_TUSERDATA) {
+        resultBuffer = bufferArgument(L, 6, packedBuffer_points, 0, 0) ;
+        lua_pushvalue(L, 6) ;
+    } else if (source && lua_type(L, 6) != LUA_TTABLE) {
+        resultBuffer = pushBuffer(L, packedBuffer_points, (size_t)target) ;
+    }
+
+    // straight into the results buffer, unless it's the points themselves
+    if (resultBuffer && resultBuffer != source) {
+        if (!packedBuffer_reshape(resultBuffer, (size_t)target, count)) {
+            return luaL_error(L, "unable to allocate memory for %d points", (int)count) ;
+        }
+        projection_project(values, count, dimensions, (size_t)target, eyeDistance, scale, offset, resultBuffer->data.points) ;
+        return 1 ;
+    }
+
+    if (!projection_reserve(&projectionOutput, count * (size_t)target)) {
+        return luaL_error(L, "unable to allocate memory for %d points", (int)count) ;
+    }
+    projection_project(values, count, dimensions, (size_t)target, eyeDistance, scale, offset, projectionOutput.values) ;
+
+    if (resultBuffer) {
+        if (!packedBuffer_reshape(resultBuffer, (size_t)target, count)) {
+            return luaL_error(L, "unable to allocate memory for %d points", (int)count) ;
+        }
+        if (count > 0) memcpy(resultBuffer->data.points, projectionOutput.values, count * (size_t)target * sizeof(double)) ;
+        return 1 ;
+    }
+
+    if (lua_type(L, 6) == LUA_TTABLE) {
+        lua_pushvalue(L, 6) ;
+    } else {
+        lua_createtable(L, (int)count, 0) ;
+    }
+    int    results  = lua_gettop(L) ;
+    size_t previous = lua_rawlen(L, results) ;
+    for (size_t i = 0 ; i < count ; i++) {
+        if (lua_rawgeti(L, results, (lua_Integer)(i + 1)) != LUA_TTABLE) {
+            lua_pop(L, 1) ;
+            lua_createtable(L, (int)target, 0) ;
+            lua_pushvalue(L, -1) ;
+            lua_rawseti(L, results, (lua_Integer)(i + 1)) ;
+        }
+        for (size_t c = 0 ; c < (size_t)target ; c++) {
+            lua_pushnumber(L, projectionOutput.values[i * (size_t)target + c]) ;
+            lua_rawseti(L, -2, (lua_Integer)(c + 1)) ;
+        }
+        for (size_t c = lua_rawlen(L, -1) ; c > (size_t)target ; c--) {
+            lua_pushnil(L) ;
+            lua_rawseti(L, -2, (lua_Integer)c) ;
+        }
+        lua_pop(L, 1) ;
+    }
+    for (size_t i = previous ; i > count ; i--) {
+        lua_pushnil(L) ;
+        lua_rawseti(L, results, (lua_Integer)i) ;
+    }
+    return 1 ;
+}
+
+// common to pointBuffer and indexBuffer: (components, [count]) for count zeroed items, or a table
+// of items to copy
+static int newBuffer(lua_State *L, packedBufferType type) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    if (lua_type(L, 1) == LUA_TTABLE) {
+        [skin checkArgs:LS_TTABLE, LS_TBREAK] ;
+        bufferArgument(L, 1, type, 1, 0) ;
+        return 1 ;
+    }
+    [skin checkArgs:LS_TNUMBER | LS_TINTEGER,                // components
+                    LS_TNUMBER | LS_TINTEGER | LS_TOPTIONAL, // count (default 0)
+                    LS_TBREAK] ;
+    lua_Integer components = lua_tointeger(L, 1) ;
+    lua_Integer count      = (lua_gettop(L) > 1) ? lua_tointeger(L, 2) : 0 ;
+    if (components < 1) return luaL_argerror(L, 1, "expected integer greater than 0") ;
+    if (count < 0) return luaL_argerror(L, 2, "expected integer greater than or equal to 0") ;
+
+    packedBuffer *buffer = pushBuffer(L, type, (size_t)components) ;
+    if (!packedBuffer_resize(buffer, (size_t)count)) {
+        return luaL_error(L, "unable to allocate memory for %d items", (int)count) ;
+    }
+    return 1 ;
+}
+
+static int dimensional_pointBuffer(lua_State *L) {
+    return newBuffer(L, packedBuffer_points) ;
+}
+
+static int dimensional_indexBuffer(lua_State *L) {
+    return newBuffer(L, packedBuffer_indicies) ;
+}
+
+// pushes a new, empty mesh onto the stack and returns it
+static halfEdgeMesh *pushMesh(lua_State *L, size_t dimensions) {
+    halfEdgeMesh *mesh = lua_newuserdata(L, sizeof(halfEdgeMesh)) ;
+    halfEdge_init(mesh, dimensions) ;
+    luaL_getmetatable(L, MESH_TAG) ;
+    lua_setmetatable(L, -2) ;
+    return mesh ;
+}
+
+// dimensional.mesh(dimensions) for an empty mesh, or dimensional.mesh(points, lines, [faces]) for
+// one built from tables or buffers in the form the other functions take
+static int dimensional_mesh(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    if (lua_type(L, 1) == LUA_TNUMBER) {
+        [skin checkArgs:LS_TNUMBER | LS_TINTEGER, LS_TBREAK] ;
+        lua_Integer dimensions = lua_tointeger(L, 1) ;
+        if (dimensions < 1) return luaL_argerror(L, 1, "expected integer greater than 0") ;
+        pushMesh(L, (size_t)dimensions) ;
+        return 1 ;
+    }
+    [skin checkArgs:LS_TTABLE | LS_TUSERDATA, BUFFER_TAG,                         // points
+                    LS_TTABLE | LS_TUSERDATA, BUFFER_TAG,                         // lines
+                    LS_TTABLE | LS_TUSERDATA | LS_TNIL | LS_TOPTIONAL, BUFFER_TAG, // faces
+                    LS_TBREAK] ;
+
+    BOOL          hasFaces = (lua_type(L, 3) == LUA_TTABLE || lua_type(L, 3) == LUA_TUSERDATA) ;
+    packedBuffer *points   = bufferArgument(L, 1, packedBuffer_points, 0, 0) ;
+    if (points->components == 0) return luaL_argerror(L, 1, "expected at least 1 point") ;
+    packedBuffer *lines = indexArgument(L, 2, 2, 2, points->count, false) ;
+    packedBuffer *faces = hasFaces ? indexArgument(L, 3, 3, 4, lines->count, true) : NULL ;
+
+    halfEdgeMesh *mesh = pushMesh(L, points->components) ;
+    if (!halfEdge_reservePoints(mesh, points->count)) {
+        return luaL_error(L, "unable to allocate memory for %d points", (int)points->count) ;
+    }
+    for (size_t i = 0 ; i < points->count ; i++) halfEdge_addPoint(mesh, &points->data.points[i * points->components]) ;
+
+    char error[128] ;
+    for (size_t i = 0 ; i < lines->count ; i++) {
+        uint32_t from = (uint32_t)lines->data.indicies[i * 2] - 1, to = (uint32_t)lines->data.indicies[i * 2 + 1] - 1 ;
+        if (halfEdge_addLine(mesh, from, to, error, sizeof(error)) == HALFEDGE_NONE) {
+            return luaL_argerror(L, 2, lua_pushfstring(L, "%s (index %d)", error, (int)(i + 1))) ;
+        }
+    }
+    for (size_t i = 0 ; faces && i < faces->count ; i++) {
+        uint32_t      faceLines[4] ;
+        const int32_t *face = &faces->data.indicies[i * faces->components] ;
+        size_t        sides = (face[faces->components - 1] == 0) ? faces->components - 1 : faces->components ;
+        for (size_t j = 0 ; j < sides ; j++) faceLines[j] = (uint32_t)face[j] - 1 ;
+        if (halfEdge_addFace(mesh, faceLines, sides, error, sizeof(error)) == HALFEDGE_NONE) {
+            return luaL_argerror(L, 3, lua_pushfstring(L, "%s (index %d)", error, (int)(i + 1))) ;
+        }
+    }
+    return 1 ;
+}
+
+// dimensional.transform(dimensions) -> transform, starting out as the identity
+static int dimensional_transform(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TNUMBER | LS_TINTEGER, LS_TBREAK] ;
+    lua_Integer dimensions = lua_tointeger(L, 1) ;
+    if (dimensions < 1) return luaL_argerror(L, 1, "expected integer greater than 0") ;
+
+    transformMatrix *transform = lua_newuserdata(L, sizeof(transformMatrix)) ;
+    transform->matrix  = NULL ;
+    transform->scratch = NULL ;
+    luaL_getmetatable(L, TRANSFORM_TAG) ;
+    lua_setmetatable(L, -2) ;
+    if (!transform_init(transform, (size_t)dimensions)) {
+        return luaL_error(L, "unable to allocate memory for a %d-D transform", (int)dimensions) ;
+    }
+    return 1 ;
+}
+
+// dimensional.writeMesh(path, points, lines, [faces], [format]) -> true | false, message; format
+// is "obj", "ply" or "mesh", and by default comes from the path's extension, with anything other
+// than .obj or .ply written in the module's own format
+static int dimensional_writeMesh(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TSTRING,
+                    LS_TTABLE | LS_TUSERDATA, BUFFER_TAG,                         // points
+                    LS_TTABLE | LS_TUSERDATA, BUFFER_TAG,                         // lines
+                    LS_TTABLE | LS_TUSERDATA | LS_TNIL | LS_TOPTIONAL, BUFFER_TAG, // faces
+                    LS_TSTRING | LS_TNIL | LS_TOPTIONAL,                          // format
+                    LS_TBREAK] ;
+    NSString   *file = [[skin toNSObjectAtIndex:1] stringByExpandingTildeInPath] ;
+    const char *path = file.fileSystemRepresentation ;
+
+    meshFileFormat format = meshFile_formatForPath(path) ;
+    if (lua_type(L, 5) == LUA_TSTRING) {
+        const char *name = lua_tostring(L, 5) ;
+        if (strcmp(name, "obj") == 0) {
+            format = meshFile_obj ;
+        } else if (strcmp(name, "ply") == 0) {
+            format = meshFile_ply ;
+        } else if (strcmp(name, "mesh") == 0) {
+            format = meshFile_native ;
+        } else {
+            return luaL_argerror(L, 5, "expected obj, ply or mesh") ;
+        }
+    }
+
+    BOOL          hasFaces = (lua_type(L, 4) == LUA_TTABLE || lua_type(L, 4) == LUA_TUSERDATA) ;
+    packedBuffer *points   = bufferArgument(L, 2, packedBuffer_points, 0, 0) ;
+    if (points->count > 0 && points->components == 0) return luaL_argerror(L, 2, "expected at least 1 component") ;
+    packedBuffer *lines = indexArgument(L, 3, 2, 2, points->count, false) ;
+    packedBuffer *faces = hasFaces ? indexArgument(L, 4, 3, 4, lines->count, true) : NULL ;
+
+    meshFileData data = {
+        .points         = points->data.points,
+        .lines          = lines->data.indicies,
+        .faces          = faces ? faces->data.indicies : NULL,
+        .dimensions     = (points->components > 0) ? points->components : 1,
+        .pointCount     = points->count,
+        .lineCount      = lines->count,
+        .faceCount      = faces ? faces->count : 0,
+        .faceComponents = faces ? faces->components : 0,
+    } ;
+    char error[256] ;
+    if (!meshFile_write(path, format, &data, error, sizeof(error))) {
+        lua_pushboolean(L, false) ;
+        lua_pushstring(L, error) ;
+        return 2 ;
+    }
+    lua_pushboolean(L, true) ;
+    return 1 ;
+}
+
+// dimensional.readMesh(path) -> points, lines, [faces] | nil, message; reads a file in the
+// module's own format, as writeMesh writes it, into buffers
+static int dimensional_readMesh(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TSTRING, LS_TBREAK] ;
+    NSString   *file = [[skin toNSObjectAtIndex:1] stringByExpandingTildeInPath] ;
+    const char *path = file.fileSystemRepresentation ;
+
+    meshFileMap map ;
+    char        error[256] ;
+    if (!meshFile_map(path, &map, error, sizeof(error))) {
+        lua_pushnil(L) ;
+        lua_pushstring(L, error) ;
+        return 2 ;
+    }
+
+    const meshFileData *data     = &map.data ;
+    packedBuffer       *points   = pushBuffer(L, packedBuffer_points, data->dimensions) ;
+    packedBuffer       *lines    = pushBuffer(L, packedBuffer_indicies, 2) ;
+    packedBuffer       *faces    = (data->faceCount > 0) ? pushBuffer(L, packedBuffer_indicies, data->faceComponents) : NULL ;
+    BOOL               allocated = packedBuffer_resize(points, data->pointCount) &&
+                                   packedBuffer_resize(lines, data->lineCount) &&
+                                   (!faces || packedBuffer_resize(faces, data->faceCount)) ;
+    if (!allocated) {
+        meshFile_unmap(&map) ;
+        return luaL_error(L, "unable to allocate memory for %d points", (int)data->pointCount) ;
+    }
+    if (points->count > 0) memcpy(points->data.points, data->points, points->count * points->components * sizeof(double)) ;
+    if (lines->count > 0)  memcpy(lines->data.indicies, data->lines, lines->count * 2 * sizeof(int32_t)) ;
+    if (faces)             memcpy(faces->data.indicies, data->faces, faces->count * faces->components * sizeof(int32_t)) ;
+    meshFile_unmap(&map) ;
+
+    // the file's been checked for its size, but not what's in it
+    BOOL inRange = packedBuffer_findOutOfRange(lines, (int64_t)points->count, false) == SIZE_MAX &&
+                   (!faces || packedBuffer_findOutOfRange(faces, (int64_t)lines->count, true) == SIZE_MAX) ;
+    if (!inRange) {
+        lua_pushnil(L) ;
+        lua_pushfstring(L, "%s is damaged: it has indicies out of range", path) ;
+        return 2 ;
+    }
+    return faces ? 3 : 2 ;
+}
 
 #pragma mark - Module Methods -
 
+// buffer:count([count]) -> integer | buffer; setting it zeroes any items added
+static int buffer_count(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, BUFFER_TAG, LS_TNUMBER | LS_TINTEGER | LS_TOPTIONAL, LS_TBREAK] ;
+    packedBuffer *buffer = luaL_checkudata(L, 1, BUFFER_TAG) ;
+
+    if (lua_gettop(L) == 1) {
+        lua_pushinteger(L, (lua_Integer)buffer->count) ;
+    } else {
+        lua_Integer count = lua_tointeger(L, 2) ;
+        if (count < 0) return luaL_argerror(L, 2, "expected integer greater than or equal to 0") ;
+        if (!packedBuffer_resize(buffer, (size_t)count)) {
+            return luaL_error(L, "unable to allocate memory for %d items", (int)count) ;
+        }
+        lua_pushvalue(L, 1) ;
+    }
+    return 1 ;
+}
+
+// buffer:components() -> integer
+static int buffer_components(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, BUFFER_TAG, LS_TBREAK] ;
+    packedBuffer *buffer = luaL_checkudata(L, 1, BUFFER_TAG) ;
+    lua_pushinteger(L, (lua_Integer)buffer->components) ;
+    return 1 ;
+}
+
+// buffer:type() -> "point" | "index"
+static int buffer_type(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, BUFFER_TAG, LS_TBREAK] ;
+    packedBuffer *buffer = luaL_checkudata(L, 1, BUFFER_TAG) ;
+    lua_pushstring(L, (buffer->type == packedBuffer_points) ? "point" : "index") ;
+    return 1 ;
+}
+
+// buffer:get(index) -> table
+static int buffer_get(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, BUFFER_TAG, LS_TNUMBER | LS_TINTEGER, LS_TBREAK] ;
+    packedBuffer *buffer = luaL_checkudata(L, 1, BUFFER_TAG) ;
+    lua_Integer  idx     = lua_tointeger(L, 2) ;
+    if (idx < 1 || (size_t)idx > buffer->count) {
+        return luaL_argerror(L, 2, lua_pushfstring(L, "expected integer between 1 and %d inclusive", (int)buffer->count)) ;
+    }
+    pushBufferItem(L, buffer, (size_t)idx - 1) ;
+    return 1 ;
+}
+
+// buffer:set(index, item) -> buffer; an index one past the end appends the item. Index items may
+// be shorter than the buffer's components and are padded with 0.
+static int buffer_set(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, BUFFER_TAG, LS_TNUMBER | LS_TINTEGER, LS_TTABLE, LS_TBREAK] ;
+    packedBuffer *buffer = luaL_checkudata(L, 1, BUFFER_TAG) ;
+    lua_Integer  idx     = lua_tointeger(L, 2) ;
+    if (idx < 1 || (size_t)idx > buffer->count + 1) {
+        return luaL_argerror(L, 2, lua_pushfstring(L, "expected integer between 1 and %d inclusive", (int)buffer->count + 1)) ;
+    }
+
+    size_t components = buffer->components ;
+    size_t length     = lua_rawlen(L, 3) ;
+    size_t minimum    = (buffer->type == packedBuffer_points) ? components : 1 ;
+    if (length < minimum || length > components) {
+        return luaL_argerror(L, 3, (minimum == components) ?
+            lua_pushfstring(L, "expected table with %d components", (int)components) :
+            lua_pushfstring(L, "expected table with 1 to %d components", (int)components)) ;
+    }
+
+    size_t previous = buffer->count ;
+    if ((size_t)idx > previous && !packedBuffer_resize(buffer, (size_t)idx)) {
+        return luaL_error(L, "unable to allocate memory for %d items", (int)idx) ;
+    }
+    size_t base = ((size_t)idx - 1) * components ;
+    for (size_t c = 0 ; c < components ; c++) {
+        if (c >= length) {
+            buffer->data.indicies[base + c] = 0 ;
+        } else if (!readBufferValue(L, 3, (lua_Integer)(c + 1), buffer, base + c)) {
+            buffer->count = previous ;
+            return luaL_argerror(L, 3, lua_pushfstring(L, "expected %s for component %d",
+                                                          (buffer->type == packedBuffer_points) ? "number" : "32 bit integer",
+                                                          (int)(c + 1))) ;
+        }
+    }
+    lua_pushvalue(L, 1) ;
+    return 1 ;
+}
+
+// buffer:values([start], [count]) -> table; the components of count items (default all of them)
+// from item start (default 1) in one flat table
+static int buffer_values(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, BUFFER_TAG,
+                    LS_TNUMBER | LS_TINTEGER | LS_TNIL | LS_TOPTIONAL,
+                    LS_TNUMBER | LS_TINTEGER | LS_TOPTIONAL,
+                    LS_TBREAK] ;
+    packedBuffer *buffer = luaL_checkudata(L, 1, BUFFER_TAG) ;
+    lua_Integer  start   = (lua_type(L, 2) == LUA_TNUMBER) ? lua_tointeger(L, 2) : 1 ;
+    if (start < 1 || (size_t)start > buffer->count + 1) {
+        return luaL_argerror(L, 2, lua_pushfstring(L, "expected integer between 1 and %d inclusive", (int)buffer->count + 1)) ;
+    }
+    size_t      available = buffer->count - ((size_t)start - 1) ;
+    lua_Integer count     = (lua_type(L, 3) == LUA_TNUMBER) ? lua_tointeger(L, 3) : (lua_Integer)available ;
+    if (count < 0 || (size_t)count > available) {
+        return luaL_argerror(L, 3, lua_pushfstring(L, "expected integer between 0 and %d inclusive", (int)available)) ;
+    }
+
+    size_t first = ((size_t)start - 1) * buffer->components ;
+    size_t total = (size_t)count * buffer->components ;
+    lua_createtable(L, (int)total, 0) ;
+    for (size_t i = 0 ; i < total ; i++) {
+        if (buffer->type == packedBuffer_points) {
+            lua_pushnumber(L, buffer->data.points[first + i]) ;
+        } else {
+            lua_pushinteger(L, buffer->data.indicies[first + i]) ;
+        }
+        lua_rawseti(L, -2, (lua_Integer)(i + 1)) ;
+    }
+    return 1 ;
+}
+
+// buffer:setValues(start, values) -> buffer; the reverse of values, growing the buffer if they go
+// past its end. Only the components given are written, so if the last item is left incomplete the
+// rest of its components keep their values (zero when the item was added by this call).
+static int buffer_setValues(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, BUFFER_TAG, LS_TNUMBER | LS_TINTEGER, LS_TTABLE, LS_TBREAK] ;
+    packedBuffer *buffer = luaL_checkudata(L, 1, BUFFER_TAG) ;
+    lua_Integer  start   = lua_tointeger(L, 2) ;
+    if (start < 1 || (size_t)start > buffer->count + 1) {
+        return luaL_argerror(L, 2, lua_pushfstring(L, "expected integer between 1 and %d inclusive", (int)buffer->count + 1)) ;
+    }
+
+    size_t total    = lua_rawlen(L, 3) ;
+    size_t first    = ((size_t)start - 1) * buffer->components ;
+    size_t needed   = (first + total + buffer->components - 1) / buffer->components ;
+    size_t previous = buffer->count ;
+    if (needed > previous && !packedBuffer_resize(buffer, needed)) {
+        return luaL_error(L, "unable to allocate memory for %d items", (int)needed) ;
+    }
+    for (size_t i = 0 ; i < total ; i++) {
+        if (!readBufferValue(L, 3, (lua_Integer)(i + 1), buffer, first + i)) {
+            if (needed > previous) buffer->count = previous ;
+            return luaL_argerror(L, 3, lua_pushfstring(L, "expected %s at index %d",
+                                                          (buffer->type == packedBuffer_points) ? "number" : "32 bit integer",
+                                                          (int)(i + 1))) ;
+        }
+    }
+    lua_pushvalue(L, 1) ;
+    return 1 ;
+}
+
+// buffer:toTable() -> table; the items as a table of tables
+static int buffer_toTable(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, BUFFER_TAG, LS_TBREAK] ;
+    pushBufferAsTable(L, luaL_checkudata(L, 1, BUFFER_TAG)) ;
+    return 1 ;
+}
+
+// buffer:copy() -> buffer
+static int buffer_copy(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, BUFFER_TAG, LS_TBREAK] ;
+    packedBuffer *buffer = luaL_checkudata(L, 1, BUFFER_TAG) ;
+    packedBuffer *copy   = pushBuffer(L, buffer->type, buffer->components) ;
+    if (!packedBuffer_copy(copy, buffer)) {
+        return luaL_error(L, "unable to allocate memory for %d items", (int)buffer->count) ;
+    }
+    return 1 ;
+}
+
+// the 0 based number of the point, line or face given as argument idx, which should be from 1 to count
+static uint32_t checkMeshIndex(lua_State *L, int idx, size_t count) {
+    lua_Integer value = lua_tointeger(L, idx) ;
+    if (value < 1 || (size_t)value > count) {
+        luaL_argerror(L, idx, lua_pushfstring(L, "expected integer between 1 and %d inclusive", (int)count)) ;
+    }
+    return (uint32_t)(value - 1) ;
+}
+
+// pushes a table of the numbers, counting from 1
+static void pushMeshIndicies(lua_State *L, const uint32_t *values, size_t count) {
+    lua_createtable(L, (int)count, 0) ;
+    for (size_t i = 0 ; i < count ; i++) {
+        lua_pushinteger(L, (lua_Integer)values[i] + 1) ;
+        lua_rawseti(L, -2, (lua_Integer)(i + 1)) ;
+    }
+}
+
+// mesh:dimensions() -> integer
+static int mesh_dimensions(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG, LS_TBREAK] ;
+    halfEdgeMesh *mesh = luaL_checkudata(L, 1, MESH_TAG) ;
+    lua_pushinteger(L, (lua_Integer)mesh->dimensions) ;
+    return 1 ;
+}
+
+// mesh:counts() -> points, lines, faces
+static int mesh_counts(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG, LS_TBREAK] ;
+    halfEdgeMesh *mesh = luaL_checkudata(L, 1, MESH_TAG) ;
+    lua_pushinteger(L, (lua_Integer)mesh->pointCount) ;
+    lua_pushinteger(L, (lua_Integer)mesh->lineCount) ;
+    lua_pushinteger(L, (lua_Integer)mesh->faceCount) ;
+    return 3 ;
+}
+
+// reads the point table at idx into components; raises an argument error if it isn't one
+static void checkMeshPoint(lua_State *L, int idx, const halfEdgeMesh *mesh, double *components) {
+    if (lua_rawlen(L, idx) != mesh->dimensions) {
+        luaL_argerror(L, idx, lua_pushfstring(L, "expected table with %d components", (int)mesh->dimensions)) ;
+    }
+    for (size_t c = 0 ; c < mesh->dimensions ; c++) {
+        int isNumber = 0 ;
+        lua_rawgeti(L, idx, (lua_Integer)(c + 1)) ;
+        components[c] = lua_tonumberx(L, -1, &isNumber) ;
+        lua_pop(L, 1) ;
+        if (!isNumber) luaL_argerror(L, idx, lua_pushfstring(L, "expected number for component %d", (int)(c + 1))) ;
+    }
+}
+
+// mesh:addPoint(point) -> integer
+static int mesh_addPoint(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG, LS_TTABLE, LS_TBREAK] ;
+    halfEdgeMesh *mesh = luaL_checkudata(L, 1, MESH_TAG) ;
+
+    double *components = lua_newuserdata(L, mesh->dimensions * sizeof(double)) ;
+    checkMeshPoint(L, 2, mesh, components) ;
+    uint32_t point = halfEdge_addPoint(mesh, components) ;
+    if (point == HALFEDGE_NONE) return luaL_error(L, "unable to allocate memory for point") ;
+    lua_pushinteger(L, (lua_Integer)point + 1) ;
+    return 1 ;
+}
+
+// mesh:addLine(from, to) -> integer
+static int mesh_addLine(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG, LS_TNUMBER | LS_TINTEGER, LS_TNUMBER | LS_TINTEGER, LS_TBREAK] ;
+    halfEdgeMesh *mesh = luaL_checkudata(L, 1, MESH_TAG) ;
+    uint32_t     from  = checkMeshIndex(L, 2, mesh->pointCount) ;
+    uint32_t     to    = checkMeshIndex(L, 3, mesh->pointCount) ;
+
+    char     error[128] ;
+    uint32_t line = halfEdge_addLine(mesh, from, to, error, sizeof(error)) ;
+    if (line == HALFEDGE_NONE) return luaL_error(L, "%s", error) ;
+    lua_pushinteger(L, (lua_Integer)line + 1) ;
+    return 1 ;
+}
+
+// mesh:addFace(lines) -> integer; lines is a table of 3 or 4 lines in order round the face
+static int mesh_addFace(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG, LS_TTABLE, LS_TBREAK] ;
+    halfEdgeMesh *mesh = luaL_checkudata(L, 1, MESH_TAG) ;
+
+    size_t sides = lua_rawlen(L, 2) ;
+    if (sides < 3 || sides > 4) return luaL_argerror(L, 2, "expected table with 3 or 4 components") ;
+    uint32_t lines[4] ;
+    for (size_t i = 0 ; i < sides ; i++) {
+        lua_rawgeti(L, 2, (lua_Integer)(i + 1)) ;
+        int         isInteger = 0 ;
+        lua_Integer line      = lua_tointegerx(L, -1, &isInteger) ;
+        lua_pop(L, 1) ;
+        if (!isInteger || line < 1 || (size_t)line > mesh->lineCount) {
+            return luaL_argerror(L, 2, lua_pushfstring(L, "expected integer between 1 and %d inclusive for component %d", (int)mesh->lineCount, (int)(i + 1))) ;
+        }
+        lines[i] = (uint32_t)line - 1 ;
+    }
+
+    char     error[128] ;
+    uint32_t face = halfEdge_addFace(mesh, lines, sides, error, sizeof(error)) ;
+    if (face == HALFEDGE_NONE) return luaL_error(L, "%s", error) ;
+    lua_pushinteger(L, (lua_Integer)face + 1) ;
+    return 1 ;
+}
+
+// mesh:point(index, [point]) -> table | mesh; gets or moves a point
+static int mesh_point(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG, LS_TNUMBER | LS_TINTEGER, LS_TTABLE | LS_TOPTIONAL, LS_TBREAK] ;
+    halfEdgeMesh *mesh  = luaL_checkudata(L, 1, MESH_TAG) ;
+    uint32_t     point  = checkMeshIndex(L, 2, mesh->pointCount) ;
+    double       *value = &mesh->points[point * mesh->dimensions] ;
+
+    if (lua_gettop(L) > 2) {
+        double *components = lua_newuserdata(L, mesh->dimensions * sizeof(double)) ;
+        checkMeshPoint(L, 3, mesh, components) ;
+        memcpy(value, components, mesh->dimensions * sizeof(double)) ;
+        lua_pushvalue(L, 1) ;
+    } else {
+        lua_createtable(L, (int)mesh->dimensions, 0) ;
+        for (size_t c = 0 ; c < mesh->dimensions ; c++) {
+            lua_pushnumber(L, value[c]) ;
+            lua_rawseti(L, -2, (lua_Integer)(c + 1)) ;
+        }
+    }
+    return 1 ;
+}
+
+// mesh:line(index) -> { from, to }
+static int mesh_line(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG, LS_TNUMBER | LS_TINTEGER, LS_TBREAK] ;
+    halfEdgeMesh *mesh = luaL_checkudata(L, 1, MESH_TAG) ;
+    uint32_t     line  = checkMeshIndex(L, 2, mesh->lineCount) ;
+    pushMeshIndicies(L, mesh->lines[line].ends, 2) ;
+    return 1 ;
+}
+
+// mesh:face(index) -> lines, points; both in order round the face
+static int mesh_face(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG, LS_TNUMBER | LS_TINTEGER, LS_TBREAK] ;
+    halfEdgeMesh *mesh = luaL_checkudata(L, 1, MESH_TAG) ;
+    uint32_t     face  = checkMeshIndex(L, 2, mesh->faceCount) ;
+
+    uint32_t lines[4], corners[4] ;
+    size_t   sides = halfEdge_faceLines(mesh, face, lines) ;
+    uint32_t half  = mesh->faces[face].firstHalf ;
+    for (size_t i = 0 ; i < sides ; i++) {
+        corners[i] = mesh->halves[half].from ;
+        half       = mesh->halves[half].next ;
+    }
+    pushMeshIndicies(L, lines, sides) ;
+    pushMeshIndicies(L, corners, sides) ;
+    return 2 ;
+}
+
+// mesh:linesAt(point) -> table
+static int mesh_linesAt(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG, LS_TNUMBER | LS_TINTEGER, LS_TBREAK] ;
+    halfEdgeMesh *mesh  = luaL_checkudata(L, 1, MESH_TAG) ;
+    uint32_t     point  = checkMeshIndex(L, 2, mesh->pointCount) ;
+
+    lua_createtable(L, (int)mesh->vertices[point].degree, 0) ;
+    lua_Integer i = 1 ;
+    for (uint32_t line = mesh->vertices[point].firstLine ; line != HALFEDGE_NONE ; line = halfEdge_nextLineAt(mesh, line, point)) {
+        lua_pushinteger(L, (lua_Integer)line + 1) ;
+        lua_rawseti(L, -2, i++) ;
+    }
+    return 1 ;
+}
+
+// mesh:facesOf(line) -> table
+static int mesh_facesOf(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG, LS_TNUMBER | LS_TINTEGER, LS_TBREAK] ;
+    halfEdgeMesh *mesh = luaL_checkudata(L, 1, MESH_TAG) ;
+    uint32_t     line  = checkMeshIndex(L, 2, mesh->lineCount) ;
+
+    lua_newtable(L) ;
+    lua_Integer i = 1 ;
+    for (uint32_t half = mesh->lines[line].firstHalf ; half != HALFEDGE_NONE ; half = mesh->halves[half].nextOnLine) {
+        lua_pushinteger(L, (lua_Integer)mesh->halves[half].face + 1) ;
+        lua_rawseti(L, -2, i++) ;
+    }
+    return 1 ;
+}
+
+// mesh:findFaces([triangles]) -> integer; adds the faces facesFromLines would find that the mesh
+// doesn't have yet, and returns how many there were
+static int mesh_findFaces(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG, LS_TBOOLEAN | LS_TOPTIONAL, LS_TBREAK] ;
+    halfEdgeMesh *mesh          = luaL_checkudata(L, 1, MESH_TAG) ;
+    BOOL         withTriangles = (lua_gettop(L) > 1) ? (BOOL)lua_toboolean(L, 2) : NO ;
+
+    long added = halfEdge_findFaces(mesh, withTriangles) ;
+    if (added < 0) return luaL_error(L, "unable to allocate memory for faces of %d lines", (int)mesh->lineCount) ;
+    lua_pushinteger(L, added) ;
+    return 1 ;
+}
+
+// mesh:subdivide([levels]) -> mesh; a new mesh with levels (default 1) of Catmull-Clark subdivision
+static int mesh_subdivide(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG, LS_TNUMBER | LS_TINTEGER | LS_TOPTIONAL, LS_TBREAK] ;
+    halfEdgeMesh *mesh   = luaL_checkudata(L, 1, MESH_TAG) ;
+    lua_Integer  levels = (lua_gettop(L) > 1) ? lua_tointeger(L, 2) : 1 ;
+    if (levels < 0) return luaL_argerror(L, 2, "expected integer greater than or equal to 0") ;
+
+    char             error[128] ;
+    catmullClarkMesh flat ;
+    catmullClark_init(&flat, mesh->dimensions) ;
+    if (!halfEdge_toCatmullClark(mesh, &flat)) {
+        catmullClark_free(&flat) ;
+        return luaL_error(L, "unable to allocate memory for subdivision") ;
+    }
+    if (!catmullClark_subdivide(&flat, (size_t)levels, error, sizeof(error))) {
+        catmullClark_free(&flat) ;
+        return luaL_error(L, "%s", error) ;
+    }
+
+    halfEdgeMesh *result = pushMesh(L, mesh->dimensions) ;
+    BOOL         built   = halfEdge_fromCatmullClark(result, &flat, error, sizeof(error)) ;
+    catmullClark_free(&flat) ;
+    if (!built) return luaL_error(L, "%s", error) ;
+    return 1 ;
+}
+
+// mesh:points(), mesh:lines() and mesh:faces() -> buffer; the mesh in the form the module's
+// functions take, faces padded with 0 to 4 lines
+static int mesh_points(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG, LS_TBREAK] ;
+    halfEdgeMesh *mesh   = luaL_checkudata(L, 1, MESH_TAG) ;
+    packedBuffer *buffer = pushBuffer(L, packedBuffer_points, mesh->dimensions) ;
+    if (!packedBuffer_resize(buffer, mesh->pointCount)) {
+        return luaL_error(L, "unable to allocate memory for %d points", (int)mesh->pointCount) ;
+    }
+    if (mesh->pointCount > 0) memcpy(buffer->data.points, mesh->points, mesh->pointCount * mesh->dimensions * sizeof(double)) ;
+    return 1 ;
+}
+
+static int mesh_lines(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG, LS_TBREAK] ;
+    halfEdgeMesh *mesh   = luaL_checkudata(L, 1, MESH_TAG) ;
+    packedBuffer *buffer = pushBuffer(L, packedBuffer_indicies, 2) ;
+    if (!packedBuffer_resize(buffer, mesh->lineCount)) {
+        return luaL_error(L, "unable to allocate memory for %d lines", (int)mesh->lineCount) ;
+    }
+    for (size_t i = 0 ; i < mesh->lineCount ; i++) {
+        buffer->data.indicies[i * 2]     = (int32_t)mesh->lines[i].ends[0] + 1 ;
+        buffer->data.indicies[i * 2 + 1] = (int32_t)mesh->lines[i].ends[1] + 1 ;
+    }
+    return 1 ;
+}
+
+static int mesh_faces(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG, LS_TBREAK] ;
+    halfEdgeMesh *mesh   = luaL_checkudata(L, 1, MESH_TAG) ;
+    packedBuffer *buffer = pushBuffer(L, packedBuffer_indicies, 4) ;
+    if (!packedBuffer_resize(buffer, mesh->faceCount)) {
+        return luaL_error(L, "unable to allocate memory for %d faces", (int)mesh->faceCount) ;
+    }
+    for (size_t i = 0 ; i < mesh->faceCount ; i++) {
+        uint32_t lines[4] ;
+        size_t   sides = halfEdge_faceLines(mesh, (uint32_t)i, lines) ;
+        for (size_t j = 0 ; j < sides ; j++) buffer->data.indicies[i * 4 + j] = (int32_t)lines[j] + 1 ;
+    }
+    return 1 ;
+}
+
+// mesh:setPoints(points) -> mesh; moves every point at once, from a table or buffer of the same
+// number of points and components
+static int mesh_setPoints(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG, LS_TTABLE | LS_TUSERDATA, BUFFER_TAG, LS_TBREAK] ;
+    halfEdgeMesh *mesh   = luaL_checkudata(L, 1, MESH_TAG) ;
+    packedBuffer *points = bufferArgument(L, 2, packedBuffer_points, 0, 0) ;
+    if (points->count != mesh->pointCount || (points->count > 0 && points->components != mesh->dimensions)) {
+        return luaL_argerror(L, 2, lua_pushfstring(L, "expected %d points with %d components", (int)mesh->pointCount, (int)mesh->dimensions)) ;
+    }
+    if (points->count > 0) memcpy(mesh->points, points->data.points, points->count * points->components * sizeof(double)) ;
+    lua_pushvalue(L, 1) ;
+    return 1 ;
+}
+
+// mesh:project(eyeDistance, [scale], [offset], [dimensions], [results]) -> buffer; the mesh's
+// points projected as projectCoordinatesDown does, into results if it's given
+static int mesh_project(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, MESH_TAG,
+                    LS_TNUMBER,                                        // eyeDistance
+                    LS_TNUMBER | LS_TNIL | LS_TOPTIONAL,               // scale (default 1)
+                    LS_TNUMBER | LS_TNIL | LS_TOPTIONAL,               // offset (default 0)
+                    LS_TNUMBER | LS_TINTEGER | LS_TNIL | LS_TOPTIONAL, // dimensions (default 3)
+                    LS_TUSERDATA | LS_TNIL | LS_TOPTIONAL, BUFFER_TAG, // results buffer to reuse
+                    LS_TBREAK] ;
+    halfEdgeMesh *mesh        = luaL_checkudata(L, 1, MESH_TAG) ;
+    double       eyeDistance = lua_tonumber(L, 2) ;
+    double       scale       = (lua_type(L, 3) == LUA_TNUMBER) ? lua_tonumber(L, 3) : 1.0 ;
+    double       offset      = (lua_type(L, 4) == LUA_TNUMBER) ? lua_tonumber(L, 4) : 0.0 ;
+    lua_Integer  target      = (lua_type(L, 5) == LUA_TNUMBER) ? lua_tointeger(L, 5) : 3 ;
+    if (target < 1 || (size_t)target > mesh->dimensions) {
+        return luaL_argerror(L, 5, lua_pushfstring(L, "expected integer between 1 and %d inclusive", (int)mesh->dimensions)) ;
+    }
+
+    packedBuffer *results = NULL ;
+    if (lua_type(L, 6) == LUA_TUSERDATA) {
+        results = bufferArgument(L, 6, packedBuffer_points, 0, 0) ;
+        lua_pushvalue(L, 6) ;
+    } else {
+        results = pushBuffer(L, packedBuffer_points, (size_t)target) ;
+    }
+    if (!packedBuffer_reshape(results, (size_t)target, mesh->pointCount)) {
+        return luaL_error(L, "unable to allocate memory for %d points", (int)mesh->pointCount) ;
+    }
+    projection_project(mesh->points, mesh->pointCount, mesh->dimensions, (size_t)target, eyeDistance, scale, offset, results->data.points) ;
+    return 1 ;
+}
+
+// the points given as argument idx for a transform, which must have its dimensions
+static packedBuffer *transformPoints(lua_State *L, int idx, const transformMatrix *transform) {
+    packedBuffer *points = bufferArgument(L, idx, packedBuffer_points, 0, 0) ;
+    if (points->count > 0 && points->components != transform->dimensions) {
+        luaL_argerror(L, idx, lua_pushfstring(L, "expected points with %d components", (int)transform->dimensions)) ;
+        return NULL ;
+    }
+    return points ;
+}
+
+// reads the table at idx as one number for each of the transform's dimensions
+static void checkTransformVector(lua_State *L, int idx, const transformMatrix *transform, double *values) {
+    if (lua_rawlen(L, idx) != transform->dimensions) {
+        luaL_argerror(L, idx, lua_pushfstring(L, "expected table with %d components", (int)transform->dimensions)) ;
+        return ;
+    }
+    for (size_t c = 0 ; c < transform->dimensions ; c++) {
+        int isNumber = 0 ;
+        lua_rawgeti(L, idx, (lua_Integer)(c + 1)) ;
+        values[c] = lua_tonumberx(L, -1, &isNumber) ;
+        lua_pop(L, 1) ;
+        if (!isNumber) luaL_argerror(L, idx, lua_pushfstring(L, "expected number for component %d", (int)(c + 1))) ;
+    }
+}
+
+static int transformation_dimensions(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, TRANSFORM_TAG, LS_TBREAK] ;
+    transformMatrix *transform = luaL_checkudata(L, 1, TRANSFORM_TAG) ;
+    lua_pushinteger(L, (lua_Integer)transform->dimensions) ;
+    return 1 ;
+}
+
+// transform:reset() -> transform, back to the identity
+static int transformation_reset(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, TRANSFORM_TAG, LS_TBREAK] ;
+    transform_reset(luaL_checkudata(L, 1, TRANSFORM_TAG)) ;
+    lua_pushvalue(L, 1) ;
+    return 1 ;
+}
+
+// transform:rotate(axis, axis, angle) -> transform; angle is in radians, in the plane of the two
+// (1 based) axes
+static int transformation_rotate(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, TRANSFORM_TAG, LS_TNUMBER | LS_TINTEGER, LS_TNUMBER | LS_TINTEGER, LS_TNUMBER, LS_TBREAK] ;
+    transformMatrix *transform = luaL_checkudata(L, 1, TRANSFORM_TAG) ;
+    lua_Integer     a          = lua_tointeger(L, 2) ;
+    lua_Integer     b          = lua_tointeger(L, 3) ;
+    for (int idx = 2 ; idx <= 3 ; idx++) {
+        lua_Integer axis = lua_tointeger(L, idx) ;
+        if (axis < 1 || (size_t)axis > transform->dimensions) {
+            return luaL_argerror(L, idx, lua_pushfstring(L, "expected integer between 1 and %d inclusive", (int)transform->dimensions)) ;
+        }
+    }
+    if (a == b) return luaL_argerror(L, 3, "expected a different axis from the first") ;
+    transform_rotate(transform, (size_t)(a - 1), (size_t)(b - 1), lua_tonumber(L, 4)) ;
+    lua_pushvalue(L, 1) ;
+    return 1 ;
+}
+
+// transform:scale(factor | factors) -> transform; one factor for every axis, or a table of one each
+static int transformation_scale(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, TRANSFORM_TAG, LS_TNUMBER | LS_TTABLE, LS_TBREAK] ;
+    transformMatrix *transform = luaL_checkudata(L, 1, TRANSFORM_TAG) ;
+    double          *factors   = lua_newuserdata(L, transform->dimensions * sizeof(double)) ;
+    if (lua_type(L, 2) == LUA_TNUMBER) {
+        for (size_t c = 0 ; c < transform->dimensions ; c++) factors[c] = lua_tonumber(L, 2) ;
+    } else {
+        checkTransformVector(L, 2, transform, factors) ;
+    }
+    transform_scale(transform, factors) ;
+    lua_pushvalue(L, 1) ;
+    return 1 ;
+}
+
+// transform:translate(offsets) -> transform
+static int transformation_translate(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, TRANSFORM_TAG, LS_TTABLE, LS_TBREAK] ;
+    transformMatrix *transform = luaL_checkudata(L, 1, TRANSFORM_TAG) ;
+    double          *offsets   = lua_newuserdata(L, transform->dimensions * sizeof(double)) ;
+    checkTransformVector(L, 2, transform, offsets) ;
+    transform_translate(transform, offsets) ;
+    lua_pushvalue(L, 1) ;
+    return 1 ;
+}
+
+// transform:matrix() -> table of dimensions + 1 rows, in homogeneous coordinates
+static int transformation_matrix(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, TRANSFORM_TAG, LS_TBREAK] ;
+    transformMatrix *transform = luaL_checkudata(L, 1, TRANSFORM_TAG) ;
+    size_t          n          = transform->dimensions + 1 ;
+    lua_createtable(L, (int)n, 0) ;
+    for (size_t i = 0 ; i < n ; i++) {
+        lua_createtable(L, (int)n, 0) ;
+        for (size_t k = 0 ; k < n ; k++) {
+            lua_pushnumber(L, transform->matrix[i * n + k]) ;
+            lua_rawseti(L, -2, (lua_Integer)(k + 1)) ;
+        }
+        lua_rawseti(L, -2, (lua_Integer)(i + 1)) ;
+    }
+    return 1 ;
+}
+
+// transform:apply(points, [results]) -> buffer; results may be the points buffer itself
+static int transformation_apply(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, TRANSFORM_TAG,
+                    LS_TTABLE | LS_TUSERDATA, BUFFER_TAG,              // points
+                    LS_TUSERDATA | LS_TNIL | LS_TOPTIONAL, BUFFER_TAG, // results buffer to reuse
+                    LS_TBREAK] ;
+    transformMatrix *transform = luaL_checkudata(L, 1, TRANSFORM_TAG) ;
+    BOOL            copied     = (lua_type(L, 2) == LUA_TTABLE) ;
+    packedBuffer    *points    = transformPoints(L, 2, transform) ;
+
+    // a table's points were copied into a new buffer, which can take the results itself
+    packedBuffer *results = points ;
+    if (lua_type(L, 3) == LUA_TUSERDATA) {
+        results = bufferArgument(L, 3, packedBuffer_points, 0, 0) ;
+        lua_pushvalue(L, 3) ;
+    } else if (!copied) {
+        results = pushBuffer(L, packedBuffer_points, transform->dimensions) ;
+    }
+    if (results != points && !packedBuffer_reshape(results, transform->dimensions, points->count)) {
+        return luaL_error(L, "unable to allocate memory for %d points", (int)points->count) ;
+    }
+    transform_apply(transform, points->data.points, points->count, results->data.points) ;
+    return 1 ;
+}
+
+// transform:project(points, eyeDistance, [scale], [offset], [dimensions], [results]) -> buffer;
+// as dimensional.projectCoordinatesDown would the transformed points, without keeping them
+static int transformation_project(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, TRANSFORM_TAG,
+                    LS_TTABLE | LS_TUSERDATA, BUFFER_TAG,              // points
+                    LS_TNUMBER,                                        // eyeDistance
+                    LS_TNUMBER | LS_TNIL | LS_TOPTIONAL,               // scale (default 1)
+                    LS_TNUMBER | LS_TNIL | LS_TOPTIONAL,               // offset (default 0)
+                    LS_TNUMBER | LS_TINTEGER | LS_TNIL | LS_TOPTIONAL, // dimensions (default 3)
+                    LS_TUSERDATA | LS_TNIL | LS_TOPTIONAL, BUFFER_TAG, // results buffer to reuse
+                    LS_TBREAK] ;
+    transformMatrix *transform   = luaL_checkudata(L, 1, TRANSFORM_TAG) ;
+    double          eyeDistance = lua_tonumber(L, 3) ;
+    double          scale       = (lua_type(L, 4) == LUA_TNUMBER) ? lua_tonumber(L, 4) : 1.0 ;
+    double          offset      = (lua_type(L, 5) == LUA_TNUMBER) ? lua_tonumber(L, 5) : 0.0 ;
+    lua_Integer     target      = (lua_type(L, 6) == LUA_TNUMBER) ? lua_tointeger(L, 6) : 3 ;
+    if (target < 1 || (size_t)target > transform->dimensions) {
+        return luaL_argerror(L, 6, lua_pushfstring(L, "expected integer between 1 and %d inclusive", (int)transform->dimensions)) ;
+    }
+    packedBuffer *points = transformPoints(L, 2, transform) ;
+    size_t       count   = points->count ;
+
+    packedBuffer *results = NULL ;
+    if (lua_type(L, 7) == LUA_TUSERDATA) {
+        results = bufferArgument(L, 7, packedBuffer_points, 0, 0) ;
+        lua_pushvalue(L, 7) ;
+    } else {
+        results = pushBuffer(L, packedBuffer_points, (size_t)target) ;
+    }
+
+    // straight into the results buffer, unless it's the points themselves
+    if (results != points) {
+        if (!packedBuffer_reshape(results, (size_t)target, count)) {
+            return luaL_error(L, "unable to allocate memory for %d points", (int)count) ;
+        }
+        transform_project(transform, points->data.points, count, (size_t)target, eyeDistance, scale, offset, results->data.points) ;
+        return 1 ;
+    }
+
+    if (!projection_reserve(&projectionOutput, count * (size_t)target)) {
+        return luaL_error(L, "unable to allocate memory for %d points", (int)count) ;
+    }
+    transform_project(transform, points->data.points, count, (size_t)target, eyeDistance, scale, offset, projectionOutput.values) ;
+    if (!packedBuffer_reshape(results, (size_t)target, count)) {
+        return luaL_error(L, "unable to allocate memory for %d points", (int)count) ;
+    }
+    if (count > 0) memcpy(results->data.points, projectionOutput.values, count * (size_t)target * sizeof(double)) ;
+    return 1 ;
+}
+
 #pragma mark - Module Constants -
 
 #pragma mark - Lua<->NSObject Conversion Functions -
 
 #pragma mark - Hammerspoon/Lua Infrastructure -
 
-// static int meta_gc(lua_State* __unused L) {
-//     return 0 ;
-// }
+static int buffer_len(lua_State *L) {
+    packedBuffer *buffer = luaL_checkudata(L, 1, BUFFER_TAG) ;
+    lua_pushinteger(L, (lua_Integer)buffer->count) ;
+    return 1 ;
+}
 
-// // Metatable for userdata objects
-// static const luaL_Reg userdata_metaLib[] = {
-//     {"__tostring", userdata_tostring},
-//     {"__eq",       userdata_eq},
-//     {"__gc",       userdata_gc},
-//     {NULL, NULL}
-// };
+static int buffer_tostring(lua_State *L) {
+    packedBuffer *buffer = luaL_checkudata(L, 1, BUFFER_TAG) ;
+    lua_pushfstring(L, "%s: %d x %d %s (%p)", BUFFER_TAG,
+                                              (int)buffer->count,
+                                              (int)buffer->components,
+                                              (buffer->type == packedBuffer_points) ? "point" : "index",
+                                              (void *)buffer) ;
+    return 1 ;
+}
+
+static int buffer_gc(lua_State *L) {
+    packedBuffer *buffer = luaL_checkudata(L, 1, BUFFER_TAG) ;
+    packedBuffer_free(buffer) ;
+    return 0 ;
+}
+
+static int mesh_tostring(lua_State *L) {
+    halfEdgeMesh *mesh = luaL_checkudata(L, 1, MESH_TAG) ;
+    lua_pushfstring(L, "%s: %d-D, %d points, %d lines, %d faces (%p)", MESH_TAG,
+                                                                       (int)mesh->dimensions,
+                                                                       (int)mesh->pointCount,
+                                                                       (int)mesh->lineCount,
+                                                                       (int)mesh->faceCount,
+                                                                       (void *)mesh) ;
+    return 1 ;
+}
+
+static int mesh_gc(lua_State *L) {
+    halfEdgeMesh *mesh = luaL_checkudata(L, 1, MESH_TAG) ;
+    halfEdge_free(mesh) ;
+    return 0 ;
+}
+
+static int transformation_tostring(lua_State *L) {
+    transformMatrix *transform = luaL_checkudata(L, 1, TRANSFORM_TAG) ;
+    lua_pushfstring(L, "%s: %d-D (%p)", TRANSFORM_TAG, (int)transform->dimensions, (void *)transform) ;
+    return 1 ;
+}
+
+static int transformation_gc(lua_State *L) {
+    transformMatrix *transform = luaL_checkudata(L, 1, TRANSFORM_TAG) ;
+    transform_free(transform) ;
+    return 0 ;
+}
+
+static int meta_gc(lua_State* __unused L) {
+    projection_freeBuffer(&projectionInput) ;
+    projection_freeBuffer(&projectionOutput) ;
+    return 0 ;
+}
+
+// Metatable for buffer objects
+static const luaL_Reg buffer_metaLib[] = {
+    {"count",      buffer_count},
+    {"components", buffer_components},
+    {"type",       buffer_type},
+    {"get",        buffer_get},
+    {"set",        buffer_set},
+    {"values",     buffer_values},
+    {"setValues",  buffer_setValues},
+    {"toTable",    buffer_toTable},
+    {"copy",       buffer_copy},
+    {"__len",      buffer_len},
+    {"__tostring", buffer_tostring},
+    {"__gc",       buffer_gc},
+    {NULL, NULL}
+};
+
+// Metatable for mesh objects
+static const luaL_Reg mesh_metaLib[] = {
+    {"dimensions", mesh_dimensions},
+    {"counts",     mesh_counts},
+    {"addPoint",   mesh_addPoint},
+    {"addLine",    mesh_addLine},
+    {"addFace",    mesh_addFace},
+    {"point",      mesh_point},
+    {"line",       mesh_line},
+    {"face",       mesh_face},
+    {"linesAt",    mesh_linesAt},
+    {"facesOf",    mesh_facesOf},
+    {"findFaces",  mesh_findFaces},
+    {"subdivide",  mesh_subdivide},
+    {"points",     mesh_points},
+    {"lines",      mesh_lines},
+    {"faces",      mesh_faces},
+    {"setPoints",  mesh_setPoints},
+    {"project",    mesh_project},
+    {"__tostring", mesh_tostring},
+    {"__gc",       mesh_gc},
+    {NULL, NULL}
+};
+
+// Metatable for transform objects
+static const luaL_Reg transform_metaLib[] = {
+    {"dimensions", transformation_dimensions},
+    {"reset",      transformation_reset},
+    {"rotate",     transformation_rotate},
+    {"scale",      transformation_scale},
+    {"translate",  transformation_translate},
+    {"matrix",     transformation_matrix},
+    {"apply",      transformation_apply},
+    {"project",    transformation_project},
+    {"__tostring", transformation_tostring},
+    {"__gc",       transformation_gc},
+    {NULL, NULL}
+};
 
 // Functions for returned object when module loads
 static luaL_Reg moduleLib[] = {
     {"generate3dObject",         dimensional_generateSceneKitObject},
     {"facesFromLines",           dimensional_facesFromLines},
 //     {"mapLinesToFaces",          dimensional_mapLinesToFaces},
-//     {"catmullClarkSubdivision",  dimensional_catmullClarkSubdivision},
-//     {"projectCoordinatesDown",   dimensional_projectCoordinatesDown},
+    {"catmullClarkSubdivision",  dimensional_catmullClarkSubdivision},
+    {"projectCoordinatesDown",   dimensional_projectCoordinatesDown},
+    {"pointBuffer",              dimensional_pointBuffer},
+    {"indexBuffer",              dimensional_indexBuffer},
+    {"mesh",                     dimensional_mesh},
+    {"transform",                dimensional_transform},
+    {"writeMesh",                dimensional_writeMesh},
+    {"readMesh",                 dimensional_readMesh},
     {NULL, NULL}
 };
 
-// // Metatable for module, if needed
-// static const luaL_Reg module_metaLib[] = {
-//     {"__gc", meta_gc},
-//     {NULL, NULL}
-// };
+// Metatable for module
+static const luaL_Reg module_metaLib[] = {
+    {"__gc", meta_gc},
+    {NULL, NULL}
+};
 
 int luaopen_hs__asm_libdimensional(lua_State* L) {
     LuaSkin *skin = [LuaSkin sharedWithState:L] ;
     refTable = [skin registerLibrary:USERDATA_TAG
                            functions:moduleLib
-                       metaFunctions:nil] ; // or module_metaLib
+                       metaFunctions:module_metaLib] ;
+    [skin registerObject:BUFFER_TAG objectFunctions:buffer_metaLib] ;
+    [skin registerObject:MESH_TAG objectFunctions:mesh_metaLib] ;
+    [skin registerObject:TRANSFORM_TAG objectFunctions:transform_metaLib] ;
 
     return 1;
 }
@@ -0,0 +1,143 @@
+// Copying Lua tables of points and indicies into packed buffers for hs._asm.dimensional
+//
+// The module's functions take either buffers or the equivalent Lua tables: an array of items, each
+// an array of numbers. A table is read with lua_rawlen and lua_rawgeti only -- no metamethods, no
+// conversion to Foundation objects -- and each value is checked as it's copied: that the items are
+// tables of the right length, that the values are numbers (not strings that look like them) or for
+// indicies, integers that fit in 32 bits, and if asked, that indicies are in range. Checking and
+// copying are the same pass over the table, so a bad index is reported as an argument error here
+// for no more than the copy costs, rather than turning into an out of bounds read further in.
+//
+// This uses the Lua C API and nothing from LuaSkin, so ../benchmark/luaTableBenchmark.c can build
+// it against a stock Lua to measure what the checks cost.
+
+#pragma once
+
+#if __has_include(<LuaSkin/lua.h>)
+#import <LuaSkin/lua.h>
+#else
+#include <lua.h>
+#endif
+
+#include "packedBuffer.h"
+
+#define LUATABLE_NO_RANGE (-1)
+
+#pragma mark - Support
+
+// the widest item in the array at idx, for index buffers that take their components from the items
+static inline size_t luaTable_widestItem(lua_State *L, int idx, size_t count) {
+    size_t widest = 0 ;
+    for (size_t i = 0 ; i < count ; i++) {
+        if (lua_rawgeti(L, idx, (lua_Integer)(i + 1)) == LUA_TTABLE) {
+            size_t length = lua_rawlen(L, -1) ;
+            if (length > widest) widest = length ;
+        }
+        lua_pop(L, 1) ;
+    }
+    return widest ;
+}
+
+// pushes the message for an index outside 1...maximum and returns it
+static inline const char *luaTable_rangeError(lua_State *L, int64_t maximum, size_t i, size_t c) {
+    return lua_pushfstring(L, "expected integer between 1 and %d inclusive for component %d of index %d",
+                              (int)maximum, (int)(c + 1), (int)(i + 1)) ;
+}
+
+#pragma mark - Copying
+
+// copies the array of tables at idx into buffer, which should be empty. If the buffer's components
+// is 0, it's taken from the items: the first one for points, the longest for indicies. Points must
+// all have that many components; index items can have from minComponents up to it and are padded
+// with 0. Unless maximum is LUATABLE_NO_RANGE, indicies must also be between 1 and maximum, with a
+// 0 (given or padded) allowed in the last component where allowZero is true, as
+// packedBuffer_findOutOfRange would check them.
+//
+// Returns NULL, or a message describing the first value that doesn't fit, which is left on the
+// stack for luaL_argerror; the buffer's contents are then undefined.
+static const char *luaTable_copyToBuffer(lua_State    *L,
+                                         int          idx,
+                                         packedBuffer *buffer,
+                                         size_t       minComponents,
+                                         int64_t      maximum,
+                                         bool         allowZero) {
+    idx = lua_absindex(L, idx) ;
+    bool   isIndicies = (buffer->type == packedBuffer_indicies) ;
+    bool   checkRange = isIndicies && maximum != LUATABLE_NO_RANGE ;
+    size_t count      = lua_rawlen(L, idx) ;
+
+    if (count == 0) {
+        lua_pushnil(L) ;
+        if (lua_next(L, idx) != 0) {
+            lua_pop(L, 2) ;
+            return lua_pushstring(L, "expected array type table or buffer") ;
+        }
+    }
+
+    if (buffer->components == 0 && count > 0) {
+        if (isIndicies) {
+            buffer->components = luaTable_widestItem(L, idx, count) ;
+        } else {
+            if (lua_rawgeti(L, idx, 1) == LUA_TTABLE) buffer->components = lua_rawlen(L, -1) ;
+            lua_pop(L, 1) ;
+        }
+        if (buffer->components == 0) return lua_pushstring(L, "expected table at index 1 to contain at least 1 component") ;
+    }
+    size_t maxComponents = buffer->components ;
+    size_t minimum       = isIndicies ? minComponents : maxComponents ;
+    if (count > 0 && !packedBuffer_resize(buffer, count)) {
+        return lua_pushfstring(L, "unable to allocate memory for %d items", (int)count) ;
+    }
+
+    for (size_t i = 0 ; i < count ; i++) {
+        size_t length = 0 ;
+        if (lua_rawgeti(L, idx, (lua_Integer)(i + 1)) == LUA_TTABLE) length = lua_rawlen(L, -1) ;
+        if (length < minimum || length > maxComponents || lua_type(L, -1) != LUA_TTABLE) {
+            lua_pop(L, 1) ;
+            return (minimum == maxComponents) ?
+                lua_pushfstring(L, "expected table at index %d to contain %d components", (int)(i + 1), (int)maxComponents) :
+                lua_pushfstring(L, "expected table at index %d to contain %d to %d components", (int)(i + 1), (int)minimum, (int)maxComponents) ;
+        }
+
+        if (isIndicies) {
+            int32_t *item = &buffer->data.indicies[i * maxComponents] ;
+            for (size_t c = 0 ; c < length ; c++) {
+                int         isNumber = 0 ;
+                lua_Integer value    = 0 ;
+                if (lua_rawgeti(L, -1, (lua_Integer)(c + 1)) == LUA_TNUMBER) value = lua_tointegerx(L, -1, &isNumber) ;
+                lua_pop(L, 1) ;
+                if (!isNumber) {
+                    lua_pop(L, 1) ;
+                    return lua_pushfstring(L, "expected integer for component %d of index %d", (int)(c + 1), (int)(i + 1)) ;
+                }
+                if (value < INT32_MIN || value > INT32_MAX) {
+                    lua_pop(L, 1) ;
+                    return lua_pushfstring(L, "expected 32 bit integer for component %d of index %d", (int)(c + 1), (int)(i + 1)) ;
+                }
+                if (checkRange && (value < 1 || value > maximum) && !(allowZero && value == 0 && c + 1 == maxComponents)) {
+                    lua_pop(L, 1) ;
+                    return luaTable_rangeError(L, maximum, i, c) ;
+                }
+                item[c] = (int32_t)value ;
+            }
+            // the padding is 0s, which are only allowed in the last component
+            if (checkRange && length < maxComponents && (length + 1 < maxComponents || !allowZero)) {
+                lua_pop(L, 1) ;
+                return luaTable_rangeError(L, maximum, i, length) ;
+            }
+        } else {
+            double *item = &buffer->data.points[i * maxComponents] ;
+            for (size_t c = 0 ; c < length ; c++) {
+                int isNumber = 0 ;
+                if (lua_rawgeti(L, -1, (lua_Integer)(c + 1)) == LUA_TNUMBER) item[c] = lua_tonumberx(L, -1, &isNumber) ;
+                lua_pop(L, 1) ;
+                if (!isNumber) {
+                    lua_pop(L, 1) ;
+                    return lua_pushfstring(L, "expected number for component %d of index %d", (int)(c + 1), (int)(i + 1)) ;
+                }
+            }
+        }
+        lua_pop(L, 1) ;
+    }
+    return NULL ;
+}
@@ -0,0 +1,206 @@
+// Finding the faces of a mesh given only its lines
+//
+// Written in plain C with no SceneKit or Lua so it can also be built into the benchmark in
+// ../benchmark. A face is a closed loop of 4 lines (or, if asked for, 3) with no other lines
+// between its corners. Rather than trying every combination of lines, each vertex gets a list of
+// the lines which touch it and loops are followed from line to line through those lists, so the
+// work depends on how many lines meet at each vertex instead of how many lines there are.
+//
+// Each face is reported once, as the lines in the order they're met going around it starting
+// from the line with the lowest index and heading towards the lower indexed of its two neighbors,
+// and the faces are sorted by those lists. This is the order the original brute force search
+// reported them in, so callers see exactly the same faces in the same order.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint32_t lines[4] ;  // 1 based indicies of the face's lines, in order around it; lines[3] is 0 for a triangle
+} meshFace ;
+
+typedef struct {
+    meshFace *faces ;
+    size_t   count ;
+    size_t   capacity ;
+
+    // scratch space, kept so repeated searches don't have to allocate it again
+    uint32_t *from ;       // compact vertex numbers of each line's endpoints
+    uint32_t *to ;
+    uint32_t *offsets ;    // the lines touching vertex v are incident[offsets[v]] up to incident[offsets[v + 1]]
+    uint32_t *incident ;
+    int64_t  *vertices ;   // sorted, distinct endpoint values
+    size_t   lineCapacity ;
+    size_t   vertexCapacity ;
+} meshFaceList ;
+
+#pragma mark - Lifecycle
+
+static inline void meshFaces_init(meshFaceList *list) {
+    memset(list, 0, sizeof(meshFaceList)) ;
+}
+
+static inline void meshFaces_free(meshFaceList *list) {
+    free(list->faces) ;
+    free(list->from) ;
+    free(list->to) ;
+    free(list->offsets) ;
+    free(list->incident) ;
+    free(list->vertices) ;
+    meshFaces_init(list) ;
+}
+
+static inline size_t meshFaces_sides(const meshFace *face) {
+    return (face->lines[3] == 0) ? 3 : 4 ;
+}
+
+#pragma mark - Support
+
+static inline int meshFaces_compareValues(const void *a, const void *b) {
+    int64_t left = *(const int64_t *)a, right = *(const int64_t *)b ;
+    return (left > right) - (left < right) ;
+}
+
+static inline int meshFaces_compareFaces(const void *a, const void *b) {
+    const meshFace *left = a, *right = b ;
+    for (size_t i = 0 ; i < 4 ; i++) {
+        if (left->lines[i] != right->lines[i]) return (left->lines[i] < right->lines[i]) ? -1 : 1 ;
+    }
+    return 0 ;
+}
+
+static inline uint32_t meshFaces_vertex(const meshFaceList *list, size_t vertexCount, int64_t value) {
+    const int64_t *found = bsearch(&value, list->vertices, vertexCount, sizeof(int64_t), meshFaces_compareValues) ;
+    return (uint32_t)(found - list->vertices) ;
+}
+
+static inline uint32_t meshFaces_otherEnd(const meshFaceList *list, uint32_t line, uint32_t vertex) {
+    return (list->from[line] == vertex) ? list->to[line] : list->from[line] ;
+}
+
+static inline bool meshFaces_add(meshFaceList *list, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    if (list->count == list->capacity) {
+        size_t   capacity = (list->capacity > 0) ? list->capacity * 2 : 256 ;
+        meshFace *faces   = realloc(list->faces, capacity * sizeof(meshFace)) ;
+        if (!faces) return false ;
+        list->faces    = faces ;
+        list->capacity = capacity ;
+    }
+    list->faces[list->count++] = (meshFace){ .lines = { a + 1, b + 1, c + 1, (d == UINT32_MAX) ? 0 : d + 1 } } ;
+    return true ;
+}
+
+// numbers the distinct endpoints and builds the list of lines touching each; lines which start and
+// end at the same vertex can't be part of a face and are left out
+static bool meshFaces_buildAdjacency(meshFaceList *list, const int64_t *endpoints, size_t lineCount, size_t *vertexCount) {
+    if (lineCount > list->lineCapacity) {
+        uint32_t *from     = realloc(list->from,     lineCount * sizeof(uint32_t)) ;
+        if (from) list->from = from ;
+        uint32_t *to       = realloc(list->to,       lineCount * sizeof(uint32_t)) ;
+        if (to) list->to = to ;
+        uint32_t *incident = realloc(list->incident, lineCount * 2 * sizeof(uint32_t)) ;
+        if (incident) list->incident = incident ;
+        int64_t  *vertices = realloc(list->vertices, lineCount * 2 * sizeof(int64_t)) ;
+        if (vertices) list->vertices = vertices ;
+        if (!(from && to && incident && vertices)) return false ;
+        list->lineCapacity = lineCount ;
+    }
+
+    memcpy(list->vertices, endpoints, lineCount * 2 * sizeof(int64_t)) ;
+    qsort(list->vertices, lineCount * 2, sizeof(int64_t), meshFaces_compareValues) ;
+    size_t count = 0 ;
+    for (size_t i = 0 ; i < lineCount * 2 ; i++) {
+        if (count == 0 || list->vertices[count - 1] != list->vertices[i]) list->vertices[count++] = list->vertices[i] ;
+    }
+    *vertexCount = count ;
+
+    if (count + 1 > list->vertexCapacity) {
+        uint32_t *offsets = realloc(list->offsets, (count + 1) * sizeof(uint32_t)) ;
+        if (!offsets) return false ;
+        list->offsets        = offsets ;
+        list->vertexCapacity = count + 1 ;
+    }
+    memset(list->offsets, 0, (count + 1) * sizeof(uint32_t)) ;
+
+    for (size_t i = 0 ; i < lineCount ; i++) {
+        list->from[i] = meshFaces_vertex(list, count, endpoints[i * 2]) ;
+        list->to[i]   = meshFaces_vertex(list, count, endpoints[i * 2 + 1]) ;
+        if (list->from[i] == list->to[i]) continue ;
+        list->offsets[list->from[i] + 1]++ ;
+        list->offsets[list->to[i] + 1]++ ;
+    }
+    for (size_t v = 0 ; v < count ; v++) list->offsets[v + 1] += list->offsets[v] ;
+
+    // offsets[v] is used as the fill position for v's list, then shifted back down afterwards;
+    // lines are added in order, so each vertex's list is sorted
+    for (size_t i = 0 ; i < lineCount ; i++) {
+        if (list->from[i] == list->to[i]) continue ;
+        list->incident[list->offsets[list->from[i]]++] = (uint32_t)i ;
+        list->incident[list->offsets[list->to[i]]++]   = (uint32_t)i ;
+    }
+    for (size_t v = count ; v > 0 ; v--) list->offsets[v] = list->offsets[v - 1] ;
+    list->offsets[0] = 0 ;
+    return true ;
+}
+
+#pragma mark - Searching
+
+// Finds the faces formed by the lines, given as pairs of endpoint values (typically point numbers)
+// in endpoints, replacing any faces already in the list. Faces have 4 sides, or 3 or 4 if triangles
+// is true. Returns false if memory couldn't be allocated.
+static bool meshFaces_find(meshFaceList *list, const int64_t *endpoints, size_t lineCount, bool triangles) {
+    list->count = 0 ;
+    if (lineCount == 0) return true ;
+    if (lineCount >= UINT32_MAX / 2) return false ;
+
+    size_t vertexCount = 0 ;
+    if (!meshFaces_buildAdjacency(list, endpoints, lineCount, &vertexCount)) return false ;
+
+    const uint32_t *offsets  = list->offsets ;
+    const uint32_t *incident = list->incident ;
+
+    // every face is found from its lowest numbered line a, going out from one end (u) along b and
+    // from the other (v) along d; only lines numbered higher than a are followed. Since the lists
+    // are sorted, the lines lower than a at the start of each can be skipped over.
+    for (uint32_t a = 0 ; a < lineCount ; a++) {
+        uint32_t u = list->from[a], v = list->to[a] ;
+        if (u == v) continue ;
+
+        for (uint32_t i = offsets[u] ; i < offsets[u + 1] ; i++) {
+            uint32_t b = incident[i] ;
+            if (b <= a) continue ;
+            uint32_t w = meshFaces_otherEnd(list, b, u) ;
+            if (w == v) continue ; // runs alongside a
+
+            for (uint32_t j = offsets[v] ; j < offsets[v + 1] ; j++) {
+                uint32_t d = incident[j] ;
+                if (d <= a || d == b) continue ;
+                uint32_t x = meshFaces_otherEnd(list, d, v) ;
+                if (x == u) continue ;
+
+                if (x == w) {
+                    if (triangles && !meshFaces_add(list, a, (b < d) ? b : d, (b < d) ? d : b, UINT32_MAX)) return false ;
+                    continue ;
+                }
+
+                // the fourth line joins w and x; the shorter list is searched
+                uint32_t from = w, other = x ;
+                if (offsets[x + 1] - offsets[x] < offsets[w + 1] - offsets[w]) {
+                    from  = x ;
+                    other = w ;
+                }
+                for (uint32_t k = offsets[from] ; k < offsets[from + 1] ; k++) {
+                    uint32_t c = incident[k] ;
+                    if (c <= a || meshFaces_otherEnd(list, c, from) != other) continue ;
+                    if (!meshFaces_add(list, a, (b < d) ? b : d, c, (b < d) ? d : b)) return false ;
+                }
+            }
+        }
+    }
+
+    qsort(list->faces, list->count, sizeof(meshFace), meshFaces_compareFaces) ;
+    return true ;
+}
@@ -0,0 +1,347 @@
+// Reading and writing meshes to files for hs._asm.dimensional
+//
+// A mesh here is the flat arrays the rest of the module passes around: points as runs of
+// `dimensions` doubles, lines as pairs of 1 based point numbers, and faces as 3 or 4 1 based line
+// numbers, padded with 0 for triangles. The writers stream them out an item at a time through a
+// large stdio buffer, so nothing the size of the file is ever built up in memory:
+//
+//   meshFile_obj     Wavefront OBJ text: v, l and f records, with faces given by their corners as
+//                    OBJ expects. OBJ has room for 4 components (x, y, z, w), so more than that
+//                    have to be projected down first.
+//   meshFile_ply     binary PLY in the machine's byte order: vertex, edge and face elements, the
+//                    vertex with a double property for every component (x, y, z, w, c5, c6, ...)
+//                    and faces as lists of corners, 0 based as PLY counts them.
+//   meshFile_native  this module's own format: a fixed header followed by the arrays exactly as
+//                    they're held in memory, so it can be written with one fwrite for each and
+//                    read back with meshFile_map without parsing anything.
+//
+// The native format is:
+//
+//   header  meshFileHeader, 48 bytes
+//   points  pointCount * dimensions doubles
+//   lines   lineCount * 2 int32_t
+//   faces   faceCount * faceComponents int32_t
+//
+// all in the byte order of the machine that wrote it, which byteOrder records; a file from a
+// machine of the other byte order is refused rather than swapped. meshFile_map checks the header
+// against the file's size, but not that the indicies are in range -- that's left to the caller,
+// who has to copy or check them anyway.
+
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef enum {
+    meshFile_obj,
+    meshFile_ply,
+    meshFile_native,
+} meshFileFormat ;
+
+typedef struct {
+    const double  *points ;  // pointCount * dimensions
+    const int32_t *lines ;   // pairs of 1 based point numbers
+    const int32_t *faces ;   // faceComponents 1 based line numbers each, 0 padded; may be NULL if faceCount is 0
+    size_t        dimensions ;
+    size_t        pointCount ;
+    size_t        lineCount ;
+    size_t        faceCount ;
+    size_t        faceComponents ;  // 3 or 4, or 0 when there are no faces
+} meshFileData ;
+
+typedef struct {
+    char     magic[8] ;       // MESHFILE_MAGIC
+    uint32_t version ;        // MESHFILE_VERSION
+    uint32_t byteOrder ;      // MESHFILE_BYTE_ORDER as the writer saw it
+    uint32_t dimensions ;
+    uint32_t faceComponents ;
+    uint64_t pointCount ;
+    uint64_t lineCount ;
+    uint64_t faceCount ;
+} meshFileHeader ;
+
+typedef struct {
+    meshFileData data ;     // pointing into the mapping
+    void         *mapping ;
+    size_t       size ;
+} meshFileMap ;
+
+#define MESHFILE_MAGIC       "DIMMESH"
+#define MESHFILE_VERSION     1
+#define MESHFILE_BYTE_ORDER  0x01020304u
+#define MESHFILE_BUFFER_SIZE (1 << 20)
+
+#pragma mark - Support
+
+static inline bool meshFile_isLittleEndian(void) {
+    const uint16_t probe = 1 ;
+    uint8_t        first ;
+    memcpy(&first, &probe, 1) ;
+    return first == 1 ;
+}
+
+// picks a format from the path's extension: .obj, .ply, and anything else is native
+static inline meshFileFormat meshFile_formatForPath(const char *path) {
+    const char *dot = strrchr(path, '.') ;
+    if (dot && strcasecmp(dot, ".obj") == 0) return meshFile_obj ;
+    if (dot && strcasecmp(dot, ".ply") == 0) return meshFile_ply ;
+    return meshFile_native ;
+}
+
+// the corners of face i, 1 based, where each of its lines meets the next; returns how many there
+// are, or 0 if the lines don't go round in a loop through different points. Lines are assumed to
+// be in range.
+static size_t meshFile_corners(const meshFileData *data, size_t i, int32_t corners[4]) {
+    const int32_t *face  = &data->faces[i * data->faceComponents] ;
+    size_t        sides  = (face[data->faceComponents - 1] == 0) ? data->faceComponents - 1 : data->faceComponents ;
+    if (sides < 3) return 0 ;
+
+    for (size_t j = 0 ; j < sides ; j++) {
+        const int32_t *line = &data->lines[(size_t)(face[j] - 1) * 2] ;
+        const int32_t *next = &data->lines[(size_t)(face[(j + 1) % sides] - 1) * 2] ;
+        if (line[0] == next[0] || line[0] == next[1]) {
+            corners[j] = line[0] ;
+        } else if (line[1] == next[0] || line[1] == next[1]) {
+            corners[j] = line[1] ;
+        } else {
+            return 0 ;
+        }
+    }
+    for (size_t j = 0 ; j < sides ; j++) {
+        const int32_t *line     = &data->lines[(size_t)(face[j] - 1) * 2] ;
+        int32_t       previous = corners[(j + sides - 1) % sides] ;
+        if (!((line[0] == previous && line[1] == corners[j]) || (line[1] == previous && line[0] == corners[j]))) return 0 ;
+        for (size_t k = 0 ; k < j ; k++) {
+            if (corners[k] == corners[j]) return 0 ;
+        }
+    }
+    return sides ;
+}
+
+#pragma mark - Writing
+
+static bool meshFile_writeOBJ(FILE *file, const meshFileData *data, char *error, size_t errorSize) {
+    if (data->dimensions > 4) {
+        snprintf(error, errorSize, "OBJ files hold at most 4 components per point, not %zu", data->dimensions) ;
+        return false ;
+    }
+    fprintf(file, "# hs._asm.dimensional: %zu points, %zu lines, %zu faces\n", data->pointCount, data->lineCount, data->faceCount) ;
+
+    for (size_t i = 0 ; i < data->pointCount ; i++) {
+        const double *point = &data->points[i * data->dimensions] ;
+        fputc('v', file) ;
+        for (size_t c = 0 ; c < 3 || c < data->dimensions ; c++) {
+            fprintf(file, " %.17g", (c < data->dimensions) ? point[c] : 0.0) ;
+        }
+        fputc('\n', file) ;
+    }
+    for (size_t i = 0 ; i < data->lineCount ; i++) {
+        fprintf(file, "l %d %d\n", data->lines[i * 2], data->lines[i * 2 + 1]) ;
+    }
+    for (size_t i = 0 ; i < data->faceCount ; i++) {
+        int32_t corners[4] ;
+        size_t  sides = meshFile_corners(data, i, corners) ;
+        if (sides == 0) {
+            snprintf(error, errorSize, "the lines of face %zu don't go round in a loop", i + 1) ;
+            return false ;
+        }
+        fputc('f', file) ;
+        for (size_t j = 0 ; j < sides ; j++) fprintf(file, " %d", corners[j]) ;
+        fputc('\n', file) ;
+    }
+    return true ;
+}
+
+static bool meshFile_writePLY(FILE *file, const meshFileData *data, char *error, size_t errorSize) {
+    static const char * const names[] = { "x", "y", "z", "w" } ;
+
+    fprintf(file, "ply\nformat %s 1.0\ncomment hs._asm.dimensional\n",
+                  meshFile_isLittleEndian() ? "binary_little_endian" : "binary_big_endian") ;
+    fprintf(file, "element vertex %zu\n", data->pointCount) ;
+    for (size_t c = 0 ; c < data->dimensions ; c++) {
+        if (c < 4) {
+            fprintf(file, "property double %s\n", names[c]) ;
+        } else {
+            fprintf(file, "property double c%zu\n", c + 1) ;
+        }
+    }
+    fprintf(file, "element edge %zu\nproperty int vertex1\nproperty int vertex2\n", data->lineCount) ;
+    fprintf(file, "element face %zu\nproperty list uchar int vertex_indices\nend_header\n", data->faceCount) ;
+
+    if (data->pointCount > 0) fwrite(data->points, sizeof(double), data->pointCount * data->dimensions, file) ;
+    for (size_t i = 0 ; i < data->lineCount ; i++) {
+        int32_t line[2] = { data->lines[i * 2] - 1, data->lines[i * 2 + 1] - 1 } ;
+        fwrite(line, sizeof(int32_t), 2, file) ;
+    }
+    for (size_t i = 0 ; i < data->faceCount ; i++) {
+        int32_t corners[4] ;
+        size_t  sides = meshFile_corners(data, i, corners) ;
+        if (sides == 0) {
+            snprintf(error, errorSize, "the lines of face %zu don't go round in a loop", i + 1) ;
+            return false ;
+        }
+        uint8_t count = (uint8_t)sides ;
+        for (size_t j = 0 ; j < sides ; j++) corners[j]-- ;
+        fwrite(&count, 1, 1, file) ;
+        fwrite(corners, sizeof(int32_t), sides, file) ;
+    }
+    return true ;
+}
+
+static bool meshFile_writeNative(FILE *file, const meshFileData *data, char *error, size_t errorSize) {
+    if (data->dimensions > UINT32_MAX) {
+        snprintf(error, errorSize, "too many components per point") ;
+        return false ;
+    }
+    meshFileHeader header ;
+    memset(&header, 0, sizeof(meshFileHeader)) ;
+    memcpy(header.magic, MESHFILE_MAGIC, sizeof(MESHFILE_MAGIC)) ;
+    header.version        = MESHFILE_VERSION ;
+    header.byteOrder      = MESHFILE_BYTE_ORDER ;
+    header.dimensions     = (uint32_t)data->dimensions ;
+    header.faceComponents = (data->faceCount > 0) ? (uint32_t)data->faceComponents : 0 ;
+    header.pointCount     = data->pointCount ;
+    header.lineCount      = data->lineCount ;
+    header.faceCount      = data->faceCount ;
+
+    fwrite(&header, sizeof(meshFileHeader), 1, file) ;
+    if (data->pointCount > 0) fwrite(data->points, sizeof(double), data->pointCount * data->dimensions, file) ;
+    if (data->lineCount > 0)  fwrite(data->lines, sizeof(int32_t), data->lineCount * 2, file) ;
+    if (data->faceCount > 0)  fwrite(data->faces, sizeof(int32_t), data->faceCount * data->faceComponents, file) ;
+    return true ;
+}
+
+// writes the mesh to path in the given format, replacing anything there; indicies are assumed to be
+// in range. On failure, error describes the problem and nothing is left at path.
+static bool meshFile_write(const char *path, meshFileFormat format, const meshFileData *data, char *error, size_t errorSize) {
+    if (data->faceCount > 0 && data->faceComponents != 3 && data->faceComponents != 4) {
+        snprintf(error, errorSize, "faces must have 3 or 4 lines, not %zu", data->faceComponents) ;
+        return false ;
+    }
+
+    FILE *file = fopen(path, "wb") ;
+    if (!file) {
+        snprintf(error, errorSize, "unable to open %s: %s", path, strerror(errno)) ;
+        return false ;
+    }
+    char *buffer = malloc(MESHFILE_BUFFER_SIZE) ;
+    if (buffer) setvbuf(file, buffer, _IOFBF, MESHFILE_BUFFER_SIZE) ;
+
+    bool written = false ;
+    switch (format) {
+        case meshFile_obj:    written = meshFile_writeOBJ(file, data, error, errorSize) ;    break ;
+        case meshFile_ply:    written = meshFile_writePLY(file, data, error, errorSize) ;    break ;
+        case meshFile_native: written = meshFile_writeNative(file, data, error, errorSize) ; break ;
+    }
+    if (written && ferror(file)) {
+        snprintf(error, errorSize, "unable to write %s: %s", path, strerror(errno)) ;
+        written = false ;
+    }
+    if (fclose(file) != 0 && written) {
+        snprintf(error, errorSize, "unable to write %s: %s", path, strerror(errno)) ;
+        written = false ;
+    }
+    free(buffer) ;
+    if (!written) remove(path) ;
+    return written ;
+}
+
+#pragma mark - Reading
+
+static inline void meshFile_unmap(meshFileMap *map) {
+    if (map->mapping) munmap(map->mapping, map->size) ;
+    memset(map, 0, sizeof(meshFileMap)) ;
+}
+
+// maps a native format file into memory and points map->data into it; the arrays are only valid
+// until meshFile_unmap. On failure, error describes the problem and map is left empty.
+static bool meshFile_map(const char *path, meshFileMap *map, char *error, size_t errorSize) {
+    memset(map, 0, sizeof(meshFileMap)) ;
+
+    int fd = open(path, O_RDONLY) ;
+    if (fd < 0) {
+        snprintf(error, errorSize, "unable to open %s: %s", path, strerror(errno)) ;
+        return false ;
+    }
+    struct stat info ;
+    if (fstat(fd, &info) != 0) {
+        snprintf(error, errorSize, "unable to read %s: %s", path, strerror(errno)) ;
+        close(fd) ;
+        return false ;
+    }
+    if (info.st_size < (off_t)sizeof(meshFileHeader)) {
+        snprintf(error, errorSize, "%s is not a mesh file", path) ;
+        close(fd) ;
+        return false ;
+    }
+    size_t size    = (size_t)info.st_size ;
+    void   *memory = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) ;
+    close(fd) ;
+    if (memory == MAP_FAILED) {
+        snprintf(error, errorSize, "unable to map %s: %s", path, strerror(errno)) ;
+        return false ;
+    }
+    map->mapping = memory ;
+    map->size    = size ;
+
+    meshFileHeader header ;
+    memcpy(&header, memory, sizeof(meshFileHeader)) ;
+    if (memcmp(header.magic, MESHFILE_MAGIC, sizeof(MESHFILE_MAGIC)) != 0) {
+        snprintf(error, errorSize, "%s is not a mesh file", path) ;
+        meshFile_unmap(map) ;
+        return false ;
+    }
+    if (header.version != MESHFILE_VERSION) {
+        snprintf(error, errorSize, "%s is version %u, which isn't supported", path, header.version) ;
+        meshFile_unmap(map) ;
+        return false ;
+    }
+    if (header.byteOrder != MESHFILE_BYTE_ORDER) {
+        snprintf(error, errorSize, "%s was written on a machine with a different byte order", path) ;
+        meshFile_unmap(map) ;
+        return false ;
+    }
+
+    // each size is checked against what's left of the file before it's multiplied out, so nothing
+    // can overflow
+    size_t remaining = size - sizeof(meshFileHeader) ;
+    size_t pointSize = sizeof(double) * header.dimensions ;
+    size_t faceSize  = sizeof(int32_t) * header.faceComponents ;
+    bool   fits      = header.dimensions > 0 &&
+                       (header.faceCount == 0 || header.faceComponents == 3 || header.faceComponents == 4) &&
+                       header.pointCount <= remaining / pointSize ;
+    if (fits) {
+        remaining -= (size_t)header.pointCount * pointSize ;
+        fits       = header.lineCount <= remaining / (2 * sizeof(int32_t)) ;
+    }
+    if (fits) {
+        remaining -= (size_t)header.lineCount * 2 * sizeof(int32_t) ;
+        fits       = (header.faceCount == 0) ? remaining == 0 :
+                     (remaining % faceSize == 0 && header.faceCount == remaining / faceSize) ;
+    }
+    if (!fits) {
+        snprintf(error, errorSize, "%s is damaged: its header doesn't match its size", path) ;
+        meshFile_unmap(map) ;
+        return false ;
+    }
+
+    const char *bytes = memory ;
+    map->data.dimensions     = header.dimensions ;
+    map->data.pointCount     = (size_t)header.pointCount ;
+    map->data.lineCount      = (size_t)header.lineCount ;
+    map->data.faceCount      = (size_t)header.faceCount ;
+    map->data.faceComponents = (header.faceCount > 0) ? header.faceComponents : 0 ;
+    map->data.points         = (const double *)(const void *)(bytes + sizeof(meshFileHeader)) ;
+    map->data.lines          = (const int32_t *)(const void *)(bytes + sizeof(meshFileHeader) + map->data.pointCount * pointSize) ;
+    map->data.faces          = map->data.lines + map->data.lineCount * 2 ;
+    return true ;
+}
@@ -0,0 +1,117 @@
+// Packed numeric buffers for hs._asm.dimensional
+//
+// A buffer is a run of items with the same number of components each, stored contiguously: points
+// as doubles, indicies (the point numbers of lines, the line numbers of faces) as 32 bit integers.
+// The module's functions read and write these directly, so a mesh kept in buffers goes from one
+// function to the next without being turned into Lua tables and back in between. Indicies are kept
+// as Lua sees them, counting from 1.
+//
+// Plain C, like the rest of the headers in this directory.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    packedBuffer_points,    // double
+    packedBuffer_indicies,  // int32_t
+} packedBufferType ;
+
+typedef struct {
+    packedBufferType type ;
+    size_t           components ;  // values per item
+    size_t           count ;       // items
+    size_t           capacity ;    // items there's room for
+    union {
+        double  *points ;
+        int32_t *indicies ;
+        void    *values ;
+    } data ;
+} packedBuffer ;
+
+#pragma mark - Lifecycle
+
+static inline void packedBuffer_init(packedBuffer *buffer, packedBufferType type, size_t components) {
+    memset(buffer, 0, sizeof(packedBuffer)) ;
+    buffer->type       = type ;
+    buffer->components = components ;
+}
+
+static inline void packedBuffer_free(packedBuffer *buffer) {
+    free(buffer->data.values) ;
+    buffer->data.values = NULL ;
+    buffer->count       = 0 ;
+    buffer->capacity    = 0 ;
+}
+
+static inline size_t packedBuffer_valueSize(const packedBuffer *buffer) {
+    return (buffer->type == packedBuffer_points) ? sizeof(double) : sizeof(int32_t) ;
+}
+
+#pragma mark - Sizing
+
+// makes room for at least count items without changing the count
+static inline bool packedBuffer_reserve(packedBuffer *buffer, size_t count) {
+    if (count <= buffer->capacity) return true ;
+    if (buffer->components == 0) return false ;
+    size_t capacity = (buffer->capacity > 0) ? buffer->capacity : 16 ;
+    while (capacity < count) capacity *= 2 ;
+    if (capacity > SIZE_MAX / (buffer->components * packedBuffer_valueSize(buffer))) return false ;
+
+    void *values = realloc(buffer->data.values, capacity * buffer->components * packedBuffer_valueSize(buffer)) ;
+    if (!values) return false ;
+    buffer->data.values = values ;
+    buffer->capacity    = capacity ;
+    return true ;
+}
+
+// sets the number of items; items added are zeroed, items dropped are forgotten
+static inline bool packedBuffer_resize(packedBuffer *buffer, size_t count) {
+    if (!packedBuffer_reserve(buffer, count)) return false ;
+    if (count > buffer->count) {
+        size_t itemSize = buffer->components * packedBuffer_valueSize(buffer) ;
+        memset((char *)buffer->data.values + buffer->count * itemSize, 0, (count - buffer->count) * itemSize) ;
+    }
+    buffer->count = count ;
+    return true ;
+}
+
+// sets the components and count together; when the components change, what was in the buffer is
+// dropped and every item starts out zeroed
+static inline bool packedBuffer_reshape(packedBuffer *buffer, size_t components, size_t count) {
+    if (components != buffer->components) {
+        packedBuffer_free(buffer) ;
+        buffer->components = components ;
+    }
+    return packedBuffer_resize(buffer, count) ;
+}
+
+// makes buffer an exact copy of source, including its type and components
+static inline bool packedBuffer_copy(packedBuffer *buffer, const packedBuffer *source) {
+    packedBuffer_free(buffer) ;
+    packedBuffer_init(buffer, source->type, source->components) ;
+    if (!packedBuffer_resize(buffer, source->count)) return false ;
+    if (source->count > 0) {
+        memcpy(buffer->data.values, source->data.values, source->count * source->components * packedBuffer_valueSize(source)) ;
+    }
+    return true ;
+}
+
+#pragma mark - Checking
+
+// for indicies: the position of the first value outside 1...maximum, or SIZE_MAX if they're all in
+// range; where allowZero is true, the last component of an item may be 0 (the missing 4th line of
+// a triangle)
+static inline size_t packedBuffer_findOutOfRange(const packedBuffer *buffer, int64_t maximum, bool allowZero) {
+    size_t total = buffer->count * buffer->components ;
+    for (size_t i = 0 ; i < total ; i++) {
+        int32_t value = buffer->data.indicies[i] ;
+        if (value >= 1 && value <= maximum) continue ;
+        if (allowZero && value == 0 && i % buffer->components == buffer->components - 1) continue ;
+        return i ;
+    }
+    return SIZE_MAX ;
+}
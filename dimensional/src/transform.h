@@ -0,0 +1,123 @@
+// Affine transforms of N-D points for hs._asm.dimensional
+//
+// A transform is an (N + 1) x (N + 1) matrix in homogeneous coordinates, so rotations, scales and
+// translations all compose into the one matrix. Each operation is applied after the ones already
+// in it, and only touches the rows it changes: a rotation in the plane of two axes mixes those two
+// rows, a scale multiplies rows, and a translation adds to the last column. Building up a chain of
+// them costs a few passes over the matrix, however many points it's used on.
+//
+// Applying it is one pass over the points: each point is multiplied through the matrix into a
+// scratch row kept with the transform, and from there either copied out or projected straight down
+// with projection_factor, so an animation frame of rotating and then projecting a mesh doesn't
+// write the rotated points anywhere in between.
+//
+// Rotations follow Examples/tesseract.lua: rotating by angle in the plane of axes a and b puts
+// cos(angle) at [a][a] and [b][b], -sin(angle) at [a][b] and sin(angle) at [b][a]. Axes count from
+// 0 here.
+
+#pragma once
+
+#include <math.h>
+
+#include "projection.h"
+
+typedef struct {
+    size_t dimensions ;
+    double *matrix ;   // dimensions + 1 rows of dimensions + 1, the last row always 0, ..., 0, 1
+    double *scratch ;  // one transformed point
+} transformMatrix ;
+
+#pragma mark - Lifecycle
+
+// sets the matrix back to the identity
+static inline void transform_reset(transformMatrix *transform) {
+    size_t n = transform->dimensions + 1 ;
+    memset(transform->matrix, 0, n * n * sizeof(double)) ;
+    for (size_t i = 0 ; i < n ; i++) transform->matrix[i * n + i] = 1.0 ;
+}
+
+// starts out as the identity; returns false if there isn't memory for it
+static inline bool transform_init(transformMatrix *transform, size_t dimensions) {
+    size_t n = dimensions + 1 ;
+    transform->dimensions = dimensions ;
+    transform->matrix     = malloc(n * n * sizeof(double)) ;
+    transform->scratch    = malloc(n * sizeof(double)) ;
+    if (!transform->matrix || !transform->scratch) return false ;
+    transform_reset(transform) ;
+    return true ;
+}
+
+static inline void transform_free(transformMatrix *transform) {
+    free(transform->matrix) ;
+    free(transform->scratch) ;
+    transform->matrix  = NULL ;
+    transform->scratch = NULL ;
+}
+
+#pragma mark - Building
+
+// rotates by angle radians in the plane of axes a and b, which must differ
+static inline void transform_rotate(transformMatrix *transform, size_t a, size_t b, double angle) {
+    size_t n    = transform->dimensions + 1 ;
+    double c    = cos(angle), s = sin(angle) ;
+    double *rowA = &transform->matrix[a * n] ;
+    double *rowB = &transform->matrix[b * n] ;
+    for (size_t k = 0 ; k < n ; k++) {
+        double x = rowA[k], y = rowB[k] ;
+        rowA[k] = c * x - s * y ;
+        rowB[k] = s * x + c * y ;
+    }
+}
+
+// scales each axis by its own factor
+static inline void transform_scale(transformMatrix *transform, const double *factors) {
+    size_t n = transform->dimensions + 1 ;
+    for (size_t i = 0 ; i < transform->dimensions ; i++) {
+        for (size_t k = 0 ; k < n ; k++) transform->matrix[i * n + k] *= factors[i] ;
+    }
+}
+
+static inline void transform_translate(transformMatrix *transform, const double *offsets) {
+    size_t n = transform->dimensions + 1 ;
+    for (size_t i = 0 ; i < transform->dimensions ; i++) transform->matrix[i * n + transform->dimensions] += offsets[i] ;
+}
+
+#pragma mark - Applying
+
+// transforms one point into the scratch row
+static inline void transform_point(const transformMatrix *transform, const double *point) {
+    size_t dimensions = transform->dimensions, n = dimensions + 1 ;
+    for (size_t i = 0 ; i < dimensions ; i++) {
+        const double *row = &transform->matrix[i * n] ;
+        double       sum  = row[dimensions] ;
+        for (size_t k = 0 ; k < dimensions ; k++) sum += row[k] * point[k] ;
+        transform->scratch[i] = sum ;
+    }
+}
+
+// transforms count points of the transform's dimensions into out, which may be points itself
+static inline void transform_apply(const transformMatrix *transform, const double *points, size_t count, double *out) {
+    size_t dimensions = transform->dimensions ;
+    for (size_t i = 0 ; i < count ; i++) {
+        transform_point(transform, &points[i * dimensions]) ;
+        memcpy(&out[i * dimensions], transform->scratch, dimensions * sizeof(double)) ;
+    }
+}
+
+// transforms count points and projects them down to target components, as projection_project
+// would the transformed points, in the same pass; out must not overlap points
+static void transform_project(const transformMatrix *transform,
+                              const double *restrict points,
+                              size_t                 count,
+                              size_t                 target,
+                              double                 eyeDistance,
+                              double                 scale,
+                              double                 offset,
+                              double       *restrict out) {
+    size_t dimensions = transform->dimensions ;
+    for (size_t i = 0 ; i < count ; i++) {
+        transform_point(transform, &points[i * dimensions]) ;
+        double factor = projection_factor(transform->scratch, dimensions, target, eyeDistance, scale, offset) ;
+        for (size_t c = 0 ; c < target ; c++) out[i * target + c] = transform->scratch[c] * factor ;
+    }
+}
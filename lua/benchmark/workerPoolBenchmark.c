@@ -0,0 +1,264 @@
+// Load test for the work-stealing scheduler in ../workerPool.h
+//
+// Queues batches of jobs on pools of 1 worker (what a single hs._asm.lua instance amounts to: one
+// state running one chunk after another) up to 8 and the number of processors, and reports jobs a
+// second, the speedup over 1 worker, how many jobs were stolen and how evenly the work was spread.
+// Three loads are run: jobs that all cost the same; jobs where every 16th batch of 16 costs 50
+// times as much, so whoever picks those up falls behind and has to be stolen from; and jobs that do
+// almost nothing, which measures what the scheduling itself costs.
+//
+// Every job records how many times it ran, and each run is checked to have run every job exactly
+// once. Jobs queued for a particular worker are checked to run there, and cancelling and stopping
+// with jobs still queued are checked to run or discard each of them exactly once.
+//
+//     make
+//     ./workerPoolBenchmark
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "workerPool.h"
+
+static double now(void) {
+    struct timespec ts ;
+    clock_gettime(CLOCK_MONOTONIC, &ts) ;
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9 ;
+}
+
+static void *allocate(size_t size) {
+    void *memory = calloc(1, size > 0 ? size : 1) ;
+    if (!memory) {
+        fprintf(stderr, "out of memory\n") ;
+        exit(1) ;
+    }
+    return memory ;
+}
+
+typedef struct {
+    uint64_t      iterations ;  // how much work the job does
+    uint64_t      result ;
+    size_t        worker ;      // where it ran, or where it has to run if it was queued for a worker
+    atomic_size_t runs ;
+    atomic_size_t discards ;
+} job ;
+
+// busy work that can't be optimized away
+static uint64_t spin(uint64_t iterations) {
+    uint64_t state = 0x9e3779b97f4a7c15ULL ^ iterations ;
+    for (uint64_t i = 0 ; i < iterations ; i++) {
+        state ^= state << 13 ;
+        state ^= state >> 7 ;
+        state ^= state << 17 ;
+    }
+    return state ;
+}
+
+static void runJob(void *item, size_t worker, void *data) {
+    (void)data ;
+    job *j = item ;
+    j->result = spin(j->iterations) ;
+    j->worker = worker ;
+    atomic_fetch_add_explicit(&j->runs, 1, memory_order_relaxed) ;
+}
+
+static void discardJob(void *item, size_t worker, void *data) {
+    (void)worker ;
+    (void)data ;
+    job *j = item ;
+    atomic_fetch_add_explicit(&j->discards, 1, memory_order_relaxed) ;
+}
+
+static void resetJobs(job *jobs, size_t count) {
+    for (size_t i = 0 ; i < count ; i++) {
+        atomic_store(&jobs[i].runs, 0) ;
+        atomic_store(&jobs[i].discards, 0) ;
+    }
+}
+
+static bool submitAll(workerPool *pool, job *jobs, size_t count) {
+    for (size_t i = 0 ; i < count ; i++) {
+        if (!workerPool_submit(pool, &jobs[i])) return false ;
+    }
+    return true ;
+}
+
+#pragma mark - Loads
+
+typedef struct {
+    const char *name ;
+    size_t     count ;
+    uint64_t   iterations ;
+    uint64_t   heavy ;  // iterations for every 16th batch of 16, or 0 for none
+} load ;
+
+static const load loads[] = {
+    { "uniform", 4000,   4000, 0 },
+    { "skewed",  4000,   1000, 50000 },
+    { "tiny",    100000, 0,    0 },
+} ;
+
+typedef struct {
+    double jobsPerSecond ;
+    size_t stolen ;
+    size_t fewest ;  // jobs completed by the least and most busy workers
+    size_t most ;
+    bool   ok ;
+} loadResult ;
+
+static loadResult runLoad(const load *l, size_t workers) {
+    loadResult result = { 0.0, 0, SIZE_MAX, 0, true } ;
+    job        *jobs  = allocate(l->count * sizeof(job)) ;
+    for (size_t i = 0 ; i < l->count ; i++) jobs[i].iterations = (l->heavy > 0 && (i / 16) % 16 == 0) ? l->heavy : l->iterations ;
+
+    workerPool pool ;
+    if (!workerPool_start(&pool, workers, runJob, NULL)) {
+        fprintf(stderr, "unable to start %zu workers\n", workers) ;
+        exit(1) ;
+    }
+
+    size_t repeats = 0 ;
+    double start   = now(), elapsed = 0.0 ;
+    do {
+        resetJobs(jobs, l->count) ;
+        if (!submitAll(&pool, jobs, l->count)) {
+            fprintf(stderr, "out of memory\n") ;
+            exit(1) ;
+        }
+        workerPool_wait(&pool) ;
+        for (size_t i = 0 ; i < l->count ; i++) result.ok = result.ok && atomic_load(&jobs[i].runs) == 1 ;
+        repeats++ ;
+        elapsed = now() - start ;
+    } while (elapsed < 0.2) ;
+
+    size_t completed = 0 ;
+    for (size_t w = 0 ; w < workers ; w++) {
+        size_t done = atomic_load(&pool.workers[w].completed) ;
+        completed += done ;
+        result.stolen += atomic_load(&pool.workers[w].stolen) ;
+        if (done < result.fewest) result.fewest = done ;
+        if (done > result.most) result.most = done ;
+    }
+    result.ok            = result.ok && completed == l->count * repeats && workerPool_outstanding(&pool) == 0 ;
+    result.jobsPerSecond = (double)(l->count * repeats) / elapsed ;
+    result.stolen        = result.stolen / repeats ;
+    result.fewest        = result.fewest / repeats ;
+    result.most          = result.most / repeats ;
+
+    workerPool_stop(&pool, NULL) ;
+    free(jobs) ;
+    return result ;
+}
+
+#pragma mark - Checks
+
+// jobs queued for each worker in turn run there and nowhere else
+static bool checkPinned(size_t workers) {
+    size_t     count = workers * 64 ;
+    job        *jobs = allocate(count * 2 * sizeof(job)) ;
+    workerPool pool ;
+    if (!workerPool_start(&pool, workers, runJob, NULL)) return false ;
+
+    // with as many for anyone, to give the workers something to steal from each other
+    bool ok = true ;
+    for (size_t i = 0 ; i < count ; i++) {
+        jobs[i].iterations         = 500 ;
+        jobs[count + i].iterations = 500 ;
+        ok = ok && workerPool_submitTo(&pool, i % workers, &jobs[i]) && workerPool_submit(&pool, &jobs[count + i]) ;
+    }
+    workerPool_wait(&pool) ;
+    for (size_t i = 0 ; i < count * 2 ; i++) ok = ok && atomic_load(&jobs[i].runs) == 1 ;
+    for (size_t i = 0 ; i < count ; i++) ok = ok && jobs[i].worker == i % workers ;
+    ok = ok && !workerPool_submitTo(&pool, workers, &jobs[0]) && !workerPool_submit(&pool, NULL) ;
+
+    workerPool_stop(&pool, NULL) ;
+    free(jobs) ;
+    return ok ;
+}
+
+// with slow jobs queued, cancelling (or stopping) runs or discards each exactly once
+static bool checkCancel(size_t workers, bool stop) {
+    size_t     count = 2000 ;
+    job        *jobs = allocate(count * sizeof(job)) ;
+    workerPool pool ;
+    if (!workerPool_start(&pool, workers, runJob, NULL)) return false ;
+
+    bool ok = true ;
+    for (size_t i = 0 ; i < count ; i++) {
+        jobs[i].iterations = 20000 ;
+        ok = ok && ((i % 3 == 0) ? workerPool_submitTo(&pool, i % workers, &jobs[i]) : workerPool_submit(&pool, &jobs[i])) ;
+    }
+    // let the workers get going, so some jobs have run, some are running and some have been stolen
+    struct timespec pause = { 0, 2000000 } ;
+    nanosleep(&pause, NULL) ;
+
+    size_t cancelled = 0 ;
+    if (stop) {
+        workerPool_stop(&pool, discardJob) ;
+    } else {
+        cancelled = workerPool_cancel(&pool, discardJob) ;
+        workerPool_wait(&pool) ;
+    }
+
+    size_t ran = 0, discarded = 0 ;
+    for (size_t i = 0 ; i < count ; i++) {
+        size_t runs = atomic_load(&jobs[i].runs), discards = atomic_load(&jobs[i].discards) ;
+        ok         = ok && runs + discards == 1 ;
+        ran       += runs ;
+        discarded += discards ;
+    }
+    if (!stop) {
+        ok = ok && cancelled == discarded && workerPool_outstanding(&pool) == 0 ;
+        // the pool carries on after cancelling
+        resetJobs(jobs, count) ;
+        ok = ok && submitAll(&pool, jobs, 100) ;
+        workerPool_wait(&pool) ;
+        for (size_t i = 0 ; i < 100 ; i++) ok = ok && atomic_load(&jobs[i].runs) == 1 ;
+        workerPool_stop(&pool, discardJob) ;
+    }
+    printf("%-8s %3zu workers: %5zu ran, %5zu discarded\n", stop ? "stop" : "cancel", workers, ran, discarded) ;
+    free(jobs) ;
+    return ok ;
+}
+
+#pragma mark - Main
+
+int main(void) {
+    size_t sizes[6]   = { 1, 2, 4, 8 } ;
+    size_t sizeCount  = 4 ;
+    long   processors = sysconf(_SC_NPROCESSORS_ONLN) ;
+    if (processors > 8) sizes[sizeCount++] = (size_t)processors ;
+    bool   allOk      = true ;
+
+    printf("%zu processors\n\n", (size_t)(processors > 0 ? processors : 1)) ;
+    printf("%-8s %8s %8s %14s %9s %8s %16s\n", "load", "workers", "jobs", "jobs/s", "speedup", "stolen", "fewest / most") ;
+
+    for (size_t l = 0 ; l < sizeof(loads) / sizeof(load) ; l++) {
+        double single = 0.0 ;
+        for (size_t s = 0 ; s < sizeCount ; s++) {
+            loadResult result = runLoad(&loads[l], sizes[s]) ;
+            if (s == 0) single = result.jobsPerSecond ;
+            allOk = allOk && result.ok ;
+
+            char spread[32] ;
+            snprintf(spread, sizeof(spread), "%zu / %zu", result.fewest, result.most) ;
+            printf("%-8s %8zu %8zu %14.0f %8.2fx %8zu %16s%s\n", loads[l].name, sizes[s], loads[l].count, result.jobsPerSecond,
+                   result.jobsPerSecond / single, result.stolen, spread, result.ok ? "" : "  WRONG") ;
+        }
+    }
+
+    printf("\n") ;
+    for (size_t s = 1 ; s < sizeCount ; s++) {
+        bool pinned = checkPinned(sizes[s]) ;
+        if (!pinned) printf("pinned   %3zu workers: WRONG\n", sizes[s]) ;
+        allOk = allOk && pinned && checkCancel(sizes[s], false) && checkCancel(sizes[s], true) ;
+    }
+
+    if (!allOk) {
+        fprintf(stderr, "jobs were lost, repeated or run in the wrong place\n") ;
+        return 1 ;
+    }
+    return 0 ;
+}
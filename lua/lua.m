@@ -21,7 +21,10 @@
 @import Cocoa ;
 @import LuaSkin ;
 
+#import "workerPool.h"
+
 static const char * const USERDATA_TAG = "hs._asm.lua" ;
+static const char * const POOL_TAG     = "hs._asm.lua.pool" ;
 
 static NSMutableDictionary *refTable = nil ;
 
@@ -35,6 +38,8 @@ static dispatch_queue_t lua_queue ;
 
 static int pushASMLuaInstance(lua_State *L, id obj) ;
 static id  toASMLuaInstanceFromLua(lua_State *L, int idx) ;
+static int pushASMLuaPool(lua_State *L, id obj) ;
+static id  toASMLuaPoolFromLua(lua_State *L, int idx) ;
 
 static int msghandler (lua_State *L) {
   const char *msg = lua_tostring(L, 1);
@@ -50,6 +55,63 @@ static int msghandler (lua_State *L) {
   return 1;  /* return the traceback */
 }
 
+// runs cmd in L and collects what it returned, or the error, for a callback
+static NSMutableDictionary *runCommand(lua_State *L, NSData *cmd) {
+    NSMutableDictionary *results = [NSMutableDictionary dictionary] ;
+
+    int status = luaL_loadbuffer (L, cmd.bytes, cmd.length, "=hammerspoon") ;
+
+    if (status == LUA_OK) {
+        int base = lua_gettop(L) ;
+        lua_pushcfunction(L, msghandler) ;
+        lua_insert(L, base) ;
+        status = lua_pcall(L, 0, LUA_MULTRET, base) ;
+        lua_remove(L, base) ;  /* remove message handler from the stack */
+
+        if (status == LUA_OK) {
+            NSMutableArray *stack = [NSMutableArray array] ;
+
+            while(lua_gettop(L) > 0) {
+                switch(lua_type(L, -1)) {
+                    case LUA_TNIL:
+                        [stack addObject:[NSNull null]] ;
+                        break ;
+                    case LUA_TNUMBER:
+                        [stack addObject:(lua_isinteger(L, -1) ? @(lua_tointeger(L, -1)) : @(lua_tonumber(L, -1)))] ;
+                        break ;
+                    case LUA_TBOOLEAN:
+                        [stack addObject:(lua_toboolean(L, -1) ? @(YES) : @(NO))] ;
+                        break ;
+                    case LUA_TFUNCTION:
+                    case LUA_TTABLE:
+                    case LUA_TUSERDATA:
+                    case LUA_TTHREAD:
+                    case LUA_TLIGHTUSERDATA:
+                    case LUA_TSTRING: {
+                        size_t size ;
+                        const char *junk = luaL_tolstring(L, -1, &size) ;
+                        [stack addObject:[NSData dataWithBytes:(const void *)junk length:size]] ;
+                        lua_pop(L, 1) ; // pop luaL_tolstring result from stack
+                        break ;
+                    }
+                }
+                lua_pop(L, 1) ;
+            }
+
+            results[@"stack"] = stack ;
+        } else {
+            results[@"error"] = [NSString stringWithFormat:@"%s", lua_tostring(L, -1)] ;
+            lua_pop(L, 1) ;
+        }
+    } else {
+        results[@"error"] = [NSString stringWithFormat:@"%s", lua_tostring(L, -1)] ;
+        lua_pop(L, 1) ;
+    }
+
+    results[@"status"] = @(status) ;
+    return results ;
+}
+
 @interface ASMLuaInstance : NSObject
 @property            int            selfRefCount ;
 @property            int            callbackRef ;
@@ -103,58 +165,7 @@ static int msghandler (lua_State *L) {
     if (cmd) {
         [_queuedCommands removeObjectAtIndex:0] ;
         dispatch_async(lua_queue, ^{
-            NSMutableDictionary *results = [NSMutableDictionary dictionary] ;
-
-            int status = luaL_loadbuffer (self->_L, cmd.bytes, cmd.length, "=hammerspoon") ;
-
-            if (status == LUA_OK) {
-                int base = lua_gettop(self->_L) ;
-                lua_pushcfunction(self->_L, msghandler) ;
-                lua_insert(self->_L, base) ;
-                status = lua_pcall(self->_L, 0, LUA_MULTRET, base) ;
-                lua_remove(self->_L, base) ;  /* remove message handler from the stack */
-
-                if (status == LUA_OK) {
-                    NSMutableArray *stack = [NSMutableArray array] ;
-
-                    while(lua_gettop(self->_L) > 0) {
-                        switch(lua_type(self->_L, -1)) {
-                            case LUA_TNIL:
-                                [stack addObject:[NSNull null]] ;
-                                break ;
-                            case LUA_TNUMBER:
-                                [stack addObject:(lua_isinteger(self->_L, -1) ? @(lua_tointeger(self->_L, -1)) : @(lua_tonumber(self->_L, -1)))] ;
-                                break ;
-                            case LUA_TBOOLEAN:
-                                [stack addObject:(lua_toboolean(self->_L, -1) ? @(YES) : @(NO))] ;
-                                break ;
-                            case LUA_TFUNCTION:
-                            case LUA_TTABLE:
-                            case LUA_TUSERDATA:
-                            case LUA_TTHREAD:
-                            case LUA_TLIGHTUSERDATA:
-                            case LUA_TSTRING: {
-                                size_t size ;
-                                const char *junk = luaL_tolstring(self->_L, -1, &size) ;
-                                [stack addObject:[NSData dataWithBytes:(const void *)junk length:size]] ;
-                                lua_pop(self->_L, 1) ; // pop luaL_tolstring result from stack
-                                break ;
-                            }
-                        }
-                        lua_pop(self->_L, 1) ;
-                    }
-
-                    results[@"stack"] = stack ;
-                } else {
-                    results[@"error"] = [NSString stringWithFormat:@"%s", lua_tostring(self->_L, -1)] ;
-                    lua_pop(self->_L, 1) ;
-                }
-            } else {
-                results[@"error"] = [NSString stringWithFormat:@"%s", lua_tostring(self->_L, -1)] ;
-                lua_pop(self->_L, 1) ;
-            }
-
-            results[@"status"] = @(status) ;
+            NSMutableDictionary *results = runCommand(self->_L, cmd) ;
 
             // invoke callback
             dispatch_sync(dispatch_get_main_queue(), ^{
@@ -198,6 +209,212 @@ static int msghandler (lua_State *L) {
 
 @end
 
+// a chunk queued on a pool; jobs are numbered from 1 in the order they're queued, with a chunk
+// broadcast to every worker being one job
+@interface ASMLuaPoolJob : NSObject
+@property (readonly) NSData     *command ;
+@property (readonly) NSUInteger number ;
+@end
+
+@implementation ASMLuaPoolJob
+- (instancetype)initWithCommand:(NSData *)command number:(NSUInteger)number {
+    self = [super init] ;
+    if (self) {
+        _command = command ;
+        _number  = number ;
+    }
+    return self ;
+}
+@end
+
+// kept in each worker's lua_State extra space, for the interrupt hook
+typedef struct {
+    atomic_size_t       current ;             // the job the worker is running
+    const atomic_size_t *interruptedThrough ; // the pool's; jobs numbered up to this are to stop
+} poolWorkerState ;
+
+// how many VM instructions run between checks for an interrupt
+#define POOL_HOOK_COUNT 1000
+
+static void poolInterruptHook(lua_State *L, lua_Debug * __unused ar) {
+    poolWorkerState *state = *(poolWorkerState **)lua_getextraspace(L) ;
+    if (atomic_load_explicit(&state->current, memory_order_relaxed) <=
+        atomic_load_explicit(state->interruptedThrough, memory_order_relaxed)) {
+        luaL_error(L, "interrupted") ;
+    }
+}
+
+// A pool of independent lua_States, each on its own worker thread, sharing one queue of chunks;
+// see workerPool.h for how the workers share the work out
+@interface ASMLuaPool : NSObject
+@property            int        selfRefCount ;
+@property            int        callbackRef ;
+
+@property (readonly) NSUInteger size ;
+@property (readonly) NSUInteger submitted ;
+@end
+
+static void poolRunJob(void *job, size_t worker, void *data) ;
+static void poolDiscardJob(void *job, size_t worker, void *data) ;
+
+@implementation ASMLuaPool {
+    workerPool      _pool ;
+    BOOL            _running ;
+    lua_State       **_states ;
+    poolWorkerState *_workerStates ;
+    atomic_size_t   _interruptedThrough ;
+}
+
+- (instancetype)initWithSize:(NSUInteger)size callbackRef:(int)callbackRef {
+    self = [super init] ;
+    if (self) {
+        _selfRefCount = 0 ;
+        _callbackRef  = callbackRef ;
+        _size         = size ;
+        _submitted    = 0 ;
+        _running      = NO ;
+        _states       = calloc(size, sizeof(lua_State *)) ;
+        _workerStates = calloc(size, sizeof(poolWorkerState)) ;
+        atomic_init(&_interruptedThrough, 0) ;
+
+        BOOL ready = (_states && _workerStates) ;
+        for (NSUInteger i = 0 ; ready && i < size ; i++) {
+            _states[i] = luaL_newstate() ;
+            ready      = (_states[i] != NULL) ;
+            if (ready) {
+                luaL_openlibs(_states[i]) ;
+                atomic_init(&_workerStates[i].current, 0) ;
+                _workerStates[i].interruptedThrough = &_interruptedThrough ;
+                *(poolWorkerState **)lua_getextraspace(_states[i]) = &_workerStates[i] ;
+                lua_sethook(_states[i], poolInterruptHook, LUA_MASKCOUNT, POOL_HOOK_COUNT) ;
+            }
+        }
+        if (ready) _running = workerPool_start(&_pool, size, poolRunJob, (__bridge void *)self) ;
+        if (!_running) {
+            [self close] ;
+            return nil ;
+        }
+    }
+    return self ;
+}
+
+- (void)dealloc {
+    [self close] ;
+}
+
+- (BOOL)isActive {
+    return _running && workerPool_outstanding(&_pool) > 0 ;
+}
+
+- (NSUInteger)pending {
+    return _running ? workerPool_outstanding(&_pool) : 0 ;
+}
+
+// queues cmd for any worker; returns its job number, or 0 if it couldn't be queued
+- (NSUInteger)enqueue:(NSData *)cmd {
+    if (!_running) return 0 ;
+    NSUInteger number = _submitted + 1 ;
+    void       *job   = (__bridge_retained void *)[[ASMLuaPoolJob alloc] initWithCommand:cmd number:number] ;
+    if (!workerPool_submit(&_pool, job)) {
+        poolDiscardJob(job, SIZE_MAX, NULL) ;
+        return 0 ;
+    }
+    _submitted = number ;
+    return number ;
+}
+
+// queues cmd for every worker, each running it in its own state; returns NO if it couldn't be
+// queued for all of them
+- (BOOL)broadcast:(NSData *)cmd {
+    if (!_running) return NO ;
+    _submitted++ ;
+    BOOL queued = YES ;
+    for (NSUInteger i = 0 ; i < _size ; i++) {
+        void *job = (__bridge_retained void *)[[ASMLuaPoolJob alloc] initWithCommand:cmd number:_submitted] ;
+        if (!workerPool_submitTo(&_pool, i, job)) {
+            poolDiscardJob(job, i, NULL) ;
+            queued = NO ;
+        }
+    }
+    return queued ;
+}
+
+// drops the jobs still queued and stops the ones running at their next check for an interrupt
+- (void)interrupt {
+    if (!_running) return ;
+    atomic_store_explicit(&_interruptedThrough, _submitted, memory_order_relaxed) ;
+    workerPool_cancel(&_pool, poolDiscardJob) ;
+}
+
+- (NSArray *)statistics {
+    NSMutableArray *stats = [NSMutableArray arrayWithCapacity:_size] ;
+    for (NSUInteger i = 0 ; _running && i < _size ; i++) {
+        [stats addObject:@{
+            @"completed" : @(atomic_load_explicit(&_pool.workers[i].completed, memory_order_relaxed)),
+            @"stolen"    : @(atomic_load_explicit(&_pool.workers[i].stolen, memory_order_relaxed)),
+        }] ;
+    }
+    return stats ;
+}
+
+// runs on the worker's thread
+- (NSMutableDictionary *)runJob:(ASMLuaPoolJob *)job onWorker:(size_t)worker {
+    atomic_store_explicit(&_workerStates[worker].current, job.number, memory_order_relaxed) ;
+    NSMutableDictionary *results = runCommand(_states[worker], job.command) ;
+    results[@"worker"] = @(worker + 1) ;
+    results[@"job"]    = @(job.number) ;
+    return results ;
+}
+
+- (void)deliverResults:(NSDictionary *)results {
+    LuaSkin *skin = [LuaSkin sharedWithState:NULL] ;
+    if (_callbackRef != LUA_NOREF) {
+        [skin pushLuaRef:refTable ref:_callbackRef] ;
+        [skin pushNSObject:results] ;
+        if (![skin protectedCallAndTraceback:1 nresults:0]) {
+            [skin logError:[NSString stringWithFormat:@"%s:callback error: %s", POOL_TAG, lua_tostring(skin.L, -1)]] ;
+            lua_pop(skin.L, 1) ;
+        }
+    }
+}
+
+// stops the workers, interrupting whatever they're running, and closes their states
+- (void)close {
+    if (_running) {
+        atomic_store_explicit(&_interruptedThrough, SIZE_MAX, memory_order_relaxed) ;
+        workerPool_stop(&_pool, poolDiscardJob) ;
+        _running = NO ;
+    }
+    for (NSUInteger i = 0 ; _states && i < _size ; i++) {
+        if (_states[i]) lua_close(_states[i]) ;
+    }
+    free(_states) ;
+    free(_workerStates) ;
+    _states       = NULL ;
+    _workerStates = NULL ;
+}
+
+@end
+
+static void poolRunJob(void *job, size_t worker, void *data) {
+    @autoreleasepool {
+        ASMLuaPoolJob       *poolJob = (__bridge_transfer ASMLuaPoolJob *)job ;
+        ASMLuaPool          *pool    = (__bridge ASMLuaPool *)data ;
+        NSMutableDictionary *results = [pool runJob:poolJob onWorker:worker] ;
+
+        // async, unlike ASMLuaInstance, so closing the pool on the main thread can wait for the
+        // workers without them waiting for it
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [pool deliverResults:results] ;
+        }) ;
+    }
+}
+
+static void poolDiscardJob(void *job, size_t __unused worker, void * __unused data) {
+    // takes back the reference the job was queued with, releasing it
+    (void)(__bridge_transfer ASMLuaPoolJob *)job ;
+}
+
 #pragma mark - Module Functions
 
 static int asm_lua_new(lua_State *L) {
@@ -215,6 +432,30 @@ static int asm_lua_new(lua_State *L) {
     return 1 ;
 }
 
+// newPool(callback, [size]) - size defaults to the number of active processors; the callback gets
+// the same results as an instance's, plus the worker that ran the chunk and its job number
+static int asm_lua_newPool(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TFUNCTION | LS_TNIL, LS_TNUMBER | LS_TINTEGER | LS_TOPTIONAL, LS_TBREAK] ;
+
+    lua_Integer size = (lua_gettop(L) > 1) ? lua_tointeger(L, 2) : (lua_Integer)NSProcessInfo.processInfo.activeProcessorCount ;
+    if (size < 1 || size > 256) return luaL_argerror(L, 2, "expected integer between 1 and 256 inclusive") ;
+
+    int callbackRef = LUA_NOREF ;
+    if (!lua_isnil(L, 1)) {
+        lua_pushvalue(L, 1) ;
+        callbackRef = [skin luaRef:refTable] ;
+    }
+
+    ASMLuaPool *obj = [[ASMLuaPool alloc] initWithSize:(NSUInteger)size callbackRef:callbackRef] ;
+    if (!obj) {
+        if (callbackRef != LUA_NOREF) [skin luaUnref:refTable ref:callbackRef] ;
+        return luaL_error(L, "unable to start %d workers", (int)size) ;
+    }
+    [skin pushNSObject:obj] ;
+    return 1 ;
+}
+
 static int asm_lua_onMainThread(lua_State *L) {
     lua_pushboolean(L, NSThread.isMainThread) ;
     return 1 ;
@@ -300,6 +541,95 @@ static int asm_lua_refCount(lua_State *L) {
     return 1 ;
 }
 
+#pragma mark - Pool Methods
+
+static int pool_enqueue(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, POOL_TAG, LS_TSTRING, LS_TBREAK] ;
+    ASMLuaPool *obj = get_objectFromUserdata(__bridge ASMLuaPool, L, 1, POOL_TAG) ;
+    NSData     *cmd = [skin toNSObjectAtIndex:2 withOptions:LS_NSLuaStringAsDataOnly] ;
+    if ([obj enqueue:cmd] == 0) return luaL_error(L, "unable to queue chunk") ;
+
+    lua_pushvalue(L, 1) ;
+    return 1 ;
+}
+
+static int pool_broadcast(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, POOL_TAG, LS_TSTRING, LS_TBREAK] ;
+    ASMLuaPool *obj = get_objectFromUserdata(__bridge ASMLuaPool, L, 1, POOL_TAG) ;
+    NSData     *cmd = [skin toNSObjectAtIndex:2 withOptions:LS_NSLuaStringAsDataOnly] ;
+    if (![obj broadcast:cmd]) return luaL_error(L, "unable to queue chunk for every worker") ;
+
+    lua_pushvalue(L, 1) ;
+    return 1 ;
+}
+
+static int pool_isActive(lua_State *L) {
+    if (lua_gettop(L) != 1) return luaL_error(L, "no arguments expected") ;
+    ASMLuaPool *obj = get_objectFromUserdata(__bridge ASMLuaPool, L, 1, POOL_TAG) ;
+
+    lua_pushboolean(L, (obj.isActive)) ;
+    return 1 ;
+}
+
+static int pool_pending(lua_State *L) {
+    if (lua_gettop(L) != 1) return luaL_error(L, "no arguments expected") ;
+    ASMLuaPool *obj = get_objectFromUserdata(__bridge ASMLuaPool, L, 1, POOL_TAG) ;
+
+    lua_pushinteger(L, (lua_Integer)obj.pending) ;
+    return 1 ;
+}
+
+static int pool_size(lua_State *L) {
+    if (lua_gettop(L) != 1) return luaL_error(L, "no arguments expected") ;
+    ASMLuaPool *obj = get_objectFromUserdata(__bridge ASMLuaPool, L, 1, POOL_TAG) ;
+
+    lua_pushinteger(L, (lua_Integer)obj.size) ;
+    return 1 ;
+}
+
+static int pool_statistics(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    if (lua_gettop(L) != 1) return luaL_error(L, "no arguments expected") ;
+    ASMLuaPool *obj = get_objectFromUserdata(__bridge ASMLuaPool, L, 1, POOL_TAG) ;
+
+    [skin pushNSObject:obj.statistics] ;
+    return 1 ;
+}
+
+static int pool_callback(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, POOL_TAG, LS_TFUNCTION | LS_TNIL | LS_TOPTIONAL, LS_TBREAK] ;
+    ASMLuaPool *obj = get_objectFromUserdata(__bridge ASMLuaPool, L, 1, POOL_TAG) ;
+
+    if (lua_gettop(L) == 1) {
+        if (obj.callbackRef != LUA_NOREF) {
+            [skin pushLuaRef:refTable ref:obj.callbackRef] ;
+        } else {
+            lua_pushnil(L) ;
+        }
+    } else {
+        obj.callbackRef = [skin luaUnref:refTable ref:obj.callbackRef] ;
+        if (!lua_isnil(L, 2)) {
+            lua_pushvalue(L, 2) ;
+            obj.callbackRef = [skin luaRef:refTable] ;
+        }
+        lua_pushvalue(L, 1) ;
+    }
+    return 1 ;
+}
+
+static int pool_break(lua_State *L) {
+    if (lua_gettop(L) != 1) return luaL_error(L, "no arguments expected") ;
+    ASMLuaPool *obj = get_objectFromUserdata(__bridge ASMLuaPool, L, 1, POOL_TAG) ;
+
+    [obj interrupt] ;
+
+    lua_pushvalue(L, 1) ;
+    return 1 ;
+}
+
 #pragma mark - Module Constants
 
 #pragma mark - Lua<->NSObject Conversion Functions
@@ -328,6 +658,28 @@ static id toASMLuaInstanceFromLua(lua_State *L, int idx) {
     return value ;
 }
 
+static int pushASMLuaPool(lua_State *L, id obj) {
+    ASMLuaPool *value = obj;
+    value.selfRefCount++ ;
+    void** valuePtr = lua_newuserdata(L, sizeof(ASMLuaPool *));
+    *valuePtr = (__bridge_retained void *)value;
+    luaL_getmetatable(L, POOL_TAG);
+    lua_setmetatable(L, -2);
+
+    return 1;
+}
+
+static id toASMLuaPoolFromLua(lua_State *L, int idx) {
+    ASMLuaPool *value ;
+    if (luaL_testudata(L, idx, POOL_TAG)) {
+        value = get_objectFromUserdata(__bridge ASMLuaPool, L, idx, POOL_TAG) ;
+    } else {
+        [LuaSkin logError:[NSString stringWithFormat:@"expected %s object, found %s", POOL_TAG,
+                                                      lua_typename(L, lua_type(L, idx))]] ;
+    }
+    return value ;
+}
+
 #pragma mark - Hammerspoon/Lua Infrastructure
 
 static int userdata_tostring(lua_State* L) {
@@ -373,6 +725,44 @@ static int userdata_gc(lua_State* L) {
     return 0 ;
 }
 
+static int pool_tostring(lua_State* L) {
+    ASMLuaPool *obj = get_objectFromUserdata(__bridge ASMLuaPool, L, 1, POOL_TAG) ;
+    NSString *title = [NSString stringWithFormat:@"%lu workers, %lu pending", obj.size, obj.pending] ;
+    lua_pushstring(L, [[NSString stringWithFormat:@"%s: %@ (%p)", POOL_TAG, title, lua_topointer(L, 1)] UTF8String]) ;
+    return 1 ;
+}
+
+static int pool_eq(lua_State* L) {
+    if (luaL_testudata(L, 1, POOL_TAG) && luaL_testudata(L, 2, POOL_TAG)) {
+        ASMLuaPool *obj1 = get_objectFromUserdata(__bridge ASMLuaPool, L, 1, POOL_TAG) ;
+        ASMLuaPool *obj2 = get_objectFromUserdata(__bridge ASMLuaPool, L, 2, POOL_TAG) ;
+        lua_pushboolean(L, [obj1 isEqualTo:obj2]) ;
+    } else {
+        lua_pushboolean(L, NO) ;
+    }
+    return 1 ;
+}
+
+static int pool_gc(lua_State* L) {
+    ASMLuaPool *obj = get_objectFromUserdata(__bridge_transfer ASMLuaPool, L, 1, POOL_TAG) ;
+    if (obj) {
+        obj.selfRefCount-- ;
+        if (obj.selfRefCount == 0) {
+            if (obj.callbackRef != LUA_NOREF) {
+                lua_rawgeti(L, LUA_REGISTRYINDEX, refTable[@(L)]) ;
+                luaL_unref(L, -1, obj.callbackRef) ;
+                lua_remove(L, -1) ;
+                obj.callbackRef = LUA_NOREF ;
+            }
+            [obj close] ;
+            obj = nil ;
+        }
+    }
+    lua_pushnil(L) ;
+    lua_setmetatable(L, 1) ;
+    return 0 ;
+}
+
 static int meta_gc(lua_State* __unused L) {
     refTable[@(L)] = nil ;
     return 0 ;
@@ -395,9 +785,27 @@ static const luaL_Reg userdata_metaLib[] = {
     {NULL,         NULL}
 };
 
+// Metatable for pool objects
+static const luaL_Reg pool_metaLib[] = {
+    {"enqueue",    pool_enqueue},
+    {"broadcast",  pool_broadcast},
+    {"isActive",   pool_isActive},
+    {"pending",    pool_pending},
+    {"size",       pool_size},
+    {"statistics", pool_statistics},
+    {"callback",   pool_callback},
+    {"break",      pool_break},
+
+    {"__tostring", pool_tostring},
+    {"__eq",       pool_eq},
+    {"__gc",       pool_gc},
+    {NULL,         NULL}
+};
+
 // Functions for returned object when module loads
 static luaL_Reg moduleLib[] = {
     {"new",          asm_lua_new},
+    {"newPool",      asm_lua_newPool},
     {"onMainThread", asm_lua_onMainThread},
 
     {NULL, NULL}
@@ -457,6 +865,15 @@ int luaopen_hs__asm_lua_lua(lua_State* L) {
     lua_setfield(L, -2, "__name") ;
     lua_setfield(L, LUA_REGISTRYINDEX, USERDATA_TAG) ;
 
+    luaL_newlib(L, pool_metaLib) ;
+    lua_pushvalue(L, -1) ;
+    lua_setfield(L, -2, "__index") ;
+    lua_pushstring(L, POOL_TAG) ;
+    lua_setfield(L, -2, "__type") ;
+    lua_pushstring(L, POOL_TAG) ;
+    lua_setfield(L, -2, "__name") ;
+    lua_setfield(L, LUA_REGISTRYINDEX, POOL_TAG) ;
+
     luaL_newlib(L, moduleLib) ;
     if (module_metaLib != NULL) {
         luaL_newlib(L, module_metaLib) ;
@@ -479,6 +896,9 @@ int luaopen_hs__asm_lua_lua(lua_State* L) {
             [skin registerPushNSHelper:pushASMLuaInstance         forClass:"ASMLuaInstance"] ;
             [skin registerLuaObjectHelper:toASMLuaInstanceFromLua forClass:"ASMLuaInstance"
                                                        withUserdataMapping:USERDATA_TAG] ;
+            [skin registerPushNSHelper:pushASMLuaPool             forClass:"ASMLuaPool"] ;
+            [skin registerLuaObjectHelper:toASMLuaPoolFromLua     forClass:"ASMLuaPool"
+                                                       withUserdataMapping:POOL_TAG] ;
         }
     }
 
@@ -0,0 +1,372 @@
+// Work-stealing pool of worker threads for hs._asm.lua
+//
+// Each worker is a pthread with its own queue of jobs. Jobs are queued on a shared queue; a worker
+// with nothing of its own to do takes a share of the shared queue (an even split between the
+// workers, so a burst of jobs is spread out as it's picked up), and when that's empty too, steals
+// the newer half of another worker's queue. A worker only sleeps when there is nothing queued
+// anywhere that it could run. Jobs can also be queued for one particular worker, for things that
+// have to happen on every worker's state; those are never stolen.
+//
+// A job is an opaque, non-NULL pointer, passed with the worker's number to the pool's run function
+// on the worker's thread. Jobs still queued when the pool is cancelled or stopped are passed to a
+// discard function instead, so whatever they hold can be released; that's called with the pool's
+// locks held, so it mustn't use the pool itself.
+//
+// Plain C and pthreads, with no Foundation or Lua, so ./benchmark/workerPoolBenchmark.c can load
+// test it anywhere.
+
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef void (*workerPool_function)(void *job, size_t worker, void *data) ;
+
+typedef struct {
+    void   **items ;
+    size_t head ;
+    size_t count ;
+    size_t capacity ;
+} workerPool_queue ;
+
+typedef struct workerPool workerPool ;
+
+typedef struct {
+    workerPool       *pool ;
+    size_t           index ;
+    pthread_t        thread ;
+    pthread_mutex_t  lock ;       // guards queue
+    workerPool_queue queue ;
+    workerPool_queue pinned ;     // jobs for this worker only, guarded by the pool's lock
+    atomic_size_t    pinnedCount ;
+    atomic_size_t    completed ;  // jobs run
+    atomic_size_t    stolen ;     // jobs taken from other workers' queues
+} workerPool_worker ;
+
+struct workerPool {
+    workerPool_worker   *workers ;
+    size_t              workerCount ;
+    workerPool_function run ;
+    void                *data ;
+
+    pthread_mutex_t     lock ;        // guards shared, the pinned queues and stopping; taken before any
+                                      // worker's lock, and workers' locks are taken in order
+    pthread_cond_t      wake ;        // signalled when there's something new to run, or on stopping
+    pthread_cond_t      done ;        // broadcast when outstanding drops to 0
+    workerPool_queue    shared ;
+    atomic_size_t       available ;   // queued jobs any worker could take
+    atomic_size_t       outstanding ; // jobs queued or running
+    bool                stopping ;
+} ;
+
+#pragma mark - Queues
+
+static inline void workerPool_queueFree(workerPool_queue *queue) {
+    free(queue->items) ;
+    memset(queue, 0, sizeof(workerPool_queue)) ;
+}
+
+static inline void *workerPool_queueAt(const workerPool_queue *queue, size_t i) {
+    return queue->items[(queue->head + i) % queue->capacity] ;
+}
+
+// makes room for at least needed items
+static inline bool workerPool_queueReserve(workerPool_queue *queue, size_t needed) {
+    if (needed <= queue->capacity) return true ;
+    size_t capacity = (queue->capacity > 0) ? queue->capacity : 16 ;
+    while (capacity < needed) capacity *= 2 ;
+    void **items = malloc(capacity * sizeof(void *)) ;
+    if (!items) return false ;
+    for (size_t i = 0 ; i < queue->count ; i++) items[i] = workerPool_queueAt(queue, i) ;
+    free(queue->items) ;
+    queue->items    = items ;
+    queue->head     = 0 ;
+    queue->capacity = capacity ;
+    return true ;
+}
+
+static inline bool workerPool_queuePush(workerPool_queue *queue, void *item) {
+    if (!workerPool_queueReserve(queue, queue->count + 1)) return false ;
+    queue->items[(queue->head + queue->count) % queue->capacity] = item ;
+    queue->count++ ;
+    return true ;
+}
+
+// the oldest item, which the owner takes
+static inline void *workerPool_queuePopFront(workerPool_queue *queue) {
+    if (queue->count == 0) return NULL ;
+    void *item  = queue->items[queue->head] ;
+    queue->head = (queue->head + 1) % queue->capacity ;
+    queue->count-- ;
+    return item ;
+}
+
+// the newest item, which a thief takes
+static inline void *workerPool_queuePopBack(workerPool_queue *queue) {
+    if (queue->count == 0) return NULL ;
+    queue->count-- ;
+    return workerPool_queueAt(queue, queue->count) ;
+}
+
+// moves count items, in order, from the front of from (or from its back if fromBack is true) to the
+// back of to; returns false, moving nothing, if to can't grow to hold them
+static inline bool workerPool_queueMove(workerPool_queue *from, workerPool_queue *to, size_t count, bool fromBack) {
+    if (count == 0) return true ;
+    if (!workerPool_queueReserve(to, to->count + count)) return false ;
+    size_t first = fromBack ? from->count - count : 0 ;
+    for (size_t i = 0 ; i < count ; i++) {
+        to->items[(to->head + to->count) % to->capacity] = workerPool_queueAt(from, first + i) ;
+        to->count++ ;
+    }
+    if (!fromBack) from->head = (from->head + count) % from->capacity ;
+    from->count -= count ;
+    return true ;
+}
+
+#pragma mark - Workers
+
+static inline void workerPool_finished(workerPool *pool) {
+    if (atomic_fetch_sub_explicit(&pool->outstanding, 1, memory_order_acq_rel) == 1) {
+        pthread_mutex_lock(&pool->lock) ;
+        pthread_cond_broadcast(&pool->done) ;
+        pthread_mutex_unlock(&pool->lock) ;
+    }
+}
+
+// the next job for worker, or NULL if there's nothing it can run just now: its pinned jobs first,
+// then its own queue, then a share of the shared queue, then half of someone else's queue
+static void *workerPool_take(workerPool *pool, workerPool_worker *worker) {
+    void *job = NULL ;
+
+    if (atomic_load_explicit(&worker->pinnedCount, memory_order_acquire) > 0) {
+        pthread_mutex_lock(&pool->lock) ;
+        job = workerPool_queuePopFront(&worker->pinned) ;
+        if (job) atomic_fetch_sub_explicit(&worker->pinnedCount, 1, memory_order_relaxed) ;
+        pthread_mutex_unlock(&pool->lock) ;
+        if (job) return job ;
+    }
+
+    pthread_mutex_lock(&worker->lock) ;
+    job = workerPool_queuePopFront(&worker->queue) ;
+    pthread_mutex_unlock(&worker->lock) ;
+
+    if (!job) {
+        pthread_mutex_lock(&pool->lock) ;
+        if (pool->shared.count > 0) {
+            pthread_mutex_lock(&worker->lock) ;
+            job = workerPool_queuePopFront(&pool->shared) ;
+            // if there isn't memory to take more, this worker just runs the one
+            size_t share = pool->shared.count / pool->workerCount ;
+            workerPool_queueMove(&pool->shared, &worker->queue, share, false) ;
+            pthread_mutex_unlock(&worker->lock) ;
+        }
+        pthread_mutex_unlock(&pool->lock) ;
+    }
+
+    for (size_t i = 1 ; !job && i < pool->workerCount ; i++) {
+        workerPool_worker *victim = &pool->workers[(worker->index + i) % pool->workerCount] ;
+        workerPool_worker *first  = (victim->index < worker->index) ? victim : worker ;
+        workerPool_worker *second = (victim->index < worker->index) ? worker : victim ;
+
+        pthread_mutex_lock(&first->lock) ;
+        pthread_mutex_lock(&second->lock) ;
+        size_t half = (victim->queue.count + 1) / 2 ;
+        if (half > 0) {
+            // the newer half, running the oldest of them now and keeping the rest
+            size_t kept = workerPool_queueMove(&victim->queue, &worker->queue, half - 1, true) ? half - 1 : 0 ;
+            job = workerPool_queuePopBack(&victim->queue) ;
+            atomic_fetch_add_explicit(&worker->stolen, kept + 1, memory_order_relaxed) ;
+        }
+        pthread_mutex_unlock(&second->lock) ;
+        pthread_mutex_unlock(&first->lock) ;
+    }
+
+    if (job) atomic_fetch_sub_explicit(&pool->available, 1, memory_order_relaxed) ;
+    return job ;
+}
+
+static void *workerPool_main(void *argument) {
+    workerPool_worker *worker = argument ;
+    workerPool        *pool   = worker->pool ;
+
+    while (true) {
+        void *job = workerPool_take(pool, worker) ;
+        if (job) {
+            pool->run(job, worker->index, pool->data) ;
+            atomic_fetch_add_explicit(&worker->completed, 1, memory_order_relaxed) ;
+            workerPool_finished(pool) ;
+            continue ;
+        }
+
+        pthread_mutex_lock(&pool->lock) ;
+        bool waited = false ;
+        while (!pool->stopping &&
+               atomic_load_explicit(&pool->available, memory_order_relaxed) == 0 &&
+               atomic_load_explicit(&worker->pinnedCount, memory_order_relaxed) == 0) {
+            pthread_cond_wait(&pool->wake, &pool->lock) ;
+            waited = true ;
+        }
+        bool stopping = pool->stopping ;
+        pthread_mutex_unlock(&pool->lock) ;
+        if (stopping) break ;
+
+        // something is counted as available but was on its way between queues when this worker
+        // looked; give whoever is moving it a moment before looking again
+        if (!waited) sched_yield() ;
+    }
+    return NULL ;
+}
+
+#pragma mark - Pool
+
+// removes every job that hasn't started yet, passing each to discard (if it isn't NULL); returns
+// how many there were. Jobs already running are left to finish.
+static size_t workerPool_cancel(workerPool *pool, workerPool_function discard) {
+    // every queue is locked at once, so nothing can be stolen from a queue still to be emptied
+    // into one that's been emptied already
+    pthread_mutex_lock(&pool->lock) ;
+    for (size_t i = 0 ; i < pool->workerCount ; i++) pthread_mutex_lock(&pool->workers[i].lock) ;
+
+    size_t cancelled = 0, taken = 0 ;
+    void   *job ;
+    while ((job = workerPool_queuePopFront(&pool->shared))) {
+        if (discard) discard(job, SIZE_MAX, pool->data) ;
+        taken++ ;
+    }
+    for (size_t i = 0 ; i < pool->workerCount ; i++) {
+        workerPool_worker *worker = &pool->workers[i] ;
+        while ((job = workerPool_queuePopFront(&worker->queue))) {
+            if (discard) discard(job, i, pool->data) ;
+            taken++ ;
+        }
+        while ((job = workerPool_queuePopFront(&worker->pinned))) {
+            if (discard) discard(job, i, pool->data) ;
+            atomic_fetch_sub_explicit(&worker->pinnedCount, 1, memory_order_relaxed) ;
+            cancelled++ ;
+        }
+    }
+    atomic_fetch_sub_explicit(&pool->available, taken, memory_order_relaxed) ;
+    cancelled += taken ;
+
+    if (cancelled > 0 && atomic_fetch_sub_explicit(&pool->outstanding, cancelled, memory_order_acq_rel) == cancelled) {
+        pthread_cond_broadcast(&pool->done) ;
+    }
+    for (size_t i = pool->workerCount ; i > 0 ; i--) pthread_mutex_unlock(&pool->workers[i - 1].lock) ;
+    pthread_mutex_unlock(&pool->lock) ;
+    return cancelled ;
+}
+
+// stops the workers once the jobs they're running are done, discarding the rest as
+// workerPool_cancel does, and frees everything
+static void workerPool_stop(workerPool *pool, workerPool_function discard) {
+    if (!pool->workers) return ;
+    workerPool_cancel(pool, discard) ;
+
+    pthread_mutex_lock(&pool->lock) ;
+    pool->stopping = true ;
+    pthread_cond_broadcast(&pool->wake) ;
+    pthread_mutex_unlock(&pool->lock) ;
+
+    // every thread has to have finished before any worker's lock goes, as they steal from each other
+    for (size_t i = 0 ; i < pool->workerCount ; i++) {
+        if (pool->workers[i].pool) pthread_join(pool->workers[i].thread, NULL) ;
+    }
+    for (size_t i = 0 ; i < pool->workerCount ; i++) {
+        workerPool_worker *worker = &pool->workers[i] ;
+        pthread_mutex_destroy(&worker->lock) ;
+        workerPool_queueFree(&worker->queue) ;
+        workerPool_queueFree(&worker->pinned) ;
+    }
+    free(pool->workers) ;
+    workerPool_queueFree(&pool->shared) ;
+    pthread_cond_destroy(&pool->wake) ;
+    pthread_cond_destroy(&pool->done) ;
+    pthread_mutex_destroy(&pool->lock) ;
+    pool->workers     = NULL ;
+    pool->workerCount = 0 ;
+}
+
+// starts workerCount threads, each calling run with the jobs it takes and data; returns false,
+// with nothing left running, if they couldn't all be started
+static bool workerPool_start(workerPool *pool, size_t workerCount, workerPool_function run, void *data) {
+    memset(pool, 0, sizeof(workerPool)) ;
+    if (workerCount == 0) return false ;
+    pool->workers = calloc(workerCount, sizeof(workerPool_worker)) ;
+    if (!pool->workers) return false ;
+
+    pool->workerCount = workerCount ;
+    pool->run         = run ;
+    pool->data        = data ;
+    pthread_mutex_init(&pool->lock, NULL) ;
+    pthread_cond_init(&pool->wake, NULL) ;
+    pthread_cond_init(&pool->done, NULL) ;
+    atomic_init(&pool->available, 0) ;
+    atomic_init(&pool->outstanding, 0) ;
+
+    for (size_t i = 0 ; i < workerCount ; i++) {
+        workerPool_worker *worker = &pool->workers[i] ;
+        worker->index = i ;
+        pthread_mutex_init(&worker->lock, NULL) ;
+        atomic_init(&worker->pinnedCount, 0) ;
+        atomic_init(&worker->completed, 0) ;
+        atomic_init(&worker->stolen, 0) ;
+    }
+    // worker->pool marks the workers whose threads are running, for workerPool_stop
+    for (size_t i = 0 ; i < workerCount ; i++) {
+        workerPool_worker *worker = &pool->workers[i] ;
+        worker->pool = pool ;
+        if (pthread_create(&worker->thread, NULL, workerPool_main, worker) != 0) {
+            worker->pool = NULL ;
+            workerPool_stop(pool, NULL) ;
+            return false ;
+        }
+    }
+    return true ;
+}
+
+// queues job for any worker; returns false if it's NULL or there isn't memory to queue it
+static bool workerPool_submit(workerPool *pool, void *job) {
+    if (!job) return false ;
+    pthread_mutex_lock(&pool->lock) ;
+    bool queued = workerPool_queuePush(&pool->shared, job) ;
+    if (queued) {
+        atomic_fetch_add_explicit(&pool->outstanding, 1, memory_order_relaxed) ;
+        atomic_fetch_add_explicit(&pool->available, 1, memory_order_relaxed) ;
+        pthread_cond_signal(&pool->wake) ;
+    }
+    pthread_mutex_unlock(&pool->lock) ;
+    return queued ;
+}
+
+// queues job for the given worker only; returns false if it's NULL, there's no such worker, or
+// there isn't memory to queue it
+static bool workerPool_submitTo(workerPool *pool, size_t worker, void *job) {
+    if (!job || worker >= pool->workerCount) return false ;
+    pthread_mutex_lock(&pool->lock) ;
+    bool queued = workerPool_queuePush(&pool->workers[worker].pinned, job) ;
+    if (queued) {
+        atomic_fetch_add_explicit(&pool->outstanding, 1, memory_order_relaxed) ;
+        atomic_fetch_add_explicit(&pool->workers[worker].pinnedCount, 1, memory_order_release) ;
+        // the wake condition is shared, so everyone has to check whether it's for them
+        pthread_cond_broadcast(&pool->wake) ;
+    }
+    pthread_mutex_unlock(&pool->lock) ;
+    return queued ;
+}
+
+// jobs queued or running
+static inline size_t workerPool_outstanding(workerPool *pool) {
+    return atomic_load_explicit(&pool->outstanding, memory_order_acquire) ;
+}
+
+// blocks until every job queued has been run or cancelled
+static void workerPool_wait(workerPool *pool) {
+    pthread_mutex_lock(&pool->lock) ;
+    while (atomic_load_explicit(&pool->outstanding, memory_order_acquire) > 0) pthread_cond_wait(&pool->done, &pool->lock) ;
+    pthread_mutex_unlock(&pool->lock) ;
+}
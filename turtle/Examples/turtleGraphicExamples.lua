@@ -208,3 +208,54 @@ local t = os.time()
 tc3 = tc.turtleCanvas():_background(wheel, _step)
 print("Blocked for", os.time() - t)
 
+
+
+
+
+
+-- The same wheel written in Logo and compiled once; the loops and recursive calls run in C
+-- instead of calling back into Lua for every command, and it still yields when backgrounded.
+tc = require("hs.canvas.turtle")
+
+logoWheel = tc.compile([[
+    to fern :size :sign
+        if :size < 1 [ stop ]
+        fd :size
+        rt 70 * :sign fern :size * 0.5 :sign * -1 lt 70 * :sign
+        fd :size
+        lt 70 * :sign fern :size * 0.5 :sign rt 70 * :sign
+        rt 7 * :sign fern :size - 1 :sign lt 7 * :sign
+        bk :size * 2
+    end
+    to tree :size
+        if :size < 5 [ forward :size back :size stop ]
+        forward :size/3
+        left 30 tree :size*2/3 right 30
+        forward :size/6
+        right 25 tree :size/2 left 25
+        forward :size/3
+        right 25 tree :size/2 left 25
+        forward :size/6
+        back :size
+    end
+    to wheel :step
+        repeat 360 / :step [
+            pu home seth (repcount - 1) * :step bk 150 pd
+            fern 25 1
+            fern 25 -1
+        ]
+    end
+]])
+
+local t = os.time()
+tc4 = tc.turtleCanvas():run(logoWheel, "wheel", _step or 90)
+print("Blocked for", os.time() - t)
+
+local t = os.time()
+tc5 = tc.turtleCanvas():hide():_background(function(self)
+    self:run(logoWheel, "wheel", _step or 90):show()
+    print("Completed in", os.time() - t)
+end)
+print("Blocked for", os.time() - t)
+
+tc6 = tc.turtleCanvas():penup():back(150):pendown():run(logoWheel, "tree", 300)
@@ -0,0 +1,324 @@
+// Snapshot checkpoints for rewinding hs.canvas.turtle drawings
+//
+// Plain C so it can be used (and measured) outside of Hammerspoon -- nothing in here knows about
+// AppKit or Lua. A checkpoint records everything needed to put the turtle and its raster back the
+// way they were after a given number of commands: the turtle state (including any open fills), how
+// many fill vertices the log held, a snapshot of every tile, and an opaque pointer for whatever else
+// the owner tracks outside of turtleState (palette, label font, etc.)
+//
+// Rewinding to command k then costs restoring the nearest checkpoint at or before k and replaying
+// the commands between the two (see turtleState_replay), rather than replaying everything from the
+// beginning. A base checkpoint at the start of the drawing is always kept so there is always
+// somewhere to rewind from.
+//
+// Tile snapshots are reference counted and shared between checkpoints: only tiles which have been
+// drawn into since the previous checkpoint (tile->modified) are copied, so a drawing which moves
+// around costs a copy of the area it has changed rather than of the whole raster each time. When
+// the snapshots outgrow maxBytes, every other checkpoint is dropped and the spacing between
+// checkpoints doubles, so memory stays bounded while rewind cost grows only gradually.
+//
+// Recording is split in two because the owner may not have rasterized the commands up to a
+// checkpoint at the moment the state for it is recorded: turtleCheckpoints_record captures the
+// state, turtleCheckpoints_captureTiles adds the raster once it has caught up. Only checkpoints with
+// both are used for rewinding.
+
+#pragma once
+
+#include "commandLog.h"
+#include "tileCache.h"
+#include "turtleEngine.h"
+
+typedef struct {
+    int32_t  x ;
+    int32_t  y ;
+    uint8_t  *pixels ;
+    size_t   bytes ;
+    size_t   references ;
+} turtleTileSnapshot ;
+
+typedef struct {
+    size_t             commandCount ;     // commands in the log when recorded
+    size_t             fillVertexCount ;
+    turtleState        state ;            // with its own copy of the open fills
+    turtleTileSnapshot **tiles ;
+    size_t             tileCount ;
+    bool               hasTiles ;         // false until turtleCheckpoints_captureTiles
+    void               *owner ;
+} turtleCheckpoint ;
+
+typedef struct {
+    size_t           interval ;           // commands between checkpoints; 0 for only the base checkpoint
+    size_t           spacing ;            // interval, doubled each time checkpoints are thinned out
+    size_t           maxBytes ;           // limit for tile snapshots; 0 for no limit
+    turtleCheckpoint *items ;             // in ascending commandCount
+    size_t           count ;
+    size_t           capacity ;
+    size_t           bytes ;              // snapshot pixels plus bookkeeping
+    size_t           baseline ;           // commandCount of the checkpoint tile->modified is relative to
+
+    // statistics
+    size_t           recorded ;
+    size_t           thinned ;
+
+    void             (*releaseOwner)(void *owner) ;
+} turtleCheckpoints ;
+
+#pragma mark - Snapshots
+
+static inline void turtleSnapshot_release(turtleCheckpoints *cps, turtleTileSnapshot *snapshot) {
+    if (--snapshot->references > 0) return ;
+    cps->bytes -= snapshot->bytes + sizeof(turtleTileSnapshot) ;
+    free(snapshot->pixels) ;
+    free(snapshot) ;
+}
+
+// the snapshot of tile (x, y) in cp, or NULL; hint is where it was in the tile cache, which is
+// usually where it is in the checkpoint too
+static inline turtleTileSnapshot *turtleCheckpoint_snapshot(const turtleCheckpoint *cp, int32_t x, int32_t y, size_t hint) {
+    if (hint < cp->tileCount && cp->tiles[hint]->x == x && cp->tiles[hint]->y == y) return cp->tiles[hint] ;
+    for (size_t i = 0 ; i < cp->tileCount ; i++) {
+        if (cp->tiles[i]->x == x && cp->tiles[i]->y == y) return cp->tiles[i] ;
+    }
+    return NULL ;
+}
+
+#pragma mark - Lifecycle
+
+static inline void turtleCheckpoints_init(turtleCheckpoints *cps, size_t interval, size_t maxBytes) {
+    memset(cps, 0, sizeof(turtleCheckpoints)) ;
+    cps->baseline = SIZE_MAX ;
+    cps->interval = interval ;
+    cps->spacing  = interval ;
+    cps->maxBytes = maxBytes ;
+}
+
+static inline void turtleCheckpoints_releaseItem(turtleCheckpoints *cps, turtleCheckpoint *cp) {
+    for (size_t i = 0 ; i < cp->tileCount ; i++) turtleSnapshot_release(cps, cp->tiles[i]) ;
+    cps->bytes -= cp->tileCount * sizeof(turtleTileSnapshot *) + cp->state.fills.capacity * sizeof(turtleFill) ;
+    free(cp->tiles) ;
+    turtleState_free(&cp->state) ;
+    if (cp->owner && cps->releaseOwner) cps->releaseOwner(cp->owner) ;
+    memset(cp, 0, sizeof(turtleCheckpoint)) ;
+}
+
+// drops the checkpoints recorded after commandCount commands
+static inline void turtleCheckpoints_truncate(turtleCheckpoints *cps, size_t commandCount) {
+    while (cps->count > 0 && cps->items[cps->count - 1].commandCount > commandCount) {
+        turtleCheckpoints_releaseItem(cps, &cps->items[--cps->count]) ;
+    }
+}
+
+// drops every checkpoint (e.g. when the drawing is cleaned); the owner records a new base next
+static inline void turtleCheckpoints_clear(turtleCheckpoints *cps) {
+    while (cps->count > 0) turtleCheckpoints_releaseItem(cps, &cps->items[--cps->count]) ;
+    cps->spacing  = cps->interval ;
+    cps->baseline = SIZE_MAX ;
+}
+
+static inline void turtleCheckpoints_free(turtleCheckpoints *cps) {
+    turtleCheckpoints_clear(cps) ;
+    free(cps->items) ;
+    cps->items    = NULL ;
+    cps->capacity = 0 ;
+}
+
+#pragma mark - Memory Limit
+
+// removes the checkpoint at position i, keeping the rest in order
+static inline void turtleCheckpoints_remove(turtleCheckpoints *cps, size_t i) {
+    turtleCheckpoints_releaseItem(cps, &cps->items[i]) ;
+    memmove(&cps->items[i], &cps->items[i + 1], (cps->count - i - 1) * sizeof(turtleCheckpoint)) ;
+    cps->count-- ;
+}
+
+// Drops every other checkpoint (keeping the base and the most recent) until the snapshots fit
+// within maxBytes, doubling the spacing each time. If only the base and one other are left and
+// they still don't fit, the other goes too.
+static inline void turtleCheckpoints_enforceLimit(turtleCheckpoints *cps) {
+    if (cps->maxBytes == 0) return ;
+    while (cps->bytes > cps->maxBytes && cps->count > 2) {
+        for (size_t i = cps->count - 2 ; i >= 1 ; i -= 2) {
+            turtleCheckpoints_remove(cps, i) ;
+            if (i < 2) break ;
+        }
+        cps->spacing = (cps->spacing > 0) ? cps->spacing * 2 : 0 ;
+        cps->thinned++ ;
+    }
+    while (cps->bytes > cps->maxBytes && cps->count > 1) turtleCheckpoints_remove(cps, cps->count - 1) ;
+}
+
+// changes the interval and limit; existing checkpoints are kept unless they no longer fit
+static inline void turtleCheckpoints_configure(turtleCheckpoints *cps, size_t interval, size_t maxBytes) {
+    cps->interval = interval ;
+    cps->spacing  = interval ;
+    cps->maxBytes = maxBytes ;
+    turtleCheckpoints_enforceLimit(cps) ;
+}
+
+#pragma mark - Recording
+
+// true if a checkpoint should be recorded now that the log holds commandCount commands
+static inline bool turtleCheckpoints_due(const turtleCheckpoints *cps, size_t commandCount) {
+    if (cps->spacing == 0 || cps->count == 0) return false ;
+    return commandCount >= cps->items[cps->count - 1].commandCount + cps->spacing ;
+}
+
+// Records the turtle state as it is after the commands currently in the log, replacing any
+// checkpoints at or beyond that point; owner is released with releaseOwner when the checkpoint is
+// dropped, including when this fails. Returns the checkpoint, still without tiles, or NULL if memory
+// could not be allocated.
+static inline turtleCheckpoint *turtleCheckpoints_record(turtleCheckpoints *cps, const turtleLog *log,
+                                                         const turtleState *state, void *owner) {
+    turtleCheckpoints_truncate(cps, log->count) ;
+    if (cps->count > 0 && cps->items[cps->count - 1].commandCount == log->count) {
+        turtleCheckpoints_releaseItem(cps, &cps->items[--cps->count]) ;
+    }
+
+    turtleFill *fills = NULL ;
+    if (state->fills.count > 0) {
+        fills = malloc(state->fills.count * sizeof(turtleFill)) ;
+        if (fills) memcpy(fills, state->fills.fills, state->fills.count * sizeof(turtleFill)) ;
+    }
+    if ((state->fills.count > 0 && !fills) ||
+        !turtleLog_grow((void **)&cps->items, &cps->capacity, cps->count + 1, sizeof(turtleCheckpoint))) {
+        free(fills) ;
+        if (owner && cps->releaseOwner) cps->releaseOwner(owner) ;
+        return NULL ;
+    }
+
+    turtleCheckpoint *cp = &cps->items[cps->count++] ;
+    memset(cp, 0, sizeof(turtleCheckpoint)) ;
+    cp->commandCount         = log->count ;
+    cp->fillVertexCount      = log->fillVertexCount ;
+    cp->state                = *state ;
+    cp->state.fills.fills    = fills ;
+    cp->state.fills.capacity = state->fills.count ;
+    cp->owner                = owner ;
+    cps->bytes += cp->state.fills.capacity * sizeof(turtleFill) ;
+    cps->recorded++ ;
+    return cp ;
+}
+
+// Adds the raster to cp once the tiles include exactly the commands up to cp->commandCount. Tiles
+// not modified since the last capture (or restore) share that checkpoint's snapshots, provided it's
+// still around. Returns false if memory could not be allocated, in which case cp is dropped.
+static inline bool turtleCheckpoints_captureTiles(turtleCheckpoints *cps, turtleCheckpoint *cp, turtleTileCache *tiles) {
+    size_t           position = (size_t)(cp - cps->items) ;
+    turtleCheckpoint *prior   = NULL ;
+    for (size_t i = position ; i > 0 ; i--) {
+        if (cps->items[i - 1].hasTiles) {
+            if (cps->items[i - 1].commandCount == cps->baseline) prior = &cps->items[i - 1] ;
+            break ;
+        }
+    }
+
+    bool isGood = true ;
+    if (tiles->count > 0) {
+        cp->tiles = malloc(tiles->count * sizeof(turtleTileSnapshot *)) ;
+        isGood    = (cp->tiles != NULL) ;
+    }
+    if (isGood) cps->bytes += tiles->count * sizeof(turtleTileSnapshot *) ;
+
+    size_t bytesPerTile = turtleTiles_bytesPerTile(tiles) ;
+    for (size_t i = 0 ; isGood && i < tiles->count ; i++) {
+        turtleTile         *tile     = &tiles->tiles[i] ;
+        turtleTileSnapshot *snapshot = (prior && !tile->modified) ? turtleCheckpoint_snapshot(prior, tile->x, tile->y, i) : NULL ;
+
+        if (snapshot) {
+            snapshot->references++ ;
+        } else {
+            snapshot = malloc(sizeof(turtleTileSnapshot)) ;
+            uint8_t *pixels = snapshot ? malloc(bytesPerTile) : NULL ;
+            if (!pixels) {
+                free(snapshot) ;
+                isGood = false ;
+                break ;
+            }
+            memcpy(pixels, tile->pixels, bytesPerTile) ;
+            *snapshot = (turtleTileSnapshot){ .x = tile->x, .y = tile->y, .pixels = pixels, .bytes = bytesPerTile, .references = 1 } ;
+            cps->bytes += bytesPerTile + sizeof(turtleTileSnapshot) ;
+        }
+        cp->tiles[cp->tileCount++] = snapshot ;
+    }
+
+    if (!isGood) {
+        // the unused slots were counted above, so count them back out before releasing
+        if (cp->tiles) cps->bytes -= (tiles->count - cp->tileCount) * sizeof(turtleTileSnapshot *) ;
+        turtleCheckpoints_remove(cps, position) ;
+        return false ;
+    }
+
+    for (size_t i = 0 ; i < tiles->count ; i++) tiles->tiles[i].modified = false ;
+    cp->hasTiles  = true ;
+    cps->baseline = cp->commandCount ;
+    turtleCheckpoints_enforceLimit(cps) ;
+    return true ;
+}
+
+#pragma mark - Rewinding
+
+// the latest complete checkpoint at or before commandCount, or NULL if there isn't one
+static inline turtleCheckpoint *turtleCheckpoints_find(const turtleCheckpoints *cps, size_t commandCount) {
+    size_t low = 0, high = cps->count ;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2 ;
+        if (cps->items[mid].commandCount <= commandCount) {
+            low = mid + 1 ;
+        } else {
+            high = mid ;
+        }
+    }
+    for ( ; low > 0 ; low--) {
+        if (cps->items[low - 1].hasTiles) return &cps->items[low - 1] ;
+    }
+    return NULL ;
+}
+
+// Puts the turtle state, the log's fill vertices and the tiles back the way they were at cp. Tiles
+// allocated since are cleared rather than freed, since the owner may have state attached to them.
+// The caller truncates the log (and anything else it keeps per command) and the checkpoints, and
+// then replays from cp->commandCount. Returns false if memory could not be allocated, in which case
+// the tiles are incomplete.
+static inline bool turtleCheckpoints_restore(turtleCheckpoints *cps, const turtleCheckpoint *cp,
+                                             turtleLog *log, turtleState *state, turtleTileCache *tiles) {
+    turtleFillStack fills = state->fills ;
+    fills.count = 0 ;
+    bool isGood = turtleLog_grow((void **)&fills.fills, &fills.capacity, cp->state.fills.count, sizeof(turtleFill)) ;
+    if (isGood && cp->state.fills.count > 0) {
+        memcpy(fills.fills, cp->state.fills.fills, cp->state.fills.count * sizeof(turtleFill)) ;
+        fills.count = cp->state.fills.count ;
+    }
+    *state       = cp->state ;
+    state->fills = fills ;
+    if (cp->fillVertexCount < log->fillVertexCount) log->fillVertexCount = cp->fillVertexCount ;
+
+    size_t bytesPerTile = turtleTiles_bytesPerTile(tiles) ;
+    for (size_t i = 0 ; i < tiles->count ; i++) {
+        turtleTile         *tile     = &tiles->tiles[i] ;
+        turtleTileSnapshot *snapshot = turtleCheckpoint_snapshot(cp, tile->x, tile->y, i) ;
+        if (snapshot) {
+            memcpy(tile->pixels, snapshot->pixels, bytesPerTile) ;
+        } else {
+            memset(tile->pixels, 0, bytesPerTile) ;
+        }
+        tile->modified = false ;
+    }
+    for (size_t i = 0 ; i < cp->tileCount ; i++) {
+        if (turtleTiles_find(tiles, cp->tiles[i]->x, cp->tiles[i]->y)) continue ;
+        turtleTile *tile = turtleTiles_fetch(tiles, cp->tiles[i]->x, cp->tiles[i]->y) ;
+        if (!tile) {
+            isGood = false ;
+            break ;
+        }
+        memcpy(tile->pixels, cp->tiles[i]->pixels, bytesPerTile) ;
+        tile->modified = false ;
+    }
+    cps->baseline = isGood ? cp->commandCount : SIZE_MAX ;
+    return isGood ;
+}
+
+#pragma mark - Statistics
+
+static inline size_t turtleCheckpoints_bytesAllocated(const turtleCheckpoints *cps) {
+    return sizeof(turtleCheckpoints) + cps->capacity * sizeof(turtleCheckpoint) + cps->bytes ;
+}
@@ -0,0 +1,416 @@
+// Compact command log for hs.canvas.turtle
+//
+// Plain C so it can be used (and measured) outside of Hammerspoon -- nothing in here knows about
+// AppKit or Lua. Each command is stored as a one byte opcode, a one byte flag field, and a slice of
+// a single contiguous array of doubles holding the command's arguments followed by any values
+// derived from the turtle state when the command was appended (start and end points, style, etc.)
+//
+// Strings and color specifications can't be represented as doubles, so the owner of the log is
+// expected to intern them and store the resulting index instead. Pen color, width and mode are
+// interned here as "styles" so that every drawing command carries everything needed to render
+// it without replaying the commands which preceded it; the paths themselves are built lazily
+// from these values when they are actually rendered.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+// these need to track t_wrappedCommands in internal.m, so if you change one, change the other
+typedef enum {
+  c__special = 0, // was used for tests with compressed strokes into single path; now uncertain about it...
+  c_forward,
+  c_back,
+  c_left,
+  c_right,
+  c_setpos,
+  c_setxy,
+  c_setx,
+  c_sety,
+  c_setheading,
+  c_home,
+  c_pendown,
+  c_penup,
+  c_penpaint,
+  c_penerase,
+  c_penreverse,
+  c_setpensize,
+  c_arc,
+  c_setscrunch,
+  c_setlabelheight,
+  c_setlabelfont,
+  c_label,
+  c_setpencolor,
+  c_setbackground,
+  c_setpalette,
+  c_fillstart,
+  c_fillend,
+
+  c__commandCount // not a command; must remain last
+} t_commandTypes ;
+
+typedef enum {
+    t_penPaint = 0,
+    t_penErase,
+    t_penReverse,
+} t_penModes ;
+
+// slots for the derived values stored after the arguments of each command type
+enum { t_moveX0 = 0, t_moveY0, t_moveX1, t_moveY1, t_moveStyle, t_moveSlots } ;
+enum { t_arcX = 0, t_arcY, t_arcHeading, t_arcScaleX, t_arcScaleY, t_arcStyle, t_arcSlots } ;
+enum { t_labelX = 0, t_labelY, t_labelHeading, t_labelScaleX, t_labelScaleY, t_labelFont, t_labelStyle, t_labelSlots } ;
+enum { t_colorIdx = 0, t_colorSlots } ;
+enum { t_fillStartX = 0, t_fillStartY, t_fillStartSlots } ;
+enum { t_fillEndStartIdx = 0, t_fillEndVertexStart, t_fillEndVertexCount, t_fillEndStyle, t_fillEndSlots } ;
+
+// per command flags; the low bits record which numeric arguments were integers so the original
+// arguments can be reproduced exactly by _commands
+#define T_FLAG_DRAWS      0x80
+#define T_FLAG_INTEGER(n) ((uint8_t)(1u << (n)))
+#define T_MAX_ARGUMENTS   7
+
+#define T_NO_STYLE        UINT32_MAX
+
+typedef struct {
+    uint32_t color ; // index into the log's color table
+    uint32_t mode ;  // t_penModes
+    double   width ;
+} turtleStyle ;
+
+typedef struct {
+    uint8_t     *ops ;
+    uint8_t     *flags ;
+    uint32_t    *offsets ;        // count + 1 entries; command i owns values[offsets[i]] to values[offsets[i + 1] - 1]
+    double      *values ;
+    size_t      count ;
+    size_t      capacity ;
+    size_t      valueCount ;
+    size_t      valueCapacity ;
+
+    turtleStyle *styles ;
+    uint32_t    *styleHash ;      // open addressing; holds style index + 1, 0 is empty
+    size_t      styleCount ;
+    size_t      styleCapacity ;
+    size_t      styleHashSize ;
+
+    double      *colors ;         // RGBA, 4 per entry
+    size_t      colorCount ;
+    size_t      colorCapacity ;
+
+    double      *fillVertices ;   // x, y pairs recorded while a fill is open; see turtleFillStack
+    size_t      fillVertexCount ;
+    size_t      fillVertexCapacity ;
+} turtleLog ;
+
+// Fills which have been started but not yet ended. While any fill is open, the end point of every
+// move is appended to the log's fill vertices; each open fill remembers where its vertices begin, so
+// ending one costs time proportional to its own vertices and nested fills share the same storage
+// (an outer fill's polygon includes the vertices of any fills nested within it).
+typedef struct {
+    size_t commandIdx ;           // index of the fillstart command
+    size_t vertexStart ;          // index of the fill's first vertex in the log's fill vertices
+} turtleFill ;
+
+typedef struct {
+    turtleFill *fills ;
+    size_t     count ;
+    size_t     capacity ;
+} turtleFillStack ;
+
+#pragma mark - Command Shapes
+
+// number of doubles used to store the arguments for a command; table arguments (setpos and
+// setpensize) are flattened and colors, fonts, and label text are stored as interned indicies
+static inline uint8_t turtleLog_argCount(uint8_t op) {
+    switch(op) {
+        case c_forward:
+        case c_back:
+        case c_left:
+        case c_right:
+        case c_setx:
+        case c_sety:
+        case c_setheading:
+        case c_setlabelheight:
+        case c_setlabelfont:
+        case c_label:
+        case c_setpencolor:
+        case c_setbackground:
+        case c_fillend:
+            return 1 ;
+        case c_setpos:
+        case c_setxy:
+        case c_setpensize:
+        case c_arc:
+        case c_setscrunch:
+        case c_setpalette:
+            return 2 ;
+        default:
+            return 0 ;
+    }
+}
+
+// type of a flattened argument: 'n'umber, or the interned index of a 's'tring or 'c'olor
+static inline char turtleLog_argType(uint8_t op, uint8_t arg) {
+    switch(op) {
+        case c_setlabelfont:
+        case c_label:
+            return 's' ;
+        case c_setpencolor:
+        case c_setbackground:
+        case c_fillend:
+            return 'c' ;
+        case c_setpalette:
+            return (arg == 1) ? 'c' : 'n' ;
+        default:
+            return 'n' ;
+    }
+}
+
+static inline uint8_t turtleLog_derivedCount(uint8_t op) {
+    switch(op) {
+        case c_forward:
+        case c_back:
+        case c_setpos:
+        case c_setxy:
+        case c_setx:
+        case c_sety:
+        case c_home:
+            return t_moveSlots ;
+        case c_arc:
+            return t_arcSlots ;
+        case c_label:
+            return t_labelSlots ;
+        case c_setpencolor:
+        case c_setbackground:
+        case c_setpalette:
+            return t_colorSlots ;
+        case c_fillstart:
+            return t_fillStartSlots ;
+        case c_fillend:
+            return t_fillEndSlots ;
+        default:
+            return 0 ;
+    }
+}
+
+static inline bool turtleLog_isMove(uint8_t op) {
+    return (op == c_forward || op == c_back || op == c_setpos || op == c_setxy ||
+            op == c_setx    || op == c_sety || op == c_home) ;
+}
+
+#pragma mark - Lifecycle
+
+static inline void turtleLog_init(turtleLog *log) {
+    memset(log, 0, sizeof(turtleLog)) ;
+}
+
+static inline void turtleLog_free(turtleLog *log) {
+    free(log->ops) ;
+    free(log->flags) ;
+    free(log->offsets) ;
+    free(log->values) ;
+    free(log->styles) ;
+    free(log->styleHash) ;
+    free(log->colors) ;
+    free(log->fillVertices) ;
+    turtleLog_init(log) ;
+}
+
+// forgets the commands but keeps the interned styles and colors (and the allocated space) since
+// they are likely to be used again
+static inline void turtleLog_clear(turtleLog *log) {
+    log->count           = 0 ;
+    log->valueCount      = 0 ;
+    log->fillVertexCount = 0 ;
+}
+
+// forgets the interned styles and colors as well (keeping the allocated space); only valid once the
+// commands referring to them have been cleared
+static inline void turtleLog_clearStyles(turtleLog *log) {
+    if (log->styleHash) memset(log->styleHash, 0, log->styleHashSize * sizeof(uint32_t)) ;
+    log->styleCount = 0 ;
+    log->colorCount = 0 ;
+}
+
+// truncates the log so that only the first newCount commands remain
+static inline void turtleLog_truncate(turtleLog *log, size_t newCount) {
+    if (newCount < log->count) {
+        log->count      = newCount ;
+        log->valueCount = (newCount > 0) ? log->offsets[newCount] : 0 ;
+    }
+}
+
+// always allocates something, even when nothing is needed yet, so the pointer is only NULL on failure
+static bool turtleLog_grow(void **ptr, size_t *capacity, size_t needed, size_t itemSize) {
+    if (needed <= *capacity && *ptr) return true ;
+    size_t newCapacity = (*capacity == 0) ? 256 : *capacity ;
+    while (newCapacity < needed) newCapacity *= 2 ;
+    void *newPtr = realloc(*ptr, newCapacity * itemSize) ;
+    if (!newPtr) return false ;
+    *ptr      = newPtr ;
+    *capacity = newCapacity ;
+    return true ;
+}
+
+#pragma mark - Commands
+
+// appends a command and returns a pointer to its derived values (which are zeroed) so the caller
+// can fill them in, or NULL if memory could not be allocated; the log is unchanged on failure, and a
+// command without derived values (penup) gets a valid, empty pointer rather than NULL
+static inline double *turtleLog_append(turtleLog *log, uint8_t op, const double *args, uint8_t flags) {
+    uint8_t argc     = turtleLog_argCount(op) ;
+    uint8_t derivedc = turtleLog_derivedCount(op) ;
+
+    if (log->count + 1 > log->capacity) {
+        size_t   newCapacity = (log->capacity == 0) ? 256 : log->capacity * 2 ;
+        uint8_t  *newOps     = realloc(log->ops, newCapacity * sizeof(uint8_t)) ;
+        if (!newOps) return NULL ;
+        log->ops = newOps ;
+        uint8_t  *newFlags   = realloc(log->flags, newCapacity * sizeof(uint8_t)) ;
+        if (!newFlags) return NULL ;
+        log->flags = newFlags ;
+        uint32_t *newOffsets = realloc(log->offsets, (newCapacity + 1) * sizeof(uint32_t)) ;
+        if (!newOffsets) return NULL ;
+        log->offsets  = newOffsets ;
+        log->capacity = newCapacity ;
+    }
+
+    size_t needed = log->valueCount + argc + derivedc ;
+    if (needed > UINT32_MAX) return NULL ;
+    if (!turtleLog_grow((void **)&log->values, &log->valueCapacity, needed, sizeof(double))) return NULL ;
+
+    double *slice = log->values + log->valueCount ;
+    if (argc > 0) memcpy(slice, args, argc * sizeof(double)) ;
+    if (derivedc > 0) memset(slice + argc, 0, derivedc * sizeof(double)) ;
+
+    log->ops[log->count]         = op ;
+    log->flags[log->count]       = flags ;
+    log->offsets[log->count]     = (uint32_t)log->valueCount ;
+    log->offsets[log->count + 1] = (uint32_t)needed ;
+    log->valueCount              = needed ;
+    log->count++ ;
+
+    return slice + argc ;
+}
+
+static inline double *turtleLog_args(const turtleLog *log, size_t idx) {
+    return log->values + log->offsets[idx] ;
+}
+
+static inline double *turtleLog_derived(const turtleLog *log, size_t idx) {
+    return log->values + log->offsets[idx] + turtleLog_argCount(log->ops[idx]) ;
+}
+
+#pragma mark - Fills
+
+static inline bool turtleLog_appendFillVertex(turtleLog *log, double x, double y) {
+    if (!turtleLog_grow((void **)&log->fillVertices, &log->fillVertexCapacity, (log->fillVertexCount + 1) * 2, sizeof(double))) {
+        return false ;
+    }
+    log->fillVertices[log->fillVertexCount * 2]     = x ;
+    log->fillVertices[log->fillVertexCount * 2 + 1] = y ;
+    log->fillVertexCount++ ;
+    return true ;
+}
+
+static inline bool turtleFills_push(turtleFillStack *stack, size_t commandIdx, size_t vertexStart) {
+    if (!turtleLog_grow((void **)&stack->fills, &stack->capacity, stack->count + 1, sizeof(turtleFill))) return false ;
+    stack->fills[stack->count++] = (turtleFill){ .commandIdx = commandIdx, .vertexStart = vertexStart } ;
+    return true ;
+}
+
+// returns false if no fill is open
+static inline bool turtleFills_pop(turtleFillStack *stack, turtleFill *fill) {
+    if (stack->count == 0) return false ;
+    *fill = stack->fills[--stack->count] ;
+    return true ;
+}
+
+static inline void turtleFills_free(turtleFillStack *stack) {
+    free(stack->fills) ;
+    memset(stack, 0, sizeof(turtleFillStack)) ;
+}
+
+#pragma mark - Interned Styles and Colors
+
+static inline uint32_t turtleLog_appendColor(turtleLog *log, double r, double g, double b, double a) {
+    if (!turtleLog_grow((void **)&log->colors, &log->colorCapacity, (log->colorCount + 1) * 4, sizeof(double))) {
+        return T_NO_STYLE ;
+    }
+    double *entry = log->colors + log->colorCount * 4 ;
+    entry[0] = r ; entry[1] = g ; entry[2] = b ; entry[3] = a ;
+    return (uint32_t)(log->colorCount++) ;
+}
+
+static inline size_t turtleLog_styleHashOf(uint32_t color, uint32_t mode, double width) {
+    uint64_t bits ;
+    memcpy(&bits, &width, sizeof(bits)) ;
+    uint64_t h = (uint64_t)color * 0x9E3779B97F4A7C15ULL ;
+    h ^= (uint64_t)mode + 0x632BE59BD9B4E019ULL + (h << 6) + (h >> 2) ;
+    h ^= bits + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2) ;
+    return (size_t)h ;
+}
+
+static bool turtleLog_rehashStyles(turtleLog *log, size_t newSize) {
+    uint32_t *newHash = calloc(newSize, sizeof(uint32_t)) ;
+    if (!newHash) return false ;
+    for (size_t i = 0 ; i < log->styleCount ; i++) {
+        turtleStyle *s = &log->styles[i] ;
+        size_t slot = turtleLog_styleHashOf(s->color, s->mode, s->width) & (newSize - 1) ;
+        while (newHash[slot] != 0) slot = (slot + 1) & (newSize - 1) ;
+        newHash[slot] = (uint32_t)(i + 1) ;
+    }
+    free(log->styleHash) ;
+    log->styleHash     = newHash ;
+    log->styleHashSize = newSize ;
+    return true ;
+}
+
+// returns the index for the style, adding it if it hasn't been seen before
+static inline uint32_t turtleLog_internStyle(turtleLog *log, uint32_t color, uint32_t mode, double width) {
+    if ((log->styleCount + 1) * 2 > log->styleHashSize) {
+        if (!turtleLog_rehashStyles(log, (log->styleHashSize == 0) ? 64 : log->styleHashSize * 2)) return T_NO_STYLE ;
+    }
+    size_t mask = log->styleHashSize - 1 ;
+    size_t slot = turtleLog_styleHashOf(color, mode, width) & mask ;
+    while (log->styleHash[slot] != 0) {
+        turtleStyle *s = &log->styles[log->styleHash[slot] - 1] ;
+        if (s->color == color && s->mode == mode && memcmp(&s->width, &width, sizeof(double)) == 0) {
+            return log->styleHash[slot] - 1 ;
+        }
+        slot = (slot + 1) & mask ;
+    }
+
+    if (!turtleLog_grow((void **)&log->styles, &log->styleCapacity, log->styleCount + 1, sizeof(turtleStyle))) {
+        return T_NO_STYLE ;
+    }
+    log->styles[log->styleCount] = (turtleStyle){ .color = color, .mode = mode, .width = width } ;
+    log->styleHash[slot] = (uint32_t)(log->styleCount + 1) ;
+    return (uint32_t)(log->styleCount++) ;
+}
+
+static inline const turtleStyle *turtleLog_style(const turtleLog *log, double styleIdx) {
+    size_t idx = (size_t)styleIdx ;
+    return (idx < log->styleCount) ? &log->styles[idx] : NULL ;
+}
+
+#pragma mark - Statistics
+
+// bytes currently allocated by the log, including unused capacity
+static inline size_t turtleLog_bytesAllocated(const turtleLog *log) {
+    return log->capacity      * (sizeof(uint8_t) * 2 + sizeof(uint32_t)) +
+           log->valueCapacity * sizeof(double) +
+           log->styleCapacity * sizeof(turtleStyle) +
+           log->styleHashSize * sizeof(uint32_t) +
+           log->colorCapacity * sizeof(double) +
+           log->fillVertexCapacity * sizeof(double) ;
+}
+
+// bytes actually used by the commands currently in the log
+static inline size_t turtleLog_bytesUsed(const turtleLog *log) {
+    return log->count      * (sizeof(uint8_t) * 2 + sizeof(uint32_t)) + sizeof(uint32_t) +
+           log->valueCount * sizeof(double) +
+           log->fillVertexCount * sizeof(double) * 2 ;
+}
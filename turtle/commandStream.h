@@ -0,0 +1,439 @@
+// Compact binary serialization of hs.canvas.turtle command logs
+//
+// Plain C so it can be used (and measured) outside of Hammerspoon -- nothing in here knows about
+// AppKit or Lua. A stream is a sequence of records:
+//
+//   header   "TRTL" followed by a version byte; starts a segment and forgets every object defined
+//            before it, so segments can be written, stored and loaded independently of each other
+//   command  a one byte opcode and, if the command has arguments, a flag byte followed by its
+//            flattened arguments (see turtleLog_argType). A number flagged as an integer is a
+//            zigzag encoded LEB128 varint and any other number is a little endian float64; string
+//            and color arguments are the varint id of an object defined earlier in the segment
+//   object   0xFF, a kind byte and the object's value: a string is a varint length followed by its
+//            UTF-8 bytes, a palette index a varint, and a color a component count (3 or 4) followed
+//            by that many float64s on a 0 - 100 scale, like the color arrays accepted by the turtle
+//
+// Object ids are assigned in the order objects are defined, starting at 0 in each segment, and the
+// writer only defines an object the first time a segment refers to it. Only the arguments are
+// stored -- everything the log derives from the turtle's state is rebuilt when the stream is
+// replayed -- so most commands take 2 or 3 bytes instead of the 9 per argument of a packed string.
+//
+// The flag byte records which arguments were integers, as the log does, so the commands come back
+// exactly as they were given. The header can't be mistaken for a command because 'T' is far larger
+// than any opcode.
+
+#pragma once
+
+#include "commandLog.h"
+
+#include <math.h>
+
+#define T_STREAM_MAGIC      "TRTL"
+#define T_STREAM_VERSION    1
+#define T_STREAM_HEADER_LEN 5
+#define T_STREAM_OBJECT     0xFF
+
+typedef enum {
+    t_streamString = 1,
+    t_streamPalette,
+    t_streamColor,
+} t_streamObjectKinds ;
+
+typedef struct {
+    uint8_t    kind ;            // t_streamObjectKinds
+    const char *string ;         // not NUL terminated; for the reader, points into the stream
+    size_t     length ;
+    uint32_t   palette ;
+    uint8_t    componentCount ;  // 3 or 4
+    double     components[4] ;   // 0 - 100
+} turtleStreamObject ;
+
+// Fills in the object the log's interned index for an argument of type 's' or 'c' refers to.
+// Returning false stops the writer.
+typedef bool (*turtleStreamDescriber)(void *context, char type, uint32_t idx, turtleStreamObject *object) ;
+
+typedef struct {
+    uint8_t  *bytes ;            // output waiting to be drained by the owner
+    size_t   length ;
+    size_t   capacity ;
+
+    // stream id + 1 of the object for each interned index of the log, 0 if not yet defined in
+    // this segment; strings and colors are indexed separately
+    uint32_t *ids[2] ;
+    size_t   idCapacity[2] ;
+    uint32_t objectCount ;
+
+    // statistics
+    size_t   commandsWritten ;
+    size_t   bytesWritten ;      // including bytes already drained
+} turtleStreamWriter ;
+
+typedef enum {
+    t_streamCommand = 0,
+    t_streamEnd,
+    t_streamError,
+} t_streamResults ;
+
+typedef struct {
+    const uint8_t      *bytes ;
+    size_t             length ;
+    size_t             position ;
+
+    turtleStreamObject *objects ;     // defined in the current segment, by stream id
+    size_t             objectCount ;
+    size_t             objectCapacity ;
+    bool               inSegment ;
+    size_t             segments ;     // headers read so far
+
+    // the command most recently read; string and color arguments are stream ids
+    size_t             start ;        // byte offset of the command
+    uint8_t            op ;
+    uint8_t            flags ;
+    double             args[T_MAX_ARGUMENTS] ;
+
+    const char         *error ;
+    size_t             errorPosition ;
+} turtleStreamReader ;
+
+#pragma mark - Encoding
+
+static inline bool turtleStream_reserve(turtleStreamWriter *writer, size_t more) {
+    return turtleLog_grow((void **)&writer->bytes, &writer->capacity, writer->length + more, 1) ;
+}
+
+// callers reserve space first; a varint never takes more than 10 bytes
+static inline void turtleStream_putVarint(turtleStreamWriter *writer, uint64_t value) {
+    while (value >= 0x80) {
+        writer->bytes[writer->length++] = (uint8_t)(value | 0x80) ;
+        value >>= 7 ;
+    }
+    writer->bytes[writer->length++] = (uint8_t)value ;
+}
+
+static inline void turtleStream_putDouble(turtleStreamWriter *writer, double value) {
+    uint64_t bits ;
+    memcpy(&bits, &value, sizeof(bits)) ;
+    for (int i = 0 ; i < 8 ; i++) writer->bytes[writer->length++] = (uint8_t)(bits >> (i * 8)) ;
+}
+
+static inline uint64_t turtleStream_zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63) ;
+}
+
+static inline int64_t turtleStream_unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1) ;
+}
+
+// integers beyond this are stored as doubles, which is all the log could hold for them anyway
+static inline bool turtleStream_isVarint(double value) {
+    return value == trunc(value) && fabs(value) < 0x1p62 ;
+}
+
+#pragma mark - Writer
+
+static inline void turtleStreamWriter_init(turtleStreamWriter *writer) {
+    memset(writer, 0, sizeof(turtleStreamWriter)) ;
+}
+
+static inline void turtleStreamWriter_free(turtleStreamWriter *writer) {
+    free(writer->bytes) ;
+    free(writer->ids[0]) ;
+    free(writer->ids[1]) ;
+    turtleStreamWriter_init(writer) ;
+}
+
+// forgets the output once the owner has written it somewhere, keeping the defined objects
+static inline void turtleStreamWriter_drain(turtleStreamWriter *writer) {
+    writer->length = 0 ;
+}
+
+// writes a header, after which objects are defined again as they're used
+static inline bool turtleStreamWriter_beginSegment(turtleStreamWriter *writer) {
+    if (!turtleStream_reserve(writer, T_STREAM_HEADER_LEN)) return false ;
+    memcpy(writer->bytes + writer->length, T_STREAM_MAGIC, 4) ;
+    writer->bytes[writer->length + 4] = T_STREAM_VERSION ;
+    writer->length       += T_STREAM_HEADER_LEN ;
+    writer->bytesWritten += T_STREAM_HEADER_LEN ;
+
+    for (int i = 0 ; i < 2 ; i++) {
+        if (writer->ids[i]) memset(writer->ids[i], 0, writer->idCapacity[i] * sizeof(uint32_t)) ;
+    }
+    writer->objectCount = 0 ;
+    return true ;
+}
+
+static bool turtleStreamWriter_defineObject(turtleStreamWriter *writer, const turtleStreamObject *object) {
+    size_t before = writer->length ;
+    switch(object->kind) {
+        case t_streamString:
+            if (!turtleStream_reserve(writer, 12 + object->length)) return false ;
+            writer->bytes[writer->length++] = T_STREAM_OBJECT ;
+            writer->bytes[writer->length++] = t_streamString ;
+            turtleStream_putVarint(writer, object->length) ;
+            if (object->length > 0) memcpy(writer->bytes + writer->length, object->string, object->length) ;
+            writer->length += object->length ;
+            break ;
+        case t_streamPalette:
+            if (!turtleStream_reserve(writer, 12)) return false ;
+            writer->bytes[writer->length++] = T_STREAM_OBJECT ;
+            writer->bytes[writer->length++] = t_streamPalette ;
+            turtleStream_putVarint(writer, object->palette) ;
+            break ;
+        case t_streamColor: {
+            uint8_t count = (object->componentCount == 3) ? 3 : 4 ;
+            if (!turtleStream_reserve(writer, 3 + count * sizeof(double))) return false ;
+            writer->bytes[writer->length++] = T_STREAM_OBJECT ;
+            writer->bytes[writer->length++] = t_streamColor ;
+            writer->bytes[writer->length++] = count ;
+            for (uint8_t i = 0 ; i < count ; i++) turtleStream_putDouble(writer, object->components[i]) ;
+        }   break ;
+        default:
+            return false ;
+    }
+    writer->bytesWritten += writer->length - before ;
+    return true ;
+}
+
+// returns the stream id for an interned index, defining the object if this segment hasn't yet
+static bool turtleStreamWriter_objectId(turtleStreamWriter *writer, char type, uint32_t idx, uint32_t *id,
+                                        turtleStreamDescriber describe, void *context) {
+    int table = (type == 's') ? 0 : 1 ;
+    if (idx < writer->idCapacity[table] && writer->ids[table][idx] != 0) {
+        *id = writer->ids[table][idx] - 1 ;
+        return true ;
+    }
+
+    size_t oldCapacity = writer->idCapacity[table] ;
+    if (!turtleLog_grow((void **)&writer->ids[table], &writer->idCapacity[table], (size_t)idx + 1, sizeof(uint32_t))) {
+        return false ;
+    }
+    if (writer->idCapacity[table] > oldCapacity) {
+        memset(writer->ids[table] + oldCapacity, 0, (writer->idCapacity[table] - oldCapacity) * sizeof(uint32_t)) ;
+    }
+
+    turtleStreamObject object ;
+    memset(&object, 0, sizeof(object)) ;
+    if (!describe(context, type, idx, &object))               return false ;
+    if (!turtleStreamWriter_defineObject(writer, &object))   return false ;
+
+    *id = writer->objectCount++ ;
+    writer->ids[table][idx] = *id + 1 ;
+    return true ;
+}
+
+// The turtle follows every fillend with a setpencolor restoring the pen color from before the fill,
+// and adds it again whenever the fillend is appended, so it isn't written to the stream.
+static inline bool turtleStream_isImplied(const turtleLog *log, size_t idx) {
+    return idx > 0 && log->ops[idx] == c_setpencolor && log->ops[idx - 1] == c_fillend ;
+}
+
+// Appends the command at idx of the log, and any objects it needs which haven't been defined yet,
+// to the output; the first command written must follow a call to turtleStreamWriter_beginSegment.
+// Commands the turtle adds on its own are skipped. Returns false if memory could not be allocated or
+// the describer failed.
+static bool turtleStreamWriter_writeCommand(turtleStreamWriter *writer, const turtleLog *log, size_t idx,
+                                            turtleStreamDescriber describe, void *context) {
+    if (turtleStream_isImplied(log, idx)) return true ;
+
+    uint8_t op   = log->ops[idx] ;
+    uint8_t argc = turtleLog_argCount(op) ;
+    double  *args = turtleLog_args(log, idx) ;
+
+    // objects have to be defined before the command refers to them
+    uint32_t ids[T_MAX_ARGUMENTS] ;
+    for (uint8_t i = 0 ; i < argc ; i++) {
+        char type = turtleLog_argType(op, i) ;
+        if (type != 'n' && !turtleStreamWriter_objectId(writer, type, (uint32_t)args[i], &ids[i], describe, context)) {
+            return false ;
+        }
+    }
+
+    if (!turtleStream_reserve(writer, 2 + (size_t)argc * 10)) return false ;
+    size_t before = writer->length ;
+    writer->bytes[writer->length++] = op ;
+
+    if (argc > 0) {
+        uint8_t flags = 0 ;
+        for (uint8_t i = 0 ; i < argc ; i++) {
+            if (turtleLog_argType(op, i) == 'n' && (log->flags[idx] & T_FLAG_INTEGER(i)) && turtleStream_isVarint(args[i])) {
+                flags |= T_FLAG_INTEGER(i) ;
+            }
+        }
+        writer->bytes[writer->length++] = flags ;
+
+        for (uint8_t i = 0 ; i < argc ; i++) {
+            if (turtleLog_argType(op, i) != 'n') {
+                turtleStream_putVarint(writer, ids[i]) ;
+            } else if (flags & T_FLAG_INTEGER(i)) {
+                turtleStream_putVarint(writer, turtleStream_zigzag((int64_t)args[i])) ;
+            } else {
+                turtleStream_putDouble(writer, args[i]) ;
+            }
+        }
+    }
+
+    writer->bytesWritten += writer->length - before ;
+    writer->commandsWritten++ ;
+    return true ;
+}
+
+#pragma mark - Reader
+
+static inline void turtleStreamReader_init(turtleStreamReader *reader, const uint8_t *bytes, size_t length) {
+    turtleStreamObject *objects  = reader->objects ;
+    size_t             capacity = reader->objectCapacity ;
+    memset(reader, 0, sizeof(turtleStreamReader)) ;
+    reader->bytes          = bytes ;
+    reader->length         = length ;
+    reader->objects        = objects ;   // reused if the reader is pointed at another stream
+    reader->objectCapacity = capacity ;
+}
+
+static inline void turtleStreamReader_free(turtleStreamReader *reader) {
+    free(reader->objects) ;
+    reader->objects        = NULL ;
+    reader->objectCapacity = 0 ;
+    turtleStreamReader_init(reader, NULL, 0) ;
+}
+
+// true if the bytes start with a stream header, i.e. they aren't some other encoding of commands
+static inline bool turtleStream_isStream(const uint8_t *bytes, size_t length) {
+    return length >= T_STREAM_HEADER_LEN && memcmp(bytes, T_STREAM_MAGIC, 4) == 0 ;
+}
+
+static inline t_streamResults turtleStreamReader_fail(turtleStreamReader *reader, const char *message, size_t position) {
+    reader->error         = message ;
+    reader->errorPosition = position ;
+    return t_streamError ;
+}
+
+static inline bool turtleStreamReader_getVarint(turtleStreamReader *reader, uint64_t *value) {
+    uint64_t result = 0 ;
+    for (unsigned shift = 0 ; shift < 64 ; shift += 7) {
+        if (reader->position >= reader->length) return false ;
+        uint8_t byte = reader->bytes[reader->position++] ;
+        result |= (uint64_t)(byte & 0x7F) << shift ;
+        if (!(byte & 0x80)) {
+            *value = result ;
+            return true ;
+        }
+    }
+    return false ;
+}
+
+static inline bool turtleStreamReader_getDouble(turtleStreamReader *reader, double *value) {
+    if (reader->length - reader->position < 8) return false ;
+    uint64_t bits = 0 ;
+    for (int i = 0 ; i < 8 ; i++) bits |= (uint64_t)reader->bytes[reader->position++] << (i * 8) ;
+    memcpy(value, &bits, sizeof(bits)) ;
+    return true ;
+}
+
+static inline bool turtleStreamReader_failObject(turtleStreamReader *reader, const char *message, size_t position) {
+    turtleStreamReader_fail(reader, message, position) ;
+    return false ;
+}
+
+// reads the object definition which started at start; false (with the error set) if it's malformed
+static bool turtleStreamReader_readObject(turtleStreamReader *reader, size_t start) {
+    if (reader->position >= reader->length) return turtleStreamReader_failObject(reader, "truncated object", start) ;
+    if (!turtleLog_grow((void **)&reader->objects, &reader->objectCapacity, reader->objectCount + 1, sizeof(turtleStreamObject))) {
+        return turtleStreamReader_failObject(reader, "unable to allocate memory for object", start) ;
+    }
+
+    turtleStreamObject *object = &reader->objects[reader->objectCount] ;
+    memset(object, 0, sizeof(turtleStreamObject)) ;
+    object->kind = reader->bytes[reader->position++] ;
+
+    uint64_t value = 0 ;
+    switch(object->kind) {
+        case t_streamString:
+            if (!turtleStreamReader_getVarint(reader, &value) || value > reader->length - reader->position) {
+                return turtleStreamReader_failObject(reader, "truncated string", start) ;
+            }
+            object->string    = (const char *)(reader->bytes + reader->position) ;
+            object->length    = (size_t)value ;
+            reader->position += (size_t)value ;
+            break ;
+        case t_streamPalette:
+            if (!turtleStreamReader_getVarint(reader, &value)) return turtleStreamReader_failObject(reader, "truncated palette index", start) ;
+            if (value > 255) return turtleStreamReader_failObject(reader, "palette index must be between 0 and 255 inclusive", start) ;
+            object->palette = (uint32_t)value ;
+            break ;
+        case t_streamColor:
+            if (reader->position >= reader->length) return turtleStreamReader_failObject(reader, "truncated color", start) ;
+            object->componentCount = reader->bytes[reader->position++] ;
+            if (object->componentCount < 3 || object->componentCount > 4) {
+                return turtleStreamReader_failObject(reader, "color must have 3 or 4 components", start) ;
+            }
+            for (uint8_t i = 0 ; i < object->componentCount ; i++) {
+                if (!turtleStreamReader_getDouble(reader, &object->components[i])) {
+                    return turtleStreamReader_failObject(reader, "truncated color", start) ;
+                }
+                if (!isfinite(object->components[i])) return turtleStreamReader_failObject(reader, "color components must be finite numbers", start) ;
+            }
+            break ;
+        default:
+            return turtleStreamReader_failObject(reader, "unrecognized object kind", start) ;
+    }
+
+    reader->objectCount++ ;
+    return true ;
+}
+
+// Reads up to and including the next command, defining any objects before it. Returns
+// t_streamCommand with the command in the reader, t_streamEnd once every byte has been read, or
+// t_streamError with a message and the byte offset of the record at fault.
+static t_streamResults turtleStreamReader_next(turtleStreamReader *reader) {
+    while (reader->position < reader->length) {
+        size_t  start = reader->position ;
+        uint8_t byte  = reader->bytes[reader->position] ;
+
+        if (byte == (uint8_t)T_STREAM_MAGIC[0]) {
+            if (!turtleStream_isStream(reader->bytes + start, reader->length - start)) {
+                return turtleStreamReader_fail(reader, "truncated header", start) ;
+            }
+            if (reader->bytes[start + 4] != T_STREAM_VERSION) return turtleStreamReader_fail(reader, "unsupported version", start) ;
+            reader->position   += T_STREAM_HEADER_LEN ;
+            reader->objectCount = 0 ;
+            reader->inSegment   = true ;
+            reader->segments++ ;
+            continue ;
+        }
+        if (!reader->inSegment) return turtleStreamReader_fail(reader, "missing header", start) ;
+
+        reader->position++ ;
+        if (byte == T_STREAM_OBJECT) {
+            if (!turtleStreamReader_readObject(reader, start)) return t_streamError ;
+            continue ;
+        }
+        if (byte >= c__commandCount) return turtleStreamReader_fail(reader, "undefined command number", start) ;
+
+        reader->start = start ;
+        reader->op    = byte ;
+        reader->flags = 0 ;
+
+        uint8_t argc = turtleLog_argCount(byte) ;
+        if (argc > 0) {
+            if (reader->position >= reader->length) return turtleStreamReader_fail(reader, "truncated arguments", start) ;
+            reader->flags = reader->bytes[reader->position++] & (uint8_t)~T_FLAG_DRAWS ;
+        }
+
+        for (uint8_t i = 0 ; i < argc ; i++) {
+            uint64_t value = 0 ;
+            if (turtleLog_argType(byte, i) != 'n') {
+                if (!turtleStreamReader_getVarint(reader, &value)) return turtleStreamReader_fail(reader, "truncated arguments", start) ;
+                if (value >= reader->objectCount) return turtleStreamReader_fail(reader, "reference to undefined object", start) ;
+                reader->args[i] = (double)value ;
+            } else if (reader->flags & T_FLAG_INTEGER(i)) {
+                if (!turtleStreamReader_getVarint(reader, &value)) return turtleStreamReader_fail(reader, "truncated arguments", start) ;
+                reader->args[i] = (double)turtleStream_unzigzag(value) ;
+            } else {
+                if (!turtleStreamReader_getDouble(reader, &reader->args[i])) return turtleStreamReader_fail(reader, "truncated arguments", start) ;
+                if (!isfinite(reader->args[i])) return turtleStreamReader_fail(reader, "arguments must be finite numbers", start) ;
+            }
+        }
+        return t_streamCommand ;
+    }
+    return t_streamEnd ;
+}
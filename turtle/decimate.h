@@ -0,0 +1,177 @@
+// Level of detail decimation for runs of hs.canvas.turtle moves
+//
+// Plain C so it can be used (and measured) outside of Hammerspoon -- nothing in here knows about
+// AppKit or Lua. Recursive drawings (ferns, trees, snowflakes) spend most of their commands on moves
+// which are a pixel or less long once drawn, and stroking each of them costs as much as stroking a
+// long one. A decimator is fed the segments of a run of moves which may be stroked together (see the
+// coalescing rules of the renderers) and reduces each connected chain of them to a polyline whose
+// vertices are only kept where dropping them would move the line by more than the tolerance.
+//
+// The tolerance is in the same units as the segments; callers pass device pixels, so the result only
+// differs from the full drawing by less than the tolerance wherever it's drawn. The first and last
+// point of every chain are always kept, as is every point where the chain turns back on itself by
+// more than the tolerance, so the extent of the drawing doesn't change. The command log is never
+// touched -- decimation only changes what is handed to the stroke -- and fills aren't decimated.
+// The renderers still stroke each remaining segment on its own, so no joins are introduced.
+//
+// Checking a candidate against only the previous point would let the error build up along a slowly
+// curving chain, so the points dropped since the last kept one are remembered (up to
+// T_DECIMATE_WINDOW of them) and each must stay within the tolerance of the replacing segment.
+
+#pragma once
+
+#include "commandLog.h"
+
+#include <math.h>
+
+#define T_DECIMATE_WINDOW 32
+
+typedef struct {
+    double tolerance ;                        // 0 only drops points lying exactly on the line
+
+    // output: x, y pairs, with polylines starting at the indicies in starts
+    double *points ;
+    size_t pointCount ;
+    size_t pointCapacity ;                    // in points
+    size_t *starts ;
+    size_t lineCount ;
+    size_t lineCapacity ;
+
+    // the chain being built: the last point added which hasn't been kept or dropped yet, and the
+    // points dropped since the last kept one
+    bool   hasPending ;
+    double pendingX, pendingY ;
+    double dropped[T_DECIMATE_WINDOW * 2] ;
+    size_t droppedCount ;
+
+    // statistics
+    size_t segmentsIn ;
+    size_t segmentsOut ;
+} turtleDecimator ;
+
+#pragma mark - Lifecycle
+
+static inline void turtleDecimator_init(turtleDecimator *decimator) {
+    memset(decimator, 0, sizeof(turtleDecimator)) ;
+}
+
+static inline void turtleDecimator_free(turtleDecimator *decimator) {
+    free(decimator->points) ;
+    free(decimator->starts) ;
+    turtleDecimator_init(decimator) ;
+}
+
+// empties the output (keeping its storage and the statistics) before the next run
+static inline void turtleDecimator_reset(turtleDecimator *decimator, double tolerance) {
+    decimator->tolerance    = (tolerance > 0.0) ? tolerance : 0.0 ;
+    decimator->pointCount   = 0 ;
+    decimator->lineCount    = 0 ;
+    decimator->hasPending   = false ;
+    decimator->droppedCount = 0 ;
+}
+
+static inline void turtleDecimator_resetStatistics(turtleDecimator *decimator) {
+    decimator->segmentsIn  = 0 ;
+    decimator->segmentsOut = 0 ;
+}
+
+static inline size_t turtleDecimator_bytesAllocated(const turtleDecimator *decimator) {
+    return decimator->pointCapacity * 2 * sizeof(double) + decimator->lineCapacity * sizeof(size_t) ;
+}
+
+#pragma mark - Output
+
+static inline bool turtleDecimator_emit(turtleDecimator *decimator, double x, double y) {
+    if (!turtleLog_grow((void **)&decimator->points, &decimator->pointCapacity, decimator->pointCount + 1, 2 * sizeof(double))) {
+        return false ;
+    }
+    decimator->points[decimator->pointCount * 2]     = x ;
+    decimator->points[decimator->pointCount * 2 + 1] = y ;
+    decimator->pointCount++ ;
+    return true ;
+}
+
+static inline size_t turtleDecimator_lineLength(const turtleDecimator *decimator, size_t line) {
+    size_t to = (line + 1 < decimator->lineCount) ? decimator->starts[line + 1] : decimator->pointCount ;
+    return to - decimator->starts[line] ;
+}
+
+static inline const double *turtleDecimator_linePoints(const turtleDecimator *decimator, size_t line) {
+    return decimator->points + decimator->starts[line] * 2 ;
+}
+
+#pragma mark - Decimation
+
+// distance from (px, py) to the segment from (ax, ay) to (bx, by)
+static inline double turtleDecimator_distance(double px, double py, double ax, double ay, double bx, double by) {
+    double dx = bx - ax, dy = by - ay ;
+    double lengthSquared = dx * dx + dy * dy ;
+    double t = (lengthSquared > 0.0) ? ((px - ax) * dx + (py - ay) * dy) / lengthSquared : 0.0 ;
+    if (t < 0.0) t = 0.0 ;
+    if (t > 1.0) t = 1.0 ;
+    return hypot(px - (ax + t * dx), py - (ay + t * dy)) ;
+}
+
+// keeps the pending point, ending whatever was dropped before it
+static inline bool turtleDecimator_keepPending(turtleDecimator *decimator) {
+    if (!decimator->hasPending) return true ;
+    if (!turtleDecimator_emit(decimator, decimator->pendingX, decimator->pendingY)) return false ;
+    decimator->segmentsOut++ ;
+    decimator->hasPending   = false ;
+    decimator->droppedCount = 0 ;
+    return true ;
+}
+
+// Ends the chain being built, keeping its last point. Call before reading the output.
+static inline bool turtleDecimator_finish(turtleDecimator *decimator) {
+    return turtleDecimator_keepPending(decimator) ;
+}
+
+// Adds the segment from (x0, y0) to (x1, y1). A segment starting exactly where the previous one ended
+// continues its chain; anything else starts a new one. Returns false if memory could not be allocated.
+static bool turtleDecimator_addSegment(turtleDecimator *decimator, double x0, double y0, double x1, double y1) {
+    decimator->segmentsIn++ ;
+
+    double lastX = 0.0, lastY = 0.0 ;
+    if (decimator->hasPending) {
+        lastX = decimator->pendingX ; lastY = decimator->pendingY ;
+    } else if (decimator->pointCount > 0) {
+        lastX = decimator->points[(decimator->pointCount - 1) * 2] ;
+        lastY = decimator->points[(decimator->pointCount - 1) * 2 + 1] ;
+    }
+
+    if (decimator->pointCount == 0 || x0 != lastX || y0 != lastY) {
+        if (!turtleDecimator_finish(decimator)) return false ;
+        if (!turtleLog_grow((void **)&decimator->starts, &decimator->lineCapacity, decimator->lineCount + 1, sizeof(size_t))) {
+            return false ;
+        }
+        decimator->starts[decimator->lineCount++] = decimator->pointCount ;
+        if (!turtleDecimator_emit(decimator, x0, y0)) return false ;
+    } else if (decimator->hasPending) {
+        // the pending point can go if it, and everything dropped before it, stays within the
+        // tolerance of the segment which would replace them
+        double anchorX = decimator->points[(decimator->pointCount - 1) * 2] ;
+        double anchorY = decimator->points[(decimator->pointCount - 1) * 2 + 1] ;
+        double tol     = decimator->tolerance ;
+        bool   canDrop = decimator->droppedCount < T_DECIMATE_WINDOW &&
+                         turtleDecimator_distance(decimator->pendingX, decimator->pendingY, anchorX, anchorY, x1, y1) <= tol ;
+
+        for (size_t i = 0 ; canDrop && i < decimator->droppedCount ; i++) {
+            canDrop = turtleDecimator_distance(decimator->dropped[i * 2], decimator->dropped[i * 2 + 1], anchorX, anchorY, x1, y1) <= tol ;
+        }
+
+        if (canDrop) {
+            decimator->dropped[decimator->droppedCount * 2]     = decimator->pendingX ;
+            decimator->dropped[decimator->droppedCount * 2 + 1] = decimator->pendingY ;
+            decimator->droppedCount++ ;
+            decimator->hasPending = false ;
+        } else if (!turtleDecimator_keepPending(decimator)) {
+            return false ;
+        }
+    }
+
+    decimator->pendingX   = x1 ;
+    decimator->pendingY   = y1 ;
+    decimator->hasPending = true ;
+    return true ;
+}
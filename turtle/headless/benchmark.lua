@@ -0,0 +1,304 @@
+-- Headless benchmark for the hs.canvas.turtle engine
+--
+-- Runs drawings from ../Examples/turtleGraphicExamples.lua against turtlecore (build it with `make`
+-- in this directory) and reports how fast commands are appended, how fast they're rasterized, how
+-- long export takes, and the peak memory used by the command log, tiles and rasterizer. A second
+-- table compares render time for the line drawings with decimation of short moves off and on (see
+-- turtle:decimation), a third how rendering scales as it's split across more threads (see
+-- turtle:threads), a fourth shows how long rewinding takes (see turtle:rewind) as drawings get
+-- longer, with and without checkpoints, a fifth how large saved drawings are and how fast they load
+-- (see turtle:save and turtle:load), and a sixth how much faster the line drawings are appended
+-- when written in Logo and compiled (see turtlecore.compile and turtle:run).
+--
+--     lua benchmark.lua [outputDirectory]
+--
+-- If an output directory is given, each drawing is also written there as SVG and PPM.
+
+package.cpath = "./?.so;" .. package.cpath
+local turtlecore = require("turtlecore")
+
+local outputDirectory = ...
+
+local fern
+fern = function(self, size, sign)
+    if (size >= 1) then
+        self:forward(size):right(70 * sign)
+        fern(self, size * 0.5, sign * -1)
+        self:left(70 * sign):forward(size):left(70 * sign)
+        fern(self, size * 0.5, sign)
+        self:right(70 * sign):right(7 * sign)
+        fern(self, size - 1, sign)
+        self:left(7 * sign):back(size * 2)
+    end
+end
+
+local tree
+tree = function(self, size)
+    if size < 5 then
+        self:forward(size):back(size)
+        return
+    end
+    self:forward(size / 3):left(30)
+    tree(self, size * 2/3)
+    self:right(30):forward(size / 6):right(25)
+    tree(self, size / 2)
+    self:left(25):forward(size / 3):right(25)
+    tree(self, size / 2)
+    self:left(25):forward(size / 6):back(size)
+end
+
+local drawings = {
+    {
+        name = "fern",
+        draw = function(t)
+            t:penup():back(150):pendown()
+            fern(t, 25, 1)
+            fern(t, 25, -1)
+        end,
+    }, {
+        name = "fernWheel",
+        draw = function(t)
+            for i = 0, 359, 30 do
+                t:penup():home():setheading(i):back(150):pendown()
+                fern(t, 25, 1)
+                fern(t, 25, -1)
+            end
+        end,
+    }, {
+        name = "tree",
+        draw = function(t)
+            t:penup():back(150):pendown()
+            tree(t, 300)
+        end,
+    }, {
+        name = "fills",
+        draw = function(t)
+            for i = 1, 2000 do
+                t:setpencolor({ (i * 7) % 100, (i * 13) % 100, (i * 29) % 100, 50 })
+                 :fillstart():forward(40):right(120):forward(40):right(120):forward(40):fillend(i % 8)
+                 :penup():right(17):forward(3):pendown()
+            end
+        end,
+    }, {
+        name = "arcs",
+        draw = function(t)
+            t:penreverse():setpensize({ 3, 3 })
+            for i = 1, 500 do
+                t:arc(270, (i % 200) + 5):right(7)
+            end
+        end,
+    },
+}
+
+local formatBytes = function(bytes)
+    if bytes >= 1048576 then
+        return string.format("%.1f MiB", bytes / 1048576)
+    else
+        return string.format("%.1f KiB", bytes / 1024)
+    end
+end
+
+print(string.format("%-10s %10s %14s %14s %10s %10s %10s %12s",
+      "drawing", "commands", "append cmd/s", "render cmd/s", "svg s", "ppm s", "tiles", "peak memory"))
+
+for _, drawing in ipairs(drawings) do
+    local t = turtlecore.new()
+
+    local start = os.clock()
+    drawing.draw(t)
+    local appendTime = os.clock() - start
+
+    start = os.clock()
+    t:render()
+    local renderTime = os.clock() - start
+
+    local svgTime, ppmTime = 0, 0
+    if outputDirectory then
+        start = os.clock()
+        assert(t:svg(outputDirectory .. "/" .. drawing.name .. ".svg"))
+        svgTime = os.clock() - start
+
+        start = os.clock()
+        assert(t:ppm(outputDirectory .. "/" .. drawing.name .. ".ppm"))
+        ppmTime = os.clock() - start
+    end
+
+    local memory = t:memory()
+    print(string.format("%-10s %10d %14.0f %14.0f %10.3f %10.3f %10d %12s",
+          drawing.name, t:count(),
+          t:count() / math.max(appendTime, 1e-9),
+          t:count() / math.max(renderTime, 1e-9),
+          svgTime, ppmTime, memory.tileCount, formatBytes(memory.peak)))
+end
+
+-- renders each line drawing with a few decimation tolerances, in pixels; the segments column is how
+-- many segments were actually rasterized for the moves which could be decimated
+local tolerances = { 0, 0.25, 0.5, 1 }
+
+print()
+print(string.format("%-10s %10s %10s %14s %10s %12s", "drawing", "commands", "tolerance", "render cmd/s", "speedup", "segments"))
+
+for _, drawing in ipairs(drawings) do
+    if drawing.name == "fern" or drawing.name == "fernWheel" or drawing.name == "tree" then
+        local baseline
+        for _, tolerance in ipairs(tolerances) do
+            local t = turtlecore.new():decimation(tolerance)
+            drawing.draw(t)
+
+            local start = os.clock()
+            t:render()
+            local renderTime = math.max(os.clock() - start, 1e-9)
+            baseline = baseline or renderTime
+
+            local stats = t:decimation()
+            print(string.format("%-10s %10d %10.2f %14.0f %9.2fx %12s",
+                  drawing.name, t:count(), tolerance, t:count() / renderTime, baseline / renderTime,
+                  (tolerance > 0) and string.format("%d/%d", stats.segmentsOut, stats.segmentsIn) or "-"))
+        end
+    end
+end
+
+-- renders each drawing with 1, 2, 4, ... threads up to the number of processors (timed with
+-- turtlecore.clock, since os.clock adds up every thread's time); fills and arcs use translucent
+-- colors and reverse mode, which only come out right because layers are applied in order.
+-- Drawings shorter than a few thousand commands per thread aren't split at all.
+local processors = turtlecore.processors()
+local threadCounts, count = {}, 1
+while count < processors do
+    table.insert(threadCounts, count)
+    count = count * 2
+end
+table.insert(threadCounts, processors)
+
+print()
+print(string.format("%-10s %10s %10s %14s %10s %12s", "drawing", "commands", "threads", "render cmd/s", "speedup", "layer memory"))
+
+for _, drawing in ipairs(drawings) do
+    local baseline
+    for _, threads in ipairs(threadCounts) do
+        local t = turtlecore.new():threads(threads)
+        drawing.draw(t)
+
+        local start = turtlecore.clock()
+        t:render()
+        local renderTime = math.max(turtlecore.clock() - start, 1e-9)
+        baseline = baseline or renderTime
+
+        print(string.format("%-10s %10d %10d %14.0f %9.2fx %12s",
+              drawing.name, t:count(), threads, t:count() / renderTime, baseline / renderTime,
+              formatBytes(t:threads().peakLayerBytes)))
+    end
+end
+
+-- rewinds to a few points in each drawing, from the end backwards, and reports the average time for
+-- rewinding and bringing the raster up to date again
+local rewindTargets = { 0.9, 0.7, 0.5, 0.3, 0.1 }
+local intervals     = { 0, 10000, 1000 }
+
+print()
+print(string.format("%-10s %10s %10s %14s %12s %12s", "drawing", "commands", "interval", "rewind ms", "checkpoints", "memory"))
+
+for _, size in ipairs({ 10, 15, 20, 25 }) do
+    for _, interval in ipairs(intervals) do
+        local t = turtlecore.new()
+        t:checkpoints(interval, 256 * 1048576)
+        t:penup():back(150):pendown()
+        fern(t, size, 1)
+        fern(t, size, -1)
+        t:render()
+
+        local total, elapsed = t:count(), 0
+        for _, fraction in ipairs(rewindTargets) do
+            local start = os.clock()
+            t:rewind(math.floor(total * fraction)):render()
+            elapsed = elapsed + os.clock() - start
+        end
+
+        print(string.format("%-10s %10d %10d %14.3f %12d %12s",
+              "fern " .. size, total, interval, elapsed * 1000 / #rewindTargets,
+              t:checkpoints().count, formatBytes(t:memory().checkpoints)))
+    end
+end
+
+-- saves each drawing and loads it back into a new turtle; bytes/cmd is the size of the saved file
+-- per command
+print()
+print(string.format("%-10s %10s %12s %10s %14s %14s", "drawing", "commands", "file size", "bytes/cmd", "save cmd/s", "load cmd/s"))
+
+local savePath = os.tmpname()
+for _, drawing in ipairs(drawings) do
+    local t = turtlecore.new()
+    drawing.draw(t)
+
+    local start = os.clock()
+    assert(t:save(savePath))
+    local saveTime = math.max(os.clock() - start, 1e-9)
+
+    local loaded = turtlecore.new()
+    start = os.clock()
+    assert(loaded:load(savePath))
+    local loadTime = math.max(os.clock() - start, 1e-9)
+    assert(loaded:count() == t:count(), "loaded drawing doesn't match")
+
+    local file = assert(io.open(savePath, "rb"))
+    local size = file:seek("end")
+    file:close()
+
+    print(string.format("%-10s %10d %12s %10.2f %14.0f %14.0f",
+          drawing.name, t:count(), formatBytes(size), size / t:count(), t:count() / saveTime, t:count() / loadTime))
+end
+os.remove(savePath)
+
+-- draws the fern, fern wheel and tree again from the same procedures written in Logo and compiled
+-- (see turtle:run), so every loop and recursive call runs in C rather than calling back into Lua
+local logoProcedures = [[
+to fern :size :sign
+    if :size < 1 [ stop ]
+    fd :size
+    rt 70 * :sign fern :size * 0.5 :sign * -1 lt 70 * :sign
+    fd :size
+    lt 70 * :sign fern :size * 0.5 :sign rt 70 * :sign
+    rt 7 * :sign fern :size - 1 :sign lt 7 * :sign
+    bk :size * 2
+end
+to tree :size
+    if :size < 5 [ forward :size back :size stop ]
+    forward :size / 3
+    left 30 tree :size * 2 / 3 right 30
+    forward :size / 6
+    right 25 tree :size / 2 left 25
+    forward :size / 3
+    right 25 tree :size / 2 left 25
+    forward :size / 6
+    back :size
+end
+]]
+local logoDrawings = {
+    fern      = "pu bk 150 pd fern 25 1 fern 25 -1",
+    fernWheel = "repeat 12 [ pu home seth (repcount - 1) * 30 bk 150 pd fern 25 1 fern 25 -1 ]",
+    tree      = "pu bk 150 pd tree 300",
+}
+
+print()
+print(string.format("%-10s %10s %14s %14s %10s %12s", "drawing", "commands", "lua cmd/s", "logo cmd/s", "speedup", "program"))
+
+for _, drawing in ipairs(drawings) do
+    local source = logoDrawings[drawing.name]
+    if source then
+        local t = turtlecore.new()
+        local start = os.clock()
+        drawing.draw(t)
+        local luaTime = math.max(os.clock() - start, 1e-9)
+
+        local program = assert(turtlecore.compile(logoProcedures .. source))
+        local compiled = turtlecore.new()
+        start = os.clock()
+        compiled:run(program)
+        local logoTime = math.max(os.clock() - start, 1e-9)
+        assert(compiled:count() == t:count(), "compiled drawing doesn't match")
+
+        print(string.format("%-10s %10d %14.0f %14.0f %9.2fx %12s",
+              drawing.name, t:count(), t:count() / luaTime, t:count() / logoTime, luaTime / logoTime,
+              string.format("%d bytes", #program)))
+    end
+end
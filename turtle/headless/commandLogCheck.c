@@ -0,0 +1,125 @@
+// Check of how much memory ../commandLog.h uses per command
+//
+// Builds logs of N moves through turtleState_update, the way hs.canvas.turtle and turtlecore do, for
+// a few shapes of drawing -- nothing but forward, forward and right in turn, and forward with the
+// pen color changed every 100 moves -- and reports the bytes used and allocated per command. Fails
+// if any uses more than maxBytesUsed per command (a forward is 6 bytes of opcode, flags and offset
+// plus its argument and 5 derived values) or has more than maxBytesAllocated allocated per command
+// (the arrays double as they grow, so up to twice what's used plus the style and color tables).
+//
+// Also checks that a command taking no values (penup) can be the first in a new or cleared log.
+//
+// For comparison, the NSArray of @[ @(cmd), NSMutableDictionary ] entries this replaced cost several
+// hundred bytes and half a dozen allocations for every forward.
+//
+//     make check
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "commandLog.h"
+#include "turtleEngine.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define maxBytesUsed      64.0
+#define maxBytesAllocated 128.0
+
+static double now(void) {
+    struct timespec ts ;
+    clock_gettime(CLOCK_MONOTONIC, &ts) ;
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9 ;
+}
+
+typedef enum { d_straight, d_zigzag, d_colors, d_count } drawing ;
+
+static const char *drawingNames[d_count] = { "straight", "zigzag", "colors" } ;
+
+typedef struct {
+    size_t count ;
+    double bytesUsed ;        // per command
+    double bytesAllocated ;   // per command
+    double commandsPerSecond ;
+    bool   ok ;
+} checkResult ;
+
+static bool appendCommand(turtleLog *log, turtleState *state, uint8_t op, double arg, uint32_t colorIdx) {
+    if (!turtleLog_append(log, op, &arg, 0)) return false ;
+    return turtleState_update(state, log, log->count - 1, colorIdx) ;
+}
+
+static checkResult buildLog(drawing shape, size_t moves) {
+    checkResult result = { 0, 0.0, 0.0, 0.0, true } ;
+    turtleLog   log ;
+    turtleState state ;
+
+    turtleLog_init(&log) ;
+    uint32_t colors[8] ;
+    for (uint32_t i = 0 ; i < 8 ; i++) colors[i] = turtleLog_appendColor(&log, i / 7.0, 0.5, 1.0 - i / 7.0, 1.0) ;
+    turtleState_init(&state, colors[0], colors[7]) ;
+
+    double start = now() ;
+    for (size_t i = 0 ; i < moves && result.ok ; i++) {
+        if (shape == d_colors && i % 100 == 0) {
+            // the argument is the interned specifier, which the owner of the log keeps
+            result.ok = appendCommand(&log, &state, c_setpencolor, (double)(i / 100 % 8), colors[i / 100 % 8]) ;
+        }
+        result.ok = result.ok && appendCommand(&log, &state, c_forward, 10.0, T_NO_STYLE) ;
+        if (shape == d_zigzag) result.ok = result.ok && appendCommand(&log, &state, c_right, (i % 2) ? 90.0 : -90.0, T_NO_STYLE) ;
+    }
+    double elapsed = now() - start ;
+
+    result.count             = log.count ;
+    result.bytesUsed         = (double)turtleLog_bytesUsed(&log) / (double)log.count ;
+    result.bytesAllocated    = (double)turtleLog_bytesAllocated(&log) / (double)log.count ;
+    result.commandsPerSecond = (double)log.count / elapsed ;
+    result.ok                = result.ok && result.bytesUsed <= maxBytesUsed && result.bytesAllocated <= maxBytesAllocated ;
+
+    turtleState_free(&state) ;
+    turtleLog_free(&log) ;
+    return result ;
+}
+
+// commands without arguments or derived values (penup and the like) take no space in the values
+// array, so they have to append cleanly as the first command of a new or cleared log too
+static bool checkEmptyFirstCommand(void) {
+    turtleLog log ;
+    turtleLog_init(&log) ;
+
+    bool ok = turtleLog_append(&log, c_penup, NULL, 0) != NULL && log.count == 1 ;
+    turtleLog_clear(&log) ;
+    ok = ok && turtleLog_append(&log, c_pendown, NULL, 0) != NULL && log.count == 1 ;
+    ok = ok && turtleLog_append(&log, c_forward, (double[]){ 10.0 }, 0) != NULL && log.count == 2 &&
+         turtleLog_args(&log, 1)[0] == 10.0 ;
+
+    turtleLog_free(&log) ;
+    return ok ;
+}
+
+int main(void) {
+    size_t sizes[] = { 1000, 100000, 1000000 } ;
+    bool   allOk   = true ;
+
+    printf("%-10s %8s %10s %12s %12s %14s\n", "drawing", "moves", "commands", "used/cmd", "alloc/cmd", "commands/s") ;
+    for (drawing shape = 0 ; shape < d_count ; shape++) {
+        for (size_t s = 0 ; s < sizeof(sizes) / sizeof(size_t) ; s++) {
+            checkResult result = buildLog(shape, sizes[s]) ;
+            allOk = allOk && result.ok ;
+            printf("%-10s %8zu %10zu %12.1f %12.1f %14.0f%s\n", drawingNames[shape], sizes[s], result.count, result.bytesUsed,
+                   result.bytesAllocated, result.commandsPerSecond, result.ok ? "" : "  WRONG") ;
+        }
+    }
+
+    bool emptyOk = checkEmptyFirstCommand() ;
+    printf("\npenup as the first command: %s\n", emptyOk ? "correct" : "WRONG") ;
+    if (!emptyOk) {
+        fprintf(stderr, "a command without values couldn't be appended to an empty log\n") ;
+        return 1 ;
+    }
+
+    if (!allOk) {
+        fprintf(stderr, "the command log used more than %.0f bytes (or had more than %.0f allocated) per command\n", maxBytesUsed, maxBytesAllocated) ;
+        return 1 ;
+    }
+    return 0 ;
+}
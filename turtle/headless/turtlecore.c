@@ -0,0 +1,1052 @@
+// Headless binding of the hs.canvas.turtle engine for stock Lua
+//
+// Builds with nothing more than a C compiler and the Lua headers (see the Makefile in this directory)
+// so that the command log, turtle state machine, tile cache and software rasterizer can be run,
+// profiled and compared outside of Hammerspoon. Only the plain Lua C API is used -- no LuaSkin, no
+// AppKit -- and the commands accept the same arguments as their hs.canvas.turtle counterparts,
+// except that colors are limited to palette indicies, names, "#rrggbb" strings and { r, g, b[, a] }
+// tables with components from 0 to 100.
+//
+// local turtlecore = require("turtlecore")
+// local t = turtlecore.new()
+// t:penup():back(150):pendown():forward(100)
+// t:render():ppm("out.ppm")
+
+// for sysconf and clock_gettime in turtlecore.processors and turtlecore.clock
+#define _POSIX_C_SOURCE 200809L
+
+#include "commandLog.h"
+#include "tileCache.h"
+#include "turtleEngine.h"
+#include "turtleRaster.h"
+#include "parallelRaster.h"
+#include "turtleExport.h"
+#include "checkpoints.h"
+#include "commandStream.h"
+#include "turtleProgram.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <lua.h>
+#include <lauxlib.h>
+
+#define USERDATA_TAG "turtlecore"
+
+#if LUA_VERSION_NUM < 503
+#error "turtlecore requires Lua 5.3 or newer"
+#endif
+
+// must track t_commandTypes in commandLog.h; argument types are n(umber), s(tring), c(olor) and
+// p(air) for the { number, number } tables setpos and setpensize take
+static const struct {
+    const char *name ;
+    const char *synonym ;
+    const char *arguments ;
+} commands[c__commandCount] = {
+    { "_special",       NULL,    ""   },
+    { "forward",        "fd",    "n"  },
+    { "back",           "bk",    "n"  },
+    { "left",           "lt",    "n"  },
+    { "right",          "rt",    "n"  },
+    { "setpos",         NULL,    "p"  },
+    { "setxy",          NULL,    "nn" },
+    { "setx",           NULL,    "n"  },
+    { "sety",           NULL,    "n"  },
+    { "setheading",     "seth",  "n"  },
+    { "home",           NULL,    ""   },
+    { "pendown",        "pd",    ""   },
+    { "penup",          "pu",    ""   },
+    { "penpaint",       "ppt",   ""   },
+    { "penerase",       "pe",    ""   },
+    { "penreverse",     "px",    ""   },
+    { "setpensize",     NULL,    "p"  },
+    { "arc",            NULL,    "nn" },
+    { "setscrunch",     NULL,    "nn" },
+    { "setlabelheight", NULL,    "n"  },
+    { "setlabelfont",   NULL,    "s"  },
+    { "label",          NULL,    "s"  },
+    { "setpencolor",    "setpc", "c"  },
+    { "setbackground",  "setbg", "c"  },
+    { "setpalette",     NULL,    "nc" },
+    { "fillstart",      NULL,    ""   },
+    { "fillend",        NULL,    "c"  },
+} ;
+
+static const struct {
+    const char *name ;
+    double     rgba[4] ;
+} defaultPalette[] = {
+    { "black",   { 0.0, 0.0, 0.0, 1.0 } },
+    { "blue",    { 0.0, 0.0, 1.0, 1.0 } },
+    { "green",   { 0.0, 1.0, 0.0, 1.0 } },
+    { "cyan",    { 0.0, 1.0, 1.0, 1.0 } },
+    { "red",     { 1.0, 0.0, 0.0, 1.0 } },
+    { "magenta", { 1.0, 0.0, 1.0, 1.0 } },
+    { "yellow",  { 1.0, 1.0, 0.0, 1.0 } },
+    { "white",   { 1.0, 1.0, 1.0, 1.0 } },
+} ;
+#define PALETTE_NAMED (sizeof(defaultPalette) / sizeof(defaultPalette[0]))
+#define PALETTE_SIZE  256
+
+typedef struct {
+    uint32_t name ;               // interned string index
+    double   size ;
+} labelFont ;
+
+// what a checkpoint needs to restore beyond turtleState
+typedef struct {
+    uint32_t palette[PALETTE_SIZE] ;
+    uint32_t paletteCount ;
+    uint32_t labelFontName ;
+} coreCheckpoint ;
+
+typedef struct {
+    turtleLog            log ;
+    turtleState          state ;
+    turtleTileCache      tiles ;
+    turtleRaster         raster ;
+    turtleParallelRaster parallel ;
+    size_t               rendered ;  // commands already rasterized into the tiles
+    turtleCheckpoints    checkpoints ;
+
+    uint32_t        palette[PALETTE_SIZE] ; // color table indicies
+    uint32_t        paletteCount ;
+
+    uint32_t        *colorHash ;  // open addressing; holds color index + 1, 0 is empty
+    size_t          colorHashSize ;
+
+    uint32_t        stringCount ; // strings are interned in the userdata's user value
+    uint32_t        labelFontName ;
+    labelFont       *fonts ;
+    size_t          fontCount ;
+    size_t          fontCapacity ;
+    double          currentFont ; // index into fonts, or -1 when the font or height has changed
+
+    turtleStreamReader reader ;   // kept between loads for its object table
+    uint32_t        *streamStrings ; // interned index + 1 of each string object in the segment being loaded
+    size_t          streamStringCapacity ;
+
+    turtleProgramRun program ;    // kept so an error raised part way through a run doesn't leak it
+
+    size_t          peakBytes ;
+} turtleCore ;
+
+#pragma mark - Support Functions
+
+static size_t bytesAllocated(const turtleCore *turtle) {
+    return sizeof(turtleCore) +
+           turtleLog_bytesAllocated(&turtle->log) +
+           turtle->state.fills.capacity * sizeof(turtleFill) +
+           turtleTiles_bytesAllocated(&turtle->tiles) +
+           turtleRaster_bytesAllocated(&turtle->raster) +
+           turtleParallel_bytesAllocated(&turtle->parallel) +
+           turtleCheckpoints_bytesAllocated(&turtle->checkpoints) + turtle->checkpoints.count * sizeof(coreCheckpoint) +
+           turtle->colorHashSize * sizeof(uint32_t) +
+           turtle->fontCapacity * sizeof(labelFont) ;
+}
+
+static void trackPeak(turtleCore *turtle) {
+    size_t bytes = bytesAllocated(turtle) ;
+    if (bytes > turtle->peakBytes) turtle->peakBytes = bytes ;
+}
+
+static size_t colorHashOf(const double *rgba, size_t hashSize) {
+    uint64_t h = 0xcbf29ce484222325ULL ;
+    const unsigned char *bytes = (const unsigned char *)rgba ;
+    for (size_t i = 0 ; i < sizeof(double) * 4 ; i++) h = (h ^ bytes[i]) * 0x100000001b3ULL ;
+    return (size_t)(h & (hashSize - 1)) ;
+}
+
+// returns the color table index for the color, adding it if it hasn't been seen before
+static uint32_t internColor(lua_State *L, turtleCore *turtle, const double *rgba) {
+    if ((turtle->log.colorCount + 1) * 2 > turtle->colorHashSize) {
+        size_t   newSize = (turtle->colorHashSize == 0) ? 64 : turtle->colorHashSize * 2 ;
+        uint32_t *newHash = calloc(newSize, sizeof(uint32_t)) ;
+        if (!newHash) luaL_error(L, "unable to allocate memory for color table") ;
+        for (size_t i = 0 ; i < turtle->log.colorCount ; i++) {
+            size_t slot = colorHashOf(turtle->log.colors + i * 4, newSize) ;
+            while (newHash[slot] != 0) slot = (slot + 1) & (newSize - 1) ;
+            newHash[slot] = (uint32_t)(i + 1) ;
+        }
+        free(turtle->colorHash) ;
+        turtle->colorHash     = newHash ;
+        turtle->colorHashSize = newSize ;
+    }
+
+    size_t slot = colorHashOf(rgba, turtle->colorHashSize) ;
+    while (turtle->colorHash[slot] != 0) {
+        uint32_t idx = turtle->colorHash[slot] - 1 ;
+        if (memcmp(turtle->log.colors + (size_t)idx * 4, rgba, sizeof(double) * 4) == 0) return idx ;
+        slot = (slot + 1) & (turtle->colorHashSize - 1) ;
+    }
+    uint32_t idx = turtleLog_appendColor(&turtle->log, rgba[0], rgba[1], rgba[2], rgba[3]) ;
+    if (idx == T_NO_STYLE) luaL_error(L, "unable to allocate memory for color table") ;
+    turtle->colorHash[slot] = idx + 1 ;
+    return idx ;
+}
+
+// returns the index of the string at idx in the user value at uv, adding it if necessary
+static uint32_t internString(lua_State *L, turtleCore *turtle, int uv, int idx) {
+    idx = lua_absindex(L, idx) ;
+    lua_pushvalue(L, idx) ;
+    lua_rawget(L, uv) ;
+    if (lua_isnumber(L, -1)) {
+        uint32_t result = (uint32_t)lua_tointeger(L, -1) ;
+        lua_pop(L, 1) ;
+        return result ;
+    }
+    lua_pop(L, 1) ;
+
+    uint32_t result = turtle->stringCount++ ;
+    lua_pushvalue(L, idx) ;
+    lua_pushinteger(L, (lua_Integer)result) ;
+    lua_rawset(L, uv) ;
+    lua_pushvalue(L, idx) ;
+    lua_rawseti(L, uv, (lua_Integer)result + 1) ;
+    return result ;
+}
+
+static const char *internedString(lua_State *L, int uv, double idx) {
+    lua_rawgeti(L, uv, (lua_Integer)idx + 1) ;
+    const char *result = lua_tostring(L, -1) ; // still referenced by the user value, so safe to pop
+    lua_pop(L, 1) ;
+    return result ;
+}
+
+// resolves the color argument at idx the way hs.canvas.turtle does, falling back to black
+static uint32_t colorArgument(lua_State *L, turtleCore *turtle, int idx) {
+    double rgba[4] = { 0.0, 0.0, 0.0, 1.0 } ;
+
+    if (lua_type(L, idx) == LUA_TNUMBER) {
+        lua_Integer paletteIdx = lua_tointeger(L, idx) ;
+        if (paletteIdx < 0 || paletteIdx >= (lua_Integer)turtle->paletteCount) paletteIdx = 0 ;
+        return turtle->palette[paletteIdx] ;
+    } else if (lua_type(L, idx) == LUA_TSTRING) {
+        const char *spec = lua_tostring(L, idx) ;
+        if (spec[0] == '#') {
+            unsigned long code = strtoul(spec + 1, NULL, 16) ;
+            rgba[0] = (double)((code >> 16) & 0xff) / 0xff ;
+            rgba[1] = (double)((code >>  8) & 0xff) / 0xff ;
+            rgba[2] = (double)( code        & 0xff) / 0xff ;
+        } else {
+            for (size_t i = 0 ; i < PALETTE_NAMED ; i++) {
+                if (strcmp(spec, defaultPalette[i].name) == 0) return turtle->palette[i] ;
+            }
+            luaL_argerror(L, idx, "unrecognized color name") ;
+        }
+    } else if (lua_type(L, idx) == LUA_TTABLE) {
+        size_t count = lua_rawlen(L, idx) ;
+        if (count < 3 || count > 4) luaL_argerror(L, idx, "color table must contain 3 or 4 numbers") ;
+        for (size_t i = 0 ; i < count ; i++) {
+            lua_rawgeti(L, idx, (lua_Integer)i + 1) ;
+            if (lua_type(L, -1) != LUA_TNUMBER) luaL_argerror(L, idx, "color table must contain 3 or 4 numbers") ;
+            rgba[i] = lua_tonumber(L, -1) / 100.0 ;
+            lua_pop(L, 1) ;
+        }
+    } else {
+        luaL_argerror(L, idx, "expected color") ;
+    }
+    return internColor(L, turtle, rgba) ;
+}
+
+static double finiteNumber(lua_State *L, int idx) {
+    double value = luaL_checknumber(L, idx) ;
+    if (!isfinite(value)) luaL_argerror(L, idx, "must be a finite number") ;
+    return value ;
+}
+
+#pragma mark - Checkpoints
+
+// records a checkpoint of the state after the commands currently in the log; its tiles are added by
+// captureCheckpoints once the raster catches up
+static void recordCheckpoint(lua_State *L, turtleCore *turtle) {
+    coreCheckpoint *owner = malloc(sizeof(coreCheckpoint)) ;
+    if (!owner) luaL_error(L, "unable to allocate memory for checkpoint") ;
+    memcpy(owner->palette, turtle->palette, sizeof(turtle->palette)) ;
+    owner->paletteCount  = turtle->paletteCount ;
+    owner->labelFontName = turtle->labelFontName ;
+    if (!turtleCheckpoints_record(&turtle->checkpoints, &turtle->log, &turtle->state, owner)) {
+        luaL_error(L, "unable to allocate memory for checkpoint") ;
+    }
+}
+
+// adds the tiles to any checkpoints the raster has just caught up with
+static bool captureCheckpoints(turtleCore *turtle) {
+    bool isGood = true ;
+    for (size_t i = 0 ; i < turtle->checkpoints.count ; i++) {
+        turtleCheckpoint *cp = &turtle->checkpoints.items[i] ;
+        if (cp->hasTiles || cp->commandCount != turtle->rendered) continue ;
+        isGood = turtleCheckpoints_captureTiles(&turtle->checkpoints, cp, &turtle->tiles) && isGood ;
+        break ;
+    }
+    return isGood ;
+}
+
+// the command count of the first checkpoint still waiting for its tiles, or the log's count
+static size_t nextCheckpointToCapture(const turtleCore *turtle) {
+    for (size_t i = 0 ; i < turtle->checkpoints.count ; i++) {
+        const turtleCheckpoint *cp = &turtle->checkpoints.items[i] ;
+        if (!cp->hasTiles && cp->commandCount >= turtle->rendered) return cp->commandCount ;
+    }
+    return turtle->log.count ;
+}
+
+#pragma mark - Commands
+
+static void appendCommand(lua_State *L, turtleCore *turtle, uint8_t op, const double *args, uint8_t flags, uint32_t colorIdx) ;
+
+// updates the turtle for the command at idx; when replaying, the command is already in the log along
+// with anything which followed it, so nothing new is added
+static void applyCommand(lua_State *L, turtleCore *turtle, size_t idx, uint32_t colorIdx, bool replaying) {
+    uint8_t op       = turtle->log.ops[idx] ;
+    double  *args    = turtleLog_args(&turtle->log, idx) ;
+    double  *derived = turtleLog_derived(&turtle->log, idx) ;
+
+    if (op == c_setlabelheight || op == c_setlabelfont) turtle->currentFont = -1.0 ;
+    if (op == c_setlabelfont) turtle->labelFontName = (uint32_t)args[0] ;
+    if (op == c_setpalette && args[0] >= turtle->paletteCount) {
+        for (uint32_t i = turtle->paletteCount ; i <= (uint32_t)args[0] ; i++) turtle->palette[i] = turtle->palette[0] ;
+        turtle->paletteCount = (uint32_t)args[0] + 1 ;
+    }
+    if (op == c_setpalette && args[0] > 7) turtle->palette[(size_t)args[0]] = colorIdx ; // the first 8 are fixed
+
+    if (!turtleState_update(&turtle->state, &turtle->log, idx, colorIdx)) {
+        luaL_error(L, "unable to allocate memory for fill") ;
+    }
+
+    if (op == c_label && replaying) {
+        turtle->currentFont = derived[t_labelFont] ;
+    } else if (op == c_label) {
+        if (turtle->currentFont < 0.0) {
+            if (!turtleLog_grow((void **)&turtle->fonts, &turtle->fontCapacity, turtle->fontCount + 1, sizeof(labelFont))) {
+                luaL_error(L, "unable to allocate memory for label font") ;
+            }
+            turtle->fonts[turtle->fontCount] = (labelFont){ .name = turtle->labelFontName, .size = turtle->state.labelHeight } ;
+            turtle->currentFont = (double)turtle->fontCount++ ;
+        }
+        derived[t_labelFont] = turtle->currentFont ;
+    } else if (op == c_fillend && !replaying) {
+        // reset color back to pre-fill color
+        double penColor = turtle->state.penColor ;
+        appendCommand(L, turtle, c_setpencolor, &penColor, 0, turtle->state.penColor) ;
+    }
+}
+
+// appends a command whose arguments are already in args and updates the turtle state
+static void appendCommand(lua_State *L, turtleCore *turtle, uint8_t op, const double *args, uint8_t flags, uint32_t colorIdx) {
+    if (!turtleLog_append(&turtle->log, op, args, flags)) luaL_error(L, "unable to allocate memory for command") ;
+    applyCommand(L, turtle, turtle->log.count - 1, colorIdx, false) ;
+    if (turtleCheckpoints_due(&turtle->checkpoints, turtle->log.count)) recordCheckpoint(L, turtle) ;
+}
+
+// validation beyond the argument types; NULL if the values are acceptable
+static const char *checkCommandValues(uint8_t op, const double *args) {
+    if (op == c_setpensize && !(args[0] > 0.0)) return "pen size must be greater than 0" ;
+    if (op == c_setscrunch && !(args[0] > 0.0 && args[1] > 0.0)) return "scrunch scales must be greater than 0" ;
+    if (op == c_setpalette && !(args[0] >= 0.0 && args[0] < PALETTE_SIZE)) return "palette index must be between 0 and 255" ;
+    return NULL ;
+}
+
+// upvalue 1 is the command number
+static int turtle_command(lua_State *L) {
+    turtleCore *turtle   = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    uint8_t    op        = (uint8_t)lua_tointeger(L, lua_upvalueindex(1)) ;
+    const char *types    = commands[op].arguments ;
+    double     args[T_MAX_ARGUMENTS] ;
+    uint8_t    argc      = 0 ;
+    uint8_t    flags     = 0 ;
+    uint32_t   colorIdx  = T_NO_STYLE ;
+    int        luaArg    = 2 ;
+
+    lua_getuservalue(L, 1) ;
+    int uv = lua_gettop(L) ;
+
+    for (const char *type = types ; *type ; type++, luaArg++) {
+        switch(*type) {
+            case 'n': {
+                args[argc] = finiteNumber(L, luaArg) ;
+                if (lua_isinteger(L, luaArg)) flags |= T_FLAG_INTEGER(argc) ;
+                argc++ ;
+            } break ;
+            case 'p': {
+                luaL_checktype(L, luaArg, LUA_TTABLE) ;
+                for (lua_Integer i = 1 ; i <= 2 ; i++) {
+                    lua_rawgeti(L, luaArg, i) ;
+                    if (lua_type(L, -1) != LUA_TNUMBER || !isfinite(lua_tonumber(L, -1))) {
+                        luaL_argerror(L, luaArg, "expected table of two finite numbers") ;
+                    }
+                    if (lua_isinteger(L, -1)) flags |= T_FLAG_INTEGER(argc) ;
+                    args[argc++] = lua_tonumber(L, -1) ;
+                    lua_pop(L, 1) ;
+                }
+            } break ;
+            case 's': {
+                luaL_checkstring(L, luaArg) ; // converts numbers in place, so they're interned as strings
+                args[argc++] = internString(L, turtle, uv, luaArg) ;
+            } break ;
+            case 'c': {
+                colorIdx     = colorArgument(L, turtle, luaArg) ;
+                args[argc++] = colorIdx ;
+            } break ;
+        }
+    }
+
+    const char *errMsg = checkCommandValues(op, args) ;
+    if (errMsg) luaL_argerror(L, 2, errMsg) ;
+
+    appendCommand(L, turtle, op, args, flags, colorIdx) ;
+    trackPeak(turtle) ;
+    lua_settop(L, 1) ;
+    return 1 ;
+}
+
+#pragma mark - Module Functions
+
+/// turtlecore.new([tilePixels]) -> turtle
+/// Constructor
+/// Creates a new headless turtle with hs.canvas.turtle's defaults: at home facing up with the pen down, painting black on white.
+///
+/// Parameters:
+///  * `tilePixels` - an optional integer specifying the pixels along each side of a 256 point tile; defaults to 256 (use 512 to match a retina display)
+static int turtle_new(lua_State *L) {
+    lua_Integer tilePixels = luaL_optinteger(L, 1, T_TILE_SIZE) ;
+    luaL_argcheck(L, tilePixels > 0 && tilePixels <= 4096, 1, "tile pixels must be between 1 and 4096") ;
+
+    turtleCore *turtle = lua_newuserdata(L, sizeof(turtleCore)) ;
+    memset(turtle, 0, sizeof(turtleCore)) ;
+    luaL_getmetatable(L, USERDATA_TAG) ;
+    lua_setmetatable(L, -2) ;
+    lua_newtable(L) ;
+    lua_setuservalue(L, -2) ;
+
+    turtleLog_init(&turtle->log) ;
+    turtleTiles_init(&turtle->tiles, T_TILE_SIZE, (uint32_t)tilePixels) ;
+    turtleRaster_init(&turtle->raster) ;
+    turtleParallel_init(&turtle->parallel, 1) ;
+    turtleCheckpoints_init(&turtle->checkpoints, 0, 0) ;
+    turtle->checkpoints.releaseOwner = free ;
+    for (size_t i = 0 ; i < PALETTE_NAMED ; i++) turtle->palette[i] = internColor(L, turtle, defaultPalette[i].rgba) ;
+    turtle->paletteCount = PALETTE_NAMED ;
+    turtleState_init(&turtle->state, turtle->palette[0], turtle->palette[7]) ;
+    turtle->currentFont = -1.0 ;
+
+    lua_getuservalue(L, -1) ;
+    lua_pushstring(L, "sans-serif") ;
+    turtle->labelFontName = internString(L, turtle, lua_gettop(L) - 1, -1) ;
+    lua_pop(L, 2) ;
+
+    recordCheckpoint(L, turtle) ;
+    captureCheckpoints(turtle) ;
+    trackPeak(turtle) ;
+    return 1 ;
+}
+
+/// turtlecore.processors() -> integer
+/// Function
+/// Returns the number of processors currently online, for choosing a thread count for `turtle:threads`.
+static int turtle_processors(lua_State *L) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN) ;
+    lua_pushinteger(L, (count > 0) ? (lua_Integer)count : 1) ;
+    return 1 ;
+}
+
+/// turtlecore.clock() -> number
+/// Function
+/// Returns the seconds elapsed on a monotonic clock; unlike `os.clock`, which adds up the processor time of every thread, this measures how long multi-threaded renders actually take.
+static int turtle_clock(lua_State *L) {
+    struct timespec now ;
+    clock_gettime(CLOCK_MONOTONIC, &now) ;
+    lua_pushnumber(L, (lua_Number)now.tv_sec + (lua_Number)now.tv_nsec / 1e9) ;
+    return 1 ;
+}
+
+/// turtlecore.compile(source) -> string | nil, errorMessage
+/// Function
+/// Compiles Logo source -- procedures with numeric parameters, `repeat`, `if`, `ifelse`, `stop` and the commands which take numbers -- into a program for `turtle:run`, as hs.canvas.turtle's `_compile` does. Returns nil and a message with the line at fault if it can't be compiled.
+static int turtle_compile(lua_State *L) {
+    size_t     length  = 0 ;
+    const char *source = luaL_checklstring(L, 1, &length) ;
+
+    uint8_t *program      = NULL ;
+    size_t  programLength = 0 ;
+    char    errMsg[256] ;
+    if (!turtleProgram_compile(source, length, &program, &programLength, errMsg, sizeof(errMsg))) {
+        lua_pushnil(L) ;
+        lua_pushstring(L, errMsg) ;
+        return 2 ;
+    }
+    lua_pushlstring(L, (const char *)program, programLength) ;
+    free(program) ;
+    return 1 ;
+}
+
+#pragma mark - Methods
+
+/// turtle:render() -> turtle
+/// Method
+/// Rasterizes the commands appended since the last render (or clean) into the tile cache, stopping along the way to add the raster to any checkpoints recorded since. Long stretches of commands are split across the threads set with `turtle:threads`.
+static int turtle_render(lua_State *L) {
+    turtleCore *turtle = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    bool       isGood  = true ;
+    while (isGood && turtle->rendered < turtle->log.count) {
+        size_t stop = nextCheckpointToCapture(turtle) ;
+        isGood = turtleParallel_render(&turtle->parallel, &turtle->raster, &turtle->tiles, &turtle->log, turtle->rendered, stop) ;
+        turtle->rendered = stop ;
+        // a checkpoint which can't be captured is dropped, so this can't get stuck
+        captureCheckpoints(turtle) ;
+        trackPeak(turtle) ;
+    }
+    if (!isGood) return luaL_error(L, "unable to allocate memory for tiles") ;
+    lua_settop(L, 1) ;
+    return 1 ;
+}
+
+/// turtle:clean() -> turtle
+/// Method
+/// Erases the drawing and the command log without moving the turtle or changing its pen.
+static int turtle_clean(lua_State *L) {
+    turtleCore *turtle = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    turtleLog_clear(&turtle->log) ;
+    turtleState_clean(&turtle->state) ;
+    turtleTiles_clear(&turtle->tiles) ;
+    turtle->rendered = 0 ;
+    turtleCheckpoints_clear(&turtle->checkpoints) ;
+    recordCheckpoint(L, turtle) ;
+    captureCheckpoints(turtle) ;
+    lua_settop(L, 1) ;
+    return 1 ;
+}
+
+/// turtle:rewind(count) -> turtle
+/// Method
+/// Discards every command after the first `count` and puts the turtle and the raster back the way they were at that point by restoring the nearest checkpoint and replaying the commands after it. The raster is brought up to date with the next `turtle:render`.
+static int turtle_rewind(lua_State *L) {
+    turtleCore  *turtle = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    lua_Integer count   = luaL_checkinteger(L, 2) ;
+    luaL_argcheck(L, count >= 0 && (size_t)count <= turtle->log.count, 2, "count must be between 0 and the number of commands") ;
+
+    // the base checkpoint is always complete, so there is always one to find
+    turtleCheckpoint *cp = turtleCheckpoints_find(&turtle->checkpoints, (size_t)count) ;
+    if (!cp) return luaL_error(L, "no checkpoint to rewind from") ;
+    turtleLog_truncate(&turtle->log, (size_t)count) ;
+    turtleCheckpoints_truncate(&turtle->checkpoints, (size_t)count) ;
+
+    bool           isGood = turtleCheckpoints_restore(&turtle->checkpoints, cp, &turtle->log, &turtle->state, &turtle->tiles) ;
+    coreCheckpoint *owner = cp->owner ;
+    memcpy(turtle->palette, owner->palette, sizeof(turtle->palette)) ;
+    turtle->paletteCount  = owner->paletteCount ;
+    turtle->labelFontName = owner->labelFontName ;
+    turtle->currentFont   = -1.0 ;
+    turtle->rendered      = cp->commandCount ;
+
+    for (size_t idx = cp->commandCount ; idx < (size_t)count ; idx++) {
+        applyCommand(L, turtle, idx, turtleLog_commandColor(&turtle->log, idx), true) ;
+    }
+    if (!isGood) return luaL_error(L, "unable to allocate memory for tiles") ;
+    lua_settop(L, 1) ;
+    return 1 ;
+}
+
+/// turtle:checkpoints([interval], [maxBytes]) -> turtle | table
+/// Method
+/// Sets how many commands apart checkpoints are recorded (0, the default, keeps only the checkpoint at the start of the drawing) and how many bytes their tile snapshots may use (0 for no limit). With no arguments, returns a table with the `interval`, current `spacing`, `maxBytes`, `count`, `bytes`, and the number of checkpoints `recorded` and times they've been `thinned` to fit.
+static int turtle_checkpoints(lua_State *L) {
+    turtleCore        *turtle = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    turtleCheckpoints *cps    = &turtle->checkpoints ;
+
+    if (lua_gettop(L) == 1) {
+        lua_newtable(L) ;
+        lua_pushinteger(L, (lua_Integer)cps->interval) ; lua_setfield(L, -2, "interval") ;
+        lua_pushinteger(L, (lua_Integer)cps->spacing) ;  lua_setfield(L, -2, "spacing") ;
+        lua_pushinteger(L, (lua_Integer)cps->maxBytes) ; lua_setfield(L, -2, "maxBytes") ;
+        lua_pushinteger(L, (lua_Integer)cps->count) ;    lua_setfield(L, -2, "count") ;
+        lua_pushinteger(L, (lua_Integer)cps->bytes) ;    lua_setfield(L, -2, "bytes") ;
+        lua_pushinteger(L, (lua_Integer)cps->recorded) ; lua_setfield(L, -2, "recorded") ;
+        lua_pushinteger(L, (lua_Integer)cps->thinned) ;  lua_setfield(L, -2, "thinned") ;
+        return 1 ;
+    }
+
+    lua_Integer interval = luaL_optinteger(L, 2, (lua_Integer)cps->interval) ;
+    lua_Integer maxBytes = luaL_optinteger(L, 3, (lua_Integer)cps->maxBytes) ;
+    luaL_argcheck(L, interval >= 0, 2, "interval must be 0 or greater") ;
+    luaL_argcheck(L, maxBytes >= 0, 3, "maxBytes must be 0 or greater") ;
+    turtleCheckpoints_configure(cps, (size_t)interval, (size_t)maxBytes) ;
+    lua_settop(L, 1) ;
+    return 1 ;
+}
+
+/// turtle:decimation([tolerance]) -> turtle | table
+/// Method
+/// Sets the tolerance, in pixels, within which runs of opaque moves are simplified before they're rasterized (0, the default, rasterizes every move as it was logged). The command log isn't changed and only commands rendered afterwards are affected. With no arguments, returns a table with the `tolerance` and the number of moves passed through decimation (`segmentsIn`) and segments actually rasterized for them (`segmentsOut`) so far.
+static int turtle_decimation(lua_State *L) {
+    turtleCore   *turtle = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    turtleRaster *raster = &turtle->raster ;
+
+    if (lua_gettop(L) == 1) {
+        lua_newtable(L) ;
+        lua_pushnumber(L, raster->tolerance) ;                           lua_setfield(L, -2, "tolerance") ;
+        lua_pushinteger(L, (lua_Integer)raster->decimator.segmentsIn) ;  lua_setfield(L, -2, "segmentsIn") ;
+        lua_pushinteger(L, (lua_Integer)raster->decimator.segmentsOut) ; lua_setfield(L, -2, "segmentsOut") ;
+        return 1 ;
+    }
+
+    lua_Number tolerance = luaL_checknumber(L, 2) ;
+    luaL_argcheck(L, tolerance >= 0.0, 2, "tolerance must be 0 or greater") ;
+    raster->tolerance = tolerance ;
+    turtleDecimator_resetStatistics(&raster->decimator) ;
+    lua_settop(L, 1) ;
+    return 1 ;
+}
+
+/// turtle:threads([count]) -> turtle | table
+/// Method
+/// Sets how many threads, including the calling one, `turtle:render` splits long stretches of commands across (1, the default, renders serially). Each thread's share is rounded to 8 bits per channel once, as it's applied, rather than after every command, so where antialiased edges, translucent colors or reverse mode drawn by different threads overlap, the result may differ from a serial render by a few levels per channel (at most 3 in the benchmark's drawings). With no arguments, returns a table with the `threads`, the number of `renders` which were split, the number of worker `layers` applied to the tiles, and the most bytes the layers have used at once (`peakLayerBytes`).
+static int turtle_threads(lua_State *L) {
+    turtleCore           *turtle   = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    turtleParallelRaster *parallel = &turtle->parallel ;
+
+    if (lua_gettop(L) == 1) {
+        lua_newtable(L) ;
+        lua_pushinteger(L, (lua_Integer)parallel->threads) ;        lua_setfield(L, -2, "threads") ;
+        lua_pushinteger(L, (lua_Integer)parallel->renders) ;        lua_setfield(L, -2, "renders") ;
+        lua_pushinteger(L, (lua_Integer)parallel->layersApplied) ;  lua_setfield(L, -2, "layers") ;
+        lua_pushinteger(L, (lua_Integer)parallel->peakLayerBytes) ; lua_setfield(L, -2, "peakLayerBytes") ;
+        return 1 ;
+    }
+
+    lua_Integer threads = luaL_checkinteger(L, 2) ;
+    luaL_argcheck(L, threads >= 1 && threads <= T_PARALLEL_MAX_THREADS, 2, "count must be between 1 and 64") ;
+    turtleParallel_setThreads(parallel, (size_t)threads) ;
+    lua_settop(L, 1) ;
+    return 1 ;
+}
+
+static int turtle_pos(lua_State *L) {
+    turtleCore *turtle = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    lua_newtable(L) ;
+    lua_pushnumber(L, turtle->state.x / turtle->state.scaleX) ; lua_rawseti(L, -2, 1) ;
+    lua_pushnumber(L, turtle->state.y / turtle->state.scaleY) ; lua_rawseti(L, -2, 2) ;
+    return 1 ;
+}
+
+static int turtle_heading(lua_State *L) {
+    turtleCore *turtle = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    lua_pushnumber(L, turtle->state.heading) ;
+    return 1 ;
+}
+
+static int turtle_count(lua_State *L) {
+    turtleCore *turtle = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    lua_pushinteger(L, (lua_Integer)turtle->log.count) ;
+    return 1 ;
+}
+
+/// turtle:memory() -> table
+/// Method
+/// Returns a table with the bytes currently allocated for the `log`, `tiles`, `raster` scratch space and `checkpoints`, their `total`, the `peak` total seen so far, and the number of `tileCount` tiles allocated.
+static int turtle_memory(lua_State *L) {
+    turtleCore *turtle = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    trackPeak(turtle) ;
+    lua_newtable(L) ;
+    lua_pushinteger(L, (lua_Integer)turtleLog_bytesAllocated(&turtle->log)) ;     lua_setfield(L, -2, "log") ;
+    lua_pushinteger(L, (lua_Integer)turtleTiles_bytesAllocated(&turtle->tiles)) ; lua_setfield(L, -2, "tiles") ;
+    lua_pushinteger(L, (lua_Integer)turtleRaster_bytesAllocated(&turtle->raster)) ; lua_setfield(L, -2, "raster") ;
+    lua_pushinteger(L, (lua_Integer)turtleCheckpoints_bytesAllocated(&turtle->checkpoints)) ; lua_setfield(L, -2, "checkpoints") ;
+    lua_pushinteger(L, (lua_Integer)bytesAllocated(turtle)) ;                     lua_setfield(L, -2, "total") ;
+    lua_pushinteger(L, (lua_Integer)turtle->peakBytes) ;                          lua_setfield(L, -2, "peak") ;
+    lua_pushinteger(L, (lua_Integer)turtle->tiles.count) ;                        lua_setfield(L, -2, "tileCount") ;
+    return 1 ;
+}
+
+typedef struct {
+    lua_State  *L ;
+    int        uv ;
+    turtleCore *turtle ;
+} labelContext ;
+
+static bool labelForCommand(void *context, const turtleLog *log, size_t idx, const char **text, const char **font, double *size) {
+    labelContext *ctx      = context ;
+    double       fontIdx   = turtleLog_derived(log, idx)[t_labelFont] ;
+    labelFont    *theFont  = &ctx->turtle->fonts[(size_t)fontIdx] ;
+
+    *text = internedString(ctx->L, ctx->uv, turtleLog_args(log, idx)[0]) ;
+    *font = internedString(ctx->L, ctx->uv, theFont->name) ;
+    *size = theFont->size ;
+    return true ;
+}
+
+static FILE *openForWriting(lua_State *L, int idx) {
+    const char *path = luaL_checkstring(L, idx) ;
+    FILE       *file = fopen(path, "wb") ;
+    if (!file) {
+        lua_pushnil(L) ;
+        lua_pushfstring(L, "%s: %s", path, strerror(errno)) ;
+    }
+    return file ;
+}
+
+/// turtle:svg(path) -> true | nil, errorMessage
+/// Method
+/// Writes the drawing to the file at `path` as SVG, streaming each command as it goes. Labels are included as text.
+static int turtle_svg(lua_State *L) {
+    turtleCore *turtle = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    FILE       *file   = openForWriting(L, 2) ;
+    if (!file) return 2 ;
+
+    lua_getuservalue(L, 1) ;
+    labelContext context = { .L = L, .uv = lua_gettop(L), .turtle = turtle } ;
+
+    // pad by the widest pen used so strokes along the edges aren't clipped
+    double pad = 1.0 ;
+    for (size_t i = 0 ; i < turtle->log.styleCount ; i++) pad = fmax(pad, turtle->log.styles[i].width) ;
+
+    bool isGood = turtleExport_svg(file, &turtle->log, &turtle->state, pad, labelForCommand, &context) ;
+    isGood = (fclose(file) == 0) && isGood ;
+    if (!isGood) {
+        lua_pushnil(L) ;
+        lua_pushstring(L, "error writing svg") ;
+        return 2 ;
+    }
+    lua_pushboolean(L, 1) ;
+    return 1 ;
+}
+
+/// turtle:ppm(path) -> true | nil, errorMessage
+/// Method
+/// Writes the rendered tiles (see `turtle:render`) over the background color to the file at `path` as a binary PPM, one row at a time. Labels are not rasterized.
+static int turtle_ppm(lua_State *L) {
+    turtleCore *turtle = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    FILE       *file   = openForWriting(L, 2) ;
+    if (!file) return 2 ;
+
+    bool isGood = turtleExport_ppm(file, &turtle->tiles, turtle->log.colors + (size_t)turtle->state.background * 4) ;
+    isGood = (fclose(file) == 0) && isGood ;
+    if (!isGood) {
+        lua_pushnil(L) ;
+        lua_pushstring(L, "error writing ppm") ;
+        return 2 ;
+    }
+    lua_pushboolean(L, 1) ;
+    return 1 ;
+}
+
+// describes strings and colors for the command stream; palette indicies were resolved to colors
+// when the commands were appended, so colors are always written as their components
+static bool describeObject(void *context, char type, uint32_t idx, turtleStreamObject *object) {
+    labelContext *ctx = context ;
+    if (type == 's') {
+        object->kind   = t_streamString ;
+        object->string = internedString(ctx->L, ctx->uv, idx) ;
+        object->length = strlen(object->string) ;
+    } else {
+        const double *rgba = ctx->turtle->log.colors + (size_t)idx * 4 ;
+        object->kind           = t_streamColor ;
+        object->componentCount = 4 ;
+        for (int i = 0 ; i < 4 ; i++) object->components[i] = rgba[i] * 100.0 ;
+    }
+    return true ;
+}
+
+/// turtle:save(path) -> true | nil, errorMessage
+/// Method
+/// Writes the command log to the file at `path` in the binary form described in `../commandStream.h`, which `turtle:load` and hs.canvas.turtle's `_loadCommands` can read back.
+static int turtle_save(lua_State *L) {
+    turtleCore *turtle = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    FILE       *file   = openForWriting(L, 2) ;
+    if (!file) return 2 ;
+
+    lua_getuservalue(L, 1) ;
+    labelContext       context = { .L = L, .uv = lua_gettop(L), .turtle = turtle } ;
+    turtleStreamWriter writer ;
+    turtleStreamWriter_init(&writer) ;
+
+    bool isGood = turtleStreamWriter_beginSegment(&writer) ;
+    for (size_t i = 0 ; isGood && i < turtle->log.count ; i++) {
+        isGood = turtleStreamWriter_writeCommand(&writer, &turtle->log, i, describeObject, &context) ;
+        if (isGood && (writer.length >= 65536 || i + 1 == turtle->log.count)) {
+            isGood = fwrite(writer.bytes, 1, writer.length, file) == writer.length ;
+            turtleStreamWriter_drain(&writer) ;
+        }
+    }
+    if (isGood && writer.length > 0) isGood = fwrite(writer.bytes, 1, writer.length, file) == writer.length ;
+    turtleStreamWriter_free(&writer) ;
+    isGood = (fclose(file) == 0) && isGood ;
+    if (!isGood) {
+        lua_pushnil(L) ;
+        lua_pushstring(L, "error writing commands") ;
+        return 2 ;
+    }
+    lua_pushboolean(L, 1) ;
+    return 1 ;
+}
+
+// the log color index for a color object from a command stream, resolved the way colorArgument
+// would have resolved the value it was written from; NULL errMsg if it's acceptable
+static uint32_t streamColor(lua_State *L, turtleCore *turtle, const turtleStreamObject *object, const char **errMsg) {
+    *errMsg = NULL ;
+    if (object->kind == t_streamPalette) {
+        return turtle->palette[(object->palette < turtle->paletteCount) ? object->palette : 0] ;
+    } else if (object->kind == t_streamColor) {
+        double rgba[4] = { 0.0, 0.0, 0.0, 1.0 } ;
+        for (uint8_t i = 0 ; i < object->componentCount ; i++) rgba[i] = object->components[i] / 100.0 ;
+        return internColor(L, turtle, rgba) ;
+    }
+
+    // names and "#rrggbb" strings
+    lua_pushlstring(L, object->string, object->length) ;
+    const char *spec = lua_tostring(L, -1) ;
+    bool       known = (spec[0] == '#') ;
+    for (size_t i = 0 ; !known && i < PALETTE_NAMED ; i++) known = (strcmp(spec, defaultPalette[i].name) == 0) ;
+    uint32_t colorIdx = 0 ;
+    if (known) {
+        colorIdx = colorArgument(L, turtle, -1) ;
+    } else {
+        *errMsg = "unrecognized color name" ;
+    }
+    lua_pop(L, 1) ;
+    return colorIdx ;
+}
+
+/// turtle:load(path) -> turtle | nil, errorMessage
+/// Method
+/// Appends the commands in a file written by `turtle:save` (or hs.canvas.turtle's `_saveCommands`) without calling back into Lua for each one. Loading stops at the first error; commands before it remain.
+static int turtle_load(lua_State *L) {
+    turtleCore *turtle = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    const char *path   = luaL_checkstring(L, 2) ;
+
+    // read into a userdata so it's collected if an error is raised part way through
+    FILE *file = fopen(path, "rb") ;
+    if (!file) {
+        lua_pushnil(L) ;
+        lua_pushfstring(L, "%s: %s", path, strerror(errno)) ;
+        return 2 ;
+    }
+    long    length = (fseek(file, 0, SEEK_END) == 0) ? ftell(file) : -1 ;
+    uint8_t *data  = (length > 0) ? lua_newuserdata(L, (size_t)length) : NULL ;
+    bool    isGood = data && fseek(file, 0, SEEK_SET) == 0 && fread(data, 1, (size_t)length, file) == (size_t)length ;
+    fclose(file) ;
+    if (!isGood || !turtleStream_isStream(data, (size_t)length)) {
+        lua_pushnil(L) ;
+        lua_pushfstring(L, "%s: not a file of saved turtle commands", path) ;
+        return 2 ;
+    }
+
+    lua_getuservalue(L, 1) ;
+    int                uv      = lua_gettop(L) ;
+    turtleStreamReader *reader = &turtle->reader ;
+    turtleStreamReader_init(reader, data, (size_t)length) ;
+
+    size_t          segment = 0 ;
+    t_streamResults result  = t_streamEnd ;
+    const char      *errMsg = NULL ;
+
+    while (!errMsg && (result = turtleStreamReader_next(reader)) == t_streamCommand) {
+        if (reader->segments != segment || reader->objectCount > turtle->streamStringCapacity) {
+            size_t oldCapacity = turtle->streamStringCapacity ;
+            if (!turtleLog_grow((void **)&turtle->streamStrings, &turtle->streamStringCapacity, reader->objectCount, sizeof(uint32_t))) {
+                return luaL_error(L, "unable to allocate memory for strings") ;
+            }
+            size_t from = (reader->segments != segment) ? 0 : oldCapacity ;
+            if (turtle->streamStringCapacity > from) {
+                memset(turtle->streamStrings + from, 0, (turtle->streamStringCapacity - from) * sizeof(uint32_t)) ;
+            }
+            segment = reader->segments ;
+        }
+
+        uint8_t  op       = reader->op ;
+        uint8_t  argc     = turtleLog_argCount(op) ;
+        uint32_t colorIdx = T_NO_STYLE ;
+        double   args[T_MAX_ARGUMENTS] ;
+
+        for (uint8_t i = 0 ; !errMsg && i < argc ; i++) {
+            char type = turtleLog_argType(op, i) ;
+            if (type == 'n') {
+                args[i] = reader->args[i] ;
+                continue ;
+            }
+
+            size_t                   id     = (size_t)reader->args[i] ;
+            const turtleStreamObject *object = &reader->objects[id] ;
+            if (type == 's') {
+                if (object->kind != t_streamString) {
+                    errMsg = "expected string" ;
+                } else if (turtle->streamStrings[id] == 0) {
+                    lua_pushlstring(L, object->string, object->length) ;
+                    turtle->streamStrings[id] = internString(L, turtle, uv, -1) + 1 ;
+                    lua_pop(L, 1) ;
+                }
+                if (!errMsg) args[i] = turtle->streamStrings[id] - 1 ;
+            } else {
+                colorIdx = streamColor(L, turtle, object, &errMsg) ;
+                args[i]  = colorIdx ;
+            }
+        }
+        if (!errMsg) errMsg = checkCommandValues(op, args) ;
+        if (errMsg) break ;
+
+        appendCommand(L, turtle, op, args, reader->flags, colorIdx) ;
+    }
+    trackPeak(turtle) ;
+
+    if (errMsg || result == t_streamError) {
+        lua_pushnil(L) ;
+        if (errMsg) {
+            lua_pushfstring(L, "%s: %s: %s at byte %d", path, commands[reader->op].name, errMsg, (int)reader->start) ;
+        } else {
+            lua_pushfstring(L, "%s: %s at byte %d", path, reader->error, (int)reader->errorPosition) ;
+        }
+        return 2 ;
+    }
+    lua_settop(L, 1) ;
+    return 1 ;
+}
+
+// the turtleProgramEmitter for turtle:run; colors are palette indicies
+static const char *programCommand(void *context, uint8_t op, const double *programArgs, uint8_t flags, bool *pause) {
+    labelContext *ctx     = context ;
+    double       args[T_MAX_ARGUMENTS] ;
+    uint32_t     colorIdx = T_NO_STYLE ;
+    (void)pause ; // runs here always go to completion
+
+    for (uint8_t i = 0 ; i < turtleLog_argCount(op) ; i++) {
+        args[i] = programArgs[i] ;
+        if (turtleLog_argType(op, i) == 'c') {
+            if (!(flags & T_FLAG_INTEGER(i)) || args[i] < 0.0 || args[i] >= PALETTE_SIZE) return "color must be a palette index between 0 and 255" ;
+            uint32_t paletteIdx = (uint32_t)args[i] ;
+            colorIdx  = ctx->turtle->palette[(paletteIdx < ctx->turtle->paletteCount) ? paletteIdx : 0] ;
+            args[i]   = colorIdx ;
+            flags    &= (uint8_t)~T_FLAG_INTEGER(i) ;
+        }
+    }
+    const char *errMsg = checkCommandValues(op, args) ;
+    if (errMsg) return errMsg ;
+
+    appendCommand(ctx->L, ctx->turtle, op, args, flags, colorIdx) ;
+    return NULL ;
+}
+
+/// turtle:run(program, [procedure], ...) -> turtle
+/// Method
+/// Runs a Logo program compiled by `turtlecore.compile`, or Logo source which is compiled first, to completion without calling back into Lua. `procedure` names the procedure to run with the remaining arguments as its parameters; if it's nil, the instructions outside of any procedure definition are run. Raises an error if the program can't be started or stops because of an error; commands before it remain.
+static int turtle_run(lua_State *L) {
+    turtleCore *turtle     = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    size_t     length      = 0 ;
+    const char *program    = luaL_checklstring(L, 2, &length) ;
+    size_t     nameLength  = 0 ;
+    const char *name       = luaL_optlstring(L, 3, NULL, &nameLength) ;
+    int        argc        = (lua_gettop(L) > 3) ? lua_gettop(L) - 3 : 0 ;
+    double     args[T_PROGRAM_MAX_PARAMS] ;
+
+    luaL_argcheck(L, argc <= T_PROGRAM_MAX_PARAMS, 4 + T_PROGRAM_MAX_PARAMS, "too many arguments for procedure") ;
+    for (int i = 0 ; i < argc ; i++) args[i] = finiteNumber(L, 4 + i) ;
+
+    if (!turtleProgram_isProgram((const uint8_t *)program, length)) {
+        uint8_t *compiled      = NULL ;
+        size_t  compiledLength = 0 ;
+        char    errMsg[256] ;
+        if (!turtleProgram_compile(program, length, &compiled, &compiledLength, errMsg, sizeof(errMsg))) {
+            return luaL_error(L, "%s", errMsg) ;
+        }
+        lua_pushlstring(L, (const char *)compiled, compiledLength) ;
+        free(compiled) ;
+        program = lua_tolstring(L, -1, &length) ;
+    }
+
+    if (!turtleProgram_start(&turtle->program, (const uint8_t *)program, length, name, nameLength, args, (size_t)argc)) {
+        return luaL_error(L, "%s", turtle->program.error) ;
+    }
+
+    lua_getuservalue(L, 1) ;
+    labelContext context = { .L = L, .uv = lua_gettop(L), .turtle = turtle } ;
+    t_programResults result = turtleProgram_resume(&turtle->program, programCommand, &context, 0) ;
+    trackPeak(turtle) ;
+    if (result == t_programError) {
+        if (turtle->program.errorOp != c__special) {
+            return luaL_error(L, "%s: %s", commands[turtle->program.errorOp].name, turtle->program.error) ;
+        }
+        return luaL_error(L, "%s", turtle->program.error) ;
+    }
+    lua_settop(L, 1) ;
+    return 1 ;
+}
+
+static int turtle_tostring(lua_State *L) {
+    turtleCore *turtle = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    lua_pushfstring(L, "%s: %d commands (%p)", USERDATA_TAG, (int)turtle->log.count, (void *)turtle) ;
+    return 1 ;
+}
+
+static int turtle_gc(lua_State *L) {
+    turtleCore *turtle = luaL_checkudata(L, 1, USERDATA_TAG) ;
+    turtleLog_free(&turtle->log) ;
+    turtleState_free(&turtle->state) ;
+    turtleTiles_free(&turtle->tiles) ;
+    turtleRaster_free(&turtle->raster) ;
+    turtleParallel_free(&turtle->parallel) ;
+    turtleCheckpoints_free(&turtle->checkpoints) ;
+    turtleStreamReader_free(&turtle->reader) ;
+    turtleProgram_free(&turtle->program) ;
+    free(turtle->colorHash) ;
+    free(turtle->fonts) ;
+    free(turtle->streamStrings) ;
+    turtle->colorHash     = NULL ;
+    turtle->fonts         = NULL ;
+    turtle->streamStrings = NULL ;
+    return 0 ;
+}
+
+// Metatable for userdata objects
+static const luaL_Reg userdata_metaLib[] = {
+    {"render",      turtle_render},
+    {"clean",       turtle_clean},
+    {"rewind",      turtle_rewind},
+    {"checkpoints", turtle_checkpoints},
+    {"decimation",  turtle_decimation},
+    {"threads",     turtle_threads},
+    {"pos",         turtle_pos},
+    {"heading",     turtle_heading},
+    {"count",       turtle_count},
+    {"memory",      turtle_memory},
+    {"svg",         turtle_svg},
+    {"ppm",         turtle_ppm},
+    {"save",        turtle_save},
+    {"load",        turtle_load},
+    {"run",         turtle_run},
+
+    {"__tostring",  turtle_tostring},
+    {"__gc",        turtle_gc},
+    {NULL,          NULL}
+} ;
+
+// Functions for returned object when module loads
+static const luaL_Reg moduleLib[] = {
+    {"new",        turtle_new},
+    {"processors", turtle_processors},
+    {"clock",      turtle_clock},
+    {"compile",    turtle_compile},
+    {NULL,         NULL}
+} ;
+
+int luaopen_turtlecore(lua_State *L) ;
+int luaopen_turtlecore(lua_State *L) {
+    luaL_newmetatable(L, USERDATA_TAG) ;
+    luaL_setfuncs(L, userdata_metaLib, 0) ;
+    for (lua_Integer op = 1 ; op < c__commandCount ; op++) {
+        lua_pushinteger(L, op) ;
+        lua_pushcclosure(L, turtle_command, 1) ;
+        if (commands[op].synonym) {
+            lua_pushvalue(L, -1) ;
+            lua_setfield(L, -3, commands[op].synonym) ;
+        }
+        lua_setfield(L, -2, commands[op].name) ;
+    }
+    lua_pushvalue(L, -1) ;
+    lua_setfield(L, -2, "__index") ;
+    lua_pop(L, 1) ;
+
+    lua_newtable(L) ;
+    luaL_setfuncs(L, moduleLib, 0) ;
+    return 1 ;
+}
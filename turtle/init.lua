@@ -23,6 +23,7 @@ local canvas   = require("hs.canvas")
 local screen   = require("hs.screen")
 local eventtap = require("hs.eventtap")
 local mouse    = require("hs.mouse")
+local timer    = require("hs.timer")
 
 -- don't need these directly, just their helpers
 require("hs.image")
@@ -158,7 +159,7 @@ local finspect = function(obj)
     return inspect(obj, { newline = " ", indent = "" })
 end
 
-local _backgroundQueues = setmetatable({}, {
+local _userdataKeyedMT = {
     __mode = "k",
 
     -- work around for the fact that we're using selfRefCount to allow for auto-clean on __gc
@@ -209,7 +210,12 @@ local _backgroundQueues = setmetatable({}, {
         end
         rawset(self, key, value)
     end,
-})
+}
+
+local _backgroundQueues = setmetatable({}, _userdataKeyedMT)
+
+-- commands held by _buffer until they're submitted as a batch through _appendCommands
+local _commandBuffers = setmetatable({}, _userdataKeyedMT)
 
 -- Public interface ------------------------------------------------------
 
@@ -396,17 +402,80 @@ module.turtleCanvas = function(...)
     return turtleViewObject
 end
 
--- methods with visual impact call this to allow for yields when we're running in a coroutine
-local coroutineFriendlyCheck = function(self)
+-- methods with visual impact call this to allow for yields when we're running in a coroutine; count
+-- is the number of commands issued since the last check (buffered commands arrive in batches).
+-- Whether it's time to yield is decided by _yieldCheck, by count or by time (see _yieldBudget)
+local coroutineFriendlyCheck = function(self, count)
     -- don't get tripped up by other coroutines
-    if _backgroundQueues[self] and _backgroundQueues[self].ourCoroutine then
-        if not self:_neverYield() then
-            local thread, isMain = coroutine.running()
-            if not isMain and (self:_cmdCount() % self:_yieldRatio()) == 0 then
-                coroutine.applicationYield()
+    local runner = _backgroundQueues[self]
+    if runner and runner.ourCoroutine then
+        local thread, isMain = coroutine.running()
+        if not isMain and self:_yieldCheck(count or 1) then
+            coroutine.applicationYield()
+        end
+    end
+end
+
+local __appendCommands = turtleMT._appendCommands
+
+-- submits any commands held by _buffer; level is passed to error so the message points at the
+-- code which triggered the flush
+local flushCommandBuffer = function(self, level)
+    local buffer = _commandBuffers[self]
+    if buffer and buffer.count > 0 then
+        local commands = buffer.commands
+        buffer.commands, buffer.length, buffer.count = {}, 0, 0
+        local result = __appendCommands(self, commands)
+        if type(result) == "string" then error(result, level or 3) end
+    end
+end
+
+-- adds a wrapped command to the buffer in the flat form _appendCommands expects; returns false,
+-- leaving the buffer untouched, if the arguments don't match the command's definition so the caller
+-- can fall back to _appendCommand for a proper error message
+local bufferCommand = function(self, buffer, cmdNumber, argTypes, ...)
+    if select("#", ...) ~= #argTypes then return false end
+
+    local commands, length = buffer.commands, buffer.length
+    local rollback = function()
+        for i = buffer.length + 1, length, 1 do commands[i] = nil end
+        return false
+    end
+
+    length = length + 1
+    commands[length] = cmdNumber
+    for i, argType in ipairs(argTypes) do
+        local arg = select(i, ...)
+        if type(argType) == "table" then
+            if type(arg) ~= "table" or #arg ~= #argType then return rollback() end
+            for j = 1, #argType, 1 do
+                if arg[j] == nil then return rollback() end
+                length = length + 1
+                commands[length] = arg[j]
             end
+        else
+            if arg == nil then return rollback() end
+            length = length + 1
+            commands[length] = arg
         end
     end
+    buffer.length, buffer.count = length, buffer.count + 1
+
+    -- make sure a partial batch still gets drawn once the current Lua code returns
+    if not buffer.flushTimer then
+        buffer.flushTimer = timer.doAfter(0, function()
+            buffer.flushTimer = nil
+            local ok, err = pcall(flushCommandBuffer, self)
+            if not ok then log.e(err) end
+        end)
+    end
+
+    if buffer.count >= buffer.size then
+        local count = buffer.count
+        flushCommandBuffer(self, 4)
+        coroutineFriendlyCheck(self, count)
+    end
+    return true
 end
 
 --- hs.canvas.turtle:pos() -> table
@@ -715,6 +784,7 @@ end
 ---
 ---  * Backgrounding like this may take a little longer to complete the function, but will not block Hammerspoon from completing other tasks and will make your system significantly more responsive during long running tasks.
 ---    * See [hs.canvas.turtle:_yieldRatio](#_yieldRatio) to adjust how many turtle commands are executed before each yield. This can have an impact on the total time a function takes to complete by trading Hammerspoon responsiveness for function speed.
+---    * See [hs.canvas.turtle:_yieldBudget](#_yieldBudget) to yield after a set amount of time instead, which keeps Hammerspoon responsive regardless of how long individual commands take, and [hs.canvas.turtle:_yieldStats](#_yieldStats) to see how the slices between yields are actually running.
 ---    * See [hs.canvas.turtle:_neverYield](#_neverYield) to prevent this behavior and cause the queued function(s) to run to completion before returning. If a function has already been backgrounded, once it resumes, the function will continue (followed by any additionally queued background functions) without further yielding.
 ---
 ---  * As an example, consider this function which generates a fern frond:
@@ -775,6 +845,7 @@ turtleMT._background = function(self, func, ...)
             while #runner.queue ~= 0 do
                 table.remove(runner.queue, 1)()
             end
+            self:_yieldCheck(0, true)
             runner.ourCoroutine = nil
         end)
         runner.ourCoroutine()
@@ -783,6 +854,42 @@ turtleMT._background = function(self, func, ...)
     return self
 end
 
+--- hs.canvas.turtle:_buffer([count]) -> turtleViewObject | integer | false
+--- Method
+--- Get or set whether turtle drawing commands are held in Lua and submitted to the turtle view in batches.
+---
+--- Parameters:
+---  * `count` - an optional integer greater than 0 specifying how many commands to hold before submitting them as a batch, or false to submit each command as it is issued. Defaults to false.
+---
+--- Returns:
+---  * if an argument is provided, returns the turtleViewObject; otherwise returns the current value.
+---
+--- Notes:
+---  * Buffering avoids the overhead of crossing from Lua into the turtle view for every command, which for drawings with many thousands of steps can be most of the time spent drawing.
+---  * The buffer is submitted when `count` commands have been issued, when any method other than a turtle drawing command is used (so queries like [hs.canvas.turtle:pos](#pos) always reflect every command issued), when buffering is turned off, and once the currently running Lua code returns control to Hammerspoon.
+---  * Commands are validated when they are submitted, so an error in a buffered command is reported by whichever command or method caused the submission; any commands buffered before the one in error will have been performed.
+turtleMT._buffer = function(self, ...)
+    local args = table.pack(...)
+    local buffer = _commandBuffers[self]
+
+    if args.n == 0 then
+        return buffer and buffer.size or false
+    end
+
+    local count = args[1]
+    if not (count == false or (math.type(count) == "integer" and count > 0)) then
+        error("expected integer greater than 0 or false", 2)
+    end
+
+    flushCommandBuffer(self)
+    if buffer then
+        buffer.size = count
+    elseif count then
+        _commandBuffers[self] = { commands = {}, length = 0, count = 0, size = count }
+    end
+    return self
+end
+
 turtleMT.bye = function(self, doItNoMatterWhat)
     local c = self:_canvas()
     if c then
@@ -1214,8 +1321,42 @@ end
 
 -- 6.7 Saving and Loading Pictures
 
--- savepict - not implemented at present
--- loadpict - not implemented at present
+--- hs.canvas.turtle:savepict(path) -> turtleViewObject
+--- Method
+--- Saves the turtle's drawing to a file which can be read back in with [hs.canvas.turtle:loadpict](#loadpict).
+---
+--- Parameters:
+---  * `path` - a string specifying the file to write the drawing to; it is replaced if it already exists
+---
+--- Returns:
+---  * the turtleViewObject
+---
+--- Notes:
+---  * the drawing is saved as the commands which drew it (see `hs.canvas.turtle:_saveCommands`), so it is recreated exactly, at any size, when loaded.
+turtleMT.savepict = function(self, path)
+    local ok, err = self:_saveCommands(path)
+    if not ok then error(err, 2) end
+    return self
+end
+
+--- hs.canvas.turtle:loadpict(path) -> turtleViewObject
+--- Method
+--- Clears the turtle's drawing and replaces it with one saved by [hs.canvas.turtle:savepict](#savepict).
+---
+--- Parameters:
+---  * `path` - a string specifying the file to read the drawing from
+---
+--- Returns:
+---  * the turtleViewObject
+---
+--- Notes:
+---  * the turtle is sent home, as with [hs.canvas.turtle:clearscreen](#clearscreen), before the saved commands are replayed; the pen and colors are changed only as the saved commands change them.
+turtleMT.loadpict = function(self, path)
+    local ok, err = self:clearscreen():_loadCommands(path)
+    if not ok then error(err, 2) end
+    return self
+end
+
 -- epspict  - not implemented at present; a similar function can be found with `:_image()`
 
 
@@ -1227,11 +1368,108 @@ end
 -- button   - not implemented at present
 
 
+-- Compiled Programs (unique to this module)
+
+--- hs.canvas.turtle.compile(source) -> string
+--- Function
+--- Compiles Logo source into a program which can be run by a turtle with [hs.canvas.turtle:run](#run).
+---
+--- Parameters:
+---  * `source` - a string containing Logo procedure definitions and instructions
+---
+--- Returns:
+---  * the compiled program, as a string
+---
+--- Notes:
+---  * an error is raised, with the line at fault, if the source can't be compiled.
+---  * programs can use `repeat` (with `repcount`), `if`, `ifelse`, `stop`, procedures with numeric parameters which may call themselves, arithmetic and comparisons, and the turtle commands which take numbers; colors are given as palette indicies. Anything outside of a procedure definition is the program's main procedure. See `hs.canvas.turtle._compile`.
+---  * for example, the fern from [hs.canvas.turtle:_background](#_background):
+---
+---       ```
+---       fern = hs.canvas.turtle.compile([[
+---           to fern :size :sign
+---               if :size < 1 [ stop ]
+---               fd :size
+---               rt 70 * :sign fern :size * 0.5 :sign * -1 lt 70 * :sign
+---               fd :size
+---               lt 70 * :sign fern :size * 0.5 :sign rt 70 * :sign
+---               rt 7 * :sign fern :size - 1 :sign lt 7 * :sign
+---               bk :size * 2
+---           end
+---           pu bk 150 pd
+---           fern 25 1
+---           fern 25 -1
+---       ]])
+---       hs.canvas.turtle.turtleCanvas():run(fern)
+---       ```
+module.compile = function(source)
+    local program, err = module._compile(source)
+    if not program then error(err, 2) end
+    return program
+end
+
+--- hs.canvas.turtle:run(program, [procedure], ...) -> turtleViewObject
+--- Method
+--- Runs a Logo program on the turtle.
+---
+--- Parameters:
+---  * `program`   - a program compiled by [hs.canvas.turtle.compile](#compile), or a string of Logo source which is compiled first
+---  * `procedure` - an optional string naming the procedure in the program to run; if it's nil or absent, the instructions outside of any procedure definition are run
+---  * `...`       - numbers for the procedure's parameters, if it has any
+---
+--- Returns:
+---  * the turtleViewObject
+---
+--- Notes:
+---  * the program runs in C without calling back into Lua for each command, loop or procedure call, so it's much faster than the same drawing written in Lua. Compile a program once when it's going to be run more than once.
+---  * when called from a function run by [hs.canvas.turtle:_background](#_background), the program yields just as the turtle's methods do; otherwise it runs to completion before returning.
+---  * an error is raised if the program can't be started or stops because of an error; commands performed before the error remain.
+turtleMT.run = function(self, program, procedure, ...)
+    if type(program) == "string" and program:sub(1, 4) ~= "TLGO" then
+        local err
+        program, err = module._compile(program)
+        if not program then error(err, 2) end
+    end
+
+    local run, err = self:_startProgram(program, procedure, ...)
+    if not run then error(err, 2) end
+
+    -- as with coroutineFriendlyCheck, only yield from our own coroutine
+    local mayYield = false
+    local runner = _backgroundQueues[self]
+    if runner and runner.ourCoroutine then
+        local thread, isMain = coroutine.running()
+        mayYield = not isMain
+    end
+
+    while true do
+        local done, stepErr = self:_stepProgram(run, mayYield)
+        if done then break end
+        if done == nil then error(stepErr, 2) end
+        coroutine.applicationYield()
+    end
+    return self
+end
+
+
 -- Others (unique to this module)
 
 -- _background - documented where defined
+-- _buffer     - documented where defined
 -- _neverYield - not implemented at present
 -- _yieldRatio - not implemented at present
+-- _yieldBudget - documented in internal.m
+-- _yieldStats - documented in internal.m
+-- _commandsAt - documented in internal.m
+-- _checkpoints - documented in internal.m
+-- _decimation - documented in internal.m
+-- _rewind - documented in internal.m
+-- _saveCommands - documented in internal.m
+-- _commandChunks - documented in internal.m
+-- _loadCommands - documented in internal.m
+-- _compile - documented in internal.m
+-- _startProgram - documented in internal.m
+-- _stepProgram - documented in internal.m
 -- _pause      -
 
 -- _image
@@ -1251,8 +1489,13 @@ end
 
 -- Internal use only, no need to fully document at present
 --   _appendCommand
+--   _appendCommands
 --   _canvas
 --   _cmdCount
+--   _cmdMemory
+--   _tileMemory
+--   _labelCache
+--   _yieldCheck
 --   _commands
 --   _palette
 
@@ -1264,6 +1507,7 @@ end
 for i, v in ipairs(_wrappedCommands) do
     local cmdLabel, cmdNumber = v[1], i - 1
 --     local synonyms = v[2] or {}
+    local argTypes = table.move(v, 4, #v, 1, {})
 
     if not cmdLabel:match("^_") then
         if not turtleMT[cmdLabel] then
@@ -1272,6 +1516,11 @@ for i, v in ipairs(_wrappedCommands) do
                 turtleMT[cmdLabel] = function(self, ...)
                     local args = table.pack(...)
                     if type(args[1]) ~= "table" then args[1] = { args[1], args[1] } end
+                    local buffer = _commandBuffers[self]
+                    if buffer and buffer.size and bufferCommand(self, buffer, cmdNumber, argTypes, table.unpack(args, 1, args.n)) then
+                        return self
+                    end
+                    flushCommandBuffer(self)
                     local result = self:_appendCommand(cmdNumber, table.unpack(args))
                     if type(result) == "string" then
                         error(result, 2) ;
@@ -1281,6 +1530,11 @@ for i, v in ipairs(_wrappedCommands) do
                 end
             else
                 turtleMT[cmdLabel] = function(self, ...)
+                    local buffer = _commandBuffers[self]
+                    if buffer and buffer.size and bufferCommand(self, buffer, cmdNumber, argTypes, ...) then
+                        return self
+                    end
+                    flushCommandBuffer(self)
                     local result = self:_appendCommand(cmdNumber, ...)
                     if type(result) == "string" then
                         error(result, 2) ;
@@ -1311,8 +1565,19 @@ end
 
 -- Return Module Object --------------------------------------------------
 
+-- the wrapped drawing commands can be buffered by _buffer; anything else needs to see their results
+local _bufferable = {}
+for i, v in ipairs(_wrappedCommands) do
+    if not v[1]:match("^_") then
+        _bufferable[v[1]] = true
+        for _, synonym in ipairs(v[2]) do _bufferable[synonym] = true end
+    end
+end
+
 turtleMT.__indexLookup = turtleMT.__index
 turtleMT.__index = function(self, key)
+    if not _bufferable[key] then flushCommandBuffer(self) end
+
     -- handle the methods as they are defined
     if turtleMT.__indexLookup[key] then return turtleMT.__indexLookup[key] end
     -- no "logo like" command will start with an underscore
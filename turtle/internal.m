@@ -2,39 +2,19 @@
 @import LuaSkin ;
 
 @import Darwin.C.tgmath ;
-
-// these two need to track, so I declare them here to keep them together to simplify
-// remembering to synchronize them
-typedef NS_ENUM( NSUInteger, t_commandTypes ) {
-  c__special = 0, // was used for tests with compressed strokes into single path; now uncertain about it...
-  c_forward,
-  c_back,
-  c_left,
-  c_right,
-  c_setpos,
-  c_setxy,
-  c_setx,
-  c_sety,
-  c_setheading,
-  c_home,
-  c_pendown,
-  c_penup,
-  c_penpaint,
-  c_penerase,
-  c_penreverse,
-  c_setpensize,
-  c_arc,
-  c_setscrunch,
-  c_setlabelheight,
-  c_setlabelfont,
-  c_label,
-  c_setpencolor,
-  c_setbackground,
-  c_setpalette,
-  c_fillstart,
-  c_fillend
-} ;
-
+#import <stdatomic.h>
+
+#import "commandLog.h"
+#import "tileCache.h"
+#import "turtleEngine.h"
+#import "yieldBudget.h"
+#import "spatialIndex.h"
+#import "checkpoints.h"
+#import "decimate.h"
+#import "commandStream.h"
+#import "turtleProgram.h"
+
+// t_wrappedCommands needs to track t_commandTypes in commandLog.h, so if you change one, change the other
 //  name                  synonyms       visual  type(s)
 #define t_wrappedCommands @[ \
     @[ @"_special",       @[],           @(YES)  ],                           \
@@ -72,7 +52,7 @@ typedef NS_ENUM( NSUInteger, t_commandTypes ) {
 
 //   document -- always my bane
 
-//   savepict should allow for type -- raw (default), lua, logo
+//   savepict should allow for type -- raw (default, now _saveCommands), lua, logo
 //      logo limits colors to 3 numbers (ignore alpha or NSColor tables)
 //      logo ignores mark type, converts markfill to filled and inserts it where mark was wrapping everything from mark forward
 //           skips very next command (which resets our penColor)
@@ -90,12 +70,31 @@ static int                refTable   = LUA_NOREF ;
 static int                fontMapRef = LUA_NOREF ;
 
 static const CGFloat      offScreenPadding = 0.01 ; // keep 1% space around actual content
+static const NSUInteger   maxCoalescedMoves = 4096 ; // keeps the paths built for long runs of moves reasonable
+static const size_t       minParallelCommands = 4096 ; // fewer undrawn commands than this are drawn on the main thread
+static const size_t       defaultCheckpointBytes = 64 * 1024 * 1024 ; // tile snapshots kept for _rewind
+static const size_t       streamFlushBytes = 64 * 1024 ; // output buffered by _saveCommands between writes
+static const lua_Integer  defaultChunkCommands = 4096 ; // commands in each chunk from _commandChunks
+static const size_t       programInstructionSlice = 1000000 ; // a backgrounded program yields after this many instructions even if it isn't drawing
 
 static void *myKVOContext = &myKVOContext ; // See http://nshipster.com/key-value-observing/
 
 static NSArray        *wrappedCommands ;
+// flattened argument types for each command as stored in the command log: 'n'umber, 's'tring, or
+// 'c'olor; built from wrappedCommands when the module loads so the bulk append loops don't have
+// to walk the NSArrays for every command
+static char           argumentTypes[c__commandCount][T_MAX_ARGUMENTS + 1] ;
 static NSArray        *defaultColorPalette ;
 
+// tiles hold a retained NSGraphicsContext wrapping a bitmap context on their pixels
+static void releaseTileContext(void *context) {
+    CFBridgingRelease(context) ;
+}
+
+static void releaseCheckpointOwner(void *owner) {
+    CFBridgingRelease(owner) ;
+}
+
 #define get_objectFromUserdata(objType, L, idx, tag) (objType*)*((void**)luaL_checkudata(L, idx, tag))
 
 #pragma mark - Support Functions and Classes
@@ -117,10 +116,152 @@ NSColor *NSColorFromHexColorString(NSString *colorString) {
     return result ;
 }
 
+// LuaSkin converts Lua integers into NSNumbers holding a long long, so anything not stored as a
+// floating point type came from an integer
+static BOOL isIntegerNumber(NSNumber *number) {
+    const char *type = number.objCType ;
+    return !(strcmp(type, @encode(double)) == 0 || strcmp(type, @encode(float)) == 0) ;
+}
+
+static NSCompositingOperation compositingFromPenMode(uint32_t mode) {
+    return (mode == t_penReverse) ? NSCompositingOperationXOR :
+           (mode == t_penErase)   ? NSCompositingOperationDestinationOut :
+                                    NSCompositingOperationSourceOver ;
+}
+
+// converts an object definition read from a command stream into the form the Lua methods would have
+// been given; nil if a string isn't valid UTF-8
+static NSObject *objectFromStream(const turtleStreamObject *object) {
+    switch(object->kind) {
+        case t_streamString:
+            return [[NSString alloc] initWithBytes:object->string length:object->length encoding:NSUTF8StringEncoding] ;
+        case t_streamPalette:
+            return @(object->palette) ;
+        case t_streamColor: {
+            NSMutableArray *components = [NSMutableArray arrayWithCapacity:object->componentCount] ;
+            for (uint8_t i = 0 ; i < object->componentCount ; i++) [components addObject:@(object->components[i])] ;
+            return [components copy] ;
+        }
+    }
+    return nil ;
+}
+
+static NSError *turtleError(NSString *message) {
+    return [NSError errorWithDomain:(NSString * _Nonnull)[NSString stringWithUTF8String:USERDATA_TAG]
+                               code:-1
+                           userInfo:@{ NSLocalizedDescriptionKey : message }] ;
+}
+
+// validation beyond the argument types; arguments are as flattened for the command log
+static NSString *checkCommandValues(uint8_t cmd, const double *args) {
+    if (cmd == c_setpensize) {
+        if (args[0] <= 0) return @"width must be positive" ;
+    } else if (cmd == c_setscrunch) {
+        if (args[0] <= 0) return @"xscale must be positive" ;
+        if (args[1] <= 0) return @"yscale must be positive" ;
+    } else if (cmd == c_setpalette) {
+        long idx = (long)args[0] ;
+        if (idx < 0 || idx > 255) return @"index must be between 0 and 255 inclusive" ;
+    }
+    return nil ;
+}
+
+// LRU cache of un-transformed label outlines keyed by font name, size and text; the position,
+// heading and scrunch of each label are applied to a copy of the cached path
+@interface HSTurtleGlyphCache : NSObject
+@property (nonatomic)           NSUInteger capacity ;
+@property (nonatomic, readonly) NSUInteger hits ;
+@property (nonatomic, readonly) NSUInteger misses ;
+@property (nonatomic, readonly) NSUInteger count ;
+
+- (NSBezierPath *)outlineForText:(NSString *)text inFont:(NSFont *)font ;
+@end
+
+@implementation HSTurtleGlyphCache {
+    NSMutableDictionary<NSArray *, NSBezierPath *> *_outlines ;
+    NSMutableOrderedSet<NSArray *>                 *_recentlyUsed ; // least recently used first
+}
+
+- (instancetype)init {
+    self = [super init] ;
+    if (self) {
+        _capacity     = 256 ;
+        _hits         = 0 ;
+        _misses       = 0 ;
+        _outlines     = [NSMutableDictionary dictionary] ;
+        _recentlyUsed = [NSMutableOrderedSet orderedSet] ;
+    }
+    return self ;
+}
+
+- (NSUInteger)count {
+    return _outlines.count ;
+}
+
+- (void)setCapacity:(NSUInteger)capacity {
+    _capacity = capacity ;
+    [self evictToCapacity] ;
+}
+
+- (void)evictToCapacity {
+    while (_recentlyUsed.count > _capacity) {
+        [_outlines removeObjectForKey:_recentlyUsed.firstObject] ;
+        [_recentlyUsed removeObjectAtIndex:0] ;
+    }
+}
+
+- (NSBezierPath *)outlineForText:(NSString *)text inFont:(NSFont *)font {
+    NSArray      *key     = @[ font.fontName, @(font.pointSize), text ] ;
+    NSBezierPath *outline = _outlines[key] ;
+
+    if (outline) {
+        _hits++ ;
+        [_recentlyUsed removeObject:key] ;
+        [_recentlyUsed addObject:key] ;
+        return outline ;
+    }
+
+    _misses++ ;
+    outline = [NSBezierPath bezierPath] ;
+    NSTextStorage   *storage   = [[NSTextStorage alloc] initWithString:text
+                                                            attributes:@{ NSFontAttributeName : font }] ;
+    NSLayoutManager *manager   = [[NSLayoutManager alloc] init] ;
+    NSTextContainer *container = [[NSTextContainer alloc] init] ;
+
+    [storage addLayoutManager:manager] ;
+    [manager addTextContainer:container] ;
+
+    NSRange glyphRange = [manager glyphRangeForTextContainer:container] ;
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wvla"
+    CGGlyph glyphArray[glyphRange.length + 1] ;
+#pragma clang diagnostic pop
+
+    NSUInteger glyphCount = [manager getGlyphsInRange:glyphRange glyphs:glyphArray
+                                                             properties:NULL
+                                                       characterIndexes:NULL
+                                                             bidiLevels:NULL] ;
+
+    [outline moveToPoint:NSZeroPoint] ;
+    [outline appendBezierPathWithCGGlyphs:glyphArray count:(NSInteger)glyphCount inFont:font] ;
+
+    if (_capacity > 0) {
+        _outlines[key] = outline ;
+        [_recentlyUsed addObject:key] ;
+        [self evictToCapacity] ;
+    }
+    return outline ;
+}
+
+@end
+
 @interface HSCanvasTurtleView : NSView
 @property (nonatomic)           int                    selfRefCount ;
 
-@property (nonatomic, readonly) NSMutableArray         *commandList ;
+@property (nonatomic, readonly) NSUInteger             commandCount ;
+@property (nonatomic, readonly) NSMutableArray         *internedObjects ;
+@property (nonatomic, readonly) HSTurtleGlyphCache     *glyphCache ;
 
 @property (nonatomic)           NSSize                 turtleSize ;
 @property (nonatomic)           NSImage                *turtleImage ;
@@ -152,31 +293,67 @@ NSColor *NSColorFromHexColorString(NSString *colorString) {
 @property (nonatomic)           BOOL                   renderingPaused ;
 @property (nonatomic)           BOOL                   neverYield ;
 @property (nonatomic)           lua_Integer            yieldRatio ;
+@property (nonatomic)           CGFloat                decimation ;
+
+- (const turtleLog *)commandLog ;
+- (const turtleTileCache *)tileCache ;
+- (const turtleIndex *)spatialIndex ;
+- (turtleCheckpoints *)checkpoints ;
+- (const turtleState *)turtleState ;
+- (turtleYield *)yieldScheduler ;
+- (NSIndexSet *)commandsAtPoint:(NSPoint)point withTolerance:(CGFloat)tolerance ;
+- (BOOL)rewindToCommand:(size_t)count withState:(lua_State *)L ;
 @end
 
+// passed to emitProgramCommand by resumeProgram:mayYield:done:andState:error:; error is set if a
+// command from the program couldn't be appended
+typedef struct {
+    __unsafe_unretained HSCanvasTurtleView *turtleCanvas ;
+    lua_State                              *L ;
+    BOOL                                   mayYield ;
+    __unsafe_unretained NSError            *error ;
+} programContext ;
+
+// the turtleProgramEmitter for programs run by the view; defined after HSCanvasTurtleView since it
+// calls into it
+static const char *emitProgramCommand(void *context, uint8_t cmd, const double *args, uint8_t flags, bool *pause) ;
+
 @implementation HSCanvasTurtleView {
     BOOL                   _neverRender ;
     NSWindow               *_parentWindow ;
 
-    // things clean doesn't reset -- this is where drawRect starts before rendering anything
-    CGFloat                _tInitX ;
-    CGFloat                _tInitY ;
-    CGFloat                _tInitHeading ;
-    BOOL                   _tInitPenDown ;
-    NSCompositingOperation _tInitPenMode ;
-    CGFloat                _tInitPenSize ;
-    CGFloat                _tInitScaleX ;
-    CGFloat                _tInitScaleY ;
-
-    CGFloat                _initLabelFontSize ;
-    NSString               *_initLabelFontName ;
-    NSColor                *_pInitColor ;
-    NSColor                *_bInitColor ;
-
-    NSImage                *_offScreen ;
+    // position, heading, pen and fill state; the properties above for these read from here
+    turtleState            _state ;
+
+    // slices between yields for _background; see yieldBudget.h
+    turtleYield            _yield ;
+
+    // the compiled Logo program being run by _startProgram and _stepProgram (see turtleProgram.h);
+    // _programRuns counts the runs started so a paused run can tell it has been replaced
+    turtleProgramRun       _program ;
+    lua_Integer            _programRuns ;
+
+    // the raster is kept as a sparse set of tiles (see tileCache.h), filled in from _index only
+    // where it's actually needed; _offScreenWidth and _offScreenHeight track the extent of the
+    // drawing, centered on home, for _image
+    turtleTileCache        _tiles ;
+    turtleIndex            _index ;
+    turtleDecimator        _decimator ; // scratch space for rasterizeMovesInCell: when decimation is on; other threads drawing cells get their own
     CGFloat                _offScreenWidth ;
     CGFloat                _offScreenHeight ;
-    NSUInteger             _offScreenIdx ;
+
+    // snapshots of the turtle and the tiles for _rewind (see checkpoints.h); _replaying is set while
+    // commands already in the log are re-applied after restoring one
+    turtleCheckpoints      _checkpoints ;
+    BOOL                   _replaying ;
+
+    // see commandLog.h; strings, fonts and color specifiers are stored in the log as an index
+    // into _internedObjects, NSColors used when rendering as an index into _internedColors
+    turtleLog              _log ;
+    NSMutableDictionary    *_internedObjectIndex ;
+    NSMutableArray         *_internedColors ;
+    NSMutableDictionary    *_internedColorIndex ;
+    NSFont                 *_labelFont ; // resolved from _labelFontName and the label height when first needed
 }
 
 #pragma mark - Required for Canvas compatible view -
@@ -191,32 +368,61 @@ NSColor *NSColorFromHexColorString(NSString *colorString) {
         _renderingPaused = NO ;
         _neverYield      = NO ;
         _yieldRatio      = 500 ;
+        turtleYield_init(&_yield) ;
+        turtleProgram_init(&_program) ;
+        _programRuns     = 0 ;
 
         _colorPalette    = [defaultColorPalette mutableCopy] ;
 
         _translateX      = 0.0 ;
         _translateY      = 0.0 ;
 
+        turtleLog_init(&_log) ;
+        _internedObjects     = [NSMutableArray array] ;
+        _internedObjectIndex = [NSMutableDictionary dictionary] ;
+        _internedColors      = [NSMutableArray array] ;
+        _internedColorIndex  = [NSMutableDictionary dictionary] ;
+        _glyphCache          = [[HSTurtleGlyphCache alloc] init] ;
+
+        turtleTiles_init(&_tiles, T_TILE_SIZE, T_TILE_SIZE) ;
+        turtleIndex_init(&_index, T_TILE_SIZE) ;
+        _tiles.releaseContext = releaseTileContext ;
+        turtleDecimator_init(&_decimator) ;
+        _decimation           = 0.0 ;
+
+        turtleCheckpoints_init(&_checkpoints, 0, defaultCheckpointBytes) ;
+        _checkpoints.releaseOwner = releaseCheckpointOwner ;
+        _replaying                = NO ;
+
         self.wantsLayer = YES ;
         [self resetTurtleView] ;
     }
     return self ;
 }
 
+- (void)dealloc {
+    turtleLog_free(&_log) ;
+    turtleTiles_free(&_tiles) ;
+    turtleIndex_free(&_index) ;
+    turtleDecimator_free(&_decimator) ;
+    turtleCheckpoints_free(&_checkpoints) ;
+    turtleState_free(&_state) ;
+    turtleProgram_free(&_program) ;
+}
+
 // This is the default, but I put it here as a reminder since almost everything else in
 // Hammerspoon *does* use a flipped coordinate system
 - (BOOL)isFlipped { return NO ; }
 
-- (void)drawRect:(__unused NSRect)dirtyRect {
+- (void)drawRect:(NSRect)dirtyRect {
     if (!(_neverRender || _renderingPaused)) {
-        [self updateOffScreenImage] ;
         self.layer.backgroundColor = _bColor.CGColor ;
 
         NSGraphicsContext *gc = [NSGraphicsContext currentContext];
         [gc saveGraphicsState] ;
 
-// // Shows boundary of _offScreen image for debugging purposes
-//         [_pInitColor setStroke] ;
+// // Shows boundary of _image extent for debugging purposes
+//         [_pColor setStroke] ;
 //         [[NSBezierPath bezierPathWithRect:NSMakeRect(
 //             (self.frame.size.width - _offScreenWidth)   / 2.0 + _translateX,
 //             (self.frame.size.height - _offScreenHeight) / 2.0 + _translateY,
@@ -224,26 +430,21 @@ NSColor *NSColorFromHexColorString(NSString *colorString) {
 //             _offScreenHeight
 //         )] stroke] ;
 
-        NSRect fromRect = NSMakeRect(
-            (_offScreenWidth  - self.frame.size.width)  / 2.0 - _translateX,
-            (_offScreenHeight - self.frame.size.height) / 2.0 - _translateY,
-            self.frame.size.width,
-            self.frame.size.height
+        NSPoint home = NSMakePoint(
+            self.frame.size.width  / 2.0 + _translateX,
+            self.frame.size.height / 2.0 + _translateY
         ) ;
-
-        [_offScreen drawAtPoint:NSZeroPoint
-                        fromRect:fromRect
-                       operation:NSCompositingOperationSourceOver
-                        fraction:1.0] ;
+        [self updateTilesInRect:NSOffsetRect(dirtyRect, -home.x, -home.y)] ;
+        [self drawTilesInContext:gc.CGContext withHomeAt:home inRect:dirtyRect] ;
 
         if (_turtleVisible) {
             NSPoint location = NSMakePoint(
-                _tX + self.frame.size.width  / 2.0 + _translateX,
-                _tY + self.frame.size.height / 2.0 + _translateY
+                _state.x + self.frame.size.width  / 2.0 + _translateX,
+                _state.y + self.frame.size.height / 2.0 + _translateY
             ) ;
             NSAffineTransform *turtleRotation = [[NSAffineTransform alloc] init] ;
             [turtleRotation translateXBy:location.x yBy:location.y] ;
-            [turtleRotation rotateByDegrees:(360 - _tHeading)] ;
+            [turtleRotation rotateByDegrees:(360 - _state.heading)] ;
 
             [gc saveGraphicsState];
 
@@ -319,17 +520,8 @@ NSColor *NSColorFromHexColorString(NSString *colorString) {
 }
 
 - (void)resetTurtleView {
-    _tX       = 0.0 ;
-    _tY       = 0.0 ;
-    _tHeading = 0.0 ;
-    _tPenDown = YES ;
-    _tPenMode = NSCompositingOperationSourceOver ;
-    _tPenSize = NSBezierPath.defaultLineWidth ;
-    _tScaleX  = 1.0 ;
-    _tScaleY  = 1.0 ;
-
-    _labelFontSize = 14.0 ;
     _labelFontName = @"sans-serif" ;
+    _labelFont     = nil ;
 
     _turtleVisible = YES ;
     _turtleSize    = NSMakeSize(45, 45) ;
@@ -340,31 +532,39 @@ NSColor *NSColorFromHexColorString(NSString *colorString) {
     _pColor       = _colorPalette[_pPaletteIdx][1] ;
     _bColor       = _colorPalette[_bPaletteIdx][1] ;
 
+    turtleState_free(&_state) ;
+    turtleState_init(&_state, [self internColor:_pColor], [self internColor:_bColor]) ;
+    _state.penSize = NSBezierPath.defaultLineWidth ;
+
     [self resetForClean] ;
 }
 
 - (void)resetForClean {
-    _tInitX       = _tX ;
-    _tInitY       = _tY ;
-    _tInitHeading = _tHeading ;
-    _tInitPenDown = _tPenDown ;
-    _tInitPenMode = _tPenMode ;
-    _tInitPenSize = _tPenSize ;
-    _tInitScaleX  = _tScaleX ;
-    _tInitScaleY  = _tScaleY ;
-
-    _initLabelFontSize = _labelFontSize ;
-    _initLabelFontName = _labelFontName ;
-
-    _pInitColor   = _pColor ;
-    _bInitColor   = _bColor ;
-
-    _commandList  = [NSMutableArray array] ;
+    turtleLog_clear(&_log) ;
+    turtleState_clean(&_state) ;
+
+    // nothing refers to the interned objects and colors once the log is empty, so they're let go
+    // rather than kept for the life of the view; the turtle's own colors are interned again
+    turtleLog_clearStyles(&_log) ;
+    [_internedObjects removeAllObjects] ;
+    [_internedObjectIndex removeAllObjects] ;
+    [_internedColors removeAllObjects] ;
+    [_internedColorIndex removeAllObjects] ;
+    _state.penColor   = [self internColor:_pColor] ;
+    _state.background = [self internColor:_bColor] ;
 
     _offScreenWidth  = _turtleSize.width  * (1.0 + offScreenPadding * 2.0) ;
     _offScreenHeight = _turtleSize.height * (1.0 + offScreenPadding * 2.0) ;
-    _offScreenIdx    = 0 ;
-    _offScreen       = [[NSImage alloc] initWithSize:NSMakeSize(_offScreenWidth, _offScreenHeight)] ;
+
+    // match the tile resolution to the display we're on (or will most likely be on)
+    CGFloat scale = self.window ? self.window.backingScaleFactor : NSScreen.mainScreen.backingScaleFactor ;
+    turtleTiles_clear(&_tiles) ;
+    turtleIndex_clear(&_index) ;
+    _tiles.tilePixels = (uint32_t)(T_TILE_SIZE * fmax(scale, 1.0)) ;
+
+    // there's always a checkpoint at the start of the drawing to rewind to
+    turtleCheckpoints_clear(&_checkpoints) ;
+    [self recordCheckpoint] ;
 
     self.layer.backgroundColor = _bColor.CGColor ;
     self.needsDisplay = !(_neverRender || _renderingPaused) ;
@@ -518,26 +718,7 @@ NSColor *NSColorFromHexColorString(NSString *colorString) {
                         break ;
                     }
                 }
-
-                // command specific validataion
-                if (!errMsg) {
-                    NSArray<NSNumber *> *argumentsAsNumbers = arguments ;
-                    if (cmd == c_setpensize) {
-                        NSArray<NSNumber *> *list = arguments[0] ;
-                        CGFloat number = list[0].doubleValue ;
-                        if (number <= 0) errMsg = [NSString stringWithFormat:@"%@: width must be positive", cmdName] ;
-                    } else if (cmd == c_setscrunch) {
-                        CGFloat number = argumentsAsNumbers[0].doubleValue ;
-                        if (number <= 0) errMsg = [NSString stringWithFormat:@"%@: xscale must be positive", cmdName] ;
-                        number = argumentsAsNumbers[1].doubleValue ;
-                        if (number <= 0) errMsg = [NSString stringWithFormat:@"%@: yscale must be positive", cmdName] ;
-                    } else if (cmd == c_setpalette) {
-                        NSInteger idx = argumentsAsNumbers[0].integerValue ;
-                        if (idx < 0 || idx > 255) {
-                            errMsg = [NSString stringWithFormat:@"%@: index must be between 0 and 255 inclusive", cmdName] ;
-                        }
-                    }
-                }
+                // command specific validation is done by checkCommandValues once the arguments are flattened
             }
         } else {
             errMsg = [NSString stringWithFormat:@"%@: expected %lu arguments but found %lu", cmdName, expectedArgCount, actualArgCount] ;
@@ -547,258 +728,184 @@ NSColor *NSColorFromHexColorString(NSString *colorString) {
     }
 
     if (errMsg) {
-        if (error) {
-            *error = [NSError errorWithDomain:(NSString * _Nonnull)[NSString stringWithUTF8String:USERDATA_TAG]
-                                         code:-1
-                                     userInfo:@{ NSLocalizedDescriptionKey : errMsg }] ;
-        }
+        if (error) *error = turtleError(errMsg) ;
         return NO ;
     }
     return YES ;
 }
 
-- (void)updateStateWithCommand:(NSUInteger)cmd andArguments:(nullable NSArray *)arguments andState:(lua_State *)L {
-    NSMutableDictionary *stepAttributes = _commandList.lastObject[1] ;
-
-    NSArray<NSNumber *> *argumentsAsNumbers = (NSArray *)arguments ;
-
-    CGFloat x = _tX ;
-    CGFloat y = _tY ;
-
+- (void)includeBoundsInOffScreen:(NSRect)bounds {
     CGFloat withPadding = 1.0 + offScreenPadding * 2.0 ;
 
-    switch(cmd) {
-        case c_forward:
-        case c_back:
-        case c_setpos:
-        case c_setxy:
-        case c_setx:
-        case c_sety:
-        case c_home: {
-            if (cmd == c_forward || cmd == c_back) {
-                CGFloat headingInRadians = _tHeading * M_PI / 180 ;
-                CGFloat distance = argumentsAsNumbers[0].doubleValue ;
-                if (cmd == c_back) distance = -distance ;
-                _tX = x + distance * sin(headingInRadians) * _tScaleX ;
-                _tY = y + distance * cos(headingInRadians) * _tScaleY ;
-            } else if (cmd == c_setpos) {
-                NSArray<NSNumber *> *listOfNumbers = arguments[0] ;
-                _tX = listOfNumbers[0].doubleValue * _tScaleX ;
-                _tY = listOfNumbers[1].doubleValue * _tScaleY ;
-            } else if (cmd == c_setxy) {
-                _tX = argumentsAsNumbers[0].doubleValue * _tScaleX ;
-                _tY = argumentsAsNumbers[1].doubleValue * _tScaleY ;
-            } else if (cmd == c_setx) {
-                _tX = argumentsAsNumbers[0].doubleValue * _tScaleX ;
-            } else if (cmd == c_sety) {
-                _tY = argumentsAsNumbers[0].doubleValue * _tScaleY ;
-            } else if (cmd == c_home) {
-                _tX       = 0.0 ;
-                _tY       = 0.0 ;
-                _tHeading = 0.0 ;
-            }
-
-            if (_tPenDown) {
-                NSBezierPath *strokePath = [NSBezierPath bezierPath] ;
-                strokePath.lineWidth = _tPenSize ;
-                [strokePath moveToPoint:NSMakePoint(x, y)] ;
-                [strokePath lineToPoint:NSMakePoint(_tX, _tY)] ;
-                stepAttributes[@"stroke"] = strokePath ;
-
-                NSRect strokeBounds = strokePath.bounds ;
-                _offScreenWidth  = fmax(
-                    (fabs(strokeBounds.origin.x) * 2 + strokeBounds.size.width) * withPadding,
-                    _offScreenWidth
-                ) ;
-                _offScreenHeight = fmax(
-                    (fabs(strokeBounds.origin.y) * 2 + strokeBounds.size.height) * withPadding,
-                    _offScreenHeight
-                ) ;
-            }
-            stepAttributes[@"startPoint"] = [NSValue valueWithPoint:NSMakePoint(x, y)] ;
-            stepAttributes[@"endPoint"]   = [NSValue valueWithPoint:NSMakePoint(_tX, _tY)] ;
-        } break ;
-
-        case c_left:
-        case c_right:
-        case c_setheading: {
-            CGFloat angle = argumentsAsNumbers[0].doubleValue ;
-            if (cmd == c_left) {
-                angle = _tHeading - angle ;
-            } else if (cmd == c_right) {
-                angle = _tHeading + angle ;
-         // } else if (cmd == c_setheading) { // NOP since first line in this block does this
-         //     angle = angle ;
-            }
-            _tHeading = fmod(angle, 360) ;
-        } break ;
+    _offScreenWidth  = fmax(
+        (fabs(bounds.origin.x) * 2 + bounds.size.width) * withPadding,
+        _offScreenWidth
+    ) ;
+    _offScreenHeight = fmax(
+        (fabs(bounds.origin.y) * 2 + bounds.size.height) * withPadding,
+        _offScreenHeight
+    ) ;
+}
 
-        case c_pendown:
-        case c_penup: {
-            _tPenDown = (cmd == c_pendown) ;
-        } break ;
+// Returns NO, without changing anything, if the command's color couldn't be interned; the caller
+// should drop the command.
+- (BOOL)updateStateWithCommandAtIndex:(size_t)idx andState:(lua_State *)L {
+    uint8_t  cmd      = _log.ops[idx] ;
+    double   *args    = turtleLog_args(&_log, idx) ;
+    double   *derived = turtleLog_derived(&_log, idx) ;
+    uint32_t colorIdx = T_NO_STYLE ;
 
-        case c_penpaint:
-        case c_penerase:
-        case c_penreverse: {
-            _tPenMode = (cmd == c_penreverse) ? NSCompositingOperationXOR :
-                        (cmd == c_penerase)   ? NSCompositingOperationDestinationOut :
-                                                NSCompositingOperationSourceOver ;
-            _tPenDown = YES ;
-            stepAttributes[@"penMode"] = @(_tPenMode) ;
-        } break ;
-        case c_setpensize: {
-            NSArray<NSNumber *> *list = arguments[0] ;
-            _tPenSize = list[0].doubleValue ;
-        } break ;
-        case c_arc: {
-            CGFloat angle  = argumentsAsNumbers[0].doubleValue ;
-            CGFloat radius = argumentsAsNumbers[1].doubleValue ;
-            NSBezierPath *strokePath = [NSBezierPath bezierPath] ;
-            strokePath.lineWidth = _tPenSize ;
-            [strokePath appendBezierPathWithArcWithCenter:NSMakePoint(0, 0)
-                                                   radius:radius
-                                               startAngle:((360 - _tHeading) + 90)
-                                                 endAngle:((360 - (_tHeading + angle)) + 90)
-                                                clockwise:(angle > 0)] ;
-            NSAffineTransform *scrunch = [[NSAffineTransform alloc] init] ;
-            [scrunch scaleXBy:_tScaleX yBy:_tScaleY] ;
-            [scrunch translateXBy:(_tX / _tScaleX) yBy:(_tY / _tScaleY)] ;
-            [strokePath transformUsingAffineTransform:scrunch] ;
-            stepAttributes[@"stroke"] = strokePath ;
-
-            NSRect strokeBounds = strokePath.bounds ;
-            _offScreenWidth  = fmax(
-                (fabs(strokeBounds.origin.x) * 2 + strokeBounds.size.width) * withPadding,
-                _offScreenWidth
-            ) ;
-            _offScreenHeight = fmax(
-                (fabs(strokeBounds.origin.y) * 2 + strokeBounds.size.height) * withPadding,
-                _offScreenHeight
-            ) ;
-        } break ;
-        case c_setscrunch: {
-            _tScaleX = argumentsAsNumbers[0].doubleValue ;
-            _tScaleY = argumentsAsNumbers[1].doubleValue ;
-        } break ;
+    // the engine handles the geometry and pen state (see turtleEngine.h); colors, fonts and the
+    // palette are resolved here first
+    switch(cmd) {
+        case c__special: {
+            [LuaSkin logWarn:[NSString stringWithFormat:@"%s:@updateStateWithCommandAtIndex:andState: - command code %u currently unsupported; ignoring", USERDATA_TAG, (unsigned int)cmd]] ;
+            return YES ;
+        }
         case c_setlabelheight: {
-            _labelFontSize = argumentsAsNumbers[0].doubleValue ;
+            _labelFont = nil ;
         } break ;
         case c_setlabelfont: {
-            _labelFontName = (NSString *)arguments[0] ;
-        } break ;
-        case c_label: {
-            NSString *fontName = _labelFontName ;
-            LuaSkin *skin = [LuaSkin sharedWithState:L] ;
-            [skin pushLuaRef:refTable ref:fontMapRef] ;
-            if (lua_getfield(L, -1, _labelFontName.UTF8String) != LUA_TNIL) fontName = [skin toNSObjectAtIndex:-1] ;
-            lua_pop(L, 2) ;
-
-            NSFont *theFont = [NSFont fontWithName:fontName size:_labelFontSize] ;
-            if (!theFont) theFont = [NSFont userFontOfSize:_labelFontSize] ;
-
-            NSBezierPath* strokePath   = [NSBezierPath bezierPath] ;
-            NSTextStorage *storage     = [[NSTextStorage alloc] initWithString:(NSString *)arguments[0]
-                                                                    attributes:@{ NSFontAttributeName : theFont }] ;
-            NSLayoutManager *manager   = [[NSLayoutManager alloc] init] ;
-            NSTextContainer *container = [[NSTextContainer alloc] init] ;
-
-            [storage addLayoutManager:manager] ;
-            [manager addTextContainer:container] ;
-
-            NSRange glyphRange = [manager glyphRangeForTextContainer:container] ;
-
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wvla"
-            CGGlyph glyphArray[glyphRange.length + 1] ;
-#pragma clang diagnostic pop
-
-            NSUInteger glyphCount = [manager getGlyphsInRange:glyphRange glyphs:glyphArray
-                                                                     properties:NULL
-                                                               characterIndexes:NULL
-                                                                     bidiLevels:NULL] ;
-
-            [strokePath moveToPoint:NSZeroPoint] ;
-            [strokePath appendBezierPathWithCGGlyphs:glyphArray count:(NSInteger)glyphCount inFont:theFont] ;
-            NSAffineTransform *scrunchAndTurn = [[NSAffineTransform alloc] init] ;
-            [scrunchAndTurn scaleXBy:_tScaleX yBy:_tScaleY] ;
-            [scrunchAndTurn translateXBy:(_tX / _tScaleX) yBy:(_tY / _tScaleY)] ;
-            [scrunchAndTurn rotateByDegrees:((360 - _tHeading) + 90)] ;
-            [strokePath transformUsingAffineTransform:scrunchAndTurn] ;
-//             stepAttributes[@"stroke"] = strokePath ; // I think it looks crisper with just the fill
-            stepAttributes[@"fill"] = strokePath ;
-
-            NSRect strokeBounds = strokePath.bounds ;
-            _offScreenWidth  = fmax(
-                (fabs(strokeBounds.origin.x) * 2 + strokeBounds.size.width) * withPadding,
-                _offScreenWidth
-            ) ;
-            _offScreenHeight = fmax(
-                (fabs(strokeBounds.origin.y) * 2 + strokeBounds.size.height) * withPadding,
-                _offScreenHeight
-            ) ;
+            _labelFontName = _internedObjects[(NSUInteger)args[0]] ;
+            _labelFont     = nil ;
         } break ;
         case c_setpencolor: {
-            _pColor = [self colorFromArgument:arguments[0] withState:L] ;
-            stepAttributes[@"penColor"] = _pColor ;
-            if ([(NSObject *)arguments[0] isKindOfClass:[NSNumber class]]) {
-                _pPaletteIdx = argumentsAsNumbers[0].unsignedIntegerValue ;
+            NSObject *argument = _internedObjects[(NSUInteger)args[0]] ;
+            NSColor  *newColor = [self colorFromArgument:argument withState:L] ;
+            colorIdx = [self internColor:newColor] ;
+            if (colorIdx == T_NO_STYLE) return NO ;
+            _pColor  = newColor ;
+            if ([argument isKindOfClass:[NSNumber class]]) {
+                _pPaletteIdx = ((NSNumber *)argument).unsignedIntegerValue ;
             } else {
                 _pPaletteIdx = NSUIntegerMax ;
             }
         } break ;
         case c_setbackground: {
-            _bColor = [self colorFromArgument:arguments[0] withState:L] ;
-            stepAttributes[@"backgroundColor"] = _bColor ;
-            if ([(NSObject *)arguments[0] isKindOfClass:[NSNumber class]]) {
-                _bPaletteIdx = argumentsAsNumbers[0].unsignedIntegerValue ;
+            NSObject *argument = _internedObjects[(NSUInteger)args[0]] ;
+            NSColor  *newColor = [self colorFromArgument:argument withState:L] ;
+            colorIdx = [self internColor:newColor] ;
+            if (colorIdx == T_NO_STYLE) return NO ;
+            _bColor  = newColor ;
+            if ([argument isKindOfClass:[NSNumber class]]) {
+                _bPaletteIdx = ((NSNumber *)argument).unsignedIntegerValue ;
             } else {
                 _bPaletteIdx = NSUIntegerMax ;
             }
         } break ;
         case c_setpalette: {
-            NSUInteger paletteIdx = argumentsAsNumbers[0].unsignedIntegerValue ;
+            NSUInteger paletteIdx = (NSUInteger)args[0] ;
+            NSColor    *newColor  = [self colorFromArgument:_internedObjects[(NSUInteger)args[1]] withState:L] ;
+            colorIdx = [self internColor:newColor] ;
+            if (colorIdx == T_NO_STYLE) return NO ;
             if (paletteIdx > 7) { // we ignore changes to the first 8 colors
                 // it's eitehr this or switch to NSDictionary for a "sparse" array
                 while (paletteIdx > _colorPalette.count) _colorPalette[_colorPalette.count] = @[ @"", _colorPalette[0][1] ] ;
-                _colorPalette[paletteIdx] = @[ @"", [self colorFromArgument:arguments[1] withState:L]] ;
+                _colorPalette[paletteIdx] = @[ @"", newColor ] ;
             }
         } break ;
-        case c_fillstart: {
-            stepAttributes[@"startPoint"] = [NSValue valueWithPoint:NSMakePoint(_tX, _tY)] ;
-        } break ;
         case c_fillend: {
-            stepAttributes[@"penColor"] = [self colorFromArgument:arguments[0] withState:L] ;
-            NSBezierPath *fillPath = [NSBezierPath bezierPath] ;
-            NSUInteger startIdx = 0 ;
-            for (NSUInteger i = _commandList.count ; i > 0 ; i--) {
-                NSUInteger currentCmd = ((NSNumber *)_commandList[i - 1][0]).unsignedIntegerValue ;
-                if (currentCmd == c_fillstart) {
-                    startIdx = i - 1 ;
-                    break ;
-                }
-            }
-            BOOL hasStartPoint = NO ;
-            for (NSUInteger j = startIdx ; j < _commandList.count ; j++) {
-                NSDictionary *properties = _commandList[j][1] ;
-                if (!hasStartPoint && properties[@"startPoint"]) {
-                    hasStartPoint = YES ;
-                    [fillPath moveToPoint:((NSValue *)properties[@"startPoint"]).pointValue] ;
-                }
-                if (hasStartPoint && properties[@"endPoint"]) {
-                    [fillPath lineToPoint:((NSValue *)properties[@"endPoint"]).pointValue] ;
-                }
+            colorIdx = [self internColor:[self colorFromArgument:_internedObjects[(NSUInteger)args[0]] withState:L]] ;
+            if (colorIdx == T_NO_STYLE) return NO ;
+        } break ;
+        default:
+            break ;
+    }
+
+    if (!turtleState_update(&_state, &_log, idx, colorIdx)) {
+        [LuaSkin logError:[NSString stringWithFormat:@"%s:@updateStateWithCommandAtIndex:andState: - unable to allocate memory for fill; fill will be incomplete", USERDATA_TAG]] ;
+    }
+
+    if (cmd == c_label) {
+        if (!_labelFont) {
+            NSString *fontName = _labelFontName ;
+            LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+            [skin pushLuaRef:refTable ref:fontMapRef] ;
+            if (lua_getfield(L, -1, _labelFontName.UTF8String) != LUA_TNIL) fontName = [skin toNSObjectAtIndex:-1] ;
+            lua_pop(L, 2) ;
+
+            _labelFont = [NSFont fontWithName:fontName size:_state.labelHeight] ;
+            if (!_labelFont) _labelFont = [NSFont userFontOfSize:_state.labelHeight] ;
+        }
+        derived[t_labelFont] = [self internObject:_labelFont] ;
+
+        // the engine can't measure text, so labels are included in the bounds here
+        NSRect bounds = [self labelPathForCommandAtIndex:idx].bounds ;
+        turtleState_includeBounds(&_state, NSMinX(bounds), NSMinY(bounds), NSMaxX(bounds), NSMaxY(bounds)) ;
+        [self includeBoundsInOffScreen:bounds] ;
+        if (!turtleIndex_addBounds(&_index, idx, NSMinX(bounds), NSMinY(bounds), NSMaxX(bounds), NSMaxY(bounds), 1.0)) {
+            [LuaSkin logError:[NSString stringWithFormat:@"%s:@updateStateWithCommandAtIndex:andState: - unable to allocate memory for spatial index; label may not be drawn", USERDATA_TAG]] ;
+        }
+    } else {
+        if (turtleLog_isMove(cmd) || cmd == c_arc) {
+            double minX, minY, maxX, maxY ;
+            if (turtleLog_commandBounds(&_log, idx, &minX, &minY, &maxX, &maxY)) {
+                [self includeBoundsInOffScreen:NSMakeRect(minX, minY, maxX - minX, maxY - minY)] ;
             }
-            [fillPath closePath] ;
-            stepAttributes[@"fill"]     = fillPath ;
-            stepAttributes[@"endPoint"] = [NSValue valueWithPoint:NSMakePoint(_tX, _tY)] ;
+        }
+        // half the line width plus a little extra for antialiasing
+        if (!turtleIndex_addCommand(&_index, &_log, idx, 1.0)) {
+            [LuaSkin logError:[NSString stringWithFormat:@"%s:@updateStateWithCommandAtIndex:andState: - unable to allocate memory for spatial index; command may not be drawn", USERDATA_TAG]] ;
+        }
+        // when replaying, the setpencolor which followed is already in the log
+        if (cmd == c_fillend && !_replaying) {
             [self appendCommand:c_setpencolor withArguments:@[ _pColor ] andState:L error:NULL] ; // reset color back to pre-fill color
-        } break ;
-        default: {
-            [LuaSkin logWarn:[NSString stringWithFormat:@"%s:@updateStateWithCommand:andArguments:andState: - command code %lu currently unsupported; ignoring", USERDATA_TAG, cmd]] ;
-            return ;
         }
     }
+
+    if (!_replaying && turtleCheckpoints_due(&_checkpoints, _log.count)) [self recordCheckpoint] ;
+    return YES ;
+}
+
+// Records a checkpoint of the turtle and the tiles after the commands currently in the log. Every
+// cell is brought up to date first so the tiles captured match the log exactly; this is why
+// checkpoints beyond the base one are off unless asked for with _checkpoints.
+- (void)recordCheckpoint {
+    [self updateTilesInRect:NSMakeRect(-DBL_MAX / 4.0, -DBL_MAX / 4.0, DBL_MAX / 2.0, DBL_MAX / 2.0)] ;
+
+    NSDictionary *owner = @{
+        @"palette"       : [_colorPalette copy],
+        @"pColor"        : _pColor,
+        @"bColor"        : _bColor,
+        @"pPaletteIdx"   : @(_pPaletteIdx),
+        @"bPaletteIdx"   : @(_bPaletteIdx),
+        @"labelFontName" : _labelFontName,
+    } ;
+    turtleCheckpoint *cp = turtleCheckpoints_record(&_checkpoints, &_log, &_state, (void *)CFBridgingRetain(owner)) ;
+    if (!cp || !turtleCheckpoints_captureTiles(&_checkpoints, cp, &_tiles)) {
+        [LuaSkin logError:[NSString stringWithFormat:@"%s:@recordCheckpoint - unable to allocate memory for checkpoint", USERDATA_TAG]] ;
+    }
+}
+
+// Discards the commands after the first count and puts everything back the way it was at that
+// point: the nearest checkpoint is restored and the commands between it and count are replayed.
+- (BOOL)rewindToCommand:(size_t)count withState:(lua_State *)L {
+    turtleCheckpoint *cp = turtleCheckpoints_find(&_checkpoints, count) ;
+    if (!cp || count > _log.count) return NO ;
+
+    turtleLog_truncate(&_log, count) ;
+    turtleCheckpoints_truncate(&_checkpoints, count) ;
+    if (!turtleCheckpoints_restore(&_checkpoints, cp, &_log, &_state, &_tiles)) {
+        [LuaSkin logError:[NSString stringWithFormat:@"%s:@rewindToCommand:withState: - unable to allocate memory for tiles; drawing may be incomplete", USERDATA_TAG]] ;
+    }
+    turtleIndex_rewind(&_index, cp->commandCount) ;
+
+    NSDictionary *owner = (__bridge NSDictionary *)cp->owner ;
+    _colorPalette  = [(NSArray *)owner[@"palette"] mutableCopy] ;
+    _pColor        = owner[@"pColor"] ;
+    _bColor        = owner[@"bColor"] ;
+    _pPaletteIdx   = [(NSNumber *)owner[@"pPaletteIdx"] unsignedIntegerValue] ;
+    _bPaletteIdx   = [(NSNumber *)owner[@"bPaletteIdx"] unsignedIntegerValue] ;
+    _labelFontName = owner[@"labelFontName"] ;
+    _labelFont     = nil ;
+
+    _replaying = YES ;
+    for (size_t idx = cp->commandCount ; idx < count ; idx++) [self updateStateWithCommandAtIndex:idx andState:L] ;
+    _replaying = NO ;
+
+    self.layer.backgroundColor = _bColor.CGColor ;
+    self.needsDisplay = !(_neverRender || _renderingPaused) ;
+    return YES ;
 }
 
 - (BOOL)appendCommand:(NSUInteger)cmd withArguments:(nullable NSArray *)arguments
@@ -807,23 +914,871 @@ NSColor *NSColorFromHexColorString(NSString *colorString) {
 
     BOOL isGood = [self validateCommand:cmd withArguments:arguments error:error] ;
     if (isGood) {
-        NSArray *newCommand = @[ @(cmd), [NSMutableDictionary dictionary] ] ;
-        if (arguments) newCommand[1][@"arguments"] = arguments ;
-        [_commandList addObject:newCommand] ;
-        [self updateStateWithCommand:cmd andArguments:arguments andState:L] ;
+        // flatten into the form stored by the command log; validateCommand has already verified
+        // that the arguments match the types (and count) expected
+        double  packedArgs[T_MAX_ARGUMENTS] ;
+        uint8_t argc  = 0 ;
+        uint8_t flags = 0 ;
+
+        NSArray *cmdDetails = wrappedCommands[cmd] ;
+        for (NSUInteger i = 0 ; i < arguments.count ; i++) {
+            NSObject *expectedArgType = cmdDetails[3 + i] ;
+            if ([expectedArgType isKindOfClass:[NSArray class]]) {
+                for (NSNumber *item in (NSArray *)arguments[i]) {
+                    if (isIntegerNumber(item)) flags |= T_FLAG_INTEGER(argc) ;
+                    packedArgs[argc++] = item.doubleValue ;
+                }
+            } else if ([(NSString *)expectedArgType isEqualToString:@"number"]) {
+                NSNumber *item = arguments[i] ;
+                if (isIntegerNumber(item)) flags |= T_FLAG_INTEGER(argc) ;
+                packedArgs[argc++] = item.doubleValue ;
+            } else {
+                packedArgs[argc++] = [self internObject:arguments[i]] ;
+            }
+        }
 
-        self.needsDisplay = !(_neverRender || _renderingPaused) ;
+        isGood = [self appendFlattenedCommand:(uint8_t)cmd withArguments:packedArgs flags:flags andState:L error:error] ;
+        if (isGood) self.needsDisplay = !(_neverRender || _renderingPaused) ;
     }
 
     return isGood ;
 }
 
+// common tail of the single and bulk append methods; arguments have already been type checked,
+// flattened and, for strings and colors, interned. Does not mark the view for display.
+- (BOOL)appendFlattenedCommand:(uint8_t)cmd withArguments:(const double *)args
+                                                    flags:(uint8_t)flags
+                                                 andState:(lua_State *)L
+                                                    error:(NSError * __autoreleasing *)error {
+    NSString *errMsg = checkCommandValues(cmd, args) ;
+    if (errMsg) {
+        if (error) *error = turtleError([NSString stringWithFormat:@"%@: %@", wrappedCommands[cmd][0], errMsg]) ;
+        return NO ;
+    }
+
+    if (!turtleLog_append(&_log, cmd, args, flags)) {
+        if (error) *error = turtleError(@"unable to allocate memory for command") ;
+        return NO ;
+    }
+    if (![self updateStateWithCommandAtIndex:(_log.count - 1) andState:L]) {
+        turtleLog_truncate(&_log, _log.count - 1) ;
+        if (error) *error = turtleError(@"unable to allocate memory for color") ;
+        return NO ;
+    }
+    return YES ;
+}
+
+// appends commands from a flat array of command numbers, each followed by its arguments as they are
+// stored in the command log -- table arguments (setpos and setpensize) are given as their individual
+// numbers -- so { 1, 10, 4, 90, 5, 0, 0 } is forward(10), right(90), setpos({0, 0}). Stops at the
+// first error; commands before it remain appended.
+- (BOOL)appendCommandsFromTableAtIndex:(int)idx andState:(lua_State *)L error:(NSError * __autoreleasing *)error {
+    LuaSkin     *skin   = [LuaSkin sharedWithState:L] ;
+    lua_Integer length  = luaL_len(L, idx) ;
+    lua_Integer pos     = 1 ;
+    NSString    *errMsg = nil ;
+    size_t      initial = _log.count ;
+
+    while (!errMsg && pos <= length) {
+        lua_Integer entry = pos ;
+        lua_Integer cmd   = -1 ;
+        if (lua_rawgeti(L, idx, pos++) == LUA_TNUMBER && lua_isinteger(L, -1)) cmd = lua_tointeger(L, -1) ;
+        lua_pop(L, 1) ;
+
+        if (cmd < 0 || cmd >= c__commandCount) {
+            errMsg = [NSString stringWithFormat:@"undefined command number specified at index %lld", entry] ;
+            break ;
+        }
+
+        NSString   *cmdName = wrappedCommands[(NSUInteger)cmd][0] ;
+        const char *types   = argumentTypes[cmd] ;
+        uint8_t    argc     = (uint8_t)strlen(types) ;
+        double     args[T_MAX_ARGUMENTS] ;
+        uint8_t    flags    = 0 ;
+
+        if (length - pos + 1 < argc) {
+            errMsg = [NSString stringWithFormat:@"%@: expected %u values but found %lld at index %lld", cmdName, argc, length - pos + 1, entry] ;
+            break ;
+        }
+
+        for (uint8_t i = 0 ; i < argc ; i++) {
+            int luaType = lua_rawgeti(L, idx, pos++) ;
+            if (types[i] == 'n') {
+                if (luaType != LUA_TNUMBER) {
+                    errMsg = @"expected number" ;
+                } else {
+                    args[i] = lua_tonumber(L, -1) ;
+                    if (!isfinite(args[i])) errMsg = @"must be a finite number" ;
+                    if (lua_isinteger(L, -1)) flags |= T_FLAG_INTEGER(i) ;
+                }
+            } else {
+                NSObject *object = [skin toNSObjectAtIndex:-1] ;
+                errMsg = [self check:object forExpectedType:((types[i] == 's') ? @"string" : @"color")] ;
+                if (!errMsg) args[i] = [self internObject:object] ;
+            }
+            lua_pop(L, 1) ;
+            if (errMsg) {
+                errMsg = [NSString stringWithFormat:@"%@: %@ for value %u at index %lld", cmdName, errMsg, (i + 1), entry] ;
+                break ;
+            }
+        }
+
+        if (!errMsg) {
+            NSError *appendError = nil ;
+            if (![self appendFlattenedCommand:(uint8_t)cmd withArguments:args flags:flags andState:L error:&appendError]) {
+                errMsg = [NSString stringWithFormat:@"%@ at index %lld", appendError.localizedDescription, entry] ;
+            }
+        }
+    }
+
+    if (_log.count != initial) self.needsDisplay = !(_neverRender || _renderingPaused) ;
+    if (errMsg) {
+        if (error) *error = turtleError(errMsg) ;
+        return NO ;
+    }
+    return YES ;
+}
+
+// appends commands from a binary string where each command is a one byte command number followed
+// by its flattened arguments as native byte order doubles (i.e. string.pack("=Bdd", 5, x, y) for
+// setpos({x, y})). Color arguments are palette indicies and commands with string arguments can't
+// be packed. Integral values are recorded as integers for _commands.
+- (BOOL)appendPackedCommands:(const uint8_t *)data length:(size_t)length
+                                                 andState:(lua_State *)L
+                                                    error:(NSError * __autoreleasing *)error {
+    size_t   pos     = 0 ;
+    NSString *errMsg = nil ;
+    size_t   initial = _log.count ;
+
+    while (!errMsg && pos < length) {
+        size_t  entry = pos ;
+        uint8_t cmd   = data[pos++] ;
+
+        if (cmd >= c__commandCount) {
+            errMsg = [NSString stringWithFormat:@"undefined command number specified at byte %zu", entry] ;
+            break ;
+        }
+
+        NSString   *cmdName = wrappedCommands[cmd][0] ;
+        const char *types   = argumentTypes[cmd] ;
+        uint8_t    argc     = (uint8_t)strlen(types) ;
+        double     args[T_MAX_ARGUMENTS] ;
+        uint8_t    flags    = 0 ;
+
+        if (length - pos < argc * sizeof(double)) {
+            errMsg = [NSString stringWithFormat:@"%@: truncated arguments at byte %zu", cmdName, entry] ;
+            break ;
+        }
+
+        for (uint8_t i = 0 ; i < argc ; i++) {
+            memcpy(&args[i], data + pos, sizeof(double)) ;
+            pos += sizeof(double) ;
+
+            if (types[i] == 's') {
+                errMsg = @"string arguments can't be packed" ;
+            } else if (!isfinite(args[i])) {
+                errMsg = @"must be a finite number" ;
+            } else if (types[i] == 'c') {
+                long paletteIdx = (long)args[i] ;
+                if (paletteIdx < 0 || paletteIdx > 255) {
+                    errMsg = @"index must be between 0 and 255 inclusive" ;
+                } else {
+                    args[i] = [self internObject:@(paletteIdx)] ;
+                }
+            } else if (args[i] == trunc(args[i]) && fabs(args[i]) < 0x1p53) {
+                flags |= T_FLAG_INTEGER(i) ;
+            }
+            if (errMsg) {
+                errMsg = [NSString stringWithFormat:@"%@: %@ for value %u at byte %zu", cmdName, errMsg, (i + 1), entry] ;
+                break ;
+            }
+        }
+
+        if (!errMsg) {
+            NSError *appendError = nil ;
+            if (![self appendFlattenedCommand:cmd withArguments:args flags:flags andState:L error:&appendError]) {
+                errMsg = [NSString stringWithFormat:@"%@ at byte %zu", appendError.localizedDescription, entry] ;
+            }
+        }
+    }
+
+    if (_log.count != initial) self.needsDisplay = !(_neverRender || _renderingPaused) ;
+    if (errMsg) {
+        if (error) *error = turtleError(errMsg) ;
+        return NO ;
+    }
+    return YES ;
+}
+
+// appends commands from a binary stream written by _saveCommands or _commandChunks (see
+// commandStream.h). Each object the stream defines is checked and interned once per segment rather
+// than once per command using it, so replaying a drawing involves no Lua at all. Stops at the first
+// error; commands before it remain appended.
+- (BOOL)appendStreamedCommands:(const uint8_t *)data length:(size_t)length
+                                                   andState:(lua_State *)L
+                                                      error:(NSError * __autoreleasing *)error {
+    turtleStreamReader reader ;
+    memset(&reader, 0, sizeof(reader)) ;
+    turtleStreamReader_init(&reader, data, length) ;
+
+    // the interned index for each object of the current segment by stream id, kept separately for
+    // strings and colors since a string may be valid as one and not the other
+    NSMutableArray  *interned[2] = { [NSMutableArray array], [NSMutableArray array] } ;
+    size_t          segment      = 0 ;
+    t_streamResults result       = t_streamEnd ;
+    NSString        *errMsg      = nil ;
+    size_t          initial      = _log.count ;
+
+    while (!errMsg && (result = turtleStreamReader_next(&reader)) == t_streamCommand) {
+        if (reader.segments != segment) {
+            [interned[0] removeAllObjects] ;
+            [interned[1] removeAllObjects] ;
+            segment = reader.segments ;
+        }
+
+        uint8_t  cmd  = reader.op ;
+        uint8_t  argc = turtleLog_argCount(cmd) ;
+        double   args[T_MAX_ARGUMENTS] ;
+
+        for (uint8_t i = 0 ; i < argc ; i++) {
+            char type = turtleLog_argType(cmd, i) ;
+            if (type == 'n') {
+                args[i] = reader.args[i] ;
+                continue ;
+            }
+
+            NSMutableArray *known = interned[(type == 's') ? 0 : 1] ;
+            NSUInteger     id     = (NSUInteger)reader.args[i] ;
+            while (known.count < reader.objectCount) [known addObject:[NSNull null]] ;
+
+            if ([known[id] isKindOfClass:[NSNumber class]]) {
+                args[i] = ((NSNumber *)known[id]).doubleValue ;
+            } else {
+                NSObject *object = objectFromStream(&reader.objects[id]) ;
+                errMsg = object ? [self check:object forExpectedType:((type == 's') ? @"string" : @"color")] : @"string is not valid UTF-8" ;
+                if (errMsg) {
+                    errMsg = [NSString stringWithFormat:@"%@: %@ for value %u at byte %zu", wrappedCommands[cmd][0], errMsg, (i + 1), reader.start] ;
+                    break ;
+                }
+                args[i]   = [self internObject:object] ;
+                known[id] = @(args[i]) ;
+            }
+        }
+
+        if (!errMsg) {
+            NSError *appendError = nil ;
+            if (![self appendFlattenedCommand:cmd withArguments:args flags:reader.flags andState:L error:&appendError]) {
+                errMsg = [NSString stringWithFormat:@"%@ at byte %zu", appendError.localizedDescription, reader.start] ;
+            }
+        }
+    }
+    if (!errMsg && result == t_streamError) {
+        errMsg = [NSString stringWithFormat:@"%s at byte %zu", reader.error, reader.errorPosition] ;
+    }
+    turtleStreamReader_free(&reader) ;
+
+    if (_log.count != initial) self.needsDisplay = !(_neverRender || _renderingPaused) ;
+    if (errMsg) {
+        if (error) *error = turtleError(errMsg) ;
+        return NO ;
+    }
+    return YES ;
+}
+
+#pragma mark   Command log support
+
+- (NSUInteger)commandCount {
+    return _log.count ;
+}
+
+- (const turtleLog *)commandLog {
+    return &_log ;
+}
+
+- (uint32_t)internObject:(NSObject *)object {
+    // @YES, @1 and @1.0 are all isEqual:, but replaying the log should give back the argument as it
+    // was given, so numbers are keyed by their class (booleans are a subclass) and type as well
+    id<NSCopying> key = (id<NSCopying>)object ;
+    if ([object isKindOfClass:[NSNumber class]]) {
+        key = @[ NSStringFromClass(object.class), @(((NSNumber *)object).objCType), object ] ;
+    }
+
+    NSNumber *known = _internedObjectIndex[key] ;
+    if (known) return known.unsignedIntValue ;
+
+    uint32_t idx = (uint32_t)_internedObjects.count ;
+    [_internedObjects addObject:object] ;
+    _internedObjectIndex[key] = @(idx) ;
+    return idx ;
+}
+
+- (uint32_t)internColor:(NSColor *)color {
+    NSNumber *known = _internedColorIndex[color] ;
+    if (known) return known.unsignedIntValue ;
+
+    // the RGBA values are for consumers of the log which don't know what an NSColor is
+    NSColor  *safeColor = [color colorUsingColorSpace:NSColorSpace.sRGBColorSpace] ;
+    uint32_t idx        = turtleLog_appendColor(&_log, safeColor ? safeColor.redComponent   : 0.0,
+                                                       safeColor ? safeColor.greenComponent : 0.0,
+                                                       safeColor ? safeColor.blueComponent  : 0.0,
+                                                       safeColor ? safeColor.alphaComponent : 1.0) ;
+    if (idx == T_NO_STYLE) {
+        [LuaSkin logError:[NSString stringWithFormat:@"%s:@internColor: - unable to allocate memory for color table", USERDATA_TAG]] ;
+        return T_NO_STYLE ;
+    }
+    [_internedColors addObject:color] ;
+    _internedColorIndex[color] = @(idx) ;
+    return idx ;
+}
+
+#pragma mark   Programs
+
+// Starts running the named procedure (nil for the main one) of a program compiled by
+// turtleProgram_compile, abandoning any run which was paused. Returns a number identifying the run
+// for resumeProgram:mayYield:done:andState:error:, or 0 if the run couldn't be started.
+- (lua_Integer)startProgram:(const uint8_t *)program length:(size_t)length
+                                                  procedure:(nullable NSString *)name
+                                                  arguments:(const double *)args
+                                                      count:(size_t)argc
+                                                      error:(NSError * __autoreleasing *)error {
+    const char *procedure = name.UTF8String ;
+    if (!turtleProgram_start(&_program, program, length, procedure, (procedure ? strlen(procedure) : 0), args, argc)) {
+        if (error) *error = turtleError(@(_program.error)) ;
+        return 0 ;
+    }
+    return ++_programRuns ;
+}
+
+// Continues the run until the program finishes or, if mayYield is true, until it's time for a
+// backgrounded function to yield (see yieldBudget.h); *done is set to YES if it finished. Stops at
+// the first error, leaving the commands performed before it.
+- (BOOL)resumeProgram:(lua_Integer)run mayYield:(BOOL)mayYield
+                                           done:(BOOL *)done
+                                       andState:(lua_State *)L
+                                          error:(NSError * __autoreleasing *)error {
+    if (run != _programRuns) {
+        if (error) *error = turtleError(@"program was replaced by a later run") ;
+        return NO ;
+    }
+
+    programContext   context = { .turtleCanvas = self, .L = L, .mayYield = (mayYield && !_neverYield), .error = nil } ;
+    size_t           initial = _log.count ;
+    t_programResults result  = turtleProgram_resume(&_program, emitProgramCommand, &context,
+                                                    (context.mayYield ? programInstructionSlice : 0)) ;
+
+    if (_log.count != initial) self.needsDisplay = !(_neverRender || _renderingPaused) ;
+    if (result == t_programError) {
+        if (error) {
+            if (context.error) {
+                *error = context.error ;
+            } else if (_program.errorOp != c__special) {
+                *error = turtleError([NSString stringWithFormat:@"%@: %s", wrappedCommands[_program.errorOp][0], _program.error]) ;
+            } else {
+                *error = turtleError(@(_program.error)) ;
+            }
+        }
+        return NO ;
+    }
+    *done = (result == t_programDone) ;
+    return YES ;
+}
+
+// a command from a running program; colors are given as palette indicies and are interned here
+- (BOOL)appendProgramCommand:(uint8_t)cmd withArguments:(const double *)programArgs
+                                                  flags:(uint8_t)flags
+                                               andState:(lua_State *)L
+                                                  error:(NSError * __autoreleasing *)error {
+    double  args[T_MAX_ARGUMENTS] ;
+    uint8_t argc = turtleLog_argCount(cmd) ;
+
+    for (uint8_t i = 0 ; i < argc ; i++) {
+        args[i] = programArgs[i] ;
+        if (argumentTypes[cmd][i] == 'c') {
+            if (!(flags & T_FLAG_INTEGER(i)) || args[i] < 0 || args[i] > 255) {
+                if (error) *error = turtleError([NSString stringWithFormat:@"%@: color must be a palette index between 0 and 255 inclusive", wrappedCommands[cmd][0]]) ;
+                return NO ;
+            }
+            args[i]  = [self internObject:@((NSUInteger)programArgs[i])] ;
+            flags   &= (uint8_t)~T_FLAG_INTEGER(i) ;
+        }
+    }
+    return [self appendFlattenedCommand:cmd withArguments:args flags:flags andState:L error:error] ;
+}
+
+#pragma mark   Turtle state
+
+- (CGFloat)tX                       { return _state.x ; }
+- (CGFloat)tY                       { return _state.y ; }
+- (CGFloat)tHeading                 { return _state.heading ; }
+- (BOOL)tPenDown                    { return _state.penDown ; }
+- (NSCompositingOperation)tPenMode  { return compositingFromPenMode(_state.penMode) ; }
+- (CGFloat)tPenSize                 { return _state.penSize ; }
+- (CGFloat)tScaleX                  { return _state.scaleX ; }
+- (CGFloat)tScaleY                  { return _state.scaleY ; }
+- (CGFloat)labelFontSize            { return _state.labelHeight ; }
+
+- (void)setTX:(CGFloat)x            { _state.x = x ; }
+- (void)setTY:(CGFloat)y            { _state.y = y ; }
+- (void)setTHeading:(CGFloat)angle  { _state.heading = angle ; }
+
+- (const turtleState *)turtleState {
+    return &_state ;
+}
+
+- (turtleYield *)yieldScheduler {
+    return &_yield ;
+}
+
+- (NSBezierPath *)arcPathForCommandAtIndex:(size_t)idx {
+    double *args    = turtleLog_args(&_log, idx) ;
+    double *derived = turtleLog_derived(&_log, idx) ;
+
+    CGFloat angle   = args[0] ;
+    CGFloat radius  = args[1] ;
+    CGFloat heading = derived[t_arcHeading] ;
+    CGFloat scaleX  = derived[t_arcScaleX] ;
+    CGFloat scaleY  = derived[t_arcScaleY] ;
+
+    NSBezierPath *strokePath = [NSBezierPath bezierPath] ;
+    [strokePath appendBezierPathWithArcWithCenter:NSMakePoint(0, 0)
+                                           radius:radius
+                                       startAngle:((360 - heading) + 90)
+                                         endAngle:((360 - (heading + angle)) + 90)
+                                        clockwise:(angle > 0)] ;
+    NSAffineTransform *scrunch = [[NSAffineTransform alloc] init] ;
+    [scrunch scaleXBy:scaleX yBy:scaleY] ;
+    [scrunch translateXBy:(derived[t_arcX] / scaleX) yBy:(derived[t_arcY] / scaleY)] ;
+    [strokePath transformUsingAffineTransform:scrunch] ;
+    return strokePath ;
+}
+
+- (NSBezierPath *)labelPathForCommandAtIndex:(size_t)idx {
+    double   *args    = turtleLog_args(&_log, idx) ;
+    double   *derived = turtleLog_derived(&_log, idx) ;
+    NSString *text    = _internedObjects[(NSUInteger)args[0]] ;
+    NSFont   *theFont = _internedObjects[(NSUInteger)derived[t_labelFont]] ;
+
+    CGFloat scaleX = derived[t_labelScaleX] ;
+    CGFloat scaleY = derived[t_labelScaleY] ;
+
+    // labels may be drawn from several threads at once (see updateTilesInRect:)
+    NSBezierPath *strokePath = nil ;
+    @synchronized (_glyphCache) {
+        strokePath = [[_glyphCache outlineForText:text inFont:theFont] copy] ;
+    }
+    NSAffineTransform *scrunchAndTurn = [[NSAffineTransform alloc] init] ;
+    [scrunchAndTurn scaleXBy:scaleX yBy:scaleY] ;
+    [scrunchAndTurn translateXBy:(derived[t_labelX] / scaleX) yBy:(derived[t_labelY] / scaleY)] ;
+    [scrunchAndTurn rotateByDegrees:((360 - derived[t_labelHeading]) + 90)] ;
+    [strokePath transformUsingAffineTransform:scrunchAndTurn] ;
+    return strokePath ;
+}
+
+- (NSBezierPath *)fillPathForCommandAtIndex:(size_t)idx {
+    double       *derived  = turtleLog_derived(&_log, idx) ;
+    double       *vertices = _log.fillVertices + (size_t)derived[t_fillEndVertexStart] * 2 ;
+    size_t       count     = (size_t)derived[t_fillEndVertexCount] ;
+    NSBezierPath *fillPath = [NSBezierPath bezierPath] ;
+
+    for (size_t i = 0 ; i < count ; i++) {
+        NSPoint vertex = NSMakePoint(vertices[i * 2], vertices[i * 2 + 1]) ;
+        if (i == 0) {
+            [fillPath moveToPoint:vertex] ;
+        } else {
+            [fillPath lineToPoint:vertex] ;
+        }
+    }
+    [fillPath closePath] ;
+    return fillPath ;
+}
+
+- (NSBezierPath *)pathForCommandAtIndex:(size_t)idx isFill:(BOOL *)isFill styleIndex:(double *)styleIdx {
+    uint8_t      cmd      = _log.ops[idx] ;
+    double       *derived = turtleLog_derived(&_log, idx) ;
+    NSBezierPath *path    = nil ;
+
+    *isFill   = NO ;
+    *styleIdx = T_NO_STYLE ;
+
+    if (turtleLog_isMove(cmd)) {
+        path = [NSBezierPath bezierPath] ;
+        [path moveToPoint:NSMakePoint(derived[t_moveX0], derived[t_moveY0])] ;
+        [path lineToPoint:NSMakePoint(derived[t_moveX1], derived[t_moveY1])] ;
+        *styleIdx = derived[t_moveStyle] ;
+    } else if (cmd == c_arc) {
+        path      = [self arcPathForCommandAtIndex:idx] ;
+        *styleIdx = derived[t_arcStyle] ;
+    } else if (cmd == c_label) {
+        path      = [self labelPathForCommandAtIndex:idx] ;
+        *styleIdx = derived[t_labelStyle] ;
+        *isFill   = YES ; // I think it looks crisper with just the fill
+    } else if (cmd == c_fillend) {
+        path      = [self fillPathForCommandAtIndex:idx] ;
+        *styleIdx = derived[t_fillEndStyle] ;
+        *isFill   = YES ;
+    }
+    return path ;
+}
+
+- (void)renderPath:(NSBezierPath *)path isFill:(BOOL)isFill withStyle:(const turtleStyle *)style inContext:(NSGraphicsContext *)gc {
+    NSColor *color = _internedColors[style->color] ;
+    gc.compositingOperation = compositingFromPenMode(style->mode) ;
+    if (isFill) {
+        [color setFill] ;
+        [path fill] ;
+    } else {
+        [color setStroke] ;
+        path.lineWidth = style->width ;
+        [path stroke] ;
+    }
+}
+
+- (NSGraphicsContext *)graphicsContextForTile:(turtleTile *)tile {
+    if (!tile->context) {
+        CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB) ;
+        CGContextRef    bitmap     = CGBitmapContextCreate(tile->pixels, _tiles.tilePixels, _tiles.tilePixels, 8,
+                                                           _tiles.tilePixels * 4, colorSpace,
+                                                           (CGBitmapInfo)kCGImageAlphaPremultipliedLast) ;
+        CGColorSpaceRelease(colorSpace) ;
+        if (!bitmap) return nil ;
+
+        NSGraphicsContext *gc = [NSGraphicsContext graphicsContextWithCGContext:bitmap flipped:NO] ;
+        CGContextRelease(bitmap) ;
+
+        // tile units are points with the turtle's home at the origin
+        CGFloat scale = _tiles.tilePixels / _tiles.tileSize ;
+        CGContextScaleCTM(gc.CGContext, scale, scale) ;
+        CGContextTranslateCTM(gc.CGContext, -tile->x * _tiles.tileSize, -tile->y * _tiles.tileSize) ;
+
+        tile->context = (void *)CFBridgingRetain(gc) ;
+    }
+    return (__bridge NSGraphicsContext *)tile->context ;
+}
+
+// tile is the one the path is drawn into, or NULL if it doesn't need one (see tileForCell:)
+- (void)renderPath:(NSBezierPath *)path isFill:(BOOL)isFill withStyle:(const turtleStyle *)style intoTile:(turtleTile *)tile {
+    if (!tile) return ;
+
+    NSGraphicsContext *gc = [self graphicsContextForTile:tile] ;
+    if (gc) {
+        NSGraphicsContext.currentContext = gc ;
+        [gc saveGraphicsState] ;
+        [self renderPath:path isFill:isFill withStyle:style inContext:gc] ;
+        [gc restoreGraphicsState] ;
+        tile->modified = true ;
+    }
+}
+
+- (const turtleStyle *)styleForCommandAtIndex:(size_t)idx {
+    uint8_t cmd      = _log.ops[idx] ;
+    double  *derived = turtleLog_derived(&_log, idx) ;
+
+    if (!(_log.flags[idx] & T_FLAG_DRAWS)) return NULL ;
+    if (turtleLog_isMove(cmd)) return turtleLog_style(&_log, derived[t_moveStyle]) ;
+    if (cmd == c_arc)          return turtleLog_style(&_log, derived[t_arcStyle]) ;
+    if (cmd == c_label)        return turtleLog_style(&_log, derived[t_labelStyle]) ;
+    if (cmd == c_fillend)      return turtleLog_style(&_log, derived[t_fillEndStyle]) ;
+    return NULL ;
+}
+
+// Returns the tile the cell draws into, allocating it if any of the cell's undrawn commands paint;
+// erasing can't change a tile that hasn't been drawn in yet, so a cell with only erasures to draw
+// is left without one. Tiles are only allocated here, before any cell is drawn, since allocating
+// one may move the others.
+- (turtleTile *)tileForCell:(const turtleCell *)cell {
+    turtleTile *tile = turtleTiles_find(&_tiles, cell->x, cell->y) ;
+    if (tile) return tile ;
+
+    for (size_t entry = cell->drawn ; entry < cell->count ; entry++) {
+        const turtleStyle *style = [self styleForCommandAtIndex:cell->commands[entry]] ;
+        if (style && style->mode != t_penErase) {
+            tile = turtleTiles_fetch(&_tiles, cell->x, cell->y) ;
+            if (!tile) {
+                [LuaSkin logError:[NSString stringWithFormat:@"%s:tileForCell - unable to allocate memory for tile (%d, %d)", USERDATA_TAG, cell->x, cell->y]] ;
+            }
+            return tile ;
+        }
+    }
+    return NULL ;
+}
+
+// Runs of moves can be stroked together without changing the result only if overlapping segments
+// would look the same drawn once as drawn repeatedly -- true for opaque paint and erase, but not for
+// reverse (XOR) or translucent colors.
+- (BOOL)canCoalesceCommandAtIndex:(size_t)idx {
+    if (!turtleLog_isMove(_log.ops[idx])) return NO ;
+    const turtleStyle *style = turtleLog_style(&_log, turtleLog_derived(&_log, idx)[t_moveStyle]) ;
+    return style && style->mode != t_penReverse && _log.colors[style->color * 4 + 3] >= 1.0 ;
+}
+
+// Strokes a run of moves in the cell sharing the same style as one path of separate subpaths, so
+// no joins are introduced and the path is stroked exactly as the individual moves would have been.
+// Commands drawn elsewhere don't appear in the cell's list and so can't interrupt a run. With
+// decimation on, the run is simplified first (see decimate.h) and only the segments kept are added
+// to the path; if the decimator can't get the memory it needs, *decimated is set to NO. Returns the
+// position in the cell's list of the first command not included.
+- (size_t)rasterizeMovesInCell:(turtleCell *)cell fromEntry:(size_t)entry
+                                                   intoTile:(turtleTile *)tile
+                                                  decimator:(turtleDecimator *)decimator
+                                                  decimated:(BOOL *)decimated {
+    double            styleIdx = turtleLog_derived(&_log, cell->commands[entry])[t_moveStyle] ;
+    const turtleStyle *style   = turtleLog_style(&_log, styleIdx) ;
+    NSBezierPath      *path    = [NSBezierPath bezierPath] ;
+    NSUInteger        moves    = 0 ;
+    BOOL              decimate = (_decimation > 0.0) ;
+    BOOL              isGood   = YES ;
+    size_t            first    = entry ;
+
+    // the tolerance is in pixels, the moves in points
+    if (decimate) turtleDecimator_reset(decimator, _decimation * _tiles.tileSize / _tiles.tilePixels) ;
+
+    for ( ; entry < cell->count && moves < maxCoalescedMoves ; entry++) {
+        size_t idx = cell->commands[entry] ;
+        if (!turtleLog_isMove(_log.ops[idx]) || turtleLog_derived(&_log, idx)[t_moveStyle] != styleIdx) break ;
+        moves++ ;
+
+        double *derived = turtleLog_derived(&_log, idx) ;
+        if (decimate) {
+            if (!turtleDecimator_addSegment(decimator, derived[t_moveX0], derived[t_moveY0], derived[t_moveX1], derived[t_moveY1])) {
+                isGood = NO ;
+                break ;
+            }
+        } else {
+            [path moveToPoint:NSMakePoint(derived[t_moveX0], derived[t_moveY0])] ;
+            [path lineToPoint:NSMakePoint(derived[t_moveX1], derived[t_moveY1])] ;
+        }
+    }
+
+    if (decimate && isGood && turtleDecimator_finish(decimator)) {
+        for (size_t line = 0 ; line < decimator->lineCount ; line++) {
+            const double *points = turtleDecimator_linePoints(decimator, line) ;
+            size_t       count   = turtleDecimator_lineLength(decimator, line) ;
+            for (size_t n = 0 ; n + 1 < count ; n++) {
+                [path moveToPoint:NSMakePoint(points[n * 2], points[n * 2 + 1])] ;
+                [path lineToPoint:NSMakePoint(points[n * 2 + 2], points[n * 2 + 3])] ;
+            }
+        }
+    } else if (decimate) {
+        // the run is stroked as it was logged instead
+        *decimated = NO ;
+        for (size_t i = first ; i < entry ; i++) {
+            double *derived = turtleLog_derived(&_log, cell->commands[i]) ;
+            [path moveToPoint:NSMakePoint(derived[t_moveX0], derived[t_moveY0])] ;
+            [path lineToPoint:NSMakePoint(derived[t_moveX1], derived[t_moveY1])] ;
+        }
+    }
+
+    [self renderPath:path isFill:NO withStyle:style intoTile:tile] ;
+    return entry ;
+}
+
+// draws the command into the cell's tile; paths for commands which cover more than one cell are
+// kept in pathCache so they're only built once per update (per thread, when drawn in parallel)
+- (void)rasterizeCommandAtIndex:(size_t)idx intoTile:(turtleTile *)tile pathCache:(NSMutableDictionary *)pathCache {
+    BOOL         isFill   = NO ;
+    double       styleIdx = T_NO_STYLE ;
+    NSBezierPath *path    = nil ;
+
+    if (turtleLog_isMove(_log.ops[idx])) {
+        path = [self pathForCommandAtIndex:idx isFill:&isFill styleIndex:&styleIdx] ;
+    } else {
+        NSArray *cached = pathCache[@(idx)] ;
+        if (!cached) {
+            path = [self pathForCommandAtIndex:idx isFill:&isFill styleIndex:&styleIdx] ;
+            if (!path) return ;
+            cached = @[ path, @(isFill), @(styleIdx) ] ;
+            pathCache[@(idx)] = cached ;
+        }
+        path     = cached[0] ;
+        isFill   = [(NSNumber *)cached[1] boolValue] ;
+        styleIdx = [(NSNumber *)cached[2] doubleValue] ;
+    }
+
+    const turtleStyle *style = turtleLog_style(&_log, styleIdx) ;
+    if (!path || !style) return ;
+    [self renderPath:path isFill:isFill withStyle:style intoTile:tile] ;
+}
+
+// draws the commands in the cell which haven't been drawn into its tile yet; the caller marks the
+// cell drawn afterwards
+- (void)rasterizeCell:(turtleCell *)cell intoTile:(turtleTile *)tile
+                                        pathCache:(NSMutableDictionary *)pathCache
+                                        decimator:(turtleDecimator *)decimator
+                                        decimated:(BOOL *)decimated {
+    size_t entry = cell->drawn ;
+    while (entry < cell->count) {
+        size_t idx = cell->commands[entry] ;
+        if ([self canCoalesceCommandAtIndex:idx]) {
+            entry = [self rasterizeMovesInCell:cell fromEntry:entry intoTile:tile decimator:decimator decimated:decimated] ;
+        } else {
+            [self rasterizeCommandAtIndex:idx intoTile:tile pathCache:pathCache] ;
+            entry++ ;
+        }
+    }
+}
+
+typedef struct {
+    turtleCell *cell ;
+    turtleTile *tile ;
+} turtleCellTile ;
+
+// Draws the cells in cells[] not yet claimed by another thread, claiming the next one from *next
+// each time. Each cell draws only into its own tile, in the order of its commands, so cells can be
+// drawn on as many threads at once as updateTilesInRect: sees fit with the same result as drawing
+// them one after another; everything else touched here is only read while the cells are drawn,
+// apart from the glyph cache, which labelPathForCommandAtIndex: locks. Returns NO if the decimator
+// couldn't get the memory it needed for some run of moves.
+- (BOOL)rasterizeCells:(const turtleCellTile *)cells count:(size_t)count
+                                                   next:(atomic_size_t *)next
+                                              decimator:(turtleDecimator *)decimator {
+    BOOL decimated = YES ;
+
+    // the current graphics context belongs to the thread
+    [NSGraphicsContext saveGraphicsState] ;
+    @autoreleasepool {
+        NSMutableDictionary *pathCache = [NSMutableDictionary dictionary] ;
+        size_t              i ;
+        while ((i = atomic_fetch_add_explicit(next, 1, memory_order_relaxed)) < count) {
+            [self rasterizeCell:cells[i].cell intoTile:cells[i].tile pathCache:pathCache decimator:decimator decimated:&decimated] ;
+        }
+    }
+    [NSGraphicsContext restoreGraphicsState] ;
+    return decimated ;
+}
+
+// Brings the tiles within rect (in drawing coordinates, with home at 0, 0) up to date. Only the
+// cells of the index which intersect rect are looked at, so commands which are out of view aren't
+// drawn until they're scrolled into view or an image including them is requested. When there's a
+// backlog to draw (after _pause(false), or while _neverYield is set), the cells are drawn on as
+// many threads as there are processors.
+- (void)updateTilesInRect:(NSRect)rect {
+    if (_index.undrawnCells == 0) return ;
+
+    int64_t fromX = turtleGrid_coordinate(_index.cellSize, NSMinX(rect)) ;
+    int64_t toX   = turtleGrid_coordinate(_index.cellSize, NSMaxX(rect)) ;
+    int64_t fromY = turtleGrid_coordinate(_index.cellSize, NSMinY(rect)) ;
+    int64_t toY   = turtleGrid_coordinate(_index.cellSize, NSMaxY(rect)) ;
+    double  area  = (double)(toX - fromX + 1) * (double)(toY - fromY + 1) ;
+
+    turtleCellTile *cells   = malloc(_index.undrawnCells * sizeof(turtleCellTile)) ;
+    size_t         count    = 0 ;
+    size_t         commands = 0 ;
+    if (!cells) {
+        [LuaSkin logError:[NSString stringWithFormat:@"%s:updateTilesInRect - unable to allocate memory for cell list", USERDATA_TAG]] ;
+        return ;
+    }
+
+    if (area > (double)_index.count) {
+        for (size_t i = 0 ; i < _index.count && count < _index.undrawnCells ; i++) {
+            turtleCell *cell = &_index.cells[i] ;
+            if (cell->drawn == cell->count) continue ;
+            if (cell->x < fromX || cell->x > toX || cell->y < fromY || cell->y > toY) continue ;
+            cells[count++] = (turtleCellTile){ .cell = cell } ;
+        }
+    } else {
+        for (int64_t ty = fromY ; ty <= toY ; ty++) {
+            for (int64_t tx = fromX ; tx <= toX ; tx++) {
+                turtleCell *cell = turtleIndex_find(&_index, (int32_t)tx, (int32_t)ty) ;
+                if (cell && cell->drawn < cell->count) cells[count++] = (turtleCellTile){ .cell = cell } ;
+            }
+        }
+    }
+    for (size_t i = 0 ; i < count ; i++) {
+        cells[i].tile  = [self tileForCell:cells[i].cell] ;
+        commands      += cells[i].cell->count - cells[i].cell->drawn ;
+    }
+
+    size_t workers = NSProcessInfo.processInfo.activeProcessorCount ;
+    if (commands < minParallelCommands) workers = 1 ;
+    if (workers > count) workers = count ;
+
+    atomic_size_t next      = 0 ;
+    atomic_bool   decimated = true ;
+    if (workers > 1) {
+        atomic_size_t *claimed   = &next ;
+        atomic_bool   *succeeded = &decimated ;
+        dispatch_apply(workers, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t worker) {
+            // the view's own decimator for the first, scratch space for the rest
+            turtleDecimator scratch ;
+            turtleDecimator_init(&scratch) ;
+            if (![self rasterizeCells:cells count:count next:claimed decimator:((worker == 0) ? &self->_decimator : &scratch)]) {
+                atomic_store(succeeded, false) ;
+            }
+            turtleDecimator_free(&scratch) ;
+        }) ;
+    } else if (count > 0) {
+        atomic_store(&decimated, [self rasterizeCells:cells count:count next:&next decimator:&_decimator]) ;
+    }
+
+    if (!atomic_load(&decimated)) {
+        [LuaSkin logError:[NSString stringWithFormat:@"%s:updateTilesInRect - unable to allocate memory for decimation; some moves were drawn without it", USERDATA_TAG]] ;
+    }
+    for (size_t i = 0 ; i < count ; i++) turtleIndex_cellDrawn(&_index, cells[i].cell) ;
+    free(cells) ;
+}
+
+// Returns the indices of the commands which draw over point (in drawing coordinates, with home at
+// 0, 0), allowing tolerance beyond the edges of strokes; only the commands in the index cells
+// around the point are tested.
+- (NSIndexSet *)commandsAtPoint:(NSPoint)point withTolerance:(CGFloat)tolerance {
+    NSMutableIndexSet *found = [NSMutableIndexSet indexSet] ;
+    int64_t fromX = turtleGrid_coordinate(_index.cellSize, point.x - tolerance) ;
+    int64_t toX   = turtleGrid_coordinate(_index.cellSize, point.x + tolerance) ;
+    int64_t fromY = turtleGrid_coordinate(_index.cellSize, point.y - tolerance) ;
+    int64_t toY   = turtleGrid_coordinate(_index.cellSize, point.y + tolerance) ;
+
+    for (int64_t ty = fromY ; ty <= toY ; ty++) {
+        for (int64_t tx = fromX ; tx <= toX ; tx++) {
+            turtleCell *cell = turtleIndex_find(&_index, (int32_t)tx, (int32_t)ty) ;
+            for (size_t entry = 0 ; cell && entry < cell->count ; entry++) {
+                size_t idx = cell->commands[entry] ;
+                if ([found containsIndex:idx]) continue ;
+                int hit = turtleLog_hitTest(&_log, idx, point.x, point.y, tolerance) ;
+                if (hit < 0) hit = [[self labelPathForCommandAtIndex:idx] containsPoint:point] ;
+                if (hit) [found addIndex:idx] ;
+            }
+        }
+    }
+    return found ;
+}
+
+// composites the tiles which intersect rect (in the destination context's coordinates) with the
+// turtle's home at the specified point
+- (void)drawTilesInContext:(CGContextRef)ctx withHomeAt:(NSPoint)home inRect:(NSRect)rect {
+    if (_tiles.count == 0) return ;
+
+    double  tileSize = _tiles.tileSize ;
+    int64_t fromX    = turtleTiles_coordinate(&_tiles, NSMinX(rect) - home.x) ;
+    int64_t toX      = turtleTiles_coordinate(&_tiles, NSMaxX(rect) - home.x) ;
+    int64_t fromY    = turtleTiles_coordinate(&_tiles, NSMinY(rect) - home.y) ;
+    int64_t toY      = turtleTiles_coordinate(&_tiles, NSMaxY(rect) - home.y) ;
+
+    CGContextSaveGState(ctx) ;
+    // tiles are drawn at their native resolution, so don't let edge antialiasing or interpolation
+    // leave seams between neighboring tiles
+    CGContextSetShouldAntialias(ctx, false) ;
+    CGContextSetInterpolationQuality(ctx, kCGInterpolationNone) ;
+
+    for (size_t i = 0 ; i < _tiles.count ; i++) {
+        turtleTile *tile = &_tiles.tiles[i] ;
+        if (tile->x < fromX || tile->x > toX || tile->y < fromY || tile->y > toY || !tile->context) continue ;
+
+        CGImageRef image = CGBitmapContextCreateImage(((__bridge NSGraphicsContext *)tile->context).CGContext) ;
+        if (image) {
+            CGContextDrawImage(ctx, CGRectMake(home.x + tile->x * tileSize, home.y + tile->y * tileSize, tileSize, tileSize), image) ;
+            CGImageRelease(image) ;
+        }
+    }
+
+    CGContextRestoreGState(ctx) ;
+}
+
 - (NSImage *)generateImageFromVisible:(BOOL)onlyVisible
                        withBackground:(BOOL)withBackground
                             andTurtle:(BOOL)withTurtle {
 
-    [self updateOffScreenImage] ;
-    NSImage *newImage = [[NSImage alloc] initWithSize:(onlyVisible ? self.frame.size : _offScreen.size)] ;
+    NSSize  imageSize = onlyVisible ? self.frame.size : NSMakeSize(_offScreenWidth, _offScreenHeight) ;
+    NSImage *newImage = [[NSImage alloc] initWithSize:imageSize] ;
 
     [newImage lockFocus] ;
         NSGraphicsContext *gc = [NSGraphicsContext currentContext];
@@ -834,32 +1789,21 @@ NSColor *NSColorFromHexColorString(NSString *colorString) {
             [NSBezierPath fillRect:NSMakeRect(0, 0, newImage.size.width, newImage.size.height)] ;
         }
 
-        NSRect fromRect = NSZeroRect ;
+        NSPoint home = NSMakePoint(imageSize.width / 2.0, imageSize.height / 2.0) ;
         if (onlyVisible) {
-            fromRect = NSMakeRect(
-                (_offScreenWidth  - self.frame.size.width)  / 2.0 - _translateX,
-                (_offScreenHeight - self.frame.size.height) / 2.0 - _translateY,
-                self.frame.size.width,
-                self.frame.size.height
-            ) ;
+            home.x = home.x + _translateX ;
+            home.y = home.y + _translateY ;
         }
-        [_offScreen drawAtPoint:NSZeroPoint
-                        fromRect:fromRect
-                       operation:NSCompositingOperationSourceOver
-                        fraction:1.0] ;
+        [self updateTilesInRect:NSMakeRect(-home.x, -home.y, imageSize.width, imageSize.height)] ;
+        [self drawTilesInContext:gc.CGContext
+                      withHomeAt:home
+                          inRect:NSMakeRect(0, 0, imageSize.width, imageSize.height)] ;
 
         if (withTurtle) {
-            NSPoint location = NSMakePoint(
-                _tX + (onlyVisible ? self.frame.size.width  : _offScreenWidth)  / 2.0,
-                _tY + (onlyVisible ? self.frame.size.height : _offScreenHeight) / 2.0
-            ) ;
-            if (onlyVisible) {
-                location.x = location.x + _translateX ;
-                location.y = location.y + _translateY ;
-            }
+            NSPoint location = NSMakePoint(_state.x + home.x, _state.y + home.y) ;
             NSAffineTransform *turtleRotation = [[NSAffineTransform alloc] init] ;
             [turtleRotation translateXBy:location.x yBy:location.y] ;
-            [turtleRotation rotateByDegrees:(360 - _tHeading)] ;
+            [turtleRotation rotateByDegrees:(360 - _state.heading)] ;
 
             [gc saveGraphicsState];
 
@@ -878,71 +1822,42 @@ NSColor *NSColorFromHexColorString(NSString *colorString) {
     return newImage ;
 }
 
-- (void)updateOffScreenImage {
-    BOOL resizeImage = (_offScreenWidth  > _offScreen.size.width) ||
-                       (_offScreenHeight > _offScreen.size.height) ;
-    if (resizeImage) {
-        @autoreleasepool {
-            NSImage *oldImage = _offScreen ;
-            NSSize  newSize   = NSMakeSize(_offScreenWidth, _offScreenHeight) ;
-            _offScreen = [[NSImage alloc] initWithSize:newSize] ;
-            [_offScreen lockFocus] ;
-                NSGraphicsContext *gc = [NSGraphicsContext currentContext];
-                [gc saveGraphicsState] ;
-                [oldImage drawInRect:NSMakeRect(
-                    (newSize.width  - oldImage.size.width)  / 2.0,
-                    (newSize.height - oldImage.size.height) / 2.0,
-                    oldImage.size.width,
-                    oldImage.size.height
-                )] ;
-                [gc restoreGraphicsState] ;
-            [_offScreen unlockFocus] ;
-        }
-    }
-
-    if (_offScreenIdx < _commandList.count) {
-        [_offScreen lockFocus] ;
-            NSGraphicsContext *gc = [NSGraphicsContext currentContext];
-            [gc saveGraphicsState] ;
-
-            // use transform so origin shifted to center of image
-            NSAffineTransform *shiftOriginToCenter = [[NSAffineTransform alloc] init] ;
-            [shiftOriginToCenter translateXBy:(_offScreenWidth  / 2.0)
-                                          yBy:(_offScreenHeight / 2.0)] ;
-            [shiftOriginToCenter concat] ;
-
-            [_pInitColor setStroke] ;
-            [_pInitColor setFill] ;
-            gc.compositingOperation = _tPenMode ;
+- (const turtleTileCache *)tileCache {
+    return &_tiles ;
+}
 
-            for (NSUInteger i = _offScreenIdx ; i < _commandList.count ; i++) {
-                NSArray *entry = _commandList[i] ;
-                NSMutableDictionary *properties = entry[1] ;
+- (const turtleIndex *)spatialIndex {
+    return &_index ;
+}
 
-                NSNumber *compositeMode = properties[@"penMode"] ;
-                if (compositeMode) gc.compositingOperation = compositeMode.unsignedIntegerValue ;
+- (turtleCheckpoints *)checkpoints {
+    return &_checkpoints ;
+}
 
-                NSColor *penColor = properties[@"penColor"] ;
-                if (penColor) {
-                    [penColor setStroke] ;
-                    [penColor setFill] ;
-                }
+// the raster is discarded and redrawn from the index as it's needed, so the whole drawing reflects
+// the new tolerance rather than just what's drawn from now on
+- (void)setDecimation:(CGFloat)decimation {
+    if (decimation == _decimation) return ;
+    _decimation = decimation ;
+    turtleTiles_clear(&_tiles) ;
+    turtleIndex_markUndrawn(&_index) ;
+    self.needsDisplay = !(_neverRender || _renderingPaused) ;
+}
 
-                NSBezierPath *strokePath = properties[@"stroke"] ;
-                if (strokePath) [strokePath stroke] ;
+@end
 
-                NSBezierPath *fillPath = properties[@"fill"] ;
-                if (fillPath) [fillPath fill] ;
-            }
+static const char *emitProgramCommand(void *context, uint8_t cmd, const double *args, uint8_t flags, bool *pause) {
+    programContext *ctx         = context ;
+    NSError        *appendError = nil ;
 
-            [gc restoreGraphicsState] ;
-        [_offScreen unlockFocus] ;
-        _offScreenIdx = _commandList.count ;
+    if (![ctx->turtleCanvas appendProgramCommand:cmd withArguments:args flags:flags andState:ctx->L error:&appendError]) {
+        ctx->error = appendError ;
+        return appendError ? appendError.localizedDescription.UTF8String : "unable to perform command" ;
     }
+    if (ctx->mayYield) *pause = turtleYield_check(ctx->turtleCanvas.yieldScheduler, 1, (size_t)ctx->turtleCanvas.yieldRatio) ;
+    return NULL ;
 }
 
-@end
-
 #pragma mark - Module Functions
 
 static int turtle_new(lua_State *L) {
@@ -975,6 +1890,38 @@ static int turtle_registerDefaultPalette(lua_State *L) {
     return 0 ;
 }
 
+/// hs.canvas.turtle._compile(source) -> string | nil, errorMessage
+/// Function
+/// Compiles Logo source into a program which a turtle can run with [hs.canvas.turtle:_startProgram](#_startProgram).
+///
+/// Parameters:
+///  * `source` - a string containing Logo procedure definitions (`to name :param ... end`) and instructions
+///
+/// Returns:
+///  * the compiled program as a string, or nil and a message, including the line at fault, if the source can't be compiled
+///
+/// Notes:
+///  * programs can use `repeat` (with `repcount`), `if`, `ifelse`, `stop`, procedures with numeric parameters which may call themselves, arithmetic and comparisons, and the turtle commands which take numbers; colors are given as palette indicies. Anything outside of a procedure definition is the program's main procedure. See `turtleProgram.h` for the details.
+///  * a compiled program doesn't refer to the turtle it was compiled for and can be run by any number of turtles.
+static int turtle_compile(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TSTRING, LS_TBREAK] ;
+    size_t     length = 0 ;
+    const char *source = lua_tolstring(L, 1, &length) ;
+
+    uint8_t *program       = NULL ;
+    size_t  programLength  = 0 ;
+    char    errMsg[256] ;
+    if (!turtleProgram_compile(source, length, &program, &programLength, errMsg, sizeof(errMsg))) {
+        lua_pushnil(L) ;
+        lua_pushstring(L, errMsg) ;
+        return 2 ;
+    }
+    lua_pushlstring(L, (const char *)program, programLength) ;
+    free(program) ;
+    return 1 ;
+}
+
 #pragma mark - Module Methods
 
 static int turtle_dumpPalette(lua_State *L) {
@@ -998,6 +1945,7 @@ static int turtle_dumpPalette(lua_State *L) {
 ///
 /// Notes:
 ///  * when you background a drawing function with [hs.canvas.turtle:_background](#_background), a coroutine is created which will yield after a certain number of drawing commands have occurred. This method allows you to adjust this number so you can balance speed of rendering and Hammerspoon responsiveness to your specific needs.
+///  * this is ignored while a time budget is set with [hs.canvas.turtle:_yieldBudget](#_yieldBudget).
 static int turtle_yieldRatio(lua_State *L) {
     LuaSkin *skin = [LuaSkin sharedWithState:L];
     [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TNUMBER | LS_TINTEGER | LS_TOPTIONAL, LS_TBREAK] ;
@@ -1026,16 +1974,114 @@ static int turtle_yieldRatio(lua_State *L) {
 ///
 /// Notes:
 ///  * Setting this to false before using [hs.canvas.turtle:_background](#_background) essentially causes the `_background` method to block until completion, as if you had gone ahead and run the function yourself. Setting it to false while a function is already running will cause it (and any additionally queued background functions) to run to completion after it next resumes without further yields.
+///  * when many commands are waiting to be drawn, as they will be after a function runs without yielding (or after rendering is resumed with `_pause(false)`), the parts of the drawing they fall in are drawn on as many threads as there are processors. Each part is still drawn in command order, so the result is identical to drawing them one at a time.
 static int turtle_neverYield(lua_State *L) {
     LuaSkin *skin = [LuaSkin sharedWithState:L];
-    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TBOOLEAN | LS_TOPTIONAL, LS_TBREAK] ;
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TBOOLEAN | LS_TOPTIONAL, LS_TBREAK] ;
+    HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+
+    if (lua_gettop(L) == 1) {
+        lua_pushboolean(L, turtleCanvas.neverYield) ;
+    } else {
+        turtleCanvas.neverYield = (BOOL)(lua_toboolean(L, 2)) ;
+        lua_pushvalue(L, 1) ;
+    }
+    return 1 ;
+}
+
+/// hs.canvas.turtle:_yieldBudget([milliseconds]) -> turtleViewObject | number | false
+/// Method
+/// Get or set the time a function backgrounded with [hs.canvas.turtle:_background](#_background) may run before yielding.
+///
+/// Parameters:
+///  * `milliseconds` - an optional number greater than 0 specifying how long each slice of a backgrounded function may run before yielding, or false to yield after a fixed number of commands as set with [hs.canvas.turtle:_yieldRatio](#_yieldRatio). Defaults to false.
+///
+/// Returns:
+///  * if an argument is provided, returns the turtleViewObject; otherwise returns the current value.
+///
+/// Notes:
+///  * a fixed number of commands per slice yields far more often than necessary when the commands are simple moves, but can block Hammerspoon for a noticeable time when they include labels or large fills. With a budget, elapsed time is measured with a monotonic clock and the number of commands between clock readings adapts to how long the commands are actually taking, so a budget of a few milliseconds keeps Hammerspoon responsive without slowing down simple drawings.
+///  * see [hs.canvas.turtle:_yieldStats](#_yieldStats) to see how closely slices are keeping to the budget.
+static int turtle_yieldBudget(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L];
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TNUMBER | LS_TBOOLEAN | LS_TOPTIONAL, LS_TBREAK] ;
+    HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+    turtleYield        *yield        = turtleCanvas.yieldScheduler ;
+
+    if (lua_gettop(L) == 1) {
+        if (yield->budget > 0.0) {
+            lua_pushnumber(L, yield->budget * 1000.0) ;
+        } else {
+            lua_pushboolean(L, NO) ;
+        }
+    } else {
+        if (lua_type(L, 2) == LUA_TBOOLEAN) {
+            if (lua_toboolean(L, 2)) return luaL_argerror(L, 2, "expected a number or false") ;
+            yield->budget = 0.0 ;
+        } else {
+            lua_Number milliseconds = lua_tonumber(L, 2) ;
+            if (!(milliseconds > 0.0 && isfinite(milliseconds))) return luaL_argerror(L, 2, "budget must be greater than 0") ;
+            yield->budget = milliseconds / 1000.0 ;
+        }
+        lua_pushvalue(L, 1) ;
+    }
+    return 1 ;
+}
+
+/// hs.canvas.turtle:_yieldStats([reset]) -> table | turtleViewObject
+/// Method
+/// Returns statistics about the slices functions backgrounded with [hs.canvas.turtle:_background](#_background) have run in between yields.
+///
+/// Parameters:
+///  * `reset` - an optional boolean, default false, specifying whether the statistics should be cleared instead of returned.
+///
+/// Returns:
+///  * if `reset` is true, returns the turtleViewObject; otherwise a table with the following keys:
+///    * `slices`           - the number of slices run
+///    * `averageSlice`     - the average time, in milliseconds, each slice ran for
+///    * `worstOverrun`     - the most, in milliseconds, any slice has run past the budget set with [hs.canvas.turtle:_yieldBudget](#_yieldBudget)
+///    * `commandsPerSlice` - the average number of commands each slice ran
+///    * `adaptiveCount`    - the current estimate of how many commands fit within the budget
+///    * `clockReadings`    - the number of times the clock was read
+static int turtle_yieldStats(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L];
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TBOOLEAN | LS_TOPTIONAL, LS_TBREAK] ;
+    HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+    turtleYield        *yield        = turtleCanvas.yieldScheduler ;
+
+    if (lua_toboolean(L, 2)) {
+        turtleYield_resetStatistics(yield) ;
+        lua_pushvalue(L, 1) ;
+    } else {
+        double slices = (double)yield->slices ;
+        lua_newtable(L) ;
+        lua_pushinteger(L, (lua_Integer)yield->slices) ;                                lua_setfield(L, -2, "slices") ;
+        lua_pushnumber(L, (slices > 0) ? yield->totalTime * 1000.0 / slices : 0.0) ;    lua_setfield(L, -2, "averageSlice") ;
+        lua_pushnumber(L, yield->worstOverrun * 1000.0) ;                               lua_setfield(L, -2, "worstOverrun") ;
+        lua_pushnumber(L, (slices > 0) ? (double)yield->totalCommands / slices : 0.0) ; lua_setfield(L, -2, "commandsPerSlice") ;
+        lua_pushinteger(L, (lua_Integer)yield->commandsPerSlice) ;                      lua_setfield(L, -2, "adaptiveCount") ;
+        lua_pushinteger(L, (lua_Integer)yield->clockReadings) ;                         lua_setfield(L, -2, "clockReadings") ;
+    }
+    return 1 ;
+}
+
+// internal; called by coroutineFriendlyCheck in init.lua after count commands have been issued by a
+// backgrounded function, returns true if it should yield now. With finished true, closes the current
+// slice instead.
+static int turtle_yieldCheck(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L];
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TNUMBER | LS_TINTEGER | LS_TOPTIONAL, LS_TBOOLEAN | LS_TOPTIONAL, LS_TBREAK] ;
     HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+    turtleYield        *yield        = turtleCanvas.yieldScheduler ;
+    lua_Integer        count         = luaL_optinteger(L, 2, 1) ;
 
-    if (lua_gettop(L) == 1) {
-        lua_pushboolean(L, turtleCanvas.neverYield) ;
+    if (lua_toboolean(L, 3)) {
+        turtleYield_endSlice(yield, turtleYield_now()) ;
+        lua_pushboolean(L, NO) ;
+    } else if (turtleCanvas.neverYield) {
+        lua_pushboolean(L, NO) ;
     } else {
-        turtleCanvas.neverYield = (BOOL)(lua_toboolean(L, 2)) ;
-        lua_pushvalue(L, 1) ;
+        lua_pushboolean(L, turtleYield_check(yield, (size_t)((count > 0) ? count : 0), (size_t)turtleCanvas.yieldRatio)) ;
     }
     return 1 ;
 }
@@ -1134,31 +2180,280 @@ static int turtle_commandCount(lua_State *L) {
     [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TBREAK] ;
     HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
 
-    lua_pushinteger(L, (lua_Integer)turtleCanvas.commandList.count) ;
+    lua_pushinteger(L, (lua_Integer)turtleCanvas.commandCount) ;
+    return 1 ;
+}
+
+// internal; _cmdMemory() -> table of the command log's size, for checking bytes per command from the console
+static int turtle_commandMemory(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TBREAK] ;
+    HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+    const turtleLog    *log          = turtleCanvas.commandLog ;
+
+    size_t bytesUsed = turtleLog_bytesUsed(log) ;
+
+    lua_newtable(L) ;
+    lua_pushinteger(L, (lua_Integer)log->count) ;                           lua_setfield(L, -2, "commands") ;
+    lua_pushinteger(L, (lua_Integer)bytesUsed) ;                            lua_setfield(L, -2, "bytesUsed") ;
+    lua_pushinteger(L, (lua_Integer)turtleLog_bytesAllocated(log)) ;        lua_setfield(L, -2, "bytesAllocated") ;
+    lua_pushinteger(L, (lua_Integer)log->styleCount) ;                      lua_setfield(L, -2, "styles") ;
+    lua_pushinteger(L, (lua_Integer)log->colorCount) ;                      lua_setfield(L, -2, "colors") ;
+    lua_pushinteger(L, (lua_Integer)turtleCanvas.internedObjects.count) ;   lua_setfield(L, -2, "objects") ;
+    lua_pushnumber(L, (log->count > 0) ? (lua_Number)bytesUsed / (lua_Number)log->count : 0.0) ;
+    lua_setfield(L, -2, "bytesPerCommand") ;
+    return 1 ;
+}
+
+// internal; _tileMemory() -> table of the tile cache and spatial index sizes, for checking from the console
+static int turtle_tileMemory(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TBREAK] ;
+    HSCanvasTurtleView    *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+    const turtleTileCache *tiles        = turtleCanvas.tileCache ;
+    const turtleIndex     *index        = turtleCanvas.spatialIndex ;
+
+    lua_newtable(L) ;
+    lua_pushinteger(L, (lua_Integer)tiles->count) ;                         lua_setfield(L, -2, "tiles") ;
+    lua_pushnumber(L, tiles->tileSize) ;                                    lua_setfield(L, -2, "tileSize") ;
+    lua_pushinteger(L, (lua_Integer)tiles->tilePixels) ;                    lua_setfield(L, -2, "tilePixels") ;
+    lua_pushinteger(L, (lua_Integer)turtleTiles_bytesAllocated(tiles)) ;    lua_setfield(L, -2, "bytesAllocated") ;
+    lua_pushinteger(L, (lua_Integer)index->count) ;                         lua_setfield(L, -2, "indexCells") ;
+    lua_pushinteger(L, (lua_Integer)index->entries) ;                       lua_setfield(L, -2, "indexEntries") ;
+    lua_pushinteger(L, (lua_Integer)index->undrawnCells) ;                  lua_setfield(L, -2, "undrawnCells") ;
+    lua_pushinteger(L, (lua_Integer)turtleIndex_bytesAllocated(index)) ;    lua_setfield(L, -2, "indexBytes") ;
+    return 1 ;
+}
+
+/// hs.canvas.turtle:_commandsAt(x, y, [tolerance]) -> table
+/// Method
+/// Returns the commands which draw over the specified point of the turtle's drawing.
+///
+/// Parameters:
+///  * `x`         - the x coordinate of the point, relative to the turtle's home position
+///  * `y`         - the y coordinate of the point, relative to the turtle's home position, with positive values above home
+///  * `tolerance` - an optional number, default 2.0, specifying how far outside of a stroke the point may be and still be considered over it
+///
+/// Returns:
+///  * a table containing the positions, in ascending order, of the matching commands in the table returned by `hs.canvas.turtle:_commands`; the table is empty if nothing has been drawn at the point.
+///
+/// Notes:
+///  * coordinates are in the same units as [hs.canvas.turtle:pos](#pos) after any scrunch has been applied, i.e. the units of the canvas itself.
+///  * to test a point from a canvas mouse callback, which is relative to the top left of the canvas, subtract half of the canvas width from x, subtract y from half of the canvas height, and then subtract the offsets returned by [hs.canvas.turtle:_translate](#_translate).
+///  * only the commands recorded near the point are tested, so this stays fast regardless of how many commands the drawing has.
+static int turtle_commandsAt(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TNUMBER, LS_TNUMBER, LS_TNUMBER | LS_TOPTIONAL, LS_TBREAK] ;
+    HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+    NSPoint            point         = NSMakePoint(lua_tonumber(L, 2), lua_tonumber(L, 3)) ;
+    lua_Number         tolerance     = luaL_optnumber(L, 4, 2.0) ;
+    if (!(tolerance >= 0.0 && isfinite(tolerance))) return luaL_argerror(L, 4, "tolerance must be 0 or greater") ;
+
+    NSIndexSet *found = [turtleCanvas commandsAtPoint:point withTolerance:tolerance] ;
+    lua_newtable(L) ;
+    __block lua_Integer position = 1 ;
+    [found enumerateIndexesUsingBlock:^(NSUInteger idx, __unused BOOL *stop) {
+        lua_pushinteger(L, (lua_Integer)idx + 1) ;
+        lua_rawseti(L, -2, position++) ;
+    }] ;
+    return 1 ;
+}
+
+/// hs.canvas.turtle:_checkpoints([interval], [maxBytes]) -> turtleViewObject | table
+/// Method
+/// Get or set how often checkpoints used by [hs.canvas.turtle:_rewind](#_rewind) are recorded and how much memory they may use.
+///
+/// Parameters:
+///  * `interval` - an optional integer specifying how many commands apart checkpoints are recorded, or 0 to keep only the checkpoint at the start of the drawing. Defaults to 0.
+///  * `maxBytes` - an optional integer specifying how many bytes the checkpoints' snapshots of the drawing may use, or 0 for no limit. Defaults to 64 MiB.
+///
+/// Returns:
+///  * if an argument is provided, returns the turtleViewObject; otherwise a table with the following keys:
+///    * `interval` - the interval set
+///    * `spacing`  - the interval currently in effect; this doubles each time checkpoints are thinned out to stay within `maxBytes`
+///    * `maxBytes` - the limit set
+///    * `count`    - the number of checkpoints currently held, including the one at the start of the drawing
+///    * `bytes`    - the bytes currently used by the checkpoints
+///    * `recorded` - the number of checkpoints recorded since the turtle was created
+///    * `thinned`  - the number of times checkpoints have been thinned out
+///
+/// Notes:
+///  * recording a checkpoint rasterizes everything drawn so far, including any parts of the drawing which aren't currently visible, and copies the parts of the drawing which have changed since the previous checkpoint, so a small interval can slow drawing down noticeably; intervals in the thousands are usually a good balance.
+///  * setting either value resets the spacing back to the interval.
+static int turtle_checkpoints(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TNUMBER | LS_TINTEGER | LS_TOPTIONAL, LS_TNUMBER | LS_TINTEGER | LS_TOPTIONAL, LS_TBREAK] ;
+    HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+    turtleCheckpoints  *checkpoints  = turtleCanvas.checkpoints ;
+
+    if (lua_gettop(L) == 1) {
+        lua_newtable(L) ;
+        lua_pushinteger(L, (lua_Integer)checkpoints->interval) ; lua_setfield(L, -2, "interval") ;
+        lua_pushinteger(L, (lua_Integer)checkpoints->spacing) ;  lua_setfield(L, -2, "spacing") ;
+        lua_pushinteger(L, (lua_Integer)checkpoints->maxBytes) ; lua_setfield(L, -2, "maxBytes") ;
+        lua_pushinteger(L, (lua_Integer)checkpoints->count) ;    lua_setfield(L, -2, "count") ;
+        lua_pushinteger(L, (lua_Integer)turtleCheckpoints_bytesAllocated(checkpoints)) ;
+        lua_setfield(L, -2, "bytes") ;
+        lua_pushinteger(L, (lua_Integer)checkpoints->recorded) ; lua_setfield(L, -2, "recorded") ;
+        lua_pushinteger(L, (lua_Integer)checkpoints->thinned) ;  lua_setfield(L, -2, "thinned") ;
+    } else {
+        lua_Integer interval = luaL_optinteger(L, 2, (lua_Integer)checkpoints->interval) ;
+        lua_Integer maxBytes = luaL_optinteger(L, 3, (lua_Integer)checkpoints->maxBytes) ;
+        if (interval < 0) return luaL_argerror(L, 2, "interval must be 0 or greater") ;
+        if (maxBytes < 0) return luaL_argerror(L, 3, "maxBytes must be 0 or greater") ;
+        turtleCheckpoints_configure(checkpoints, (size_t)interval, (size_t)maxBytes) ;
+        lua_pushvalue(L, 1) ;
+    }
+    return 1 ;
+}
+
+/// hs.canvas.turtle:_decimation([pixels]) -> turtleViewObject | number
+/// Method
+/// Get or set the tolerance within which runs of short moves are simplified before they're drawn.
+///
+/// Parameters:
+///  * `pixels` - an optional number, 0 or greater, specifying how far, in screen pixels, the simplified strokes may stray from the moves as they were issued, or 0 to draw every move exactly. Defaults to 0.
+///
+/// Returns:
+///  * if an argument is provided, returns the turtleViewObject; otherwise returns the current value.
+///
+/// Notes:
+///  * recursive drawings like ferns and trees spend most of their commands on moves only a pixel or two long, each of which costs as much to draw as a long one. With a tolerance set, connected moves in the same opaque color are reduced to the fewest segments which stay within the tolerance of the original, keeping the ends of each connected run; a tolerance of 0.5 is rarely noticeable.
+///  * moves in reverse mode or a translucent color, arcs, fills and labels are always drawn exactly.
+///  * only what is drawn is affected -- the commands themselves, and so `hs.canvas.turtle:_commands`, saved pictures and exported SVG, are unchanged.
+///  * changing the tolerance redraws the whole drawing.
+static int turtle_decimation(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TNUMBER | LS_TOPTIONAL, LS_TBREAK] ;
+    HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+
+    if (lua_gettop(L) == 1) {
+        lua_pushnumber(L, turtleCanvas.decimation) ;
+    } else {
+        lua_Number pixels = lua_tonumber(L, 2) ;
+        if (!(pixels >= 0.0 && isfinite(pixels))) return luaL_argerror(L, 2, "tolerance must be 0 or greater") ;
+        turtleCanvas.decimation = pixels ;
+        lua_pushvalue(L, 1) ;
+    }
+    return 1 ;
+}
+
+/// hs.canvas.turtle:_rewind(count) -> turtleViewObject
+/// Method
+/// Discards every command after the first `count` and returns the turtle and its drawing to how they were at that point.
+///
+/// Parameters:
+///  * `count` - an integer from 0 to the number of commands in the drawing (see `hs.canvas.turtle:_cmdCount`) specifying how many commands to keep
+///
+/// Returns:
+///  * the turtleViewObject
+///
+/// Notes:
+///  * this undoes the commands as if they had never been issued: the turtle's position, heading, pen, colors, palette and label font are all restored along with the drawing, and commands issued afterwards continue from there.
+///  * the nearest checkpoint at or before `count` is restored and the commands after it are replayed, so how long this takes depends on the interval set with [hs.canvas.turtle:_checkpoints](#_checkpoints); without checkpoints, everything up to `count` is replayed from the start of the drawing (or the last `hs.canvas.turtle:clean`).
+static int turtle_rewind(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TNUMBER | LS_TINTEGER, LS_TBREAK] ;
+    HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+    lua_Integer        count         = lua_tointeger(L, 2) ;
+
+    if (count < 0 || (size_t)count > turtleCanvas.commandLog->count) {
+        return luaL_argerror(L, 2, "count must be between 0 and the number of commands") ;
+    }
+    if (![turtleCanvas rewindToCommand:(size_t)count withState:L]) {
+        return luaL_error(L, "no checkpoint to rewind from") ;
+    }
+    lua_pushvalue(L, 1) ;
+    return 1 ;
+}
+
+// internal; _labelCache() -> table of glyph cache hits, misses and entries, or _labelCache(capacity) to
+// set how many label outlines are kept
+static int turtle_labelCache(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TNUMBER | LS_TINTEGER | LS_TOPTIONAL, LS_TBREAK] ;
+    HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+    HSTurtleGlyphCache *cache        = turtleCanvas.glyphCache ;
+
+    if (lua_gettop(L) == 2) {
+        lua_Integer capacity = lua_tointeger(L, 2) ;
+        if (capacity < 0) return luaL_argerror(L, 2, "capacity cannot be negative") ;
+        cache.capacity = (NSUInteger)capacity ;
+        lua_pushvalue(L, 1) ;
+    } else {
+        lua_newtable(L) ;
+        lua_pushinteger(L, (lua_Integer)cache.hits) ;     lua_setfield(L, -2, "hits") ;
+        lua_pushinteger(L, (lua_Integer)cache.misses) ;   lua_setfield(L, -2, "misses") ;
+        lua_pushinteger(L, (lua_Integer)cache.count) ;    lua_setfield(L, -2, "entries") ;
+        lua_pushinteger(L, (lua_Integer)cache.capacity) ; lua_setfield(L, -2, "capacity") ;
+    }
     return 1 ;
 }
 
+static void pushLogNumber(lua_State *L, const turtleLog *log, size_t idx, uint8_t argIdx) {
+    double value = turtleLog_args(log, idx)[argIdx] ;
+    if (log->flags[idx] & T_FLAG_INTEGER(argIdx)) {
+        lua_pushinteger(L, (lua_Integer)value) ;
+    } else {
+        lua_pushnumber(L, value) ;
+    }
+}
+
+// pushes the arguments for the command at idx in the same form they were originally provided
+static void pushCommandArguments(lua_State *L, HSCanvasTurtleView *turtleCanvas, size_t idx) {
+    LuaSkin         *skin       = [LuaSkin sharedWithState:L] ;
+    const turtleLog *log        = turtleCanvas.commandLog ;
+    double          *args       = turtleLog_args(log, idx) ;
+    NSArray         *cmdDetails = wrappedCommands[log->ops[idx]] ;
+    uint8_t         argIdx      = 0 ;
+
+    for (NSUInteger i = 3 ; i < cmdDetails.count ; i++) {
+        NSObject *expectedArgType = cmdDetails[i] ;
+        if ([expectedArgType isKindOfClass:[NSArray class]]) {
+            lua_newtable(L) ;
+            for (NSUInteger j = 0 ; j < ((NSArray *)expectedArgType).count ; j++) {
+                pushLogNumber(L, log, idx, argIdx++) ;
+                lua_rawseti(L, -2, luaL_len(L, -2) + 1) ;
+            }
+        } else if ([(NSString *)expectedArgType isEqualToString:@"number"]) {
+            pushLogNumber(L, log, idx, argIdx++) ;
+        } else {
+            [skin pushNSObject:turtleCanvas.internedObjects[(NSUInteger)args[argIdx++]]] ;
+        }
+        lua_rawseti(L, -2, luaL_len(L, -2) + 1) ;
+    }
+}
+
 static int turtle_commandDump(lua_State *L) {
     LuaSkin *skin = [LuaSkin sharedWithState:L] ;
     [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TBOOLEAN | LS_TOPTIONAL, LS_TBREAK] ;
     HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+    const turtleLog    *log          = turtleCanvas.commandLog ;
     BOOL raw = (lua_gettop(L) == 1) ? NO : (BOOL)(lua_toboolean(L, 2)) ;
 
-    if (raw) {
-        [skin pushNSObject:turtleCanvas.commandList withOptions:LS_NSDescribeUnknownTypes] ;
-    } else {
+    lua_newtable(L) ;
+    for (size_t i = 0 ; i < log->count ; i++) {
         lua_newtable(L) ;
-        for (NSArray *entry in turtleCanvas.commandList) {
+        lua_pushinteger(L, log->ops[i]) ; lua_rawseti(L, -2, luaL_len(L, -2) + 1) ;
+        if (raw) {
+            // arguments as provided, plus what the log recorded about the turtle state for the command
             lua_newtable(L) ;
-            [skin pushNSObject:entry[0]] ; lua_rawseti(L, -2, luaL_len(L, -2) + 1) ;
-            NSArray *arguments = entry[1][@"arguments"] ;
-            if (arguments) {
-                for (NSObject *arg in arguments) {
-                    [skin pushNSObject:arg] ; lua_rawseti(L, -2, luaL_len(L, -2) + 1) ;
-                }
+            lua_newtable(L) ;
+            pushCommandArguments(L, turtleCanvas, i) ;
+            lua_setfield(L, -2, "arguments") ;
+            lua_newtable(L) ;
+            double  *derived  = turtleLog_derived(log, i) ;
+            uint8_t derivedc = turtleLog_derivedCount(log->ops[i]) ;
+            for (uint8_t j = 0 ; j < derivedc ; j++) {
+                lua_pushnumber(L, derived[j]) ; lua_rawseti(L, -2, luaL_len(L, -2) + 1) ;
             }
+            lua_setfield(L, -2, "derived") ;
+            lua_pushboolean(L, (log->flags[i] & T_FLAG_DRAWS)) ; lua_setfield(L, -2, "draws") ;
             lua_rawseti(L, -2, luaL_len(L, -2) + 1) ;
+        } else {
+            pushCommandArguments(L, turtleCanvas, i) ;
         }
+        lua_rawseti(L, -2, luaL_len(L, -2) + 1) ;
     }
     return 1 ;
 }
@@ -1192,6 +2487,298 @@ static int turtle_appendCommand(lua_State *L) {
     return 1 ;
 }
 
+// internal; used by init.lua to submit the commands _buffer has collected, as a flat table, a packed
+// string or a command stream. Returns the turtle or an error message for the lua wrapper to raise.
+static int turtle_appendCommands(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TTABLE | LS_TSTRING, LS_TBREAK] ;
+    HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+
+    NSError *errMsg  = nil ;
+    if (lua_type(L, 2) == LUA_TSTRING) {
+        size_t     length = 0 ;
+        const char *data  = lua_tolstring(L, 2, &length) ;
+        if (turtleStream_isStream((const uint8_t *)data, length)) {
+            [turtleCanvas appendStreamedCommands:(const uint8_t *)data length:length andState:L error:&errMsg] ;
+        } else {
+            [turtleCanvas appendPackedCommands:(const uint8_t *)data length:length andState:L error:&errMsg] ;
+        }
+    } else {
+        [turtleCanvas appendCommandsFromTableAtIndex:2 andState:L error:&errMsg] ;
+    }
+
+    if (errMsg) {
+        // error is handled in lua wrapper
+        [skin pushNSObject:errMsg.localizedDescription] ;
+    } else {
+        lua_pushvalue(L, 1) ;
+    }
+    return 1 ;
+}
+
+typedef struct {
+    __unsafe_unretained HSCanvasTurtleView *turtleCanvas ;
+    lua_State                              *L ;
+} streamContext ;
+
+// describes the interned object at idx for a command stream; NSColors and color tables are written
+// as their sRGB components since nothing but a turtle could read them back otherwise
+static bool describeStreamObject(void *context, __unused char type, uint32_t idx, turtleStreamObject *object) {
+    streamContext *ctx    = context ;
+    NSObject      *source = ctx->turtleCanvas.internedObjects[idx] ;
+
+    if ([source isKindOfClass:[NSString class]]) {
+        object->kind   = t_streamString ;
+        object->string = ((NSString *)source).UTF8String ;
+        object->length = [(NSString *)source lengthOfBytesUsingEncoding:NSUTF8StringEncoding] ;
+    } else if ([source isKindOfClass:[NSNumber class]]) {
+        object->kind    = t_streamPalette ;
+        object->palette = ((NSNumber *)source).unsignedIntValue ;
+    } else if ([source isKindOfClass:[NSArray class]]) {
+        NSArray<NSNumber *> *list = (NSArray *)source ;
+        object->kind           = t_streamColor ;
+        object->componentCount = (uint8_t)list.count ;
+        for (NSUInteger i = 0 ; i < list.count ; i++) object->components[i] = list[i].doubleValue ;
+    } else {
+        NSColor *color = [[ctx->turtleCanvas colorFromArgument:source withState:ctx->L] colorUsingColorSpace:NSColorSpace.sRGBColorSpace] ;
+        if (!color) return false ;
+        object->kind           = t_streamColor ;
+        object->componentCount = 4 ;
+        object->components[0]  = color.redComponent * 100.0 ;
+        object->components[1]  = color.greenComponent * 100.0 ;
+        object->components[2]  = color.blueComponent * 100.0 ;
+        object->components[3]  = color.alphaComponent * 100.0 ;
+    }
+    return true ;
+}
+
+static bool flushStream(turtleStreamWriter *writer, FILE *file) {
+    bool isGood = fwrite(writer->bytes, 1, writer->length, file) == writer->length ;
+    turtleStreamWriter_drain(writer) ;
+    return isGood ;
+}
+
+/// hs.canvas.turtle:_saveCommands(path) -> true | nil, errorMessage
+/// Method
+/// Writes the turtle's commands to a file in a compact binary form which can be loaded again with [hs.canvas.turtle:_loadCommands](#_loadCommands).
+///
+/// Parameters:
+///  * `path` - a string specifying the file to write the commands to; it is replaced if it already exists
+///
+/// Returns:
+///  * true if the commands were written, or nil and a message describing the error if they weren't
+///
+/// Notes:
+///  * each command is stored as a byte for the command followed by its arguments, with integers as variable length integers and other numbers as doubles; strings and colors are stored once each and referred to by number, so most commands take 2 or 3 bytes. The format is described in `commandStream.h`.
+///  * only the commands are saved -- the drawing is recreated by replaying them -- so commands issued before the last `hs.canvas.turtle:clean` aren't included, and what was in effect when the saved commands began (pen color, pen size, position, etc.) is whatever the turtle they're loaded into has at that point.
+///  * colors specified as an `hs.drawing.color` table are saved as their red, green, blue and alpha components.
+static int turtle_saveCommands(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TSTRING, LS_TBREAK] ;
+    HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+    NSString           *path         = [[skin toNSObjectAtIndex:2] stringByExpandingTildeInPath] ;
+    const turtleLog    *log          = turtleCanvas.commandLog ;
+
+    FILE *file = fopen(path.fileSystemRepresentation, "wb") ;
+    if (!file) {
+        lua_pushnil(L) ;
+        lua_pushfstring(L, "%s: %s", path.UTF8String, strerror(errno)) ;
+        return 2 ;
+    }
+
+    streamContext      context = { .turtleCanvas = turtleCanvas, .L = L } ;
+    turtleStreamWriter writer ;
+    turtleStreamWriter_init(&writer) ;
+
+    bool isGood = turtleStreamWriter_beginSegment(&writer) ;
+    for (size_t i = 0 ; isGood && i < log->count ; i++) {
+        isGood = turtleStreamWriter_writeCommand(&writer, log, i, describeStreamObject, &context) ;
+        if (isGood && writer.length >= streamFlushBytes) isGood = flushStream(&writer, file) ;
+    }
+    isGood = isGood && flushStream(&writer, file) ;
+    isGood = (fclose(file) == 0) && isGood ;
+    turtleStreamWriter_free(&writer) ;
+
+    if (!isGood) {
+        lua_pushnil(L) ;
+        lua_pushfstring(L, "%s: error writing commands", path.UTF8String) ;
+        return 2 ;
+    }
+    lua_pushboolean(L, YES) ;
+    return 1 ;
+}
+
+// upvalues are the turtle, the index of the next command to write, and the commands per chunk
+static int turtle_nextCommandChunk(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    lua_pushvalue(L, lua_upvalueindex(1)) ;
+    HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:-1] ;
+    lua_pop(L, 1) ;
+    size_t             next          = (size_t)lua_tointeger(L, lua_upvalueindex(2)) ;
+    size_t             count         = (size_t)lua_tointeger(L, lua_upvalueindex(3)) ;
+    const turtleLog    *log          = turtleCanvas.commandLog ;
+
+    if (next >= log->count) {
+        lua_pushnil(L) ;
+        return 1 ;
+    }
+
+    size_t             end     = (log->count - next > count) ? next + count : log->count ;
+    streamContext      context = { .turtleCanvas = turtleCanvas, .L = L } ;
+    turtleStreamWriter writer ;
+    turtleStreamWriter_init(&writer) ;
+
+    // every chunk starts a new segment so it can be loaded without the ones before it
+    bool isGood = turtleStreamWriter_beginSegment(&writer) ;
+    for (size_t i = next ; isGood && i < end ; i++) {
+        isGood = turtleStreamWriter_writeCommand(&writer, log, i, describeStreamObject, &context) ;
+    }
+    if (isGood) lua_pushlstring(L, (const char *)writer.bytes, writer.length) ;
+    turtleStreamWriter_free(&writer) ;
+    if (!isGood) return luaL_error(L, "unable to write commands %d through %d", (int)next, (int)end) ;
+
+    lua_pushinteger(L, (lua_Integer)end) ;
+    lua_replace(L, lua_upvalueindex(2)) ;
+    return 1 ;
+}
+
+/// hs.canvas.turtle:_commandChunks([count]) -> function
+/// Method
+/// Returns an iterator which returns the turtle's commands in the binary form written by [hs.canvas.turtle:_saveCommands](#_saveCommands), a chunk at a time.
+///
+/// Parameters:
+///  * `count` - an optional integer greater than 0, default 4096, specifying how many commands to include in each chunk
+///
+/// Returns:
+///  * a function which returns the next chunk as a string each time it is called, or nil once all of the commands have been returned; suitable for use with a generic `for` loop.
+///
+/// Notes:
+///  * each chunk can be loaded on its own with [hs.canvas.turtle:_loadCommands](#_loadCommands) or `hs.canvas.turtle:_appendCommands`, and chunks written one after the other, to a file for example, can be loaded together.
+///  * commands issued while iterating are included when the iterator reaches them.
+static int turtle_commandChunks(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TNUMBER | LS_TINTEGER | LS_TOPTIONAL, LS_TBREAK] ;
+    lua_Integer count = (lua_gettop(L) == 1) ? defaultChunkCommands : lua_tointeger(L, 2) ;
+    if (count < 1) return luaL_argerror(L, 2, "count must be greater than 0") ;
+
+    lua_pushvalue(L, 1) ;
+    lua_pushinteger(L, 0) ;
+    lua_pushinteger(L, count) ;
+    lua_pushcclosure(L, turtle_nextCommandChunk, 3) ;
+    return 1 ;
+}
+
+/// hs.canvas.turtle:_loadCommands(path) -> turtleViewObject | nil, errorMessage
+/// Method
+/// Appends the commands in a file written by [hs.canvas.turtle:_saveCommands](#_saveCommands) to the turtle.
+///
+/// Parameters:
+///  * `path` - a string specifying the file to load the commands from
+///
+/// Returns:
+///  * the turtleViewObject, or nil and a message describing the error if the file can't be read or contains a command which isn't valid
+///
+/// Notes:
+///  * the commands are appended to any already in the turtle and performed from its current state, so to recreate a drawing exactly, load it into a new turtle or use `hs.canvas.turtle:loadpict`.
+///  * commands are replayed directly without calling back into Lua, so this is much faster than issuing the same commands from Lua.
+///  * loading stops at the first error; any commands before it remain.
+static int turtle_loadCommands(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TSTRING, LS_TBREAK] ;
+    HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+    NSString           *path         = [[skin toNSObjectAtIndex:2] stringByExpandingTildeInPath] ;
+
+    NSError *errMsg = nil ;
+    NSData  *data   = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:&errMsg] ;
+    if (data && !turtleStream_isStream(data.bytes, data.length)) {
+        errMsg = turtleError(@"not a file of saved turtle commands") ;
+    } else if (data) {
+        [turtleCanvas appendStreamedCommands:data.bytes length:data.length andState:L error:&errMsg] ;
+    }
+
+    if (errMsg) {
+        lua_pushnil(L) ;
+        [skin pushNSObject:[NSString stringWithFormat:@"%@: %@", path, errMsg.localizedDescription]] ;
+        return 2 ;
+    }
+    lua_pushvalue(L, 1) ;
+    return 1 ;
+}
+
+/// hs.canvas.turtle:_startProgram(program, [procedure], ...) -> integer | nil, errorMessage
+/// Method
+/// Starts running a program compiled by [hs.canvas.turtle._compile](#_compile) on the turtle.
+///
+/// Parameters:
+///  * `program`   - a string containing the compiled program
+///  * `procedure` - an optional string naming the procedure in the program to run; if it's nil or absent, the instructions outside of any procedure definition are run
+///  * `...`       - numbers for the procedure's parameters, if it has any
+///
+/// Returns:
+///  * an integer identifying the run for [hs.canvas.turtle:_stepProgram](#_stepProgram), or nil and a message if the program is damaged, the procedure doesn't exist, or the wrong number of arguments were given
+///
+/// Notes:
+///  * no commands are performed until `hs.canvas.turtle:_stepProgram` is called; `hs.canvas.turtle:run` does both.
+///  * a turtle runs one program at a time, so starting a program abandons any run which is paused.
+static int turtle_startProgram(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TSTRING, LS_TSTRING | LS_TNIL | LS_TOPTIONAL, LS_TBREAK | LS_TVARARG] ;
+    HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+    size_t             length        = 0 ;
+    const char         *program      = lua_tolstring(L, 2, &length) ;
+    NSString           *procedure    = (lua_type(L, 3) == LUA_TSTRING) ? [skin toNSObjectAtIndex:3] : nil ;
+
+    int    argc = (lua_gettop(L) > 3) ? lua_gettop(L) - 3 : 0 ;
+    double args[T_PROGRAM_MAX_PARAMS] ;
+    if (argc > T_PROGRAM_MAX_PARAMS) return luaL_argerror(L, 4 + T_PROGRAM_MAX_PARAMS, "too many arguments for procedure") ;
+    for (int i = 0 ; i < argc ; i++) args[i] = luaL_checknumber(L, 4 + i) ;
+
+    NSError     *errMsg = nil ;
+    lua_Integer run     = [turtleCanvas startProgram:(const uint8_t *)program length:length
+                                                                        procedure:procedure
+                                                                        arguments:args
+                                                                            count:(size_t)argc
+                                                                            error:&errMsg] ;
+    if (run == 0) {
+        lua_pushnil(L) ;
+        [skin pushNSObject:errMsg.localizedDescription] ;
+        return 2 ;
+    }
+    lua_pushinteger(L, run) ;
+    return 1 ;
+}
+
+/// hs.canvas.turtle:_stepProgram(run, [mayYield]) -> boolean | nil, errorMessage
+/// Method
+/// Continues running the program started by [hs.canvas.turtle:_startProgram](#_startProgram).
+///
+/// Parameters:
+///  * `run`      - the integer returned by `hs.canvas.turtle:_startProgram`
+///  * `mayYield` - an optional boolean, default false, specifying whether the program should stop when it's time for a backgrounded function to yield
+///
+/// Returns:
+///  * true if the program finished, false if it stopped so the caller can yield, or nil and a message describing the error which stopped the program
+///
+/// Notes:
+///  * the program runs entirely in C without calling back into Lua; when `mayYield` is true, it stops after the number of commands or the time set by [hs.canvas.turtle:_yieldRatio](#_yieldRatio) or [hs.canvas.turtle:_yieldBudget](#_yieldBudget), or after a million instructions which didn't draw anything, and continues from the same place the next time this method is called.
+///  * `mayYield` is ignored if [hs.canvas.turtle:_neverYield](#_neverYield) is set.
+///  * commands performed before an error remain.
+static int turtle_stepProgram(lua_State *L) {
+    LuaSkin *skin = [LuaSkin sharedWithState:L] ;
+    [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TNUMBER | LS_TINTEGER, LS_TBOOLEAN | LS_TOPTIONAL, LS_TBREAK] ;
+    HSCanvasTurtleView *turtleCanvas = [skin toNSObjectAtIndex:1] ;
+
+    BOOL    done    = NO ;
+    NSError *errMsg = nil ;
+    if (![turtleCanvas resumeProgram:lua_tointeger(L, 2) mayYield:(BOOL)lua_toboolean(L, 3) done:&done andState:L error:&errMsg]) {
+        lua_pushnil(L) ;
+        [skin pushNSObject:errMsg.localizedDescription] ;
+        return 2 ;
+    }
+    lua_pushboolean(L, done) ;
+    return 1 ;
+}
+
 static int turtle_translate(lua_State *L) {
     LuaSkin *skin = [LuaSkin sharedWithState:L] ;
     [skin checkArgs:LS_TUSERDATA, USERDATA_TAG, LS_TBREAK | LS_TVARARG] ;
@@ -1596,10 +3183,7 @@ static int turtle_palette(lua_State *L) {
         //   fill
         //   filled
 
-// Not Sure Yet
-    // 6.7 Saving and Loading Pictures
-        //   savepict -- could do in lua, leveraging _commands
-        //   loadpict -- could do in lua, leveraging _appendCommand after resetting state
+// 6.7 Saving and Loading Pictures -- savepict and loadpict wrap _saveCommands and _loadCommands in init.lua
 
 #pragma mark - Module Constants
 
@@ -1708,10 +3292,26 @@ static const luaL_Reg userdata_metaLib[] = {
 
     {"_yieldRatio",      turtle_yieldRatio},
     {"_neverYield",      turtle_neverYield},
+    {"_yieldBudget",     turtle_yieldBudget},
+    {"_yieldStats",      turtle_yieldStats},
+    {"_yieldCheck",      turtle_yieldCheck},
     {"_pause",           turtle_pauseRendering},
     {"_image",           turtle_asImage},
     {"_cmdCount",        turtle_commandCount},
+    {"_cmdMemory",       turtle_commandMemory},
+    {"_tileMemory",      turtle_tileMemory},
+    {"_labelCache",      turtle_labelCache},
+    {"_commandsAt",      turtle_commandsAt},
+    {"_checkpoints",     turtle_checkpoints},
+    {"_decimation",      turtle_decimation},
+    {"_rewind",          turtle_rewind},
     {"_appendCommand",   turtle_appendCommand},
+    {"_appendCommands",  turtle_appendCommands},
+    {"_saveCommands",    turtle_saveCommands},
+    {"_commandChunks",   turtle_commandChunks},
+    {"_loadCommands",    turtle_loadCommands},
+    {"_startProgram",    turtle_startProgram},
+    {"_stepProgram",     turtle_stepProgram},
     {"_turtleImage",     turtle_turtleImage},
     {"_turtleSize",      turtle_turtleSize},
     {"_canvas",          turtle_parentView},
@@ -1731,6 +3331,7 @@ static luaL_Reg moduleLib[] = {
     {"new",                     turtle_new},
     {"_registerDefaultPalette", turtle_registerDefaultPalette},
     {"_registerFontMap",        turtle_registerFontMap},
+    {"_compile",                turtle_compile},
     {NULL,                      NULL}
 };
 
@@ -1768,5 +3369,17 @@ int luaopen_hs_canvas_turtle_internal(lua_State* L) {
     wrappedCommands = t_wrappedCommands ;
     turtle_CommandsToBeWrapped(L) ; lua_setfield(L, -2, "_wrappedCommands") ;
 
+    for (NSUInteger cmd = 0 ; cmd < wrappedCommands.count && cmd < c__commandCount ; cmd++) {
+        NSArray *cmdDetails = wrappedCommands[cmd] ;
+        uint8_t argc        = 0 ;
+        for (NSUInteger i = 3 ; i < cmdDetails.count ; i++) {
+            NSArray *types = [cmdDetails[i] isKindOfClass:[NSArray class]] ? cmdDetails[i] : @[ cmdDetails[i] ] ;
+            for (NSString *type in types) {
+                if (argc < T_MAX_ARGUMENTS) argumentTypes[cmd][argc++] = (char)[type characterAtIndex:0] ;
+            }
+        }
+        argumentTypes[cmd][argc] = 0 ;
+    }
+
     return 1;
 }
@@ -0,0 +1,185 @@
+// Parallel rasterization of long runs of hs.canvas.turtle commands
+//
+// Plain C so it can be used (and measured) outside of Hammerspoon -- nothing in here knows about
+// AppKit or Lua. When a long range of commands is waiting to be rasterized (a paused turtle being
+// resumed, a drawing built without yielding, a rewind replaying its commands) the range is split
+// into consecutive pieces, one per worker thread. The first piece is drawn straight into the tiles
+// by the calling thread; every other piece is drawn into the worker's own layer, a tile cache whose
+// pixels hold the map each compositing operation was chained into (see turtleRaster.h) rather
+// than colors. Once every worker is done, the layers are applied to the tiles in order.
+//
+// Because a layer records how it changes whatever is beneath it instead of what it looks like on
+// its own, erase and reverse (XOR) commands in a later piece act on what the earlier pieces drew
+// just as they would when drawn in order; the only difference from drawing serially is that each
+// layer is rounded to 8 bits once, when applied, rather than after every command.
+//
+// Layers take 36 bytes per pixel, so a worker touching many tiles can use a lot of memory while
+// rendering; layers are released once they've been applied.
+
+#pragma once
+
+#include "turtleRaster.h"
+
+#include <pthread.h>
+
+#define T_PARALLEL_MAX_THREADS   64
+#define T_PARALLEL_MIN_COMMANDS  4096  // ranges shorter than this per worker aren't worth splitting
+
+typedef struct {
+    turtleRaster    raster ;          // scratch space for the worker's own polygons and coverage
+    turtleTileCache layer ;
+    const turtleLog *log ;
+    size_t          start ;
+    size_t          end ;
+    bool            isGood ;
+    pthread_t       thread ;
+    bool            running ;         // thread was created and hasn't been joined yet
+} turtleRasterWorker ;
+
+typedef struct {
+    size_t             threads ;      // workers to split long ranges across, including the caller's
+    size_t             minCommands ;
+    turtleRasterWorker *workers ;
+    size_t             workerCount ;  // workers allocated, which may be more than are in use
+
+    // statistics
+    size_t             renders ;      // ranges split across more than one worker
+    size_t             layersApplied ;
+    size_t             peakLayerBytes ; // layers are released after each render, so this is their high water mark
+} turtleParallelRaster ;
+
+#pragma mark - Lifecycle
+
+static inline void turtleParallel_init(turtleParallelRaster *parallel, size_t threads) {
+    memset(parallel, 0, sizeof(turtleParallelRaster)) ;
+    parallel->threads     = (threads > 0) ? threads : 1 ;
+    parallel->minCommands = T_PARALLEL_MIN_COMMANDS ;
+}
+
+static inline void turtleParallel_free(turtleParallelRaster *parallel) {
+    for (size_t i = 0 ; i < parallel->workerCount ; i++) {
+        turtleRaster_free(&parallel->workers[i].raster) ;
+        turtleTiles_free(&parallel->workers[i].layer) ;
+    }
+    free(parallel->workers) ;
+    turtleParallel_init(parallel, parallel->threads) ;
+}
+
+static inline void turtleParallel_setThreads(turtleParallelRaster *parallel, size_t threads) {
+    if (threads < 1)                      threads = 1 ;
+    if (threads > T_PARALLEL_MAX_THREADS) threads = T_PARALLEL_MAX_THREADS ;
+    parallel->threads = threads ;
+}
+
+static inline size_t turtleParallel_bytesAllocated(const turtleParallelRaster *parallel) {
+    size_t bytes = parallel->workerCount * sizeof(turtleRasterWorker) ;
+    for (size_t i = 0 ; i < parallel->workerCount ; i++) {
+        bytes += turtleRaster_bytesAllocated(&parallel->workers[i].raster) +
+                 turtleTiles_bytesAllocated(&parallel->workers[i].layer) ;
+    }
+    return bytes ;
+}
+
+#pragma mark - Workers
+
+static void *turtleParallel_work(void *context) {
+    turtleRasterWorker *worker = context ;
+    worker->isGood = turtleRaster_render(&worker->raster, &worker->layer, worker->log, worker->start, worker->end) ;
+    return NULL ;
+}
+
+// applies the worker's layer to the tiles, allocating any which haven't been drawn in yet
+static bool turtleParallel_applyLayer(turtleTileCache *tiles, const turtleTileCache *layer) {
+    size_t pixels = (size_t)tiles->tilePixels * tiles->tilePixels ;
+
+    for (size_t i = 0 ; i < layer->count ; i++) {
+        const turtleTile *source = &layer->tiles[i] ;
+        turtleTile       *tile   = turtleTiles_fetch(tiles, source->x, source->y) ;
+        if (!tile) return false ;
+
+        // most of a layer's pixels are usually untouched, and so still the (all zero) identity
+        static const float identity[T_LAYER_CHANNELS] = { 0 } ;
+        const float *map = (const float *)(const void *)source->pixels ;
+        for (size_t n = 0 ; n < pixels ; n++, map += T_LAYER_CHANNELS) {
+            if (memcmp(map, identity, sizeof(identity)) != 0) turtleRaster_applyLayerPixel(tile->pixels + n * 4, map) ;
+        }
+        tile->modified = true ;
+    }
+    return true ;
+}
+
+#pragma mark - Rendering
+
+// Rasterizes the commands from start up to (but not including) end into the tiles like
+// turtleRaster_render, splitting the range across the parallel raster's threads if it's long
+// enough. raster is used by the calling thread and its decimation tolerance is shared with the
+// workers. Returns false if memory could not be allocated, in which case the tiles are incomplete.
+static bool turtleParallel_render(turtleParallelRaster *parallel, turtleRaster *raster, turtleTileCache *tiles,
+                                  const turtleLog *log, size_t start, size_t end) {
+    if (end > log->count) end = log->count ;
+    size_t length = (end > start) ? end - start : 0 ;
+    size_t count  = parallel->threads ;
+    if (parallel->minCommands > 0 && length / parallel->minCommands < count) count = length / parallel->minCommands ;
+    if (count <= 1) return turtleRaster_render(raster, tiles, log, start, end) ;
+
+    // worker 0 is the calling thread drawing into the tiles themselves and only its range is used
+    if (count > parallel->workerCount) {
+        turtleRasterWorker *workers = realloc(parallel->workers, count * sizeof(turtleRasterWorker)) ;
+        if (!workers) return turtleRaster_render(raster, tiles, log, start, end) ;
+        for (size_t i = parallel->workerCount ; i < count ; i++) {
+            turtleRaster_init(&workers[i].raster) ;
+            turtleTiles_init(&workers[i].layer, tiles->tileSize, tiles->tilePixels) ;
+            workers[i].layer.bytesPerPixel = (uint32_t)T_LAYER_PIXEL_BYTES ;
+        }
+        parallel->workers     = workers ;
+        parallel->workerCount = count ;
+    }
+
+    for (size_t i = 0 ; i < count ; i++) {
+        turtleRasterWorker *worker = &parallel->workers[i] ;
+        worker->log              = log ;
+        worker->start            = start + length * i / count ;
+        worker->end              = start + length * (i + 1) / count ;
+        worker->isGood           = true ;
+        worker->running          = false ;
+        worker->raster.tolerance = raster->tolerance ;
+
+        // layers follow the tiles' geometry in case it changed since the worker was created
+        turtleTiles_clear(&worker->layer) ;
+        worker->layer.tileSize   = tiles->tileSize ;
+        worker->layer.tilePixels = tiles->tilePixels ;
+
+        if (i > 0) worker->running = (pthread_create(&worker->thread, NULL, turtleParallel_work, worker) == 0) ;
+    }
+
+    bool isGood = turtleRaster_render(raster, tiles, log, parallel->workers[0].start, parallel->workers[0].end) ;
+
+    for (size_t i = 1 ; i < count ; i++) {
+        turtleRasterWorker *worker = &parallel->workers[i] ;
+        if (worker->running) {
+            pthread_join(worker->thread, NULL) ;
+            worker->running = false ;
+        } else {
+            // the thread couldn't be started, so draw its layer here; the order layers are drawn in
+            // doesn't matter, only the order they're applied in
+            turtleParallel_work(worker) ;
+        }
+    }
+
+    size_t layerBytes = 0 ;
+    for (size_t i = 1 ; i < count ; i++) layerBytes += turtleTiles_bytesAllocated(&parallel->workers[i].layer) ;
+    if (layerBytes > parallel->peakLayerBytes) parallel->peakLayerBytes = layerBytes ;
+
+    for (size_t i = 1 ; i < count ; i++) {
+        turtleRasterWorker *worker = &parallel->workers[i] ;
+        isGood = isGood && worker->isGood && turtleParallel_applyLayer(tiles, &worker->layer) ;
+        turtleTiles_clear(&worker->layer) ;
+        parallel->layersApplied++ ;
+
+        raster->decimator.segmentsIn  += worker->raster.decimator.segmentsIn ;
+        raster->decimator.segmentsOut += worker->raster.decimator.segmentsOut ;
+        turtleDecimator_resetStatistics(&worker->raster.decimator) ;
+    }
+    parallel->renders++ ;
+    return isGood ;
+}
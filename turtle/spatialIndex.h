@@ -0,0 +1,267 @@
+// Uniform grid index of drawing commands for hs.canvas.turtle
+//
+// Plain C so it can be used (and measured) outside of Hammerspoon -- nothing in here knows about
+// AppKit or Lua. The drawing plane is divided into square cells (normally the same size as the
+// tiles in tileCache.h, so that a cell and a tile cover exactly the same area) and each cell keeps
+// the indices of the commands which draw within it, in the order they were appended. Commands are
+// added as they're appended to the log, so the index is always current and never rebuilt.
+//
+// This lets the owner rasterize just the cells it actually needs (those in view, or those covered
+// by a requested image) and find the commands under a point without looking at every command in the
+// log. Each cell also records how many of its commands the owner has already drawn, so drawing
+// resumes where it left off.
+
+#pragma once
+
+#include "commandLog.h"
+#include "tileCache.h"
+#include "turtleEngine.h"
+
+typedef struct {
+    int32_t  x ;
+    int32_t  y ;
+    uint32_t *commands ;          // ascending command indices
+    size_t   count ;
+    size_t   capacity ;
+    size_t   drawn ;              // commands[0 .. drawn - 1] have been drawn by the owner
+} turtleCell ;
+
+typedef struct {
+    double     cellSize ;
+    turtleCell *cells ;           // in creation order
+    size_t     count ;
+    size_t     capacity ;
+    uint32_t   *hash ;            // open addressing; holds cell index + 1, 0 is empty
+    size_t     hashSize ;
+    size_t     entries ;          // total command entries over all cells
+    size_t     undrawnCells ;     // cells with commands the owner hasn't drawn yet
+} turtleIndex ;
+
+#pragma mark - Lifecycle
+
+static inline void turtleIndex_init(turtleIndex *index, double cellSize) {
+    memset(index, 0, sizeof(turtleIndex)) ;
+    index->cellSize = cellSize ;
+}
+
+// forgets every command but keeps the cell table and hash allocated since they're likely to be needed again
+static inline void turtleIndex_clear(turtleIndex *index) {
+    for (size_t i = 0 ; i < index->count ; i++) free(index->cells[i].commands) ;
+    index->count        = 0 ;
+    index->entries      = 0 ;
+    index->undrawnCells = 0 ;
+    if (index->hash) memset(index->hash, 0, index->hashSize * sizeof(uint32_t)) ;
+}
+
+static inline void turtleIndex_free(turtleIndex *index) {
+    turtleIndex_clear(index) ;
+    free(index->cells) ;
+    free(index->hash) ;
+    index->cells    = NULL ;
+    index->hash     = NULL ;
+    index->capacity = 0 ;
+    index->hashSize = 0 ;
+}
+
+// marks every cell as undrawn, e.g. after the owner has discarded its raster
+static inline void turtleIndex_markUndrawn(turtleIndex *index) {
+    index->undrawnCells = 0 ;
+    for (size_t i = 0 ; i < index->count ; i++) {
+        index->cells[i].drawn = 0 ;
+        if (index->cells[i].count > 0) index->undrawnCells++ ;
+    }
+}
+
+// Forgets the commands from commandCount on, for when the log is rewound to a checkpoint (see
+// checkpoints.h). The tiles are restored to include exactly the commands before that, so whatever
+// is left in each cell counts as drawn.
+static inline void turtleIndex_rewind(turtleIndex *index, size_t commandCount) {
+    index->entries      = 0 ;
+    index->undrawnCells = 0 ;
+    for (size_t i = 0 ; i < index->count ; i++) {
+        turtleCell *cell = &index->cells[i] ;
+        while (cell->count > 0 && cell->commands[cell->count - 1] >= commandCount) cell->count-- ;
+        cell->drawn     = cell->count ;
+        index->entries += cell->count ;
+    }
+}
+
+#pragma mark - Cells
+
+static bool turtleIndex_rehash(turtleIndex *index, size_t newSize) {
+    uint32_t *newHash = calloc(newSize, sizeof(uint32_t)) ;
+    if (!newHash) return false ;
+    for (size_t i = 0 ; i < index->count ; i++) {
+        size_t slot = turtleTiles_hashOf(index->cells[i].x, index->cells[i].y, newSize) ;
+        while (newHash[slot] != 0) slot = (slot + 1) & (newSize - 1) ;
+        newHash[slot] = (uint32_t)(i + 1) ;
+    }
+    free(index->hash) ;
+    index->hash     = newHash ;
+    index->hashSize = newSize ;
+    return true ;
+}
+
+// returns the cell at (x, y) or NULL if no command draws there
+static inline turtleCell *turtleIndex_find(const turtleIndex *index, int32_t x, int32_t y) {
+    if (index->count == 0) return NULL ;
+    size_t slot = turtleTiles_hashOf(x, y, index->hashSize) ;
+    while (index->hash[slot] != 0) {
+        turtleCell *cell = &index->cells[index->hash[slot] - 1] ;
+        if (cell->x == x && cell->y == y) return cell ;
+        slot = (slot + 1) & (index->hashSize - 1) ;
+    }
+    return NULL ;
+}
+
+// adds command idx to the cell at (x, y); returns false if memory could not be allocated
+static bool turtleIndex_insert(turtleIndex *index, int32_t x, int32_t y, size_t idx) {
+    turtleCell *cell = turtleIndex_find(index, x, y) ;
+    if (!cell) {
+        if ((index->count + 1) * 2 > index->hashSize) {
+            if (!turtleIndex_rehash(index, (index->hashSize == 0) ? 64 : index->hashSize * 2)) return false ;
+        }
+        if (!turtleLog_grow((void **)&index->cells, &index->capacity, index->count + 1, sizeof(turtleCell))) return false ;
+
+        cell = &index->cells[index->count] ;
+        memset(cell, 0, sizeof(turtleCell)) ;
+        cell->x = x ;
+        cell->y = y ;
+
+        size_t slot = turtleTiles_hashOf(x, y, index->hashSize) ;
+        while (index->hash[slot] != 0) slot = (slot + 1) & (index->hashSize - 1) ;
+        index->hash[slot] = (uint32_t)(index->count + 1) ;
+        index->count++ ;
+    }
+
+    if (cell->count > 0 && cell->commands[cell->count - 1] == (uint32_t)idx) return true ;
+    if (!turtleLog_grow((void **)&cell->commands, &cell->capacity, cell->count + 1, sizeof(uint32_t))) return false ;
+    if (cell->drawn == cell->count) index->undrawnCells++ ;
+    cell->commands[cell->count++] = (uint32_t)idx ;
+    index->entries++ ;
+    return true ;
+}
+
+// records that the owner has drawn everything currently in the cell
+static inline void turtleIndex_cellDrawn(turtleIndex *index, turtleCell *cell) {
+    if (cell->drawn < cell->count) index->undrawnCells-- ;
+    cell->drawn = cell->count ;
+}
+
+#pragma mark - Adding Commands
+
+// adds command idx to the cells touched by the segment (x0, y0) - (x1, y1) widened by pad
+static bool turtleIndex_addSegment(turtleIndex *index, size_t idx, double x0, double y0, double x1, double y1, double pad) {
+    int32_t fromY = turtleGrid_coordinate(index->cellSize, fmin(y0, y1) - pad) ;
+    int32_t toY   = turtleGrid_coordinate(index->cellSize, fmax(y0, y1) + pad) ;
+    for (int64_t ty = fromY ; ty <= toY ; ty++) {
+        int32_t fromX, toX ;
+        if (turtleGrid_segmentSpan(index->cellSize, (int32_t)ty, x0, y0, x1, y1, pad, &fromX, &toX)) {
+            for (int64_t tx = fromX ; tx <= toX ; tx++) {
+                if (!turtleIndex_insert(index, (int32_t)tx, (int32_t)ty, idx)) return false ;
+            }
+        }
+    }
+    return true ;
+}
+
+// adds command idx to every cell within the bounds widened by pad
+static bool turtleIndex_addBounds(turtleIndex *index, size_t idx, double minX, double minY, double maxX, double maxY, double pad) {
+    int32_t fromX = turtleGrid_coordinate(index->cellSize, minX - pad) ;
+    int32_t toX   = turtleGrid_coordinate(index->cellSize, maxX + pad) ;
+    int32_t fromY = turtleGrid_coordinate(index->cellSize, minY - pad) ;
+    int32_t toY   = turtleGrid_coordinate(index->cellSize, maxY + pad) ;
+    for (int64_t ty = fromY ; ty <= toY ; ty++) {
+        for (int64_t tx = fromX ; tx <= toX ; tx++) {
+            if (!turtleIndex_insert(index, (int32_t)tx, (int32_t)ty, idx)) return false ;
+        }
+    }
+    return true ;
+}
+
+// Adds the drawing command at idx, widened by half its pen width plus pad. Labels can't be measured
+// here, so for them (and for commands which don't draw) this does nothing and returns true; the
+// owner adds labels with turtleIndex_addBounds. Returns false if memory could not be allocated.
+static inline bool turtleIndex_addCommand(turtleIndex *index, const turtleLog *log, size_t idx, double pad) {
+    uint8_t op       = log->ops[idx] ;
+    double  *derived = turtleLog_derived(log, idx) ;
+    double  minX, minY, maxX, maxY ;
+
+    if (!turtleLog_commandBounds(log, idx, &minX, &minY, &maxX, &maxY)) return true ;
+
+    if (turtleLog_isMove(op)) {
+        const turtleStyle *style = turtleLog_style(log, derived[t_moveStyle]) ;
+        double            width  = style ? style->width / 2.0 : 0.0 ;
+        return turtleIndex_addSegment(index, idx, derived[t_moveX0], derived[t_moveY0], derived[t_moveX1], derived[t_moveY1], width + pad) ;
+    } else if (op == c_arc) {
+        const turtleStyle *style = turtleLog_style(log, derived[t_arcStyle]) ;
+        double            width  = style ? style->width / 2.0 : 0.0 ;
+        return turtleIndex_addBounds(index, idx, minX, minY, maxX, maxY, width + pad) ;
+    }
+    return turtleIndex_addBounds(index, idx, minX, minY, maxX, maxY, pad) ;
+}
+
+#pragma mark - Hit Testing
+
+static inline double turtleHit_segmentDistance(double px, double py, double x0, double y0, double x1, double y1) {
+    double dx = x1 - x0, dy = y1 - y0 ;
+    double lengthSquared = dx * dx + dy * dy ;
+    double t = (lengthSquared > 0.0) ? ((px - x0) * dx + (py - y0) * dy) / lengthSquared : 0.0 ;
+    t = fmin(fmax(t, 0.0), 1.0) ;
+    return hypot(px - (x0 + t * dx), py - (y0 + t * dy)) ;
+}
+
+// Returns 1 if the command at idx draws over the point (x, y), allowing tolerance beyond the edge of
+// strokes, or 0 if it doesn't. Returns -1 for labels, which the owner has to test itself.
+static int turtleLog_hitTest(const turtleLog *log, size_t idx, double x, double y, double tolerance) {
+    uint8_t op       = log->ops[idx] ;
+    double  *derived = turtleLog_derived(log, idx) ;
+
+    if (!(log->flags[idx] & T_FLAG_DRAWS)) return 0 ;
+
+    if (turtleLog_isMove(op)) {
+        const turtleStyle *style = turtleLog_style(log, derived[t_moveStyle]) ;
+        double            reach  = (style ? style->width / 2.0 : 0.0) + tolerance ;
+        return turtleHit_segmentDistance(x, y, derived[t_moveX0], derived[t_moveY0], derived[t_moveX1], derived[t_moveY1]) <= reach ;
+    } else if (op == c_arc) {
+        const turtleStyle *style = turtleLog_style(log, derived[t_arcStyle]) ;
+        double            reach  = (style ? style->width / 2.0 : 0.0) + tolerance ;
+        double            start, sweep, x0, y0, x1, y1 ;
+        turtleArc_angles(log, idx, &start, &sweep) ;
+        if (fabs(sweep) > 2.0 * M_PI) sweep = copysign(2.0 * M_PI, sweep) ;
+        size_t segments = turtleArc_segments(log, idx, 1.0) ;
+        turtleArc_point(log, idx, start, &x0, &y0) ;
+        for (size_t i = 1 ; i <= segments ; i++) {
+            turtleArc_point(log, idx, start + sweep * (double)i / (double)segments, &x1, &y1) ;
+            if (turtleHit_segmentDistance(x, y, x0, y0, x1, y1) <= reach) return 1 ;
+            x0 = x1 ; y0 = y1 ;
+        }
+        return 0 ;
+    } else if (op == c_fillend) {
+        // nonzero winding, matching how the fill is drawn
+        double *vertices = log->fillVertices + (size_t)derived[t_fillEndVertexStart] * 2 ;
+        size_t count     = (size_t)derived[t_fillEndVertexCount] ;
+        int    winding   = 0 ;
+        for (size_t i = 0 ; i < count ; i++) {
+            double ax = vertices[i * 2], ay = vertices[i * 2 + 1] ;
+            double bx = vertices[((i + 1) % count) * 2], by = vertices[((i + 1) % count) * 2 + 1] ;
+            double side = (bx - ax) * (y - ay) - (x - ax) * (by - ay) ;
+            if (ay <= y && by > y && side > 0.0)       winding++ ;
+            else if (by <= y && ay > y && side < 0.0)  winding-- ;
+        }
+        return winding != 0 ;
+    } else if (op == c_label) {
+        return -1 ;
+    }
+    return 0 ;
+}
+
+#pragma mark - Statistics
+
+static inline size_t turtleIndex_bytesAllocated(const turtleIndex *index) {
+    size_t bytes = sizeof(turtleIndex) +
+                   index->capacity * sizeof(turtleCell) +
+                   index->hashSize * sizeof(uint32_t) ;
+    for (size_t i = 0 ; i < index->count ; i++) bytes += index->cells[i].capacity * sizeof(uint32_t) ;
+    return bytes ;
+}
@@ -0,0 +1,214 @@
+// Sparse tile cache for the hs.canvas.turtle off-screen raster
+//
+// Plain C so it can be used (and measured) outside of Hammerspoon -- nothing in here knows about
+// AppKit or Lua. The drawing plane is divided into square tiles of tileSize units (points) with
+// the turtle's home at the corner shared by tiles (0, 0), (-1, 0), (0, -1) and (-1, -1). A tile's
+// pixels are only allocated once something is actually drawn within it, so a turtle wandering far
+// from home costs memory proportional to the area it has drawn over rather than to the bounding
+// box of everything it has done.
+//
+// Pixels are 8 bit premultiplied RGBA with the top (largest y) row first; the owner renders into
+// them however it likes and may hang its own per-tile state (e.g. a bitmap context) off of
+// tile->context, which is released with the releaseContext callback before the pixels are freed.
+// Whatever renders into a tile should set tile->modified so snapshots of the tiles (see
+// checkpoints.h) can tell which tiles have changed since the last one. A cache may instead hold some
+// other per pixel format by changing bytesPerPixel before the first tile is allocated, as the layers
+// of parallelRaster.h do.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+#define T_TILE_SIZE 256
+
+typedef struct {
+    int32_t x ;
+    int32_t y ;
+    uint8_t *pixels ;
+    void    *context ;
+    bool    modified ;            // drawn into since the last checkpoint
+} turtleTile ;
+
+typedef struct {
+    double     tileSize ;         // in drawing units (points)
+    uint32_t   tilePixels ;       // pixels along each side of a tile
+    uint32_t   bytesPerPixel ;    // 4 for 8 bit premultiplied RGBA
+    turtleTile *tiles ;           // in allocation order
+    size_t     count ;
+    size_t     capacity ;
+    uint32_t   *hash ;            // open addressing; holds tile index + 1, 0 is empty
+    size_t     hashSize ;
+    void       (*releaseContext)(void *context) ;
+} turtleTileCache ;
+
+#pragma mark - Lifecycle
+
+static inline void turtleTiles_init(turtleTileCache *cache, double tileSize, uint32_t tilePixels) {
+    memset(cache, 0, sizeof(turtleTileCache)) ;
+    cache->tileSize      = tileSize ;
+    cache->tilePixels    = tilePixels ;
+    cache->bytesPerPixel = 4 ;
+}
+
+// releases every tile but keeps the tile table and hash allocated since they're likely to be needed
+// again; the tile and pixel sizes may be changed after this
+static inline void turtleTiles_clear(turtleTileCache *cache) {
+    for (size_t i = 0 ; i < cache->count ; i++) {
+        if (cache->tiles[i].context && cache->releaseContext) cache->releaseContext(cache->tiles[i].context) ;
+        free(cache->tiles[i].pixels) ;
+    }
+    cache->count = 0 ;
+    if (cache->hash) memset(cache->hash, 0, cache->hashSize * sizeof(uint32_t)) ;
+}
+
+static inline void turtleTiles_free(turtleTileCache *cache) {
+    turtleTiles_clear(cache) ;
+    free(cache->tiles) ;
+    free(cache->hash) ;
+    cache->tiles    = NULL ;
+    cache->hash     = NULL ;
+    cache->capacity = 0 ;
+    cache->hashSize = 0 ;
+}
+
+#pragma mark - Coordinates
+
+// coordinate of the grid cell of size cellSize containing the drawing coordinate v; clamped so a
+// turtle which has wandered absurdly far away can't overflow the cell coordinates
+static inline int32_t turtleGrid_coordinate(double cellSize, double v) {
+    double t = floor(v / cellSize) ;
+    if (!(t > INT32_MIN)) return INT32_MIN ; // also catches NaN
+    if (t > INT32_MAX)    return INT32_MAX ;
+    return (int32_t)t ;
+}
+
+// tile coordinate containing the drawing coordinate v
+static inline int32_t turtleTiles_coordinate(const turtleTileCache *cache, double v) {
+    return turtleGrid_coordinate(cache->tileSize, v) ;
+}
+
+static inline size_t turtleTiles_bytesPerTile(const turtleTileCache *cache) {
+    return (size_t)cache->tilePixels * cache->tilePixels * cache->bytesPerPixel ;
+}
+
+#pragma mark - Lookup
+
+static inline size_t turtleTiles_hashOf(int32_t x, int32_t y, size_t hashSize) {
+    uint64_t h = ((uint64_t)(uint32_t)x << 32) | (uint32_t)y ;
+    h ^= h >> 33 ;
+    h *= 0xff51afd7ed558ccdULL ;
+    h ^= h >> 33 ;
+    return (size_t)(h & (hashSize - 1)) ;
+}
+
+static bool turtleTiles_rehash(turtleTileCache *cache, size_t newSize) {
+    uint32_t *newHash = calloc(newSize, sizeof(uint32_t)) ;
+    if (!newHash) return false ;
+    for (size_t i = 0 ; i < cache->count ; i++) {
+        size_t slot = turtleTiles_hashOf(cache->tiles[i].x, cache->tiles[i].y, newSize) ;
+        while (newHash[slot] != 0) slot = (slot + 1) & (newSize - 1) ;
+        newHash[slot] = (uint32_t)(i + 1) ;
+    }
+    free(cache->hash) ;
+    cache->hash     = newHash ;
+    cache->hashSize = newSize ;
+    return true ;
+}
+
+// returns the tile at (x, y) or NULL if nothing has been drawn there yet
+static inline turtleTile *turtleTiles_find(const turtleTileCache *cache, int32_t x, int32_t y) {
+    if (cache->count == 0) return NULL ;
+    size_t slot = turtleTiles_hashOf(x, y, cache->hashSize) ;
+    while (cache->hash[slot] != 0) {
+        turtleTile *tile = &cache->tiles[cache->hash[slot] - 1] ;
+        if (tile->x == x && tile->y == y) return tile ;
+        slot = (slot + 1) & (cache->hashSize - 1) ;
+    }
+    return NULL ;
+}
+
+// returns the tile at (x, y), allocating cleared pixels for it if necessary, or NULL if memory
+// could not be allocated. Tile pointers are only valid until the next tile is allocated.
+static inline turtleTile *turtleTiles_fetch(turtleTileCache *cache, int32_t x, int32_t y) {
+    turtleTile *tile = turtleTiles_find(cache, x, y) ;
+    if (tile) return tile ;
+
+    if ((cache->count + 1) * 2 > cache->hashSize) {
+        if (!turtleTiles_rehash(cache, (cache->hashSize == 0) ? 64 : cache->hashSize * 2)) return NULL ;
+    }
+    if (cache->count + 1 > cache->capacity) {
+        size_t     newCapacity = (cache->capacity == 0) ? 32 : cache->capacity * 2 ;
+        turtleTile *newTiles   = realloc(cache->tiles, newCapacity * sizeof(turtleTile)) ;
+        if (!newTiles) return NULL ;
+        cache->tiles    = newTiles ;
+        cache->capacity = newCapacity ;
+    }
+
+    uint8_t *pixels = calloc(turtleTiles_bytesPerTile(cache), 1) ;
+    if (!pixels) return NULL ;
+
+    tile          = &cache->tiles[cache->count] ;
+    tile->x        = x ;
+    tile->y        = y ;
+    tile->pixels   = pixels ;
+    tile->context  = NULL ;
+    tile->modified = true ;
+
+    size_t slot = turtleTiles_hashOf(x, y, cache->hashSize) ;
+    while (cache->hash[slot] != 0) slot = (slot + 1) & (cache->hashSize - 1) ;
+    cache->hash[slot] = (uint32_t)(cache->count + 1) ;
+    cache->count++ ;
+    return tile ;
+}
+
+#pragma mark - Coverage
+
+// Cells of size cellSize touched by the segment (x0, y0) - (x1, y1) widened by pad within cell row
+// ty; returns false if the segment doesn't reach the row, otherwise sets *fromX and *toX to the
+// cell columns it spans. Walking a segment a row at a time like this keeps a long diagonal line
+// from touching every cell within its bounding box.
+static inline bool turtleGrid_segmentSpan(double cellSize, int32_t ty,
+                                          double x0, double y0, double x1, double y1, double pad,
+                                          int32_t *fromX, int32_t *toX) {
+    double bandLow  = (double)ty * cellSize - pad ;
+    double bandHigh = ((double)ty + 1.0) * cellSize + pad ;
+    double tLow     = 0.0 ;
+    double tHigh    = 1.0 ;
+    double dy       = y1 - y0 ;
+
+    if (dy == 0.0) {
+        if (y0 < bandLow || y0 > bandHigh) return false ;
+    } else {
+        double tA = (bandLow  - y0) / dy ;
+        double tB = (bandHigh - y0) / dy ;
+        if (tA > tB) { double swap = tA ; tA = tB ; tB = swap ; }
+        if (tA > tLow)  tLow  = tA ;
+        if (tB < tHigh) tHigh = tB ;
+        if (tLow > tHigh) return false ;
+    }
+
+    double xA = x0 + (x1 - x0) * tLow ;
+    double xB = x0 + (x1 - x0) * tHigh ;
+    *fromX = turtleGrid_coordinate(cellSize, fmin(xA, xB) - pad) ;
+    *toX   = turtleGrid_coordinate(cellSize, fmax(xA, xB) + pad) ;
+    return true ;
+}
+
+static inline bool turtleTiles_segmentSpan(const turtleTileCache *cache, int32_t ty,
+                                           double x0, double y0, double x1, double y1, double pad,
+                                           int32_t *fromX, int32_t *toX) {
+    return turtleGrid_segmentSpan(cache->tileSize, ty, x0, y0, x1, y1, pad, fromX, toX) ;
+}
+
+#pragma mark - Statistics
+
+static inline size_t turtleTiles_bytesAllocated(const turtleTileCache *cache) {
+    return sizeof(turtleTileCache) +
+           cache->capacity * sizeof(turtleTile) +
+           cache->hashSize * sizeof(uint32_t) +
+           cache->count    * turtleTiles_bytesPerTile(cache) ;
+}
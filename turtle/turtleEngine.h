@@ -0,0 +1,351 @@
+// Turtle state machine for hs.canvas.turtle
+//
+// Plain C so it can be used (and measured) outside of Hammerspoon -- nothing in here knows about
+// AppKit or Lua. turtleState_update applies a command which has just been appended to a command log
+// to the turtle's state: position, heading, scrunch, pen mode, size and color, and open fills. It
+// fills in the command's derived values (see commandLog.h) and marks it as drawing if it does.
+//
+// Anything requiring fonts or color specifications is left to the owner: colors arrive already
+// interned in the log's color table, and for labels the owner stores the font and includes the
+// label's bounds with turtleState_includeBounds once it knows how large the text actually is.
+
+#pragma once
+
+#include "commandLog.h"
+
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef struct {
+    double          x ;
+    double          y ;
+    double          heading ;     // degrees clockwise from up
+    bool            penDown ;
+    uint32_t        penMode ;     // t_penModes
+    double          penSize ;
+    double          scaleX ;
+    double          scaleY ;
+    double          labelHeight ;
+    uint32_t        penColor ;    // index into the log's color table
+    uint32_t        background ;  // index into the log's color table
+    uint32_t        strokeStyle ; // interned pen style, or T_NO_STYLE if it needs to be re-interned
+
+    turtleFillStack fills ;
+
+    // bounding box of everything drawn, ignoring pen width
+    bool            hasBounds ;
+    double          minX ;
+    double          minY ;
+    double          maxX ;
+    double          maxY ;
+} turtleState ;
+
+#pragma mark - Lifecycle
+
+static inline void turtleState_init(turtleState *state, uint32_t penColor, uint32_t background) {
+    memset(state, 0, sizeof(turtleState)) ;
+    state->penDown     = true ;
+    state->penMode     = t_penPaint ;
+    state->penSize     = 1.0 ;
+    state->scaleX      = 1.0 ;
+    state->scaleY      = 1.0 ;
+    state->labelHeight = 14.0 ;
+    state->penColor    = penColor ;
+    state->background  = background ;
+    state->strokeStyle = T_NO_STYLE ;
+}
+
+static inline void turtleState_free(turtleState *state) {
+    turtleFills_free(&state->fills) ;
+}
+
+// what clean does: forget what has been drawn (the caller clears the log) but keep the turtle
+static inline void turtleState_clean(turtleState *state) {
+    state->fills.count = 0 ;
+    state->hasBounds   = false ;
+    state->strokeStyle = T_NO_STYLE ;
+}
+
+#pragma mark - Geometry
+
+static inline void turtleState_includeBounds(turtleState *state, double minX, double minY, double maxX, double maxY) {
+    if (!state->hasBounds) {
+        state->hasBounds = true ;
+        state->minX = minX ; state->minY = minY ;
+        state->maxX = maxX ; state->maxY = maxY ;
+    } else {
+        state->minX = fmin(state->minX, minX) ; state->minY = fmin(state->minY, minY) ;
+        state->maxX = fmax(state->maxX, maxX) ; state->maxY = fmax(state->maxY, maxY) ;
+    }
+}
+
+// start and sweep, in radians counter-clockwise from the positive x axis, of the arc at idx; these
+// match the angles hs.canvas.turtle gives NSBezierPath for the arc
+static inline void turtleArc_angles(const turtleLog *log, size_t idx, double *start, double *sweep) {
+    double *args    = turtleLog_args(log, idx) ;
+    double *derived = turtleLog_derived(log, idx) ;
+    *start = ((360.0 - derived[t_arcHeading]) + 90.0) * M_PI / 180.0 ;
+    *sweep = -args[0] * M_PI / 180.0 ;
+}
+
+// point at angle theta (radians) on the arc at idx after the turtle's scrunch has been applied
+static inline void turtleArc_point(const turtleLog *log, size_t idx, double theta, double *px, double *py) {
+    double radius   = turtleLog_args(log, idx)[1] ;
+    double *derived = turtleLog_derived(log, idx) ;
+    *px = derived[t_arcX] + derived[t_arcScaleX] * radius * cos(theta) ;
+    *py = derived[t_arcY] + derived[t_arcScaleY] * radius * sin(theta) ;
+}
+
+// number of line segments to approximate the arc at idx with when it is drawn at the given scale
+// (pixels per unit) so that no segment is longer than a couple of pixels
+static inline size_t turtleArc_segments(const turtleLog *log, size_t idx, double scale) {
+    double start, sweep ;
+    turtleArc_angles(log, idx, &start, &sweep) ;
+    double *derived = turtleLog_derived(log, idx) ;
+    double radius   = fabs(turtleLog_args(log, idx)[1]) * fmax(fabs(derived[t_arcScaleX]), fabs(derived[t_arcScaleY])) ;
+    double length   = fmin(fabs(sweep), 2.0 * M_PI) * radius * scale ;
+    double count    = ceil(length / 2.0) ;
+    return (count < 8.0) ? 8 : (count > 65536.0) ? 65536 : (size_t)count ;
+}
+
+// bounds of what the command at idx draws, ignoring pen width; returns false for commands that
+// the engine can't measure (labels) or which don't draw
+static inline bool turtleLog_commandBounds(const turtleLog *log, size_t idx, double *minX, double *minY, double *maxX, double *maxY) {
+    uint8_t op      = log->ops[idx] ;
+    double  *derived = turtleLog_derived(log, idx) ;
+
+    if (!(log->flags[idx] & T_FLAG_DRAWS)) return false ;
+
+    if (turtleLog_isMove(op)) {
+        *minX = fmin(derived[t_moveX0], derived[t_moveX1]) ;
+        *maxX = fmax(derived[t_moveX0], derived[t_moveX1]) ;
+        *minY = fmin(derived[t_moveY0], derived[t_moveY1]) ;
+        *maxY = fmax(derived[t_moveY0], derived[t_moveY1]) ;
+        return true ;
+    } else if (op == c_arc) {
+        double start, sweep, px, py ;
+        turtleArc_angles(log, idx, &start, &sweep) ;
+        if (fabs(sweep) >= 2.0 * M_PI) sweep = 2.0 * M_PI ;
+        double from = fmin(start, start + sweep) ;
+        double to   = fmax(start, start + sweep) ;
+
+        // the extremes are at the ends of the arc or where it crosses an axis
+        turtleArc_point(log, idx, from, &px, &py) ;
+        *minX = *maxX = px ;
+        *minY = *maxY = py ;
+        turtleArc_point(log, idx, to, &px, &py) ;
+        *minX = fmin(*minX, px) ; *maxX = fmax(*maxX, px) ;
+        *minY = fmin(*minY, py) ; *maxY = fmax(*maxY, py) ;
+        for (double axis = ceil(from / (M_PI / 2.0)) * (M_PI / 2.0) ; axis < to ; axis += M_PI / 2.0) {
+            turtleArc_point(log, idx, axis, &px, &py) ;
+            *minX = fmin(*minX, px) ; *maxX = fmax(*maxX, px) ;
+            *minY = fmin(*minY, py) ; *maxY = fmax(*maxY, py) ;
+        }
+        return true ;
+    } else if (op == c_fillend) {
+        double *vertices = log->fillVertices + (size_t)derived[t_fillEndVertexStart] * 2 ;
+        size_t count     = (size_t)derived[t_fillEndVertexCount] ;
+        if (count == 0) return false ;
+        *minX = *maxX = vertices[0] ;
+        *minY = *maxY = vertices[1] ;
+        for (size_t i = 1 ; i < count ; i++) {
+            *minX = fmin(*minX, vertices[i * 2]) ;     *maxX = fmax(*maxX, vertices[i * 2]) ;
+            *minY = fmin(*minY, vertices[i * 2 + 1]) ; *maxY = fmax(*maxY, vertices[i * 2 + 1]) ;
+        }
+        return true ;
+    }
+    return false ;
+}
+
+#pragma mark - Commands
+
+// style used for strokes, labels and arcs; only re-interned when pen color, size or mode change.
+// T_NO_STYLE (nothing is drawn) if the pen color itself couldn't be interned.
+static inline uint32_t turtleState_strokeStyle(turtleState *state, turtleLog *log) {
+    if (state->strokeStyle == T_NO_STYLE && state->penColor != T_NO_STYLE) {
+        state->strokeStyle = turtleLog_internStyle(log, state->penColor, state->penMode, state->penSize) ;
+    }
+    return state->strokeStyle ;
+}
+
+// Applies the command at idx (normally the one just appended) to the turtle's state. colorIdx is
+// the interned color for commands with a color argument (setpencolor, setbackground, setpalette and
+// fillend) and is ignored for the others. Returns false only if memory could not be allocated for a
+// fill, in which case the fill is incomplete but the state is otherwise up to date.
+static inline bool turtleState_update(turtleState *state, turtleLog *log, size_t idx, uint32_t colorIdx) {
+    uint8_t op       = log->ops[idx] ;
+    double  *args    = turtleLog_args(log, idx) ;
+    double  *derived = turtleLog_derived(log, idx) ;
+    bool    isGood   = true ;
+
+    double x = state->x ;
+    double y = state->y ;
+
+    switch(op) {
+        case c_forward:
+        case c_back:
+        case c_setpos:
+        case c_setxy:
+        case c_setx:
+        case c_sety:
+        case c_home: {
+            if (op == c_forward || op == c_back) {
+                double headingInRadians = state->heading * M_PI / 180 ;
+                double distance = args[0] ;
+                if (op == c_back) distance = -distance ;
+                state->x = x + distance * sin(headingInRadians) * state->scaleX ;
+                state->y = y + distance * cos(headingInRadians) * state->scaleY ;
+            } else if (op == c_setpos || op == c_setxy) {
+                state->x = args[0] * state->scaleX ;
+                state->y = args[1] * state->scaleY ;
+            } else if (op == c_setx) {
+                state->x = args[0] * state->scaleX ;
+            } else if (op == c_sety) {
+                state->y = args[0] * state->scaleY ;
+            } else if (op == c_home) {
+                state->x       = 0.0 ;
+                state->y       = 0.0 ;
+                state->heading = 0.0 ;
+            }
+
+            derived[t_moveX0] = x ;
+            derived[t_moveY0] = y ;
+            derived[t_moveX1] = state->x ;
+            derived[t_moveY1] = state->y ;
+
+            if (state->fills.count > 0) isGood = turtleLog_appendFillVertex(log, state->x, state->y) ;
+
+            if (state->penDown) {
+                log->flags[idx] |= T_FLAG_DRAWS ;
+                derived[t_moveStyle] = turtleState_strokeStyle(state, log) ;
+            }
+        } break ;
+
+        case c_left:
+        case c_right:
+        case c_setheading: {
+            double angle = args[0] ;
+            if (op == c_left) {
+                angle = state->heading - angle ;
+            } else if (op == c_right) {
+                angle = state->heading + angle ;
+            }
+            state->heading = fmod(angle, 360) ;
+        } break ;
+
+        case c_pendown:
+        case c_penup: {
+            state->penDown = (op == c_pendown) ;
+        } break ;
+
+        case c_penpaint:
+        case c_penerase:
+        case c_penreverse: {
+            state->penMode     = (op == c_penreverse) ? t_penReverse :
+                                 (op == c_penerase)   ? t_penErase   :
+                                                        t_penPaint ;
+            state->penDown     = true ;
+            state->strokeStyle = T_NO_STYLE ;
+        } break ;
+        case c_setpensize: {
+            state->penSize     = args[0] ;
+            state->strokeStyle = T_NO_STYLE ;
+        } break ;
+        case c_arc: {
+            derived[t_arcX]       = state->x ;
+            derived[t_arcY]       = state->y ;
+            derived[t_arcHeading] = state->heading ;
+            derived[t_arcScaleX]  = state->scaleX ;
+            derived[t_arcScaleY]  = state->scaleY ;
+            derived[t_arcStyle]   = turtleState_strokeStyle(state, log) ;
+            log->flags[idx] |= T_FLAG_DRAWS ;
+        } break ;
+        case c_setscrunch: {
+            state->scaleX = args[0] ;
+            state->scaleY = args[1] ;
+        } break ;
+        case c_setlabelheight: {
+            state->labelHeight = args[0] ;
+        } break ;
+        case c_label: {
+            // t_labelFont is up to the owner
+            derived[t_labelX]       = state->x ;
+            derived[t_labelY]       = state->y ;
+            derived[t_labelHeading] = state->heading ;
+            derived[t_labelScaleX]  = state->scaleX ;
+            derived[t_labelScaleY]  = state->scaleY ;
+            derived[t_labelStyle]   = turtleState_strokeStyle(state, log) ;
+            log->flags[idx] |= T_FLAG_DRAWS ;
+        } break ;
+        case c_setpencolor: {
+            derived[t_colorIdx] = colorIdx ;
+            state->penColor     = colorIdx ;
+            state->strokeStyle  = T_NO_STYLE ;
+        } break ;
+        case c_setbackground: {
+            derived[t_colorIdx] = colorIdx ;
+            state->background   = colorIdx ;
+        } break ;
+        case c_setpalette: {
+            derived[t_colorIdx] = colorIdx ;
+        } break ;
+        case c_fillstart: {
+            derived[t_fillStartX] = state->x ;
+            derived[t_fillStartY] = state->y ;
+            isGood = turtleFills_push(&state->fills, idx, log->fillVertexCount) &&
+                     turtleLog_appendFillVertex(log, state->x, state->y) ;
+        } break ;
+        case c_fillend: {
+            turtleFill fill ;
+            // without a matching fillstart, there's nothing to fill
+            if (turtleFills_pop(&state->fills, &fill)) {
+                derived[t_fillEndStartIdx]    = (double)fill.commandIdx ;
+                derived[t_fillEndVertexStart] = (double)fill.vertexStart ;
+                derived[t_fillEndVertexCount] = (double)(log->fillVertexCount - fill.vertexStart) ;
+                derived[t_fillEndStyle]       = turtleLog_internStyle(log, colorIdx, state->penMode, state->penSize) ;
+                log->flags[idx] |= T_FLAG_DRAWS ;
+            }
+        } break ;
+        default:
+            break ;
+    }
+
+    double minX, minY, maxX, maxY ;
+    if (turtleLog_commandBounds(log, idx, &minX, &minY, &maxX, &maxY)) {
+        turtleState_includeBounds(state, minX, minY, maxX, maxY) ;
+    }
+    return isGood ;
+}
+
+#pragma mark - Replay
+
+// the interned color turtleState_update was given for the command at idx, recovered from its
+// derived values; T_NO_STYLE for commands without a color (or a fillend with nothing to fill)
+static inline uint32_t turtleLog_commandColor(const turtleLog *log, size_t idx) {
+    uint8_t op       = log->ops[idx] ;
+    double  *derived = turtleLog_derived(log, idx) ;
+
+    if (op == c_setpencolor || op == c_setbackground || op == c_setpalette) {
+        return (uint32_t)derived[t_colorIdx] ;
+    } else if (op == c_fillend && (log->flags[idx] & T_FLAG_DRAWS)) {
+        const turtleStyle *style = turtleLog_style(log, derived[t_fillEndStyle]) ;
+        return style ? style->color : T_NO_STYLE ;
+    }
+    return T_NO_STYLE ;
+}
+
+// Re-applies the commands from start up to (but not including) end, which must already be in the
+// log, to a state restored to how it was just before start (see checkpoints.h). The log's fill
+// vertices must have been cut back to where they were at start as well, since replaying moves
+// appends them again. As with turtleState_update, label bounds are left to the owner.
+static inline bool turtleState_replay(turtleState *state, turtleLog *log, size_t start, size_t end) {
+    bool isGood = true ;
+    if (end > log->count) end = log->count ;
+    for (size_t idx = start ; idx < end ; idx++) {
+        isGood = turtleState_update(state, log, idx, turtleLog_commandColor(log, idx)) && isGood ;
+    }
+    return isGood ;
+}
@@ -0,0 +1,206 @@
+// Streaming SVG and PPM export for hs.canvas.turtle command logs
+//
+// Plain C so it can be used (and measured) outside of Hammerspoon -- nothing in here knows about
+// AppKit or Lua. Both writers stream to a FILE * as they go so that exporting a drawing never needs
+// more memory than the drawing itself already occupies.
+//
+// SVG output is vector: runs of connected moves sharing a style become one <path>, arcs are
+// flattened into polylines, fills become closed paths using the nonzero rule, and labels become
+// <text> elements with the text, font and size supplied by the caller. SVG has no equivalent to the
+// erase and reverse pen modes without masks, so erased strokes are painted in the background color
+// and reversed strokes use the "difference" blend mode.
+//
+// PPM output is raster: the rows of the tiles in a turtleTileCache are composited over the
+// background color and written one row at a time.
+
+#pragma once
+
+#include "turtleEngine.h"
+#include "tileCache.h"
+
+#include <stdio.h>
+
+// supplies the text, font family and point size for the label at idx; return false to skip it
+typedef bool (*turtleExport_labelCallback)(void *context, const turtleLog *log, size_t idx,
+                                           const char **text, const char **font, double *size) ;
+
+#pragma mark - SVG
+
+static inline void turtleExport_svgColor(FILE *file, const turtleLog *log, uint32_t colorIdx) {
+    const double *c = log->colors + (size_t)colorIdx * 4 ;
+    fprintf(file, "rgb(%d,%d,%d)", (int)lround(fmin(fmax(c[0], 0.0), 1.0) * 255.0),
+                                   (int)lround(fmin(fmax(c[1], 0.0), 1.0) * 255.0),
+                                   (int)lround(fmin(fmax(c[2], 0.0), 1.0) * 255.0)) ;
+}
+
+static inline void turtleExport_svgPaint(FILE *file, const turtleLog *log, const turtleStyle *style,
+                                         uint32_t background, const char *attribute) {
+    uint32_t colorIdx = (style->mode == t_penErase) ? background : style->color ;
+    double   alpha    = log->colors[(size_t)colorIdx * 4 + 3] ;
+    fprintf(file, " %s=\"", attribute) ;
+    turtleExport_svgColor(file, log, colorIdx) ;
+    fprintf(file, "\"") ;
+    if (alpha < 1.0) fprintf(file, " %s-opacity=\"%g\"", attribute, alpha) ;
+    if (style->mode == t_penReverse) fprintf(file, " style=\"mix-blend-mode:difference\"") ;
+}
+
+static inline void turtleExport_svgEscaped(FILE *file, const char *text) {
+    for ( ; *text ; text++) {
+        switch(*text) {
+            case '&':  fputs("&amp;", file) ;  break ;
+            case '<':  fputs("&lt;", file) ;   break ;
+            case '>':  fputs("&gt;", file) ;   break ;
+            case '"':  fputs("&quot;", file) ; break ;
+            default:   fputc(*text, file) ;    break ;
+        }
+    }
+}
+
+// Writes the drawing as SVG. The view box covers the state's bounds padded by pad units; y is
+// flipped so the drawing appears as it does on screen. Returns false if a write failed.
+static bool turtleExport_svg(FILE *file, const turtleLog *log, const turtleState *state, double pad,
+                             turtleExport_labelCallback labelFor, void *context) {
+    double minX = state->hasBounds ? state->minX : 0.0, maxX = state->hasBounds ? state->maxX : 0.0 ;
+    double minY = state->hasBounds ? state->minY : 0.0, maxY = state->hasBounds ? state->maxY : 0.0 ;
+    minX -= pad ; minY -= pad ; maxX += pad ; maxY += pad ;
+
+    fprintf(file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n") ;
+    fprintf(file, "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"%g %g %g %g\" width=\"%g\" height=\"%g\">\n",
+                  minX, -maxY, maxX - minX, maxY - minY, maxX - minX, maxY - minY) ;
+    fprintf(file, "<rect x=\"%g\" y=\"%g\" width=\"%g\" height=\"%g\"", minX, -maxY, maxX - minX, maxY - minY) ;
+    turtleExport_svgPaint(file, log, &(turtleStyle){ .color = state->background, .mode = t_penPaint }, state->background, "fill") ;
+    fprintf(file, "/>\n<g transform=\"scale(1,-1)\" fill=\"none\" stroke-linecap=\"butt\" stroke-linejoin=\"miter\">\n") ;
+
+    // a path stays open while moves continue from where the last one ended with the same style
+    double openStyle = -1.0, lastX = 0.0, lastY = 0.0 ;
+
+    for (size_t idx = 0 ; idx < log->count ; idx++) {
+        uint8_t op       = log->ops[idx] ;
+        double  *derived = turtleLog_derived(log, idx) ;
+        if (!(log->flags[idx] & T_FLAG_DRAWS)) continue ;
+
+        if (turtleLog_isMove(op)) {
+            double styleIdx = derived[t_moveStyle] ;
+            if (styleIdx == openStyle && derived[t_moveX0] == lastX && derived[t_moveY0] == lastY) {
+                fprintf(file, " L%g %g", derived[t_moveX1], derived[t_moveY1]) ;
+            } else {
+                const turtleStyle *style = turtleLog_style(log, styleIdx) ;
+                if (!style) continue ;
+                if (openStyle >= 0.0) fprintf(file, "\"/>\n") ;
+                fprintf(file, "<path stroke-width=\"%g\"", style->width) ;
+                turtleExport_svgPaint(file, log, style, state->background, "stroke") ;
+                fprintf(file, " d=\"M%g %g L%g %g", derived[t_moveX0], derived[t_moveY0], derived[t_moveX1], derived[t_moveY1]) ;
+                openStyle = styleIdx ;
+            }
+            lastX = derived[t_moveX1] ;
+            lastY = derived[t_moveY1] ;
+            continue ;
+        }
+
+        if (openStyle >= 0.0) {
+            fprintf(file, "\"/>\n") ;
+            openStyle = -1.0 ;
+        }
+
+        if (op == c_arc) {
+            const turtleStyle *style = turtleLog_style(log, derived[t_arcStyle]) ;
+            if (!style) continue ;
+            double start, sweep, px, py ;
+            turtleArc_angles(log, idx, &start, &sweep) ;
+            if (fabs(sweep) > 2.0 * M_PI) sweep = copysign(2.0 * M_PI, sweep) ;
+            size_t segments = turtleArc_segments(log, idx, 1.0) ;
+
+            fprintf(file, "<polyline stroke-width=\"%g\"", style->width) ;
+            turtleExport_svgPaint(file, log, style, state->background, "stroke") ;
+            fprintf(file, " points=\"") ;
+            for (size_t i = 0 ; i <= segments ; i++) {
+                turtleArc_point(log, idx, start + sweep * (double)i / (double)segments, &px, &py) ;
+                fprintf(file, (i == 0) ? "%g,%g" : " %g,%g", px, py) ;
+            }
+            fprintf(file, "\"/>\n") ;
+        } else if (op == c_fillend) {
+            const turtleStyle *style = turtleLog_style(log, derived[t_fillEndStyle]) ;
+            if (!style) continue ;
+            double *vertices = log->fillVertices + (size_t)derived[t_fillEndVertexStart] * 2 ;
+            size_t count     = (size_t)derived[t_fillEndVertexCount] ;
+
+            fprintf(file, "<path fill-rule=\"nonzero\" stroke=\"none\"") ;
+            turtleExport_svgPaint(file, log, style, state->background, "fill") ;
+            fprintf(file, " d=\"") ;
+            for (size_t i = 0 ; i < count ; i++) {
+                fprintf(file, (i == 0) ? "M%g %g" : " L%g %g", vertices[i * 2], vertices[i * 2 + 1]) ;
+            }
+            fprintf(file, " Z\"/>\n") ;
+        } else if (op == c_label && labelFor) {
+            const turtleStyle *style = turtleLog_style(log, derived[t_labelStyle]) ;
+            const char        *text  = NULL, *font = NULL ;
+            double            size   = 0.0 ;
+            if (!style || !labelFor(context, log, idx, &text, &font, &size) || !text) continue ;
+
+            // undo the group's flip for the text itself, then turn it to the turtle's heading
+            fprintf(file, "<text transform=\"translate(%g,%g) scale(%g,%g) rotate(%g)\" font-size=\"%g\"",
+                          derived[t_labelX], derived[t_labelY], derived[t_labelScaleX], -derived[t_labelScaleY],
+                          derived[t_labelHeading] - 90.0, size) ;
+            if (font) {
+                fprintf(file, " font-family=\"") ;
+                turtleExport_svgEscaped(file, font) ;
+                fprintf(file, "\"") ;
+            }
+            turtleExport_svgPaint(file, log, style, state->background, "fill") ;
+            fprintf(file, ">") ;
+            turtleExport_svgEscaped(file, text) ;
+            fprintf(file, "</text>\n") ;
+        }
+    }
+    if (openStyle >= 0.0) fprintf(file, "\"/>\n") ;
+    fprintf(file, "</g>\n</svg>\n") ;
+    return !ferror(file) ;
+}
+
+#pragma mark - PPM
+
+// Writes the tiles composited over the background color (RGBA, not premultiplied) as a binary PPM
+// covering every allocated tile. Returns false if a write failed or no memory was available for the
+// row buffer.
+static bool turtleExport_ppm(FILE *file, const turtleTileCache *tiles, const double *background) {
+    int32_t minTX = 0, maxTX = 0, minTY = 0, maxTY = 0 ;
+    for (size_t i = 0 ; i < tiles->count ; i++) {
+        const turtleTile *tile = &tiles->tiles[i] ;
+        if (i == 0 || tile->x < minTX) minTX = tile->x ;
+        if (i == 0 || tile->x > maxTX) maxTX = tile->x ;
+        if (i == 0 || tile->y < minTY) minTY = tile->y ;
+        if (i == 0 || tile->y > maxTY) maxTY = tile->y ;
+    }
+
+    size_t  tp     = tiles->tilePixels ;
+    size_t  width  = (size_t)((int64_t)maxTX - minTX + 1) * tp ;
+    size_t  height = (size_t)((int64_t)maxTY - minTY + 1) * tp ;
+    uint8_t *row   = malloc(width * 3) ;
+    if (!row) return false ;
+
+    // background over black, since PPM has no alpha
+    double bgA = fmin(fmax(background[3], 0.0), 1.0) ;
+    double bg[3] ;
+    for (int c = 0 ; c < 3 ; c++) bg[c] = fmin(fmax(background[c], 0.0), 1.0) * bgA * 255.0 ;
+
+    fprintf(file, "P6\n%zu %zu\n255\n", width, height) ;
+    for (int64_t ty = maxTY ; ty >= minTY ; ty--) {
+        for (size_t y = 0 ; y < tp ; y++) {
+            for (int64_t tx = minTX ; tx <= maxTX ; tx++) {
+                const turtleTile *tile = turtleTiles_find(tiles, (int32_t)tx, (int32_t)ty) ;
+                uint8_t          *out  = row + (size_t)(tx - minTX) * tp * 3 ;
+                for (size_t x = 0 ; x < tp ; x++) {
+                    const uint8_t *pixel = tile ? tile->pixels + (y * tp + x) * 4 : NULL ;
+                    double        alpha  = pixel ? pixel[3] / 255.0 : 0.0 ;
+                    for (int c = 0 ; c < 3 ; c++) {
+                        double value = (pixel ? pixel[c] : 0) + bg[c] * (1.0 - alpha) ;
+                        out[x * 3 + (size_t)c] = (uint8_t)fmin(value + 0.5, 255.0) ;
+                    }
+                }
+            }
+            fwrite(row, 1, width * 3, file) ;
+        }
+    }
+    free(row) ;
+    return !ferror(file) ;
+}
@@ -0,0 +1,974 @@
+// Compiled Logo programs for hs.canvas.turtle
+//
+// Plain C so it can be used (and measured) outside of Hammerspoon -- nothing in here knows about
+// AppKit or Lua. A recursive drawing written in Lua runs every loop and call in the Lua VM and
+// crosses into the turtle once per command. Instead, Logo source like the fern and tree in
+// Examples/turtleGraphicExamples.lua can be compiled once into a small bytecode which is then run
+// entirely in C, handing each command to the owner as it's produced.
+//
+// The language is the part of Logo these drawings need:
+//
+//   to name :param ... end           procedures with numeric parameters; they may call themselves
+//   repeat count [ ... ]             with repcount giving the current iteration, starting at 1
+//   if cond [ ... ], ifelse c [ ] [ ] conditions are comparisons (< > = <= >= <>) of expressions
+//   stop                             returns from the current procedure
+//   + - * / and ( )                  with the usual precedence; unary minus is written -x, so
+//                                    "fd :a -1" is two arguments while "fd :a - 1" is one
+//   forward, fd, right, rt, ...      the turtle's commands which take numbers; colors are palette
+//                                    indicies and setpensize takes a single number for both sizes
+//
+// Anything outside of a procedure definition is the program's main procedure. Names are case
+// insensitive and ; starts a comment which runs to the end of the line. Labels, fonts and lists
+// aren't supported.
+//
+// A compiled program is a flat array of bytes (so the owner can keep it as a string) holding a
+// header, the procedure table and the code. Running one keeps its value stack, call frames and
+// repeat counters in a turtleProgramRun, so a run can be paused after any command -- to yield from a
+// backgrounded function, for example -- and resumed later exactly where it left off. The code is
+// checked as it runs, so a damaged program stops with an error rather than misbehaving.
+
+#pragma once
+
+#include "commandLog.h"
+
+#include <math.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#define T_PROGRAM_MAGIC        "TLGO"
+#define T_PROGRAM_VERSION      1
+#define T_PROGRAM_HEADER_LEN   5
+#define T_PROGRAM_MAX_DEPTH    10000  // nested procedure calls
+#define T_PROGRAM_MAX_PARAMS   255
+#define T_PROGRAM_NO_RETURN    UINT32_MAX
+
+typedef enum {
+    t_progConst = 0,       // f64: push the constant
+    t_progParam,           // u8: push a parameter of the current procedure
+    t_progRepcount,        // push the iteration of the innermost repeat in the current procedure, or -1
+    t_progDup,             // push a copy of the top value
+    t_progAdd,
+    t_progSub,
+    t_progMul,
+    t_progDiv,
+    t_progNeg,
+    t_progLess,
+    t_progGreater,
+    t_progLessEqual,
+    t_progGreaterEqual,
+    t_progEqual,
+    t_progNotEqual,
+    t_progJump,            // u32: continue at the code offset
+    t_progJumpIfFalse,     // u32: pop a value and continue at the offset if it's 0
+    t_progRepeat,          // u32: pop a count and start a repeat, or continue at the offset if it's less than 1
+    t_progNext,            // u32: count an iteration and continue at the offset if the repeat isn't done
+    t_progCall,            // u32: call the procedure, whose arguments are on the stack
+    t_progReturn,
+    t_progCommand,         // u8: pop the command's arguments and hand it to the owner
+
+    t_progOpCount
+} t_programOps ;
+
+typedef enum {
+    t_programDone = 0,
+    t_programPaused,
+    t_programError,
+} t_programResults ;
+
+#pragma mark - Primitives
+
+static const struct {
+    const char *name ;
+    uint8_t    op ;
+} turtleProgram_primitives[] = {
+    { "forward",        c_forward },        { "fd",    c_forward },
+    { "back",           c_back },           { "bk",    c_back },
+    { "left",           c_left },           { "lt",    c_left },
+    { "right",          c_right },          { "rt",    c_right },
+    { "setxy",          c_setxy },
+    { "setx",           c_setx },
+    { "sety",           c_sety },
+    { "setheading",     c_setheading },     { "seth",  c_setheading },
+    { "home",           c_home },
+    { "pendown",        c_pendown },        { "pd",    c_pendown },
+    { "penup",          c_penup },          { "pu",    c_penup },
+    { "penpaint",       c_penpaint },       { "ppt",   c_penpaint },
+    { "penerase",       c_penerase },       { "pe",    c_penerase },
+    { "penreverse",     c_penreverse },     { "px",    c_penreverse },
+    { "setpensize",     c_setpensize },
+    { "arc",            c_arc },
+    { "setscrunch",     c_setscrunch },
+    { "setlabelheight", c_setlabelheight },
+    { "setpencolor",    c_setpencolor },    { "setpc", c_setpencolor },
+    { "setbackground",  c_setbackground },  { "setbg", c_setbackground },
+    { "setpalette",     c_setpalette },
+    { "fillstart",      c_fillstart },
+    { "fillend",        c_fillend },
+} ;
+#define T_PROGRAM_PRIMITIVES (sizeof(turtleProgram_primitives) / sizeof(turtleProgram_primitives[0]))
+
+// number of values a primitive takes in a program; setpensize takes one which is used for both
+static inline uint8_t turtleProgram_arity(uint8_t op) {
+    return (op == c_setpensize) ? 1 : turtleLog_argCount(op) ;
+}
+
+static inline bool turtleProgram_isProgram(const uint8_t *bytes, size_t length) {
+    return length >= T_PROGRAM_HEADER_LEN && memcmp(bytes, T_PROGRAM_MAGIC, 4) == 0 ;
+}
+
+static inline uint32_t turtleProgram_getU32(const uint8_t *bytes) {
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24 ;
+}
+
+static inline double turtleProgram_getDouble(const uint8_t *bytes) {
+    uint64_t bits = 0 ;
+    for (int i = 0 ; i < 8 ; i++) bits |= (uint64_t)bytes[i] << (i * 8) ;
+    double value ;
+    memcpy(&value, &bits, sizeof(value)) ;
+    return value ;
+}
+
+#pragma mark - Compiler
+
+typedef enum {
+    t_tokenWord = 0,
+    t_tokenNumber,
+    t_tokenParam,         // :name, with the text not including the colon
+    t_tokenOperator,
+    t_tokenOpenBracket,
+    t_tokenCloseBracket,
+    t_tokenOpenParen,
+    t_tokenCloseParen,
+} t_tokenKinds ;
+
+typedef struct {
+    uint8_t    kind ;
+    bool       unaryMinus ;  // a - with space before it and none after, which starts a new value
+    const char *text ;
+    size_t     length ;
+    double     number ;
+    size_t     line ;
+} turtleToken ;
+
+typedef struct {
+    const char *name ;
+    size_t     nameLength ;
+    size_t     params ;      // index of the first parameter's token
+    uint8_t    paramCount ;
+    size_t     bodyStart ;   // token indicies of the body, not including end
+    size_t     bodyEnd ;
+    uint32_t   codeStart ;
+} turtleCompiledProcedure ;
+
+typedef struct {
+    turtleToken             *tokens ;
+    size_t                  tokenCount ;
+    size_t                  tokenCapacity ;
+
+    turtleCompiledProcedure *procedures ;   // the main procedure is always first
+    size_t                  procedureCount ;
+    size_t                  procedureCapacity ;
+
+    uint8_t                 *code ;
+    size_t                  codeLength ;
+    size_t                  codeCapacity ;
+
+    size_t                  pos ;           // next token
+    size_t                  end ;           // end of the tokens being compiled
+    size_t                  current ;       // procedure being compiled
+
+    char                    *error ;
+    size_t                  errorSize ;
+} turtleCompiler ;
+
+static bool turtleCompiler_fail(turtleCompiler *compiler, size_t line, const char *format, ...) {
+    if (compiler->errorSize > 0) {
+        int prefix = snprintf(compiler->error, compiler->errorSize, "line %zu: ", line) ;
+        if (prefix > 0 && (size_t)prefix < compiler->errorSize) {
+            va_list args ;
+            va_start(args, format) ;
+            vsnprintf(compiler->error + prefix, compiler->errorSize - (size_t)prefix, format, args) ;
+            va_end(args) ;
+        }
+    }
+    return false ;
+}
+
+static bool turtleCompiler_outOfMemory(turtleCompiler *compiler) {
+    if (compiler->errorSize > 0) snprintf(compiler->error, compiler->errorSize, "unable to allocate memory for program") ;
+    return false ;
+}
+
+static inline bool turtleCompiler_matches(const char *text, size_t length, const char *name) {
+    size_t i = 0 ;
+    for ( ; i < length && name[i] ; i++) {
+        if (tolower((unsigned char)text[i]) != name[i]) return false ;
+    }
+    return i == length && name[i] == 0 ;
+}
+
+static inline bool turtleCompiler_sameName(const char *a, size_t aLength, const char *b, size_t bLength) {
+    if (aLength != bLength) return false ;
+    for (size_t i = 0 ; i < aLength ; i++) {
+        if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) return false ;
+    }
+    return true ;
+}
+
+static inline bool turtleCompiler_isWord(const turtleToken *token, const char *name) {
+    return token->kind == t_tokenWord && turtleCompiler_matches(token->text, token->length, name) ;
+}
+
+static inline bool turtleCompiler_isOperator(const turtleToken *token, const char *op) {
+    return token->kind == t_tokenOperator && turtleCompiler_matches(token->text, token->length, op) ;
+}
+
+static inline bool turtleCompiler_isDelimiter(char ch) {
+    return isspace((unsigned char)ch) || strchr("[]();+-*/=<>", ch) != NULL ;
+}
+
+static int turtleCompiler_primitive(const char *text, size_t length) {
+    for (size_t i = 0 ; i < T_PROGRAM_PRIMITIVES ; i++) {
+        if (turtleCompiler_matches(text, length, turtleProgram_primitives[i].name)) return turtleProgram_primitives[i].op ;
+    }
+    return -1 ;
+}
+
+static bool turtleCompiler_isReserved(const char *text, size_t length) {
+    static const char *reserved[] = { "to", "end", "repeat", "repcount", "if", "ifelse", "stop" } ;
+    for (size_t i = 0 ; i < sizeof(reserved) / sizeof(reserved[0]) ; i++) {
+        if (turtleCompiler_matches(text, length, reserved[i])) return true ;
+    }
+    return turtleCompiler_primitive(text, length) >= 0 ;
+}
+
+static bool turtleCompiler_tokenize(turtleCompiler *compiler, const char *source, size_t length) {
+    size_t line = 1 ;
+    size_t i    = 0 ;
+
+    while (i < length) {
+        char ch = source[i] ;
+        if (ch == '\n') { line++ ; i++ ; continue ; }
+        if (isspace((unsigned char)ch)) { i++ ; continue ; }
+        if (ch == ';') {
+            while (i < length && source[i] != '\n') i++ ;
+            continue ;
+        }
+
+        if (!turtleLog_grow((void **)&compiler->tokens, &compiler->tokenCapacity, compiler->tokenCount + 1, sizeof(turtleToken))) {
+            return turtleCompiler_outOfMemory(compiler) ;
+        }
+        turtleToken *token = &compiler->tokens[compiler->tokenCount] ;
+        memset(token, 0, sizeof(turtleToken)) ;
+        token->text = source + i ;
+        token->line = line ;
+
+        size_t start = i ;
+        if (ch != '\0' && strchr("[]()", ch)) {
+            token->kind   = (ch == '[') ? t_tokenOpenBracket : (ch == ']') ? t_tokenCloseBracket :
+                            (ch == '(') ? t_tokenOpenParen : t_tokenCloseParen ;
+            i++ ;
+        } else if (ch != '\0' && strchr("+-*/=<>", ch)) {
+            token->kind = t_tokenOperator ;
+            i++ ;
+            if ((ch == '<' && i < length && (source[i] == '=' || source[i] == '>')) || (ch == '>' && i < length && source[i] == '=')) i++ ;
+            if (ch == '-') {
+                bool spaceBefore = (start == 0) || isspace((unsigned char)source[start - 1]) || strchr("[(", source[start - 1]) ;
+                token->unaryMinus = spaceBefore && i < length && !isspace((unsigned char)source[i]) ;
+            }
+        } else if (ch == ':') {
+            token->kind = t_tokenParam ;
+            i++ ;
+            while (i < length && !turtleCompiler_isDelimiter(source[i]) && source[i] != ':') i++ ;
+            token->text++ ;
+            if (i == start + 1) return turtleCompiler_fail(compiler, line, "expected a name after :") ;
+        } else {
+            while (i < length && !turtleCompiler_isDelimiter(source[i])) i++ ;
+            // a NUL byte is the only thing the delimiters match that isn't handled above
+            if (i == start) return turtleCompiler_fail(compiler, line, "unexpected NUL character") ;
+            token->kind = t_tokenWord ;
+            if (isdigit((unsigned char)ch) || ch == '.') {
+                char   buffer[64] ;
+                size_t wordLength = i - start ;
+                char   *end       = NULL ;
+                if (wordLength < sizeof(buffer)) {
+                    memcpy(buffer, source + start, wordLength) ;
+                    buffer[wordLength] = 0 ;
+                    token->number = strtod(buffer, &end) ;
+                }
+                if (!end || *end != 0 || !isfinite(token->number)) {
+                    return turtleCompiler_fail(compiler, line, "%.*s is not a number", (int)wordLength, source + start) ;
+                }
+                token->kind = t_tokenNumber ;
+            }
+        }
+        token->length = (size_t)(source + i - token->text) ;
+        compiler->tokenCount++ ;
+    }
+    return true ;
+}
+
+// finds each "to ... end" so procedures can be called before (or from within) their definitions
+static bool turtleCompiler_collectProcedures(turtleCompiler *compiler) {
+    for (size_t i = 0 ; i < compiler->tokenCount ; i++) {
+        if (!turtleCompiler_isWord(&compiler->tokens[i], "to")) continue ;
+
+        const turtleToken *to = &compiler->tokens[i] ;
+        if (i + 1 >= compiler->tokenCount || compiler->tokens[i + 1].kind != t_tokenWord) {
+            return turtleCompiler_fail(compiler, to->line, "expected a procedure name after to") ;
+        }
+        const turtleToken *name = &compiler->tokens[++i] ;
+        if (turtleCompiler_isReserved(name->text, name->length)) {
+            return turtleCompiler_fail(compiler, name->line, "%.*s is already defined", (int)name->length, name->text) ;
+        }
+        for (size_t p = 1 ; p < compiler->procedureCount ; p++) {
+            if (turtleCompiler_sameName(compiler->procedures[p].name, compiler->procedures[p].nameLength, name->text, name->length)) {
+                return turtleCompiler_fail(compiler, name->line, "%.*s is already defined", (int)name->length, name->text) ;
+            }
+        }
+        if (name->length > 255) return turtleCompiler_fail(compiler, name->line, "procedure name is too long") ;
+
+        if (!turtleLog_grow((void **)&compiler->procedures, &compiler->procedureCapacity, compiler->procedureCount + 1, sizeof(turtleCompiledProcedure))) {
+            return turtleCompiler_outOfMemory(compiler) ;
+        }
+        turtleCompiledProcedure *procedure = &compiler->procedures[compiler->procedureCount++] ;
+        memset(procedure, 0, sizeof(turtleCompiledProcedure)) ;
+        procedure->name       = name->text ;
+        procedure->nameLength = name->length ;
+        procedure->params     = i + 1 ;
+
+        while (i + 1 < compiler->tokenCount && compiler->tokens[i + 1].kind == t_tokenParam) {
+            if (procedure->paramCount == T_PROGRAM_MAX_PARAMS) return turtleCompiler_fail(compiler, name->line, "too many parameters") ;
+            const turtleToken *param = &compiler->tokens[i + 1] ;
+            for (size_t p = 0 ; p < procedure->paramCount ; p++) {
+                const turtleToken *other = &compiler->tokens[procedure->params + p] ;
+                if (turtleCompiler_sameName(other->text, other->length, param->text, param->length)) {
+                    return turtleCompiler_fail(compiler, param->line, ":%.*s is already an input to %.*s", (int)param->length,
+                                               param->text, (int)name->length, name->text) ;
+                }
+            }
+            procedure->paramCount++ ;
+            i++ ;
+        }
+        procedure->bodyStart = i + 1 ;
+
+        while (++i < compiler->tokenCount && !turtleCompiler_isWord(&compiler->tokens[i], "end")) {
+            if (turtleCompiler_isWord(&compiler->tokens[i], "to")) {
+                return turtleCompiler_fail(compiler, compiler->tokens[i].line, "procedures can't be defined inside of %.*s", (int)name->length, name->text) ;
+            }
+        }
+        if (i >= compiler->tokenCount) return turtleCompiler_fail(compiler, to->line, "%.*s is missing its end", (int)name->length, name->text) ;
+        procedure->bodyEnd = i ;
+    }
+    return true ;
+}
+
+static inline bool turtleCompiler_emit(turtleCompiler *compiler, uint8_t byte) {
+    if (!turtleLog_grow((void **)&compiler->code, &compiler->codeCapacity, compiler->codeLength + 1, 1)) return turtleCompiler_outOfMemory(compiler) ;
+    compiler->code[compiler->codeLength++] = byte ;
+    return true ;
+}
+
+static inline bool turtleCompiler_emitU32(turtleCompiler *compiler, uint32_t value) {
+    for (int i = 0 ; i < 4 ; i++) {
+        if (!turtleCompiler_emit(compiler, (uint8_t)(value >> (i * 8)))) return false ;
+    }
+    return true ;
+}
+
+static inline void turtleCompiler_patchU32(turtleCompiler *compiler, size_t at, uint32_t value) {
+    for (int i = 0 ; i < 4 ; i++) compiler->code[at + (size_t)i] = (uint8_t)(value >> (i * 8)) ;
+}
+
+static inline bool turtleCompiler_emitDouble(turtleCompiler *compiler, double value) {
+    uint64_t bits ;
+    memcpy(&bits, &value, sizeof(bits)) ;
+    for (int i = 0 ; i < 8 ; i++) {
+        if (!turtleCompiler_emit(compiler, (uint8_t)(bits >> (i * 8)))) return false ;
+    }
+    return true ;
+}
+
+// emits an instruction with a u32 operand, returning where the operand is so it can be patched
+static inline bool turtleCompiler_emitJump(turtleCompiler *compiler, uint8_t op, uint32_t target, size_t *operandAt) {
+    if (!turtleCompiler_emit(compiler, op)) return false ;
+    if (operandAt) *operandAt = compiler->codeLength ;
+    return turtleCompiler_emitU32(compiler, target) ;
+}
+
+static inline const turtleToken *turtleCompiler_peek(const turtleCompiler *compiler) {
+    return (compiler->pos < compiler->end) ? &compiler->tokens[compiler->pos] : NULL ;
+}
+
+static inline size_t turtleCompiler_line(const turtleCompiler *compiler) {
+    const turtleToken *token = turtleCompiler_peek(compiler) ;
+    if (token) return token->line ;
+    return (compiler->pos > 0 && compiler->tokenCount > 0) ? compiler->tokens[compiler->pos - 1].line : 1 ;
+}
+
+static bool turtleCompiler_expression(turtleCompiler *compiler) ;
+
+static bool turtleCompiler_primary(turtleCompiler *compiler) {
+    const turtleToken *token = turtleCompiler_peek(compiler) ;
+    if (!token) return turtleCompiler_fail(compiler, turtleCompiler_line(compiler), "not enough inputs") ;
+
+    if (turtleCompiler_isOperator(token, "-")) {
+        compiler->pos++ ;
+        return turtleCompiler_primary(compiler) && turtleCompiler_emit(compiler, t_progNeg) ;
+    }
+
+    compiler->pos++ ;
+    switch(token->kind) {
+        case t_tokenNumber:
+            return turtleCompiler_emit(compiler, t_progConst) && turtleCompiler_emitDouble(compiler, token->number) ;
+        case t_tokenParam: {
+            const turtleCompiledProcedure *procedure = &compiler->procedures[compiler->current] ;
+            for (uint8_t p = 0 ; p < procedure->paramCount ; p++) {
+                const turtleToken *param = &compiler->tokens[procedure->params + p] ;
+                if (turtleCompiler_sameName(param->text, param->length, token->text, token->length)) {
+                    return turtleCompiler_emit(compiler, t_progParam) && turtleCompiler_emit(compiler, p) ;
+                }
+            }
+            return turtleCompiler_fail(compiler, token->line, "%.*s has no value", (int)token->length, token->text) ;
+        }
+        case t_tokenOpenParen:
+            if (!turtleCompiler_expression(compiler)) return false ;
+            token = turtleCompiler_peek(compiler) ;
+            if (!token || token->kind != t_tokenCloseParen) return turtleCompiler_fail(compiler, turtleCompiler_line(compiler), "expected )") ;
+            compiler->pos++ ;
+            return true ;
+        case t_tokenWord:
+            if (turtleCompiler_isWord(token, "repcount")) return turtleCompiler_emit(compiler, t_progRepcount) ;
+            return turtleCompiler_fail(compiler, token->line, "%.*s doesn't output a number", (int)token->length, token->text) ;
+        default:
+            return turtleCompiler_fail(compiler, token->line, "expected a number but found %.*s", (int)token->length, token->text) ;
+    }
+}
+
+static bool turtleCompiler_term(turtleCompiler *compiler) {
+    if (!turtleCompiler_primary(compiler)) return false ;
+    const turtleToken *token ;
+    while ((token = turtleCompiler_peek(compiler)) && (turtleCompiler_isOperator(token, "*") || turtleCompiler_isOperator(token, "/"))) {
+        compiler->pos++ ;
+        if (!turtleCompiler_primary(compiler)) return false ;
+        if (!turtleCompiler_emit(compiler, (token->text[0] == '*') ? t_progMul : t_progDiv)) return false ;
+    }
+    return true ;
+}
+
+static bool turtleCompiler_sum(turtleCompiler *compiler) {
+    if (!turtleCompiler_term(compiler)) return false ;
+    const turtleToken *token ;
+    while ((token = turtleCompiler_peek(compiler)) &&
+           (turtleCompiler_isOperator(token, "+") || (turtleCompiler_isOperator(token, "-") && !token->unaryMinus))) {
+        compiler->pos++ ;
+        if (!turtleCompiler_term(compiler)) return false ;
+        if (!turtleCompiler_emit(compiler, (token->text[0] == '+') ? t_progAdd : t_progSub)) return false ;
+    }
+    return true ;
+}
+
+static bool turtleCompiler_expression(turtleCompiler *compiler) {
+    static const struct { const char *op ; uint8_t code ; } comparisons[] = {
+        { "<", t_progLess }, { ">", t_progGreater }, { "<=", t_progLessEqual }, { ">=", t_progGreaterEqual },
+        { "=", t_progEqual }, { "<>", t_progNotEqual },
+    } ;
+
+    if (!turtleCompiler_sum(compiler)) return false ;
+    const turtleToken *token = turtleCompiler_peek(compiler) ;
+    for (size_t i = 0 ; token && i < sizeof(comparisons) / sizeof(comparisons[0]) ; i++) {
+        if (turtleCompiler_isOperator(token, comparisons[i].op)) {
+            compiler->pos++ ;
+            return turtleCompiler_sum(compiler) && turtleCompiler_emit(compiler, comparisons[i].code) ;
+        }
+    }
+    return true ;
+}
+
+static bool turtleCompiler_statements(turtleCompiler *compiler, bool inBrackets) ;
+
+// compiles a bracketed list of instructions
+static bool turtleCompiler_block(turtleCompiler *compiler) {
+    const turtleToken *token = turtleCompiler_peek(compiler) ;
+    if (!token || token->kind != t_tokenOpenBracket) return turtleCompiler_fail(compiler, turtleCompiler_line(compiler), "expected [") ;
+    compiler->pos++ ;
+    if (!turtleCompiler_statements(compiler, true)) return false ;
+    token = turtleCompiler_peek(compiler) ;
+    if (!token || token->kind != t_tokenCloseBracket) return turtleCompiler_fail(compiler, turtleCompiler_line(compiler), "expected ]") ;
+    compiler->pos++ ;
+    return true ;
+}
+
+static bool turtleCompiler_statement(turtleCompiler *compiler) {
+    const turtleToken *token = &compiler->tokens[compiler->pos++] ;
+    if (token->kind != t_tokenWord) {
+        return turtleCompiler_fail(compiler, token->line, "expected an instruction but found %.*s", (int)token->length, token->text) ;
+    }
+
+    if (turtleCompiler_isWord(token, "repeat")) {
+        size_t exitAt ;
+        if (!turtleCompiler_expression(compiler) || !turtleCompiler_emitJump(compiler, t_progRepeat, 0, &exitAt)) return false ;
+        uint32_t body = (uint32_t)compiler->codeLength ;
+        if (!turtleCompiler_block(compiler) || !turtleCompiler_emitJump(compiler, t_progNext, body, NULL)) return false ;
+        turtleCompiler_patchU32(compiler, exitAt, (uint32_t)compiler->codeLength) ;
+        return true ;
+    }
+
+    if (turtleCompiler_isWord(token, "if") || turtleCompiler_isWord(token, "ifelse")) {
+        size_t elseAt, endAt ;
+        if (!turtleCompiler_expression(compiler) || !turtleCompiler_emitJump(compiler, t_progJumpIfFalse, 0, &elseAt)) return false ;
+        if (!turtleCompiler_block(compiler)) return false ;
+
+        const turtleToken *next = turtleCompiler_peek(compiler) ;
+        if (next && next->kind == t_tokenOpenBracket) {
+            if (!turtleCompiler_emitJump(compiler, t_progJump, 0, &endAt)) return false ;
+            turtleCompiler_patchU32(compiler, elseAt, (uint32_t)compiler->codeLength) ;
+            if (!turtleCompiler_block(compiler)) return false ;
+            turtleCompiler_patchU32(compiler, endAt, (uint32_t)compiler->codeLength) ;
+        } else if (turtleCompiler_isWord(token, "ifelse")) {
+            return turtleCompiler_fail(compiler, token->line, "ifelse needs a second list of instructions") ;
+        } else {
+            turtleCompiler_patchU32(compiler, elseAt, (uint32_t)compiler->codeLength) ;
+        }
+        return true ;
+    }
+
+    if (turtleCompiler_isWord(token, "stop")) return turtleCompiler_emit(compiler, t_progReturn) ;
+
+    int op = turtleCompiler_primitive(token->text, token->length) ;
+    if (op >= 0) {
+        for (uint8_t i = 0 ; i < turtleProgram_arity((uint8_t)op) ; i++) {
+            if (!turtleCompiler_expression(compiler)) return false ;
+        }
+        if (op == c_setpensize && !turtleCompiler_emit(compiler, t_progDup)) return false ;
+        return turtleCompiler_emit(compiler, t_progCommand) && turtleCompiler_emit(compiler, (uint8_t)op) ;
+    }
+
+    for (size_t p = 1 ; p < compiler->procedureCount ; p++) {
+        const turtleCompiledProcedure *procedure = &compiler->procedures[p] ;
+        if (turtleCompiler_sameName(procedure->name, procedure->nameLength, token->text, token->length)) {
+            for (uint8_t i = 0 ; i < procedure->paramCount ; i++) {
+                if (!turtleCompiler_expression(compiler)) return false ;
+            }
+            return turtleCompiler_emitJump(compiler, t_progCall, (uint32_t)p, NULL) ;
+        }
+    }
+
+    return turtleCompiler_fail(compiler, token->line, "I don't know how to %.*s", (int)token->length, token->text) ;
+}
+
+// compiles instructions up to the end of the tokens being compiled or, within brackets, the closing
+// bracket; the main procedure skips over procedure definitions
+static bool turtleCompiler_statements(turtleCompiler *compiler, bool inBrackets) {
+    const turtleToken *token ;
+    while ((token = turtleCompiler_peek(compiler))) {
+        if (token->kind == t_tokenCloseBracket) {
+            if (inBrackets) return true ;
+            return turtleCompiler_fail(compiler, token->line, "unexpected ]") ;
+        }
+        if (turtleCompiler_isWord(token, "to") && compiler->current == 0 && !inBrackets) {
+            for (size_t p = 1 ; p < compiler->procedureCount ; p++) {
+                if (compiler->procedures[p].params == compiler->pos + 2) compiler->pos = compiler->procedures[p].bodyEnd + 1 ;
+            }
+            continue ;
+        }
+        if (turtleCompiler_isWord(token, "end")) return turtleCompiler_fail(compiler, token->line, "end without to") ;
+        if (!turtleCompiler_statement(compiler)) return false ;
+    }
+    return true ;
+}
+
+// Compiles the Logo source into a program. On success, *program is set to a newly allocated copy
+// which the caller must free; otherwise false is returned with a message, including the line at
+// fault, in error.
+static bool turtleProgram_compile(const char *source, size_t length, uint8_t **program, size_t *programLength,
+                                  char *error, size_t errorSize) {
+    turtleCompiler compiler ;
+    memset(&compiler, 0, sizeof(compiler)) ;
+    compiler.error     = error ;
+    compiler.errorSize = errorSize ;
+    *program           = NULL ;
+    *programLength     = 0 ;
+
+    bool isGood = turtleLog_grow((void **)&compiler.procedures, &compiler.procedureCapacity, 1, sizeof(turtleCompiledProcedure)) ;
+    if (isGood) {
+        memset(compiler.procedures, 0, sizeof(turtleCompiledProcedure)) ;
+        compiler.procedureCount = 1 ;
+    } else {
+        turtleCompiler_outOfMemory(&compiler) ;
+    }
+    isGood = isGood && turtleCompiler_tokenize(&compiler, source, length) && turtleCompiler_collectProcedures(&compiler) ;
+
+    for (size_t p = 0 ; isGood && p < compiler.procedureCount ; p++) {
+        turtleCompiledProcedure *procedure = &compiler.procedures[p] ;
+        procedure->codeStart = (uint32_t)compiler.codeLength ;
+        compiler.current     = p ;
+        compiler.pos         = (p == 0) ? 0 : procedure->bodyStart ;
+        compiler.end         = (p == 0) ? compiler.tokenCount : procedure->bodyEnd ;
+        isGood = turtleCompiler_statements(&compiler, false) && turtleCompiler_emit(&compiler, t_progReturn) ;
+    }
+    if (isGood && compiler.codeLength >= T_PROGRAM_NO_RETURN) isGood = turtleCompiler_fail(&compiler, 1, "program is too large") ;
+
+    // header, procedure table and code
+    if (isGood) {
+        size_t size = T_PROGRAM_HEADER_LEN + 4 + 4 + compiler.codeLength ;
+        for (size_t p = 0 ; p < compiler.procedureCount ; p++) size += 1 + compiler.procedures[p].nameLength + 1 + 4 ;
+
+        uint8_t *output = malloc(size) ;
+        if (output) {
+            size_t at = 0 ;
+            memcpy(output, T_PROGRAM_MAGIC, 4) ;
+            output[4] = T_PROGRAM_VERSION ;
+            at = T_PROGRAM_HEADER_LEN ;
+            for (int i = 0 ; i < 4 ; i++) output[at++] = (uint8_t)(compiler.procedureCount >> (i * 8)) ;
+            for (size_t p = 0 ; p < compiler.procedureCount ; p++) {
+                const turtleCompiledProcedure *procedure = &compiler.procedures[p] ;
+                output[at++] = (uint8_t)procedure->nameLength ;
+                for (size_t c = 0 ; c < procedure->nameLength ; c++) output[at++] = (uint8_t)tolower((unsigned char)procedure->name[c]) ;
+                output[at++] = procedure->paramCount ;
+                for (int i = 0 ; i < 4 ; i++) output[at++] = (uint8_t)(procedure->codeStart >> (i * 8)) ;
+            }
+            for (int i = 0 ; i < 4 ; i++) output[at++] = (uint8_t)(compiler.codeLength >> (i * 8)) ;
+            memcpy(output + at, compiler.code, compiler.codeLength) ;
+            *program       = output ;
+            *programLength = size ;
+        } else {
+            isGood = turtleCompiler_outOfMemory(&compiler) ;
+        }
+    }
+
+    free(compiler.tokens) ;
+    free(compiler.procedures) ;
+    free(compiler.code) ;
+    return isGood ;
+}
+
+#pragma mark - Running
+
+typedef struct {
+    const uint8_t *name ;         // lower case, not NUL terminated
+    uint8_t       nameLength ;
+    uint8_t       paramCount ;
+    uint32_t      codeStart ;
+} turtleProgramProcedure ;
+
+typedef struct {
+    uint32_t returnTo ;           // T_PROGRAM_NO_RETURN for the procedure the run started with
+    size_t   base ;               // stack index of the procedure's first parameter
+    size_t   loopBase ;           // repeats below this belong to callers
+    uint8_t  paramCount ;
+} turtleProgramFrame ;
+
+typedef struct {
+    double count ;
+    double iteration ;
+} turtleProgramLoop ;
+
+// Hands a command to the owner; args are flattened as for the command log, with colors as palette
+// indicies. Returns NULL to carry on (setting *pause to stop the run after this command) or a
+// message describing why the command couldn't be performed.
+typedef const char *(*turtleProgramEmitter)(void *context, uint8_t op, const double *args, uint8_t flags, bool *pause) ;
+
+typedef struct {
+    uint8_t                *program ;     // a copy, so the caller's needn't outlive the run
+    size_t                 programLength ;
+    const uint8_t          *code ;
+    uint32_t               codeLength ;
+    turtleProgramProcedure *procedures ;
+    size_t                 procedureCount ;
+
+    double                 *stack ;
+    size_t                 stackCount ;
+    size_t                 stackCapacity ;
+    turtleProgramFrame     *frames ;
+    size_t                 frameCount ;
+    size_t                 frameCapacity ;
+    turtleProgramLoop      *loops ;
+    size_t                 loopCount ;
+    size_t                 loopCapacity ;
+
+    uint32_t               pc ;
+    bool                   active ;       // started and not yet done or failed
+    const char             *error ;
+    uint8_t                errorOp ;      // the command error is about, or c__special if it isn't about a command
+
+    // statistics
+    size_t                 commands ;
+    size_t                 instructions ;
+} turtleProgramRun ;
+
+static inline void turtleProgram_init(turtleProgramRun *run) {
+    memset(run, 0, sizeof(turtleProgramRun)) ;
+}
+
+static inline void turtleProgram_free(turtleProgramRun *run) {
+    free(run->program) ;
+    free(run->procedures) ;
+    free(run->stack) ;
+    free(run->frames) ;
+    free(run->loops) ;
+    turtleProgram_init(run) ;
+}
+
+static inline bool turtleProgram_fail(turtleProgramRun *run, const char *message) {
+    run->error  = message ;
+    run->active = false ;
+    return false ;
+}
+
+static inline bool turtleProgram_push(turtleProgramRun *run, double value) {
+    if (!turtleLog_grow((void **)&run->stack, &run->stackCapacity, run->stackCount + 1, sizeof(double))) {
+        return turtleProgram_fail(run, "unable to allocate memory for program stack") ;
+    }
+    run->stack[run->stackCount++] = value ;
+    return true ;
+}
+
+static bool turtleProgram_pushFrame(turtleProgramRun *run, size_t procedure, uint32_t returnTo) {
+    const turtleProgramProcedure *callee = &run->procedures[procedure] ;
+    if (run->frameCount >= T_PROGRAM_MAX_DEPTH) return turtleProgram_fail(run, "procedures are nested too deeply") ;
+    if (run->stackCount < callee->paramCount)   return turtleProgram_fail(run, "not enough inputs for procedure") ;
+    if (!turtleLog_grow((void **)&run->frames, &run->frameCapacity, run->frameCount + 1, sizeof(turtleProgramFrame))) {
+        return turtleProgram_fail(run, "unable to allocate memory for procedure call") ;
+    }
+    run->frames[run->frameCount++] = (turtleProgramFrame){
+        .returnTo   = returnTo,
+        .base       = run->stackCount - callee->paramCount,
+        .loopBase   = run->loopCount,
+        .paramCount = callee->paramCount,
+    } ;
+    run->pc = callee->codeStart ;
+    return true ;
+}
+
+// finds a procedure by name (case insensitive); NULL or an empty name is the main procedure
+static inline long turtleProgram_findProcedure(const turtleProgramRun *run, const char *name, size_t nameLength) {
+    if (!name) nameLength = 0 ;
+    for (size_t p = 0 ; p < run->procedureCount ; p++) {
+        const turtleProgramProcedure *procedure = &run->procedures[p] ;
+        if (procedure->nameLength == nameLength && (nameLength == 0 || turtleCompiler_sameName((const char *)procedure->name, nameLength, name, nameLength))) {
+            return (long)p ;
+        }
+    }
+    return -1 ;
+}
+
+// Prepares to run the named procedure of a compiled program (NULL for its main procedure) with the
+// given arguments, abandoning any run in progress. Returns false with error set if the program is
+// malformed, the procedure doesn't exist, or the number of arguments doesn't match.
+static bool turtleProgram_start(turtleProgramRun *run, const uint8_t *program, size_t length,
+                                const char *name, size_t nameLength, const double *args, size_t argc) {
+    turtleProgramRun reuse = *run ;
+    free(reuse.program) ;
+    free(reuse.procedures) ;
+    turtleProgram_init(run) ;
+    run->stack         = reuse.stack ;   // the stacks are kept for the next run
+    run->stackCapacity = reuse.stackCapacity ;
+    run->frames        = reuse.frames ;
+    run->frameCapacity = reuse.frameCapacity ;
+    run->loops         = reuse.loops ;
+    run->loopCapacity  = reuse.loopCapacity ;
+
+    if (!turtleProgram_isProgram(program, length))  return turtleProgram_fail(run, "not a compiled turtle program") ;
+    if (program[4] != T_PROGRAM_VERSION)            return turtleProgram_fail(run, "unsupported program version") ;
+
+    run->program = malloc(length) ;
+    if (!run->program) return turtleProgram_fail(run, "unable to allocate memory for program") ;
+    memcpy(run->program, program, length) ;
+    run->programLength = length ;
+
+    const uint8_t *bytes = run->program ;
+    size_t        at     = T_PROGRAM_HEADER_LEN ;
+    if (length - at < 4) return turtleProgram_fail(run, "truncated program") ;
+    uint32_t count = turtleProgram_getU32(bytes + at) ;
+    at += 4 ;
+    if (count == 0 || count > (length - at) / 6) return turtleProgram_fail(run, "truncated program") ;
+
+    run->procedures = calloc(count, sizeof(turtleProgramProcedure)) ;
+    if (!run->procedures) return turtleProgram_fail(run, "unable to allocate memory for program") ;
+    run->procedureCount = count ;
+    for (uint32_t p = 0 ; p < count ; p++) {
+        turtleProgramProcedure *procedure = &run->procedures[p] ;
+        if (length - at < 1) return turtleProgram_fail(run, "truncated program") ;
+        procedure->nameLength = bytes[at++] ;
+        if (length - at < (size_t)procedure->nameLength + 5) return turtleProgram_fail(run, "truncated program") ;
+        procedure->name       = bytes + at ;
+        at                   += procedure->nameLength ;
+        procedure->paramCount = bytes[at++] ;
+        procedure->codeStart  = turtleProgram_getU32(bytes + at) ;
+        at                   += 4 ;
+    }
+    if (length - at < 4) return turtleProgram_fail(run, "truncated program") ;
+    run->codeLength = turtleProgram_getU32(bytes + at) ;
+    at += 4 ;
+    if (length - at != run->codeLength) return turtleProgram_fail(run, "truncated program") ;
+    run->code = bytes + at ;
+    for (uint32_t p = 0 ; p < count ; p++) {
+        if (run->procedures[p].codeStart >= run->codeLength) return turtleProgram_fail(run, "procedure outside of program") ;
+    }
+
+    long procedure = turtleProgram_findProcedure(run, name, nameLength) ;
+    if (procedure < 0)                                           return turtleProgram_fail(run, "no such procedure in program") ;
+    if (argc != run->procedures[procedure].paramCount)           return turtleProgram_fail(run, "wrong number of inputs for procedure") ;
+    for (size_t i = 0 ; i < argc ; i++) {
+        if (!isfinite(args[i]))                                  return turtleProgram_fail(run, "inputs must be finite numbers") ;
+        if (!turtleProgram_push(run, args[i]))                   return false ;
+    }
+    if (!turtleProgram_pushFrame(run, (size_t)procedure, T_PROGRAM_NO_RETURN)) return false ;
+    run->active = true ;
+    return true ;
+}
+
+// Runs until the program finishes, fails, or the emitter asks for a pause; a paused run carries on
+// from where it stopped with the next call. If limit is greater than 0, the run also pauses after
+// that many instructions so a program which loops without drawing can't hold on forever.
+static t_programResults turtleProgram_resume(turtleProgramRun *run, turtleProgramEmitter emit, void *context, size_t limit) {
+    if (!run->active) {
+        if (!run->error) run->error = "program is not running" ;
+        return t_programError ;
+    }
+
+    const uint8_t *code   = run->code ;
+    uint32_t      length  = run->codeLength ;
+    size_t        steps   = 0 ;
+
+    // operands are checked to be within the code before they're read
+    #define T_NEED(bytes)  if ((size_t)length - run->pc < (bytes)) { turtleProgram_fail(run, "truncated instruction") ; return t_programError ; }
+    #define T_POP(count)   if (run->stackCount < run->frames[run->frameCount - 1].base + (count)) { turtleProgram_fail(run, "program stack underflow") ; return t_programError ; }
+    #define T_FAIL(msg)    { turtleProgram_fail(run, msg) ; return t_programError ; }
+
+    while (true) {
+        if (limit > 0 && steps++ >= limit) return t_programPaused ;
+        run->instructions++ ;
+        T_NEED(1) ;
+        uint8_t            op    = code[run->pc++] ;
+        turtleProgramFrame *frame = &run->frames[run->frameCount - 1] ;
+        double             *top  = run->stack + run->stackCount ;
+
+        switch(op) {
+            case t_progConst:
+                T_NEED(8) ;
+                if (!turtleProgram_push(run, turtleProgram_getDouble(code + run->pc))) return t_programError ;
+                run->pc += 8 ;
+                break ;
+            case t_progParam: {
+                T_NEED(1) ;
+                uint8_t param = code[run->pc++] ;
+                if (param >= frame->paramCount) T_FAIL("parameter outside of procedure") ;
+                if (!turtleProgram_push(run, run->stack[frame->base + param])) return t_programError ;
+            }   break ;
+            case t_progRepcount:
+                if (!turtleProgram_push(run, (run->loopCount > frame->loopBase) ? run->loops[run->loopCount - 1].iteration : -1.0)) {
+                    return t_programError ;
+                }
+                break ;
+            case t_progDup:
+                T_POP(1) ;
+                if (!turtleProgram_push(run, top[-1])) return t_programError ;
+                break ;
+            case t_progNeg:
+                T_POP(1) ;
+                top[-1] = -top[-1] ;
+                break ;
+            case t_progAdd:          T_POP(2) ; top[-2] = top[-2] + top[-1] ;                 run->stackCount-- ; break ;
+            case t_progSub:          T_POP(2) ; top[-2] = top[-2] - top[-1] ;                 run->stackCount-- ; break ;
+            case t_progMul:          T_POP(2) ; top[-2] = top[-2] * top[-1] ;                 run->stackCount-- ; break ;
+            case t_progDiv:          T_POP(2) ; top[-2] = top[-2] / top[-1] ;                 run->stackCount-- ; break ;
+            case t_progLess:         T_POP(2) ; top[-2] = (top[-2] <  top[-1]) ? 1.0 : 0.0 ; run->stackCount-- ; break ;
+            case t_progGreater:      T_POP(2) ; top[-2] = (top[-2] >  top[-1]) ? 1.0 : 0.0 ; run->stackCount-- ; break ;
+            case t_progLessEqual:    T_POP(2) ; top[-2] = (top[-2] <= top[-1]) ? 1.0 : 0.0 ; run->stackCount-- ; break ;
+            case t_progGreaterEqual: T_POP(2) ; top[-2] = (top[-2] >= top[-1]) ? 1.0 : 0.0 ; run->stackCount-- ; break ;
+            case t_progEqual:        T_POP(2) ; top[-2] = (top[-2] == top[-1]) ? 1.0 : 0.0 ; run->stackCount-- ; break ;
+            case t_progNotEqual:     T_POP(2) ; top[-2] = (top[-2] != top[-1]) ? 1.0 : 0.0 ; run->stackCount-- ; break ;
+            case t_progJump:
+            case t_progJumpIfFalse:
+            case t_progRepeat:
+            case t_progNext:
+            case t_progCall: {
+                T_NEED(4) ;
+                uint32_t operand = turtleProgram_getU32(code + run->pc) ;
+                run->pc += 4 ;
+                if (op != t_progCall && operand > length) T_FAIL("jump outside of program") ;
+
+                if (op == t_progJump) {
+                    run->pc = operand ;
+                } else if (op == t_progJumpIfFalse) {
+                    T_POP(1) ;
+                    if (top[-1] == 0.0) run->pc = operand ;
+                    run->stackCount-- ;
+                } else if (op == t_progRepeat) {
+                    T_POP(1) ;
+                    double count = floor(top[-1]) ;
+                    run->stackCount-- ;
+                    if (!(count >= 1.0)) {
+                        run->pc = operand ;
+                    } else if (!turtleLog_grow((void **)&run->loops, &run->loopCapacity, run->loopCount + 1, sizeof(turtleProgramLoop))) {
+                        T_FAIL("unable to allocate memory for repeat") ;
+                    } else {
+                        run->loops[run->loopCount++] = (turtleProgramLoop){ .count = count, .iteration = 1.0 } ;
+                    }
+                } else if (op == t_progNext) {
+                    if (run->loopCount <= frame->loopBase) T_FAIL("repeat outside of procedure") ;
+                    turtleProgramLoop *loop = &run->loops[run->loopCount - 1] ;
+                    if (loop->iteration < loop->count) {
+                        loop->iteration++ ;
+                        run->pc = operand ;
+                    } else {
+                        run->loopCount-- ;
+                    }
+                } else {
+                    if (operand >= run->procedureCount) T_FAIL("call to undefined procedure") ;
+                    if (!turtleProgram_pushFrame(run, operand, run->pc)) return t_programError ;
+                }
+            }   break ;
+            case t_progReturn:
+                run->stackCount = frame->base ;
+                run->loopCount  = frame->loopBase ;
+                run->frameCount-- ;
+                if (frame->returnTo == T_PROGRAM_NO_RETURN || run->frameCount == 0) {
+                    run->frameCount = 0 ;
+                    run->active     = false ;
+                    return t_programDone ;
+                }
+                run->pc = frame->returnTo ;
+                break ;
+            case t_progCommand: {
+                T_NEED(1) ;
+                uint8_t command = code[run->pc++] ;
+                if (command == c__special || command >= c__commandCount) T_FAIL("undefined command in program") ;
+                uint8_t argc = turtleLog_argCount(command) ;
+                T_POP(argc) ;
+
+                double     *args   = top - argc ;
+                uint8_t    flags   = 0 ;
+                bool       pause   = false ;
+                const char *errMsg = NULL ;
+                for (uint8_t i = 0 ; !errMsg && i < argc ; i++) {
+                    if (turtleLog_argType(command, i) == 's') {
+                        errMsg = "takes a string, which programs don't support" ;
+                    } else if (!isfinite(args[i])) {
+                        errMsg = "inputs must be finite numbers" ;
+                    } else if (args[i] == trunc(args[i]) && fabs(args[i]) < 0x1p53) {
+                        flags |= T_FLAG_INTEGER(i) ;
+                    }
+                }
+
+                if (!errMsg) errMsg = emit(context, command, args, flags, &pause) ;
+                run->stackCount -= argc ;
+                if (errMsg) {
+                    run->errorOp = command ;
+                    T_FAIL(errMsg) ;
+                }
+                run->commands++ ;
+                if (pause) return t_programPaused ;
+            }   break ;
+            default:
+                T_FAIL("undefined instruction in program") ;
+        }
+    }
+
+    #undef T_NEED
+    #undef T_POP
+    #undef T_FAIL
+}
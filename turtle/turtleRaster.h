@@ -0,0 +1,459 @@
+// Software rasterizer for hs.canvas.turtle command logs
+//
+// Plain C so it can be used (and measured) outside of Hammerspoon -- nothing in here knows about
+// AppKit or Lua. Renders the drawing commands of a turtleLog into the 8 bit premultiplied RGBA tiles
+// of a turtleTileCache, allocating tiles only where something is actually drawn. Within Hammerspoon
+// the tiles are drawn with AppKit instead; this exists so the engine can be run and benchmarked
+// headless (see headless/) and produces output close to, but not bit for bit identical with, what
+// AppKit draws.
+//
+// Every shape is reduced to a polygon and filled with the nonzero winding rule (which is also what
+// NSBezierPath uses for fills): moves become quads with butt ends, arcs are flattened and widened by
+// the pen size, and fills use the vertices recorded in the log. Coverage is sampled with 4 scanlines
+// per pixel row and exact horizontal coverage along each scanline. Pen modes map to the compositing
+// operations used by hs.canvas.turtle: paint is source over, erase is destination out, and reverse
+// is the Porter-Duff XOR. Labels require fonts and are skipped.
+//
+// With a decimation tolerance set, runs of moves which can be stroked together (opaque paint or
+// erase in the same style, with only non-drawing commands between them) are passed through a
+// turtleDecimator first and only the segments it keeps are rasterized.
+
+#pragma once
+
+#include "turtleEngine.h"
+#include "tileCache.h"
+#include "decimate.h"
+
+#define T_RASTER_SUBSAMPLES 4
+#define T_RASTER_MAX_RUN    4096  // moves decimated together; keeps the decimator's output reasonable
+
+// a polygon is a list of x, y pairs in pixel space (drawing units * scale, y up); several closed
+// contours may share one polygon, each starting at an index listed in contours
+typedef struct {
+    double *points ;
+    size_t count ;
+    size_t capacity ;             // in doubles
+    size_t *contours ;
+    size_t contourCount ;
+    size_t contourCapacity ;
+} turtlePolygon ;
+
+// scratch space reused between commands so rasterizing a long log doesn't allocate per command
+typedef struct {
+    turtlePolygon polygon ;
+    double        *crossings ;    // x, winding pairs for one scanline
+    size_t        crossingCapacity ;
+    float         *coverage ;     // one row of coverage over the polygon's horizontal extent; kept zeroed
+    size_t        coverageCapacity ;
+    double        tolerance ;     // decimation tolerance in pixels; 0 rasterizes every move
+    turtleDecimator decimator ;
+} turtleRaster ;
+
+#pragma mark - Lifecycle
+
+static inline void turtleRaster_init(turtleRaster *raster) {
+    memset(raster, 0, sizeof(turtleRaster)) ;
+}
+
+static inline void turtleRaster_free(turtleRaster *raster) {
+    free(raster->polygon.points) ;
+    free(raster->polygon.contours) ;
+    free(raster->crossings) ;
+    free(raster->coverage) ;
+    turtleDecimator_free(&raster->decimator) ;
+    turtleRaster_init(raster) ;
+}
+
+static inline size_t turtleRaster_bytesAllocated(const turtleRaster *raster) {
+    return raster->polygon.capacity        * sizeof(double) +
+           raster->polygon.contourCapacity * sizeof(size_t) +
+           raster->crossingCapacity        * sizeof(double) +
+           raster->coverageCapacity        * sizeof(float) +
+           turtleDecimator_bytesAllocated(&raster->decimator) ;
+}
+
+#pragma mark - Polygons
+
+static inline void turtlePolygon_reset(turtlePolygon *polygon) {
+    polygon->count        = 0 ;
+    polygon->contourCount = 0 ;
+}
+
+static inline bool turtlePolygon_beginContour(turtlePolygon *polygon) {
+    if (!turtleLog_grow((void **)&polygon->contours, &polygon->contourCapacity, polygon->contourCount + 1, sizeof(size_t))) {
+        return false ;
+    }
+    polygon->contours[polygon->contourCount++] = polygon->count ;
+    return true ;
+}
+
+static inline bool turtlePolygon_append(turtlePolygon *polygon, double x, double y) {
+    if (!turtleLog_grow((void **)&polygon->points, &polygon->capacity, (polygon->count + 1) * 2, sizeof(double))) {
+        return false ;
+    }
+    polygon->points[polygon->count * 2]     = x ;
+    polygon->points[polygon->count * 2 + 1] = y ;
+    polygon->count++ ;
+    return true ;
+}
+
+// Widens the polyline points[0 .. count - 1] (already in pixel space) into a closed contour by
+// halfWidth on either side. Interior vertices are offset along the average of the adjoining
+// segment normals (a miter join, limited so that sharp turns don't spike); the ends are butt caps.
+static bool turtlePolygon_appendStroke(turtlePolygon *polygon, const double *points, size_t count, double halfWidth) {
+    if (count < 2 || !(halfWidth > 0.0)) return true ;
+    if (!turtlePolygon_beginContour(polygon)) return false ;
+
+    for (int side = 0 ; side < 2 ; side++) {
+        for (size_t n = 0 ; n < count ; n++) {
+            size_t i     = (side == 0) ? n : count - 1 - n ;
+            size_t prev  = (i > 0) ? i - 1 : i ;
+            size_t next  = (i + 1 < count) ? i + 1 : i ;
+            double nx    = 0.0, ny = 0.0 ;
+            double inX   = 0.0, inY = 0.0 ;
+            bool   hasIn = false ;
+
+            if (prev != i) {
+                double dx = points[i * 2] - points[prev * 2], dy = points[i * 2 + 1] - points[prev * 2 + 1] ;
+                double length = hypot(dx, dy) ;
+                if (length > 0.0) { inX = -dy / length ; inY = dx / length ; hasIn = true ; nx += inX ; ny += inY ; }
+            }
+            if (next != i) {
+                double dx = points[next * 2] - points[i * 2], dy = points[next * 2 + 1] - points[i * 2 + 1] ;
+                double length = hypot(dx, dy) ;
+                if (length > 0.0) { nx += -dy / length ; ny += dx / length ; if (!hasIn) { inX = -dy / length ; inY = dx / length ; hasIn = true ; } }
+            }
+
+            double length = hypot(nx, ny) ;
+            double offset = halfWidth ;
+            if (length > 0.0) {
+                nx /= length ; ny /= length ;
+                double cosine = nx * inX + ny * inY ;
+                offset = halfWidth / fmax(cosine, 0.25) ;
+            }
+            if (side == 1) offset = -offset ;
+            if (!turtlePolygon_append(polygon, points[i * 2] + nx * offset, points[i * 2 + 1] + ny * offset)) return false ;
+        }
+    }
+    return true ;
+}
+
+#pragma mark - Compositing
+
+// composites a premultiplied source color with the given coverage onto one pixel
+static inline void turtleRaster_compositePixel(uint8_t *pixel, const float *source, float coverage, uint32_t mode) {
+    float sr = source[0] * coverage, sg = source[1] * coverage, sb = source[2] * coverage, sa = source[3] * coverage ;
+    float dr = pixel[0] / 255.0f, dg = pixel[1] / 255.0f, db = pixel[2] / 255.0f, da = pixel[3] / 255.0f ;
+    float r, g, b, a ;
+
+    if (mode == t_penErase) {
+        r = dr * (1.0f - sa) ; g = dg * (1.0f - sa) ; b = db * (1.0f - sa) ; a = da * (1.0f - sa) ;
+    } else if (mode == t_penReverse) {
+        r = sr * (1.0f - da) + dr * (1.0f - sa) ;
+        g = sg * (1.0f - da) + dg * (1.0f - sa) ;
+        b = sb * (1.0f - da) + db * (1.0f - sa) ;
+        a = sa * (1.0f - da) + da * (1.0f - sa) ;
+    } else {
+        r = sr + dr * (1.0f - sa) ; g = sg + dg * (1.0f - sa) ; b = sb + db * (1.0f - sa) ; a = sa + da * (1.0f - sa) ;
+    }
+    pixel[0] = (uint8_t)(fminf(r, 1.0f) * 255.0f + 0.5f) ;
+    pixel[1] = (uint8_t)(fminf(g, 1.0f) * 255.0f + 0.5f) ;
+    pixel[2] = (uint8_t)(fminf(b, 1.0f) * 255.0f + 0.5f) ;
+    pixel[3] = (uint8_t)(fminf(a, 1.0f) * 255.0f + 0.5f) ;
+}
+
+// Each of the compositing operations above is affine in the destination: with D = (r, g, b, a),
+// every color channel becomes p * Dc + q * Da + r and alpha becomes s * Da + t, where only reverse
+// makes q nonzero or s differ from p. Chaining such maps gives another of the same shape, so a
+// layer tile can record everything drawn into it as one map per pixel and be applied to whatever
+// ends up beneath it later (see parallelRaster.h) with the same result as drawing in place. Maps
+// are stored so that a cleared (all zero) pixel is the identity: r, g, b and t first, then q for
+// each color channel, then 1 - p and 1 - s.
+#define T_LAYER_CHANNELS    9
+#define T_LAYER_PIXEL_BYTES (T_LAYER_CHANNELS * sizeof(float))
+
+// chains the compositing operation for the source color with the given coverage after the map
+static inline void turtleRaster_composeLayerPixel(float *map, const float *source, float coverage, uint32_t mode) {
+    float sa = source[3] * coverage ;
+    float p  = 1.0f - sa ;                                   // the operation's own p, q, s and t
+    float s  = (mode == t_penReverse) ? 1.0f - 2.0f * sa : p ;
+    float t  = (mode == t_penErase) ? 0.0f : sa ;
+    float p1 = 1.0f - map[7], s1 = 1.0f - map[8], t1 = map[3] ;
+
+    for (int c = 0 ; c < 3 ; c++) {
+        float sc = (mode == t_penErase) ? 0.0f : source[c] * coverage ;
+        float q  = (mode == t_penReverse) ? -sc : 0.0f ;
+        map[c]     = p * map[c] + q * t1 + sc ;
+        map[4 + c] = p * map[4 + c] + q * s1 ;
+    }
+    map[3] = s * t1 + t ;
+    map[7] = 1.0f - p * p1 ;
+    map[8] = 1.0f - s * s1 ;
+}
+
+// applies a layer's map to one pixel
+static inline void turtleRaster_applyLayerPixel(uint8_t *pixel, const float *map) {
+    float da = pixel[3] / 255.0f ;
+    float p  = 1.0f - map[7], s = 1.0f - map[8] ;
+
+    for (int c = 0 ; c < 3 ; c++) {
+        float v  = p * (pixel[c] / 255.0f) + map[4 + c] * da + map[c] ;
+        pixel[c] = (uint8_t)(fminf(fmaxf(v, 0.0f), 1.0f) * 255.0f + 0.5f) ;
+    }
+    float a  = s * da + map[3] ;
+    pixel[3] = (uint8_t)(fminf(fmaxf(a, 0.0f), 1.0f) * 255.0f + 0.5f) ;
+}
+
+#pragma mark - Scan Conversion
+
+static inline void turtleRaster_sortCrossings(double *crossings, size_t count) {
+    // insertion sort; a scanline rarely crosses more than a handful of edges
+    for (size_t i = 1 ; i < count ; i++) {
+        double x = crossings[i * 2], winding = crossings[i * 2 + 1] ;
+        size_t j = i ;
+        while (j > 0 && crossings[(j - 1) * 2] > x) {
+            crossings[j * 2]     = crossings[(j - 1) * 2] ;
+            crossings[j * 2 + 1] = crossings[(j - 1) * 2 + 1] ;
+            j-- ;
+        }
+        crossings[j * 2]     = x ;
+        crossings[j * 2 + 1] = winding ;
+    }
+}
+
+// adds weight times the horizontal coverage of [xa, xb) to the row, which starts at pixel column left
+static inline void turtleRaster_accumulateSpan(float *row, int64_t left, size_t width, double xa, double xb, float weight) {
+    double rowLeft = (double)left, rowRight = (double)left + (double)width ;
+    if (xa < rowLeft)  xa = rowLeft ;
+    if (xb > rowRight) xb = rowRight ;
+    if (!(xb > xa)) return ;
+
+    int64_t first = (int64_t)floor(xa) ;
+    int64_t last  = (int64_t)ceil(xb) - 1 ;
+    if (first == last) {
+        row[first - left] += weight * (float)(xb - xa) ;
+        return ;
+    }
+    row[first - left] += weight * (float)((double)(first + 1) - xa) ;
+    for (int64_t i = first + 1 ; i < last ; i++) row[i - left] += weight ;
+    row[last - left] += weight * (float)(xb - (double)last) ;
+}
+
+// Fills the raster's polygon with the color (RGBA, not premultiplied) using the pen mode. Returns
+// false if memory could not be allocated for scratch space or tiles. Tiles with T_LAYER_PIXEL_BYTES
+// per pixel are layers and have the operation chained onto their maps instead.
+static bool turtleRaster_fillPolygon(turtleRaster *raster, turtleTileCache *tiles, const double *color, uint32_t mode) {
+    turtlePolygon *polygon = &raster->polygon ;
+    bool          layered  = (tiles->bytesPerPixel == T_LAYER_PIXEL_BYTES) ;
+    if (polygon->count < 3 || !(color[3] > 0.0)) return true ;
+
+    double minX = polygon->points[0], maxX = minX, minY = polygon->points[1], maxY = minY ;
+    for (size_t i = 1 ; i < polygon->count ; i++) {
+        minX = fmin(minX, polygon->points[i * 2]) ;     maxX = fmax(maxX, polygon->points[i * 2]) ;
+        minY = fmin(minY, polygon->points[i * 2 + 1]) ; maxY = fmax(maxY, polygon->points[i * 2 + 1]) ;
+    }
+    // the tile coordinates are clamped to int32, so the pixel space is as well
+    double limit = (double)INT32_MAX * (double)tiles->tilePixels ;
+    if (!(minX > -limit && maxX < limit && minY > -limit && maxY < limit)) return true ;
+
+    int64_t left   = (int64_t)floor(minX) ;
+    int64_t bottom = (int64_t)floor(minY) ;
+    int64_t top    = (int64_t)ceil(maxY) ;
+    size_t  width  = (size_t)((int64_t)ceil(maxX) - left) + 1 ;
+
+    size_t oldCapacity = raster->coverageCapacity ;
+    if (!turtleLog_grow((void **)&raster->coverage, &raster->coverageCapacity, width, sizeof(float))) return false ;
+    if (raster->coverageCapacity != oldCapacity) memset(raster->coverage, 0, raster->coverageCapacity * sizeof(float)) ;
+    if (!turtleLog_grow((void **)&raster->crossings, &raster->crossingCapacity, polygon->count * 2, sizeof(double))) return false ;
+
+    float   source[4] = { (float)(color[0] * color[3]), (float)(color[1] * color[3]), (float)(color[2] * color[3]), (float)color[3] } ;
+    int64_t tp        = (int64_t)tiles->tilePixels ;
+    float   weight    = 1.0f / T_RASTER_SUBSAMPLES ;
+
+    for (int64_t j = bottom ; j < top ; j++) {
+        float   *row    = raster->coverage ;
+        double  spanMin = INFINITY, spanMax = -INFINITY ;
+
+        for (int s = 0 ; s < T_RASTER_SUBSAMPLES ; s++) {
+            double sy    = (double)j + (s + 0.5) / T_RASTER_SUBSAMPLES ;
+            size_t found = 0 ;
+
+            for (size_t c = 0 ; c < polygon->contourCount ; c++) {
+                size_t from = polygon->contours[c] ;
+                size_t to   = (c + 1 < polygon->contourCount) ? polygon->contours[c + 1] : polygon->count ;
+                for (size_t i = from ; i < to ; i++) {
+                    size_t k   = (i + 1 < to) ? i + 1 : from ;
+                    double ax  = polygon->points[i * 2], ay = polygon->points[i * 2 + 1] ;
+                    double bx  = polygon->points[k * 2], by = polygon->points[k * 2 + 1] ;
+                    if ((ay <= sy && by > sy) || (by <= sy && ay > sy)) {
+                        raster->crossings[found * 2]     = ax + (sy - ay) * (bx - ax) / (by - ay) ;
+                        raster->crossings[found * 2 + 1] = (by > ay) ? 1.0 : -1.0 ;
+                        found++ ;
+                    }
+                }
+            }
+            if (found < 2) continue ;
+            turtleRaster_sortCrossings(raster->crossings, found) ;
+
+            int winding = 0 ;
+            for (size_t i = 0 ; i + 1 < found ; i++) {
+                winding += (int)raster->crossings[i * 2 + 1] ;
+                if (winding != 0) {
+                    double xa = raster->crossings[i * 2], xb = raster->crossings[(i + 1) * 2] ;
+                    turtleRaster_accumulateSpan(row, left, width, xa, xb, weight) ;
+                    spanMin = fmin(spanMin, xa) ;
+                    spanMax = fmax(spanMax, xb) ;
+                }
+            }
+        }
+        if (spanMin > spanMax) continue ;
+
+        // composite the row a tile at a time, clearing the coverage as it's used
+        int64_t from = (int64_t)floor(fmax(spanMin, (double)left)) ;
+        int64_t to   = (int64_t)ceil(fmin(spanMax, (double)left + (double)width)) ;
+        int32_t ty   = (int32_t)((j >= 0) ? j / tp : -((-j - 1) / tp) - 1) ;
+        size_t  y    = (size_t)(tp - 1 - (j - (int64_t)ty * tp)) ;
+
+        for (int64_t i = from ; i < to ; ) {
+            int32_t tx      = (int32_t)((i >= 0) ? i / tp : -((-i - 1) / tp) - 1) ;
+            int64_t tileEnd = ((int64_t)tx + 1) * tp ;
+            int64_t stop    = (to < tileEnd) ? to : tileEnd ;
+            turtleTile *tile = NULL ;
+
+            for ( ; i < stop ; i++) {
+                float coverage = row[i - left] ;
+                row[i - left]  = 0.0f ;
+                if (coverage <= 0.0f) continue ;
+                if (!tile) {
+                    tile = turtleTiles_fetch(tiles, tx, ty) ;
+                    if (!tile) {
+                        memset(row, 0, width * sizeof(float)) ;
+                        return false ;
+                    }
+                    tile->modified = true ;
+                }
+                size_t offset = y * (size_t)tp + (size_t)(i - (int64_t)tx * tp) ;
+                if (layered) {
+                    turtleRaster_composeLayerPixel((float *)(void *)tile->pixels + offset * T_LAYER_CHANNELS, source, fminf(coverage, 1.0f), mode) ;
+                } else {
+                    turtleRaster_compositePixel(tile->pixels + offset * 4, source, fminf(coverage, 1.0f), mode) ;
+                }
+            }
+        }
+    }
+    return true ;
+}
+
+#pragma mark - Commands
+
+// Builds the polygon for the drawing command at idx in pixel space; returns the style used or NULL
+// if the command doesn't draw anything the rasterizer can handle.
+static const turtleStyle *turtleRaster_polygonForCommand(turtleRaster *raster, const turtleLog *log, size_t idx, double scale) {
+    uint8_t           op       = log->ops[idx] ;
+    double            *derived = turtleLog_derived(log, idx) ;
+    const turtleStyle *style   = NULL ;
+    turtlePolygon     *polygon = &raster->polygon ;
+
+    if (!(log->flags[idx] & T_FLAG_DRAWS)) return NULL ;
+    turtlePolygon_reset(polygon) ;
+
+    if (turtleLog_isMove(op)) {
+        style = turtleLog_style(log, derived[t_moveStyle]) ;
+        if (!style) return NULL ;
+        double line[4] = { derived[t_moveX0] * scale, derived[t_moveY0] * scale, derived[t_moveX1] * scale, derived[t_moveY1] * scale } ;
+        if (!turtlePolygon_appendStroke(polygon, line, 2, style->width * scale / 2.0)) return NULL ;
+    } else if (op == c_arc) {
+        style = turtleLog_style(log, derived[t_arcStyle]) ;
+        if (!style) return NULL ;
+        double start, sweep ;
+        turtleArc_angles(log, idx, &start, &sweep) ;
+        if (fabs(sweep) > 2.0 * M_PI) sweep = copysign(2.0 * M_PI, sweep) ;
+
+        // the flattened arc is built in the polygon's own storage, then widened after it
+        size_t segments = turtleArc_segments(log, idx, scale) ;
+        for (size_t i = 0 ; i <= segments ; i++) {
+            double px, py ;
+            turtleArc_point(log, idx, start + sweep * (double)i / (double)segments, &px, &py) ;
+            if (!turtlePolygon_append(polygon, px * scale, py * scale)) return NULL ;
+        }
+        size_t lineCount = polygon->count ;
+        double *line     = malloc(lineCount * 2 * sizeof(double)) ;
+        if (!line) return NULL ;
+        memcpy(line, polygon->points, lineCount * 2 * sizeof(double)) ;
+        turtlePolygon_reset(polygon) ;
+        bool isGood = turtlePolygon_appendStroke(polygon, line, lineCount, style->width * scale / 2.0) ;
+        free(line) ;
+        if (!isGood) return NULL ;
+    } else if (op == c_fillend) {
+        style = turtleLog_style(log, derived[t_fillEndStyle]) ;
+        if (!style) return NULL ;
+        double *vertices = log->fillVertices + (size_t)derived[t_fillEndVertexStart] * 2 ;
+        size_t count     = (size_t)derived[t_fillEndVertexCount] ;
+        if (!turtlePolygon_beginContour(polygon)) return NULL ;
+        for (size_t i = 0 ; i < count ; i++) {
+            if (!turtlePolygon_append(polygon, vertices[i * 2] * scale, vertices[i * 2 + 1] * scale)) return NULL ;
+        }
+    }
+    return style ;
+}
+
+// Overlapping moves look the same drawn once as drawn repeatedly only for opaque paint and erase, so
+// only those can be decimated as a run -- the same rule hs.canvas.turtle uses for coalescing moves.
+static inline bool turtleRaster_canCoalesce(const turtleLog *log, size_t idx) {
+    if (!(log->flags[idx] & T_FLAG_DRAWS) || !turtleLog_isMove(log->ops[idx])) return false ;
+    const turtleStyle *style = turtleLog_style(log, turtleLog_derived(log, idx)[t_moveStyle]) ;
+    return style && style->mode != t_penReverse && log->colors[(size_t)style->color * 4 + 3] >= 1.0 ;
+}
+
+// Rasterizes the run of moves sharing the style of the move at *idx, skipping over commands which
+// don't draw, after decimating it to the raster's tolerance. *idx is left at the first command not
+// included. Returns false if memory could not be allocated.
+static bool turtleRaster_renderMoves(turtleRaster *raster, turtleTileCache *tiles, const turtleLog *log, size_t *idx, size_t end, double scale) {
+    double            styleIdx   = turtleLog_derived(log, *idx)[t_moveStyle] ;
+    const turtleStyle *style     = turtleLog_style(log, styleIdx) ;
+    turtleDecimator   *decimator = &raster->decimator ;
+    size_t            moves      = 0 ;
+    size_t            i          = *idx ;
+
+    turtleDecimator_reset(decimator, raster->tolerance) ;
+    for ( ; i < end && moves < T_RASTER_MAX_RUN ; i++) {
+        if (!(log->flags[i] & T_FLAG_DRAWS)) continue ;
+        if (!turtleLog_isMove(log->ops[i]) || turtleLog_derived(log, i)[t_moveStyle] != styleIdx) break ;
+        double *derived = turtleLog_derived(log, i) ;
+        if (!turtleDecimator_addSegment(decimator, derived[t_moveX0] * scale, derived[t_moveY0] * scale,
+                                                   derived[t_moveX1] * scale, derived[t_moveY1] * scale)) return false ;
+        moves++ ;
+    }
+    *idx = i ;
+    if (!turtleDecimator_finish(decimator)) return false ;
+
+    const double *color = log->colors + (size_t)style->color * 4 ;
+    for (size_t line = 0 ; line < decimator->lineCount ; line++) {
+        const double *points = turtleDecimator_linePoints(decimator, line) ;
+        size_t       count   = turtleDecimator_lineLength(decimator, line) ;
+        for (size_t n = 0 ; n + 1 < count ; n++) {
+            turtlePolygon_reset(&raster->polygon) ;
+            if (!turtlePolygon_appendStroke(&raster->polygon, points + n * 2, 2, style->width * scale / 2.0)) return false ;
+            if (!turtleRaster_fillPolygon(raster, tiles, color, style->mode)) return false ;
+        }
+    }
+    return true ;
+}
+
+// Rasterizes the commands from start up to (but not including) end into the tiles. Returns false
+// if memory could not be allocated, in which case the tiles are incomplete.
+static inline bool turtleRaster_render(turtleRaster *raster, turtleTileCache *tiles, const turtleLog *log, size_t start, size_t end) {
+    double scale = (double)tiles->tilePixels / tiles->tileSize ;
+    if (end > log->count) end = log->count ;
+
+    for (size_t idx = start ; idx < end ; ) {
+        if (raster->tolerance > 0.0 && turtleRaster_canCoalesce(log, idx)) {
+            if (!turtleRaster_renderMoves(raster, tiles, log, &idx, end, scale)) return false ;
+            continue ;
+        }
+        const turtleStyle *style = turtleRaster_polygonForCommand(raster, log, idx++, scale) ;
+        if (!style) continue ;
+        if (!turtleRaster_fillPolygon(raster, tiles, log->colors + (size_t)style->color * 4, style->mode)) return false ;
+    }
+    return true ;
+}
@@ -0,0 +1,110 @@
+// Yield scheduling for hs.canvas.turtle:_background
+//
+// Plain C so it can be used (and measured) outside of Hammerspoon -- nothing in here knows about
+// AppKit or Lua. A backgrounded drawing function runs in slices between yields. By default a slice
+// ends after a fixed number of commands; with a time budget set, a slice instead ends once it has
+// run for that long according to a monotonic clock.
+//
+// Reading the clock after every command would cost more than many of the commands themselves, so the
+// number of commands until the next reading adapts to how quickly commands are actually arriving:
+// each reading schedules the next one for when about half of the remaining budget should have been
+// used, and the first reading of a slice is placed using what fit into previous slices. A run of
+// expensive commands (labels, large fills) is caught within a reading or two rather than after a
+// fixed count, and a run of cheap moves reads the clock only a handful of times per slice.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+typedef struct {
+    double   budget ;             // seconds per slice; 0 to end slices by count instead
+    uint64_t sliceStart ;         // nanoseconds; 0 when no slice is open
+    size_t   sliceCommands ;      // commands so far in the open slice
+    size_t   nextReading ;        // sliceCommands at which the clock is next read
+    double   commandsPerSlice ;   // running estimate of how many commands fit within the budget
+
+    // statistics
+    size_t   slices ;
+    double   totalTime ;          // seconds
+    double   worstOverrun ;       // seconds beyond the budget (or 0 if never over)
+    size_t   totalCommands ;
+    size_t   clockReadings ;
+} turtleYield ;
+
+static inline uint64_t turtleYield_now(void) {
+    struct timespec now ;
+    clock_gettime(CLOCK_MONOTONIC, &now) ;
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec ;
+}
+
+static inline void turtleYield_init(turtleYield *yield) {
+    memset(yield, 0, sizeof(turtleYield)) ;
+    yield->commandsPerSlice = 500.0 ;
+}
+
+static inline void turtleYield_resetStatistics(turtleYield *yield) {
+    yield->slices        = 0 ;
+    yield->totalTime     = 0.0 ;
+    yield->worstOverrun  = 0.0 ;
+    yield->totalCommands = 0 ;
+    yield->clockReadings = 0 ;
+}
+
+// closes the open slice, if any, recording how long it ran
+static inline void turtleYield_endSlice(turtleYield *yield, uint64_t now) {
+    if (yield->sliceStart == 0) return ;
+    double elapsed = (double)(now - yield->sliceStart) / 1e9 ;
+
+    yield->slices++ ;
+    yield->totalTime     += elapsed ;
+    yield->totalCommands += yield->sliceCommands ;
+    if (yield->budget > 0.0) {
+        if (elapsed - yield->budget > yield->worstOverrun) yield->worstOverrun = elapsed - yield->budget ;
+        // only slices which used up the budget say anything about how many commands fit within it
+        if (elapsed >= yield->budget && yield->sliceCommands > 0) {
+            double fit = (double)yield->sliceCommands * yield->budget / elapsed ;
+            yield->commandsPerSlice = fmax(1.0, (yield->commandsPerSlice + fit) / 2.0) ;
+        }
+    }
+    yield->sliceStart = 0 ;
+}
+
+// Called after every commands commands have been issued; returns true if the caller should yield
+// now. ratio is the number of commands per slice when no budget is set.
+static inline bool turtleYield_check(turtleYield *yield, size_t commands, size_t ratio) {
+    if (yield->sliceStart == 0) {
+        yield->sliceStart    = turtleYield_now() ;
+        yield->sliceCommands = 0 ;
+        yield->nextReading   = (size_t)fmax(1.0, yield->commandsPerSlice / 2.0) ;
+        yield->clockReadings++ ;
+    }
+    yield->sliceCommands += commands ;
+
+    if (!(yield->budget > 0.0)) {
+        if (yield->sliceCommands < ratio) return false ;
+        yield->clockReadings++ ;
+        turtleYield_endSlice(yield, turtleYield_now()) ;
+        return true ;
+    }
+
+    if (yield->sliceCommands < yield->nextReading) return false ;
+
+    uint64_t now     = turtleYield_now() ;
+    double   elapsed = (double)(now - yield->sliceStart) / 1e9 ;
+    yield->clockReadings++ ;
+    if (elapsed >= yield->budget) {
+        turtleYield_endSlice(yield, now) ;
+        return true ;
+    }
+
+    // commands are arriving at sliceCommands / elapsed per second; read again about halfway to the
+    // point where the budget should run out
+    double remaining = (elapsed > 0.0) ? (yield->budget - elapsed) * (double)yield->sliceCommands / elapsed
+                                       : yield->commandsPerSlice ;
+    yield->nextReading = yield->sliceCommands + (size_t)fmax(1.0, remaining / 2.0) ;
+    return false ;
+}